@@ -11,15 +11,41 @@
 #include <stdlib.h>
 #include <vector>
 #include <math.h>
+#include <cmath>
 #include <getopt.h>
 #include <iomanip>
+#include <algorithm>
+#include <chrono>
 
 #include "IVFit2NLLS.h"
+#include "IVDataReader.h"
+#include "IVTrack.h"
+#include "IVBatch.h"
 #include "DoubleProbeAnalysis.h"
+#include "nlls_utils/bootstrap.h"
+#include "nlls_utils/multistart.h"
+#include "nlls_utils/adc_input.h"
+#include "nlls_utils/input_stream.h"
+
+//Batch of files, defined after main
+static int RunBatch(const std::vector<std::string> &input_files,
+                    const struct IVBatchOptions &Opts,
+                    const struct IVFit2Params &Guess);
+
+#ifdef WITH_MPI
+static const int mpi_batch = 1; //Every run is a batch over the MPI ranks
+#else
+static const int mpi_batch = 0;
+#endif
 
 /************************************************************************/
 int main(int argc, char** argv){
 
+#ifdef WITH_MPI
+   //Every rank runs main, only rank 0 prints
+   if(MPIBatchInit(&argc, &argv) > 0){ std::cout.setstate(std::ios::failbit); }
+#endif
+
 std::cout << "-- BEGIN DoubleProbeAnalysis --" << std::endl;
 
    /*
@@ -32,8 +58,43 @@ std::cout << "-- BEGIN DoubleProbeAnalysis --" << std::endl;
    const int    Max = 100;    //Maximum number of iterations while fitting
    const double Tol = 1.0E-8; //Tolerance for convergence of the curve fit
 
-   int opt = 0;                 //Command line option parser variable
+   int opt   = 0;               //Command line option parser variable
+   int mixed = 0;               //Command line option mixed precision fit
+   int adc_bytes = 0;           //Command line option raw ADC code size
+   int triage    = 1;           //Command line option triage before fitting
    char *input_filename = NULL; //Command line option input file
+   char *list_filename  = NULL; //Command line option file of input files
+   char *store_dir      = NULL; //Command line option results store
+   char *cache_dir      = NULL; //Command line option fit cache
+   char *journal_file   = NULL; //Command line option batch journal
+   char *tune_file      = NULL; //Command line option auto-tune file
+   int64_t shot    = -1;        //Command line option shot number
+   int32_t channel = 0;         //Command line option channel
+
+   //Robust loss of the fit (zero = least squares)
+   struct NLLSLoss Loss = {NLLS_LOSS_L2, 0.0};
+
+   //Batch of files: every -f plus the files listed in -l
+   std::vector<std::string> input_files;
+
+   //Bootstrap options: # resampled fits (0 = off), threads, seed, scheme
+   struct BootstrapOptions BootOpts = {0, 0, 12345, BOOT_RESIDUALS, 0.95};
+
+   //Multi-start options: # initial guesses (0 = off), threads, seed,
+   //truncated iterations, # polished candidates, noise floor tolerance
+   struct MultiStartOptions MSOpts = {0, 0, 12345, 5, 4, 1.0};
+
+   //Tracking options: window (0 = off), stride (0 = window / 4),
+   //relative drift that relinearizes
+   struct IVTrackOptions TrackOpts = {0, 0, 0.01};
+
+   //Raw ADC input: V = gain[0] * code + offset[0], I = gain[1] * code
+   //+ offset[1]
+   struct ADCCalibration Cal = {{1.0, 1.0}, {0.0, 0.0}};
+   struct ADCTrace Raw = {0, 0};
+
+   //Voltages on a uniform grid (N = 0: none), for the fit in +/-V pairs
+   struct IVGrid Grid = {0, 0.0, 0.0};
 
    //Parse the command line
    if(1 == argc){
@@ -43,16 +104,135 @@ std::cout << "-- BEGIN DoubleProbeAnalysis --" << std::endl;
        
    }
       
-   while((opt = getopt(argc, argv,"-f:")) != -1) {
+   while((opt = getopt(argc, argv,"-f:l:mB:PS:j:M:T:s:r:a:g:D:N:C:K:J:A:R:Q")) != -1) {
      
       switch (opt) {
          
          case 'f' : //input filename option
             
             input_filename = optarg;
+            input_files.push_back(optarg);
             std::cout << "Input Filename: " << input_filename;
             std::cout << std::endl;
             break;
+
+         case 'l' : //file with a list of input files option
+
+            list_filename = optarg;
+            break;
+
+         case 'D' : //results store directory option
+
+            store_dir = optarg;
+            break;
+
+         case 'K' : //fit cache directory option
+
+            cache_dir = optarg;
+            break;
+
+         case 'J' : //batch journal option
+
+            journal_file = optarg;
+            break;
+
+         case 'A' : //auto-tune file option
+
+            tune_file = optarg;
+            break;
+
+         case 'N' : //shot number option
+
+            shot = strtoll(optarg, NULL, 10);
+            break;
+
+         case 'C' : //channel option
+
+            channel = atoi(optarg);
+            break;
+
+         case 'm' : //mixed precision fit option
+
+            mixed = 1;
+            std::cout << "Mixed precision fit" << std::endl;
+            break;
+
+         case 'Q' : //fit without triage option
+
+            triage = 0;
+            std::cout << "No triage, every trace is fitted" << std::endl;
+            break;
+
+         case 'R' : //robust loss option
+
+            if(!NLLSLossParse(optarg, Loss)){
+
+               std::cerr << "Robust loss must be huber[,c] or tukey[,c]" << std::endl;
+               print_usage();
+               return (-1);
+
+            }
+            std::cout << "Robust fit: " << NLLSLossName(Loss) << ", c = ";
+            std::cout << Loss.c << std::endl;
+            break;
+
+         case 'B' : //bootstrap # resampled fits option
+
+            BootOpts.Nboot = atoi(optarg);
+            break;
+
+         case 'P' : //bootstrap resampling of (V, I) pairs option
+
+            BootOpts.mode = BOOT_PAIRS;
+            break;
+
+         case 'S' : //bootstrap random seed option
+
+            BootOpts.seed = strtoull(optarg, NULL, 10);
+            MSOpts.seed   = BootOpts.seed;
+            break;
+
+         case 'j' : //number of threads option
+
+            BootOpts.Nthreads = atoi(optarg);
+            MSOpts.Nthreads   = BootOpts.Nthreads;
+            break;
+
+         case 'M' : //multi-start # initial guesses option
+
+            MSOpts.Nstart = atoi(optarg);
+            break;
+
+         case 'T' : //tracking window # samples option
+
+            TrackOpts.Nwindow = atoi(optarg);
+            break;
+
+         case 's' : //tracking stride # samples option
+
+            TrackOpts.stride = atoi(optarg);
+            break;
+
+         case 'r' : //tracking relative drift option
+
+            TrackOpts.drift = atof(optarg);
+            break;
+
+         case 'a' : //raw ADC input, bits per code option
+
+            adc_bytes = atoi(optarg) / 8;
+            break;
+
+         case 'g' : //raw ADC calibration option
+
+            if(!ParseADCCalibration(optarg, Cal)){
+
+               std::cerr << "Calibration must be gV,oV,gI,oI" << std::endl;
+               print_usage();
+               return (-1);
+
+            }
+            break;
             
          case '?': //unrecognized command line option
             
@@ -72,55 +252,280 @@ std::cout << "-- BEGIN DoubleProbeAnalysis --" << std::endl;
         
    }
    
+   //Several files are fitted as a read -> fit -> write pipeline, and so
+   //is any file looked up in the fit cache or the journal, auto-tuned
+   //or fitted over MPI
+   if((NULL != list_filename) || (input_files.size() > 1) || (NULL != cache_dir) ||
+      (NULL != journal_file) || (NULL != tune_file) || mpi_batch){
+
+      struct IVFit2Params Guess = {Is_guess, Te_guess, 2, Loss};
+      struct BatchJournal Journal;
+      std::vector<std::string> listed;
+      int res = 0;
+
+      //Two readers keep a fit thread busy while the other waits on the disk
+      struct IVBatchOptions BatchOpts = {{2, BootOpts.Nthreads, 0}, mixed,
+                                         adc_bytes, Cal, store_dir, channel,
+                                         cache_dir, NULL, triage};
+
+      if((NULL != list_filename) && !ReadFileList(list_filename, listed)){
+
+         return (-1);
+
+      }
+      input_files.insert(input_files.end(), listed.begin(), listed.end());
+
+      if((BootOpts.Nboot > 0) || (MSOpts.Nstart > 0) || (TrackOpts.Nwindow > 0) ||
+         (shot >= 0)){
+
+         std::cerr << "-B, -M, -T and -N only apply to a single file without -K, -J";
+         std::cerr << " (or MPI),";
+         std::cerr << " ignored";
+         std::cerr << std::endl;
+
+      }
+
+      //-m and -j given on the command line win over the tuned values
+      if((NULL != tune_file) && !input_files.empty()){
+
+         struct AutoTuneConfig Tune;
+
+         if(mpi_batch){
+
+            std::cerr << "-A tunes the threads of one process, not over MPI, ignored";
+            std::cerr << std::endl;
+
+         }else if(IVBatchTune(tune_file, input_files[0].c_str(), BatchOpts, Guess, Tune)){
+
+            if(!mixed){ BatchOpts.mixed = Tune.mixed; }
+            if(0 == BatchOpts.Pipe.Nworkers){ BatchOpts.Pipe.Nworkers = Tune.Nworkers; }
+            BatchOpts.Pipe.Nqueue = BatchOpts.Pipe.Nworkers * (Tune.Nqueue / Tune.Nworkers);
+
+            std::cout << "Auto-tuned: " << (BatchOpts.mixed ? "mixed precision" : "double");
+            std::cout << " fit, " << BatchOpts.Pipe.Nworkers << " fit threads, queues of ";
+            std::cout << BatchOpts.Pipe.Nqueue << " traces (" << 1.0E3 * Tune.t_trace;
+            std::cout << " ms / trace)" << std::endl;
+
+         }else{
+
+            std::cerr << "Auto-tuning failed, default configuration" << std::endl;
+
+         }
+
+      }
+
+      if(NULL != journal_file){
+
+         if(!OpenBatchJournal(journal_file, Journal)){ return (-1); }
+         BatchOpts.journal = &Journal;
+
+      }
+
+      res = RunBatch(input_files, BatchOpts, Guess);
+      if(NULL != journal_file){ CloseBatchJournal(Journal); }
+
+      return (res);
+
+   }
+
    std::vector<double> Ii, //I (input current)
                        Vi, //V (input voltage)
+                       Si, //sigma_I (input current uncertainty)
+                       Wi, //Weights 1 / sigma_I^2
                        Ia; //I (current using fitted parameters)
 
    //Array used to store initial fit parameter guesses
-   struct IVFit2Params FitParams = {Is_guess, Te_guess, 2};
+   struct IVFit2Params FitParams = {Is_guess, Te_guess, 2, Loss};
    std::cout.precision(3);
    std::cout << "Initial fit parameters: " << std::endl;
    std::cout << " Ion saturation current [A]  : " << Is_guess << std::endl;
    std::cout << " Electron temperature   [eV] : " << Te_guess << std::endl;
    
-   //Input and Output string information
-   std::string input_filename_s(input_filename);
-   std::ifstream input_file(input_filename_s.c_str(), std::ifstream::in);
-   
-   //Attempt to read the input file
-   if(input_file.is_open()){
-     
-      std::cout << "Reading IV data..." << std::endl;
-      double col1 = 0.0,
-             col2 = 0.0;
-     
-      while(input_file.good()){
-        
-         input_file >> col1 >> col2;
-        
-         if(!input_file.eof()){ //Last line is not stored twice
-           
-            Vi.push_back(col1);
-            Ii.push_back(col2);
-           
+   //Attempt to read the input file, a third column holds sigma_I
+   if(adc_bytes > 0){
+
+      std::cout << "Reading raw ADC trace (" << 8 * adc_bytes;
+      std::cout << " bit codes)..." << std::endl;
+      if(!ReadADCTrace(input_filename, adc_bytes, Cal, Raw)){
+
+         return (-1);
+
+      }
+      std::cout << " # samples: " << Raw.Nsamples << std::endl;
+
+      //The fit reads the codes directly, the other analyses need doubles
+      if(mixed || (MSOpts.Nstart > 0) || (BootOpts.Nboot > 0) ||
+         (TrackOpts.Nwindow > 0)){
+
+         std::cout << " converting to double for -m, -M, -B or -T" << std::endl;
+         Vi.resize(Raw.Nsamples);
+         Ii.resize(Raw.Nsamples);
+         for(unsigned long i = 0; i < Raw.Nsamples; i++){
+
+            Vi[i] = ADCX(Raw, i);
+            Ii[i] = ADCY(Raw, i);
+
          }
-       
+
       }
-     
+
    }else{
-     
-      std::cerr << "Error opening file:" << input_filename_s.c_str();
+
+      std::cout << "Reading IV data..." << std::endl;
+      if(!ReadIVData(input_filename, Vi, Ii, Si)){
+
+         return (-1);
+
+      }
+
+      //The other analyses keep reading the column
+      if(!mixed && IVUniformGrid(Vi, Grid)){
+
+         std::cout << " uniform voltage grid: " << Grid.start << " V in steps of ";
+         std::cout << Grid.step << " V" << std::endl;
+
+      }
+
+   }
+
+   //A trace that cannot fit is not fitted
+   if(triage){
+
+      struct TriageStats Tri;
+
+      IVTriage(Vi, Ii, Raw, Tri);
+      std::cout << "Triage: " << TriageName(Tri.reason) << " (I from " << Tri.ymin;
+      std::cout << " to " << Tri.ymax << " A";
+      if((TRIAGE_OK == Tri.reason) || (TRIAGE_LOW_SNR == Tri.reason)){
+
+         std::cout << ", signal / noise " << Tri.snr;
+
+      }
+      std::cout << ")" << std::endl;
+      if(TRIAGE_OK != Tri.reason){
+
+         std::cerr << "Trace rejected, not fitted (-Q fits it anyway)" << std::endl;
+         return (-1);
+
+      }
+
+   }
+
+   //Weight the fit with 1 / sigma^2 if uncertainties were given
+   if(SigmaToWeights(Si, Wi)){
+
+      std::cout << "Weighted fit using sigma_I from column 3" << std::endl;
+
+   }else if(!Si.empty()){
+
+      std::cerr << "Non-positive sigma_I found, using equal weights";
       std::cerr << std::endl;
-      return (-1);
-      
-   }//Done attempting to read file
-   
-   input_file.close();
-      
+
+   }
+
+   /*
+    * Multi-start search for the initial guess. The box is set by the
+    * data: Isat within a factor 5 of max|I| and Te from max|V| / 200
+    * (a step) to 2 max|V| (almost linear), both sampled in log.
+    */
+   if(MSOpts.Nstart > 0){
+
+      double Imax = 0.0,
+             Vmax = 0.0;
+
+      for(unsigned int i = 0; i < Vi.size(); i++){
+
+         Imax = std::max(Imax, fabs(Ii[i]));
+         Vmax = std::max(Vmax, fabs(Vi[i]));
+
+      }
+
+      std::vector<double> p0(2), lo(2), hi(2), best;
+      std::vector<int> logscale(2, 1);
+      struct MultiStartResult MS;
+
+      p0[0] = FitParams.Isat; lo[0] = 0.2 * Imax;   hi[0] = 5.0 * Imax;
+      p0[1] = FitParams.Te;   lo[1] = Vmax / 200.0; hi[1] = 2.0 * Vmax;
+
+      //Niter = 0 runs the fit to convergence. The guesses are ranked by
+      //the least squares chi^2, only the final fit is robust.
+      auto fit = [&](double *param, unsigned int Niter, double &chi2){
+
+         struct IVFit2Params P = {param[0], param[1], 2};
+
+         if(!IVFit2NLLS(Ii, Vi, Wi, (0 == Niter) ? Max : Niter, Tol, P)){
+
+            return (0);
+
+         }
+
+         param[0] = P.Isat;
+         param[1] = P.Te;
+         chi2 = P.Stats.chi2;
+
+         return (int)(std::isfinite(P.Isat) && std::isfinite(P.Te));
+
+      };
+
+      std::cout << "Multi-start search (" << MSOpts.Nstart;
+      std::cout << " initial guesses)..." << std::endl;
+
+      if(MultiStart(p0, lo, hi, logscale, NoiseFloorChi2(Vi, Ii, Wi, 2), fit,
+                                                      MSOpts, best, MS)){
+
+         //Isat * tanh(V / 2Te) is unchanged by flipping both signs
+         if(best[1] < 0.0){ best[0] = -best[0]; best[1] = -best[1]; }
+
+         FitParams.Isat = best[0];
+         FitParams.Te   = best[1];
+         std::cout << " # truncated fits: " << MS.Nrun;
+         std::cout << (MS.early ? " (stopped at noise floor)" : "");
+         std::cout << std::endl;
+         std::cout << " noise floor  : " << MS.floor << std::endl;
+         std::cout << " best chi^2   : " << MS.chi2 << " (guess #";
+         std::cout << MS.best << ")" << std::endl;
+
+      }else{
+
+         std::cout << "Multi-start search failed, using initial guess";
+         std::cout << std::endl;
+
+      }
+
+   }
+
    //Perform the double probe curve fit using non-linear least squares
    std::cout << "Performing curve fit..." << std::endl;
-   if(IVFit2NLLS(Ii, Vi, Max, Tol, FitParams)){
-      
+   std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+   const int fit_ok = mixed ? IVFit2NLLSMixed(Ii, Vi, Wi, Max, Tol, FitParams)
+                    : (Vi.empty() && (adc_bytes > 0))
+                      ? IVFit2NLLSADC(Raw, Max, Tol, FitParams)
+                    : (Grid.N > 0) ? IVFit2NLLS(Ii, Grid, Wi, Max, Tol, FitParams)
+                      : IVFit2NLLS(Ii, Vi, Wi, Max, Tol, FitParams);
+   const double t_fit = std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                                                      - t0).count();
+
+   if(fit_ok){
+
+      if(mixed){
+
+         std::cout << " # float32 iterations: " << FitParams.Stats.Niter_f32;
+         std::cout << std::endl;
+
+      }
+      std::cout << " # iterations: " << FitParams.Stats.Niter << std::endl;
+      std::cout << " |dparam|^2  : " << FitParams.Stats.dparam2 << std::endl;
+      std::cout << " step / err  : " << FitParams.Stats.step << std::endl;
+      std::cout << " stopped on  : " << NLLSStopName(FitParams.Stats.stop) << std::endl;
+      std::cout << " chi^2       : " << FitParams.Stats.chi2 << std::endl;
+      std::cout << " chi^2 / dof : " << FitParams.Stats.chi2_red << std::endl;
+      std::cout << " R^2         : " << FitParams.Stats.R2 << std::endl;
+      if(NLLS_LOSS_L2 != Loss.type){
+
+         std::cout << " scale       : " << FitParams.Stats.scale << std::endl;
+         std::cout << " # outliers  : " << FitParams.Stats.Noutliers << std::endl;
+
+      }
       std::cout << "Curve fit successful!" << std::endl;
       
    }else{
@@ -133,44 +538,145 @@ std::cout << "-- BEGIN DoubleProbeAnalysis --" << std::endl;
    std::cout.precision(3);
    std::cout << "Final fit parameters: " << std::endl;
    std::cout << " Ion saturation current [A]  : " << FitParams.Isat;
-   std::cout << std::endl;
+   std::cout << " +/- " << FitParams.Stats.err[0] << std::endl;
    std::cout << " Electron temperature   [eV] : " << FitParams.Te;
-   std::cout << std::endl;
+   std::cout << " +/- " << FitParams.Stats.err[1] << std::endl;
    
-   //Declare and write the output file
-   std::string output_filename_s(input_filename);
-   output_filename_s.resize(output_filename_s.length()-4);
-   output_filename_s.append("_fit.dat");
-   std::ofstream output_file(output_filename_s.c_str(), std::ofstream::out);
-   output_file << std::scientific;
-   
-   //Attempt to open the output file
-   if(output_file.is_open()){
-     
-      std::cout << "Writing fit data to file: " << output_filename_s.c_str();
-      std::cout << std::endl;
-      double col1 = 0.0,
-             col2 = 0.0;
-     
-      for(std::vector<double>::iterator itr = Vi.begin(); itr != Vi.end();
-                                                                   ++itr){
-            
-            col1 = *itr;
-            col2 = Iv(col1, FitParams.Isat, FitParams.Te);
-            output_file << col1 << " ";
-            output_file << col2 << std::endl;
-         
+   //Bootstrap percentile intervals of the fitted parameters
+   if(BootOpts.Nboot > 0){
+
+      std::vector<double> If(Vi.size()),
+                          p0(2);
+      struct BootstrapResult Boot;
+
+      for(unsigned int i = 0; i < Vi.size(); i++){
+
+         If[i] = Iv(Vi[i], FitParams.Isat, FitParams.Te);
+
       }
-     
-   }else{
-     
-      std::cerr << "Error opening file:" << output_filename_s.c_str();
-      std::cerr << std::endl;
+      p0[0] = FitParams.Isat;
+      p0[1] = FitParams.Te;
+
+      //Refit one resampled data set, warm started from the nominal fit
+      auto refit = [&](const std::vector<double> &Vb,
+                       const std::vector<double> &Ib,
+                       const std::vector<double> &Wb, double *param){
+
+         struct IVFit2Params P = {param[0], param[1], 2, Loss};
+
+         if(!IVFit2NLLS(Ib, Vb, Wb, Max, Tol, P)){ return (0); }
+
+         param[0] = P.Isat;
+         param[1] = P.Te;
+
+         return (int)(std::isfinite(P.Isat) && std::isfinite(P.Te));
+
+      };
+
+      std::cout << "Bootstrap (" << BootOpts.Nboot << " resampled fits, ";
+      std::cout << ((BOOT_PAIRS == BootOpts.mode) ? "pairs" : "residuals");
+      std::cout << ", seed " << BootOpts.seed << ")..." << std::endl;
+
+      if(Bootstrap(Vi, Ii, Wi, If, p0, refit, BootOpts, Boot)){
+
+         std::cout << " # successful fits: " << Boot.Nok << std::endl;
+         std::cout << " " << 100.0 * BootOpts.CL;
+         std::cout << "% percentile intervals: " << std::endl;
+         std::cout << " Ion saturation current [A]  : [" << Boot.lo[0];
+         std::cout << ", " << Boot.hi[0] << "]" << std::endl;
+         std::cout << " Electron temperature   [eV] : [" << Boot.lo[1];
+         std::cout << ", " << Boot.hi[1] << "]" << std::endl;
+
+      }else{
+
+         std::cout << "Bootstrap failed" << std::endl;
+
+      }
+
+   }
+
+   /*
+    * Time resolved (Isat, Te) along the record from a sliding window,
+    * warm started from the fit of the whole record
+    */
+   if(TrackOpts.Nwindow > 0){
+
+      std::vector<struct IVTrackPoint> Track;
+      unsigned long Nrelin = 0;
+
+      if(0 == TrackOpts.stride){ TrackOpts.stride = std::max(1u, TrackOpts.Nwindow / 4); }
+
+      std::cout << "Tracking (window " << TrackOpts.Nwindow << ", stride ";
+      std::cout << TrackOpts.stride << ")..." << std::endl;
+
+      if(IVTrack(Ii, Vi, Wi, TrackOpts, FitParams, Track, Nrelin)){
+
+         std::string track_filename_s(InputStem(input_filename));
+         track_filename_s.append("_track.dat");
+         std::ofstream track_file(track_filename_s.c_str(), std::ofstream::out);
+
+         std::cout << " # windows          : " << Track.size() << std::endl;
+         std::cout << " # relinearizations : " << Nrelin << std::endl;
+
+         if(track_file.is_open()){
+
+            std::cout << "Writing track to file: " << track_filename_s.c_str();
+            std::cout << std::endl;
+            track_file << "#center Isat[A] Te[eV] dIsat[A] dTe[eV] chi2/dof";
+            track_file << std::endl << std::scientific;
+            for(unsigned int k = 0; k < Track.size(); k++){
+
+               track_file << Track[k].center << " " << Track[k].Isat << " ";
+               track_file << Track[k].Te << " " << Track[k].err[0] << " ";
+               track_file << Track[k].err[1] << " " << Track[k].chi2_red;
+               track_file << std::endl;
+
+            }
+
+         }else{
+
+            std::cerr << "Error opening file:" << track_filename_s.c_str();
+            std::cerr << std::endl;
+
+         }
+
+      }else{
+
+         std::cout << "Tracking failed" << std::endl;
+
+      }
+
+   }
+
+   //Write the fitted trace at every input voltage
+   std::string output_filename_s;
+
+   if(!WriteIVFit(input_filename, Vi, Grid, Raw, FitParams, output_filename_s)){
+
       return (-1);
-      
-   }//Done writing output file
-   
-   output_file.close();
+
+   }
+   std::cout << "Writing fit data to file: " << output_filename_s.c_str();
+   std::cout << std::endl;
+
+   //Append the fit to the results store
+   if(NULL != store_dir){
+
+      struct IVBatchResult R;
+      std::vector<struct ResultsRow> Row(1);
+
+      R.read_ok = R.write_ok = 1;
+      R.fit_ok    = fit_ok;
+      R.triage    = TRIAGE_OK;
+      R.Npoints   = Vi.empty() ? Raw.Nsamples : Vi.size();
+      R.t_fit     = t_fit;
+      R.FitParams = FitParams;
+      IVResultsRow(input_filename, shot, channel, R, Row[0]);
+
+      if(!ResultsAppend(store_dir, Row)){ return (-1); }
+      std::cout << "Appended the fit to the store: " << store_dir << std::endl;
+
+   }
       
  
 std::cout << "-- END DoubleProbeAnalysis --" << std::endl;
@@ -178,11 +684,152 @@ return(0);
 
 }
 
+/************************************************************************/
+/*
+ * Fits a batch of files (see IVBatch) and prints one line per file and
+ * the time spent by every pipeline stage
+ */
+static int RunBatch(const std::vector<std::string> &input_files,
+                    const struct IVBatchOptions &Opts,
+                    const struct IVFit2Params &Guess){
+
+   std::vector<struct IVBatchResult> Results;
+   unsigned int Ncached  = 0,
+                Nresumed = 0,
+                Ncrashed = 0,
+                Nrejected = 0;
+   int ok = 0;
+#ifdef WITH_MPI
+   std::vector<struct MPIRankStats> RankStats;
+#else
+   struct PipelineStats Stats;
+#endif
+
+   std::cout << "Batch of " << input_files.size() << " files..." << std::endl;
+
+#ifdef WITH_MPI
+   ok = IVBatchMPI(input_files, Opts, Guess, Results, RankStats);
+#else
+   ok = IVBatch(input_files, Opts, Guess, Results, Stats);
+#endif
+
+   std::cout.precision(4);
+   std::cout << "#file Npoints Isat[A] dIsat[A] Te[eV] dTe[eV] chi2/dof status";
+   std::cout << std::endl;
+   for(unsigned int i = 0; i < input_files.size(); i++){
+
+      const struct IVBatchResult &R = Results[i];
+
+      std::cout << input_files[i] << " " << R.Npoints << " ";
+      std::cout << R.FitParams.Isat << " " << R.FitParams.Stats.err[0] << " ";
+      std::cout << R.FitParams.Te << " " << R.FitParams.Stats.err[1] << " ";
+      std::cout << R.FitParams.Stats.chi2_red << " ";
+      std::cout << (R.crashed ? "crashed" : !R.read_ok ? "read_failed"
+                    : (TRIAGE_OK != R.triage) ? "rejected:"
+                    : !R.fit_ok ? "fit_failed" : !R.write_ok ? "write_failed"
+                    : R.resumed ? "resumed" : R.cached ? "cached" : "ok");
+      if(!R.crashed && R.read_ok && (TRIAGE_OK != R.triage)){
+
+         std::cout << TriageName(R.triage);
+         Nrejected++;
+
+      }
+      std::cout << std::endl;
+      Ncached  += R.cached;
+      Nresumed += R.resumed;
+      Ncrashed += R.crashed;
+
+   }
+
+   if(Opts.triage){
+
+      std::cout << "Triage: " << Nrejected << " of " << input_files.size();
+      std::cout << " files rejected, not fitted" << std::endl;
+
+   }
+   if(NULL != Opts.cache){
+
+      std::cout << "Fit cache: " << Ncached << " of " << input_files.size();
+      std::cout << " files unchanged, not fitted" << std::endl;
+
+   }
+   if(NULL != Opts.journal){
+
+      std::cout << "Journal: " << Nresumed << " of " << input_files.size();
+      std::cout << " files done by an earlier run, not fitted" << std::endl;
+      if(Ncrashed > 0){
+
+         std::cout << "Journal: " << Ncrashed << " files crashed ";
+         std::cout << BatchJournalMaxBegins << " runs, skipped" << std::endl;
+
+      }
+      if(Opts.journal->Nskipped > 0){
+
+         std::cout << "Journal: skipped " << Opts.journal->Nskipped;
+         std::cout << " bytes of torn records" << std::endl;
+
+      }
+
+   }
+#ifdef WITH_MPI
+   PrintMPIRankStats(RankStats);
+#else
+   PrintPipelineStats(Stats);
+#endif
+
+std::cout << "-- END DoubleProbeAnalysis --" << std::endl;
+return (ok ? 0 : -1);
+
+}
+
 /************************************************************************/
 void print_usage(){
    
    std::cout << "Usage:" << std::endl;
-   std::cout << "bin/DoubleProveAnalysis -f <filename>" << std::endl;
+   std::cout << "bin/DoubleProveAnalysis -f <filename> [-f <filename> ...] [-l <list>]";
+   std::cout << " [-m] [-R loss] [-M N] [-B N [-P] [-S seed] [-j N]]";
+   std::cout << " [-T N [-s N] [-r drift]] [-a 16|32 [-g gV,oV,gI,oI]]";
+   std::cout << " [-D store [-N shot] [-C channel]] [-K cache] [-J journal] [-A tune]";
+   std::cout << " [-Q]";
+   std::cout << std::endl;
+   std::cout << "   -l <list> : fit every file listed in <list> (one per line)";
+   std::cout << std::endl;
+   std::cout << "               several files run as a read -> fit -> write pipeline";
+   std::cout << std::endl;
+   std::cout << "   -m : mixed precision (float32 + double refinement) fit";
+   std::cout << std::endl;
+   std::cout << "   -R <loss> : robust fit, huber[,c] or tukey[,c] (c in units of";
+   std::cout << " the residual scale)" << std::endl;
+   std::cout << "   -M <N>    : multi-start search over N initial guesses";
+   std::cout << std::endl;
+   std::cout << "   -B <N>    : bootstrap percentile intervals from N refits";
+   std::cout << std::endl;
+   std::cout << "   -P        : bootstrap resamples (V, I) pairs (default: residuals)";
+   std::cout << std::endl;
+   std::cout << "   -S <seed> : bootstrap / multi-start random seed" << std::endl;
+   std::cout << "   -j <N>    : # threads (default: all cores)" << std::endl;
+   std::cout << "   -T <N>    : track (Isat, Te) with a sliding window of N samples";
+   std::cout << std::endl;
+   std::cout << "   -s <N>    : tracking stride (default: N / 4)" << std::endl;
+   std::cout << "   -r <drift>: relative drift that relinearizes (default: 0.01)";
+   std::cout << std::endl;
+   std::cout << "   -a <bits> : raw interleaved (V, I) int16 / int32 ADC codes";
+   std::cout << std::endl;
+   std::cout << "   -g <cal>  : ADC calibration gV,oV,gI,oI (V = gV * code + oV)";
+   std::cout << std::endl;
+   std::cout << "   -D <dir>  : append every fit to the results store <dir>";
+   std::cout << std::endl;
+   std::cout << "   -N <shot> : shot number (default: digits of the file name)";
+   std::cout << std::endl;
+   std::cout << "   -C <ch>   : channel (default: 0)" << std::endl;
+   std::cout << "   -K <dir>  : fit cache, unchanged files are not fitted again";
+   std::cout << std::endl;
+   std::cout << "   -J <file> : batch journal, a killed batch resumes where it stopped";
+   std::cout << std::endl;
+   std::cout << "   -A <file> : auto-tune -m, -j and the queues for this host, cached";
+   std::cout << " in <file>" << std::endl;
+   std::cout << "   -Q        : fit every trace, no triage of flat, clipped, noisy ...";
+   std::cout << " traces" << std::endl;
    std::cout << "bin/DoubleProbeAnalysis -f ExampleData/ExampleData.dat";
    std::cout << std::endl;
    
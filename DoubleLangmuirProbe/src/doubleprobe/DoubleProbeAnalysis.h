@@ -9,14 +9,64 @@
 #ifndef DoubleProbeAnalysis_h
 #define DoubleProbeAnalysis_h
 
+#include "nlls_utils/robust_loss.h"
+
+/*
+ * Goodness of fit statistics and parameter uncertainties. IVFit2NLLS
+ * computes them from the sums of its last iteration, so they cost no
+ * extra pass over the data. They are evaluated at the parameters of
+ * that iteration, i.e. before the final (converged) step is applied.
+ */
+struct IVFit2Stats{
+
+   double err[2];   //Standard errors of (Isat [A], Te [eV])
+   double cov[4];   //Covariance matrix of (Isat, Te), row major
+   double chi2;     //Weighted sum of squared residuals
+   double chi2_red; //Reduced chi^2, chi2 / (# points - Npar)
+   double R2;       //Coefficient of determination
+   double dparam2;  //Squared norm of the last parameter step
+   double step;     //Largest |step| of the last iteration [standard errors]
+   int    stop;     //Why the fit stopped, NLLS_STOP_*
+   int    Niter;    //Number of iterations
+   int    Niter_f32;//Number of float32 iterations (mixed precision fit)
+   double scale;    //Robust scale of the residuals [A] (robust loss)
+   int    Noutliers;//# residuals beyond c * scale (robust loss)
+
+};
+
 struct IVFit2Params{
   
    double Isat; //Ion saturation current [A]
    double Te;   //Electron temperature [eV]
    int    Npar; //Number of parameters (2)
+   struct NLLSLoss Loss; //Robust loss of the fit (zero = least squares)
+
+   struct IVFit2Stats Stats; //Output: fit statistics
    
 };
 
+/*
+ * Sliding window tracking of (Isat, Te) along a long record, see
+ * IVTrack(...)
+ */
+struct IVTrackOptions{
+
+   unsigned int Nwindow; //# samples in the window
+   unsigned int stride;  //# samples the window moves between outputs
+   double       drift;   //Relative parameter change that relinearizes
+
+};
+
+struct IVTrackPoint{
+
+   unsigned long center; //Sample index of the window center
+   double Isat;          //Ion saturation current [A]
+   double Te;            //Electron temperature [eV]
+   double err[2];        //Standard errors of (Isat, Te)
+   double chi2_red;      //Reduced chi^2 of the window
+
+};
+
 /************************************************************************/
 /*
  * Usage function used to display example calling commands.
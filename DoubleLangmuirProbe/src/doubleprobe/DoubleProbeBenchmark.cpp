@@ -0,0 +1,114 @@
+// -----------------------------------------------------------------------
+//
+//                                DoubleProbeBenchmark.cpp V 0.01
+//
+//                                 (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#include <iostream>
+#include <stdlib.h>
+#include <vector>
+#include <math.h>
+#include <stdint.h>
+#include <getopt.h>
+
+#include "DoubleProbeModel.h"
+#include "nlls_utils/model_bench.h"
+#include "nlls_utils/bootstrap.h"
+
+/************************************************************************/
+/*
+ * Compares the hand-written DoubleProbeModel with the automatically
+ * differentiated DoubleProbeModelAD on a synthetic trace: agreement of
+ * the gradients and the time of one fused Gauss-Newton pass, also on
+ * the sweep as a voltage grid fitted in +/-V pairs.
+ */
+int main(int argc, char** argv){
+
+std::cout << "-- BEGIN DoubleProbeBenchmark --" << std::endl;
+
+   const double Is_true = 5.0E-6; //Ion saturation current [A]
+   const double Te_true = 7.5;    //Electron temperature   [eV]
+   const double V_max   = 60.0;   //Voltage sweep +/- V_max [V]
+
+   int opt = 0;                   //Command line option parser variable
+   unsigned int Npoi  = 200000,   //Command line option # data points
+                Npass = 20;       //Command line option # passes timed
+
+   while((opt = getopt(argc, argv, "n:r:")) != -1){
+
+      switch (opt) {
+
+         case 'n' : //number of data points option
+
+            Npoi = atoi(optarg);
+            break;
+
+         case 'r' : //number of timed passes option
+
+            Npass = atoi(optarg);
+            break;
+
+         default :
+
+            std::cout << "Usage:" << std::endl;
+            std::cout << "build/bin/DoubleProbeBenchmark [-n Npoints] [-r Npasses]";
+            std::cout << std::endl;
+            return (-1);
+
+      }
+
+   }
+
+   if(Npoi < 2){ Npoi = 2; }
+
+   std::vector<double> V(Npoi),
+                       I(Npoi),
+                       maxrel;
+   double p[DoubleProbeModel::Npar] = {Is_true, Te_true},
+          grad[DoubleProbeModel::Npar];
+   uint64_t state = 12345;
+
+   //Synthetic trace with 1% uniform noise
+   for(unsigned int i = 0; i < Npoi; i++){
+
+      double u = ldexp((double)(SplitMix64(state) >> 11), -53) - 0.5;
+
+      V[i] = V_max * (2.0 * i / (Npoi - 1) - 1.0);
+      I[i] = DoubleProbeModel::EvalGrad(V[i], p, grad) + 0.02 * Is_true * u;
+
+   }
+
+   std::cout << "Points: " << Npoi << ", passes: " << Npass << std::endl;
+
+   GradientAgreement<DoubleProbeModel, DoubleProbeModelAD>(V, p, maxrel);
+   std::cout.precision(3);
+   std::cout << "Hand-written vs AD, max relative difference:" << std::endl;
+   std::cout << " I(V)                   : " << maxrel[DoubleProbeModel::Npar];
+   std::cout << std::endl;
+   for(unsigned int k = 0; k < DoubleProbeModel::Npar; k++){
+
+      std::cout << " d/d " << DoubleProbeModel::Name(k) << " [";
+      std::cout << DoubleProbeModel::Unit(k) << "] : " << maxrel[k] << std::endl;
+
+   }
+
+   //The same sweep as a grid, fitted in +/-V pairs
+   const GridSamples G(-V_max, 2.0 * V_max / (Npoi - 1), &I[0], NULL);
+
+   double t_hand = TimeFitPass<DoubleProbeModel>(V, I, p, Npass),
+          t_ad   = TimeFitPass<DoubleProbeModelAD>(V, I, p, Npass),
+          t_grid = TimeFitPassSamples<DoubleProbeModel>(G, Npoi, p, Npass);
+
+   std::cout << "Fused Gauss-Newton pass [ns / point]:" << std::endl;
+   std::cout << " hand-written : " << t_hand << std::endl;
+   std::cout << " AD           : " << t_ad;
+   std::cout << " (x" << t_ad / t_hand << ")" << std::endl;
+   std::cout << " +/-V grid    : " << t_grid;
+   std::cout << " (x" << t_grid / t_hand << ")" << std::endl;
+
+std::cout << "-- END DoubleProbeBenchmark --" << std::endl;
+return (0);
+
+}
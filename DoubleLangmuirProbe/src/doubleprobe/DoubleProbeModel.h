@@ -0,0 +1,102 @@
+// -----------------------------------------------------------------------
+//
+//                                 DoubleProbeModel.h V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef DoubleProbeModel_h
+#define DoubleProbeModel_h
+
+#include <math.h>
+#include <cmath>
+
+#include "nlls_utils/dual.h"
+#include "nlls_utils/nlls_solver.h"
+
+/************************************************************************/
+/*
+ * The typical double probe characteristic trace as a fit model (see
+ * nlls_utils/nlls_solver.h), parameters p = (Isat, Te):
+ *
+ *      I(V) = Isat * tanh(0.5 * e * V / Te)
+ *
+ *      d(I(V))/d(Isat) = tanh(0.5 * e * V / Te)
+ *      d(I(V))/d(Te)   = - Isat * 0.5 * V * (1.0 - tanh(0.5 * V / Te)^2)
+ *                        / Te^2
+ *
+ */
+struct DoubleProbeModel{
+
+   enum{ Npar = 2 };
+
+   static const char *Name(const unsigned int &k){
+
+      static const char *names[Npar] = {"Ion saturation current",
+                                        "Electron temperature"};
+      return (names[k]);
+
+   }
+
+   static const char *Unit(const unsigned int &k){
+
+      static const char *units[Npar] = {"A", "eV"};
+      return (units[k]);
+
+   }
+
+   /*
+    *      @param[in] T V: the voltage difference between the probe tips
+    *      @param[in] T *p: (Isat, Te)
+    *      @param[out] T *grad: d(I(V))/d(Isat), d(I(V))/d(Te)
+    *      @return T: I(V)
+    */
+   template<class T>
+   static inline T EvalGrad(const T &V, const T *p, T *grad){
+
+      const T t = tanh(T(0.5) * V / p[1]);
+
+      grad[0] = t;
+      grad[1] = -p[0] * T(0.5) * V * (T(1.0) - t * t) / (p[1] * p[1]);
+
+      return (p[0] * t);
+
+   }
+
+};
+
+/************************************************************************/
+/*
+ * The same trace written only as an expression. ADModel differentiates
+ * it automatically, DoubleProbeModelAD is a drop in replacement for
+ * DoubleProbeModel (see DoubleProbeBenchmark). New probe models can be
+ * added this way without writing derivative code.
+ */
+struct DoubleProbeExpr{
+
+   enum{ Npar = DoubleProbeModel::Npar };
+
+   static const char *Name(const unsigned int &k){ return (DoubleProbeModel::Name(k)); }
+
+   static const char *Unit(const unsigned int &k){ return (DoubleProbeModel::Unit(k)); }
+
+   template<class X, class P>
+   static inline P Eval(const X &V, const P *p){
+
+      return (p[0] * tanh(X(0.5) * V / p[1]));
+
+   }
+
+};
+
+typedef ADModel<DoubleProbeExpr> DoubleProbeModelAD;
+
+/*
+ * I(-V) = -I(V): the fit of a sweep symmetric about V = 0 evaluates the
+ * tanh once per pair of +/-V samples, see NLLSFitSamples(...)
+ */
+template<> struct NLLSModelOdd<DoubleProbeModel>{ enum{ value = 1 }; };
+template<> struct NLLSModelOdd<DoubleProbeModelAD>{ enum{ value = 1 }; };
+
+#endif
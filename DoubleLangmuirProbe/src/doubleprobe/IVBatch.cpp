@@ -0,0 +1,491 @@
+// -----------------------------------------------------------------------
+//
+//                                     IVBatch.cpp V 0.01
+//
+//                                 (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <math.h>
+
+#include "IVBatch.h"
+#include "IVFit2NLLS.h"
+#include "IVDataReader.h"
+#include "nlls_utils/input_stream.h"
+#include "nlls_utils/fit_cache.h"
+#include "nlls_utils/bootstrap.h"
+
+static const int    Max = 100;    //Maximum number of iterations while fitting
+static const double Tol = 1.0E-8; //Tolerance for convergence of the curve fit
+
+/*
+ * A trace on its way through the pipeline
+ */
+struct IVBatchItem{
+
+   std::vector<double> V, I, S, W; //Trace, uncertainties and weights
+   struct IVGrid G;                //V on a grid (G.N > 0), V is then empty
+   struct ADCTrace Raw;            //Raw trace if Opts.adc_bytes > 0
+   struct IVBatchResult Res;
+   uint64_t key;                   //Fit cache key (Opts.cache)
+   std::string output;             //Cached content of the _fit.dat file
+   uint64_t jkey;                  //Journal key (Opts.journal)
+
+};
+
+/************************************************************************/
+int WriteIVFit(const char *input_filename, const std::vector<double> &V,
+               const struct IVGrid &G, const struct ADCTrace &Raw,
+               const struct IVFit2Params &FitParams, std::string &output_filename){
+
+   output_filename = InputStem(input_filename);
+   output_filename.append("_fit.dat");
+
+   std::ofstream output_file(output_filename.c_str(), std::ofstream::out);
+   double col1 = 0.0,
+          col2 = 0.0;
+   unsigned long Nout = !V.empty() ? V.size() : (G.N > 0) ? G.N : Raw.Nsamples;
+
+   if(!output_file.is_open()){
+
+      std::cerr << "Error opening file:" << output_filename.c_str();
+      std::cerr << std::endl;
+      return (0);
+
+   }
+
+   output_file << std::scientific;
+
+   for(unsigned long i = 0; i < Nout; i++){
+
+      col1 = !V.empty() ? V[i] : (G.N > 0) ? G.start + i * G.step : ADCX(Raw, i);
+      col2 = Iv(col1, FitParams.Isat, FitParams.Te);
+      output_file << col1 << " ";
+      output_file << col2 << std::endl;
+
+   }
+
+   output_file.close();
+
+   return (!output_file.fail());
+
+}//End function WriteIVFit
+
+/************************************************************************/
+void IVResultsRow(const char *input_filename, const int64_t &shot,
+                  const int32_t &channel, const struct IVBatchResult &R,
+                  struct ResultsRow &Row){
+
+   Row.shot     = (shot >= 0) ? shot : ResultsShotFromName(input_filename);
+   Row.t_shot   = ResultsFileTime(input_filename);
+   Row.t_run    = ResultsNow();
+   Row.Npoints  = R.Npoints;
+   Row.channel  = channel;
+   Row.tool     = TOOL_DOUBLEPROBE;
+   Row.Niter    = R.FitParams.Stats.Niter;
+   Row.status   = (TRIAGE_OK != R.triage) ? -R.triage : R.fit_ok;
+   Row.t_fit    = R.t_fit;
+   Row.chi2     = R.FitParams.Stats.chi2;
+   Row.chi2_red = R.FitParams.Stats.chi2_red;
+   Row.R2       = R.FitParams.Stats.R2;
+
+   for(int k = 0; k < ResultsRow::MAXPAR; k++){ Row.p[k] = Row.err[k] = NAN; }
+
+   Row.p[0]   = R.FitParams.Isat;
+   Row.p[1]   = R.FitParams.Te;
+   Row.err[0] = R.FitParams.Stats.err[0];
+   Row.err[1] = R.FitParams.Stats.err[1];
+
+}//End function IVResultsRow
+
+/************************************************************************/
+int IVBatch(const std::vector<std::string> &files,
+            const struct IVBatchOptions &Opts, const struct IVFit2Params &Guess,
+            std::vector<struct IVBatchResult> &Results,
+            struct PipelineStats &Stats){
+
+   int res = 1;
+
+   //Everything the fit of a file depends on besides its content
+   const double opts[] = {TOOL_DOUBLEPROBE, Guess.Isat, Guess.Te, Max, Tol,
+                          (double)Opts.mixed, (double)Opts.adc_bytes,
+                          Opts.cal.gain[0], Opts.cal.offset[0],
+                          Opts.cal.gain[1], Opts.cal.offset[1],
+                          (double)Guess.Loss.type, Guess.Loss.c,
+                          (double)Opts.triage};
+   const std::vector<double> cache_opts(opts, opts + sizeof(opts) / sizeof(double));
+   const uint64_t journal_opts = FitCacheKey(0, cache_opts);
+
+   Results.assign(files.size(), IVBatchResult());
+
+   //Parse the trace, raw codes are converted only for the mixed fit, and
+   //triage it while it is in cache. A cached file is only hashed, a
+   //journaled one not even opened.
+   auto read = [&](unsigned int i, struct IVBatchItem &T){
+
+      uint64_t content = 0;
+
+      T.Res.read_ok = T.Res.fit_ok = T.Res.write_ok = T.Res.cached = 0;
+      T.Res.resumed = T.Res.crashed = 0;
+      T.Res.triage = TRIAGE_OK;
+      T.Res.Npoints = 0;
+      T.Res.t_fit = 0.0;
+      T.Res.FitParams = Guess;
+      T.Raw.bytes = 0;
+      T.Raw.Nsamples = 0;
+      T.G.N = 0;
+      T.jkey = 0;
+
+      if(NULL != Opts.journal){
+
+         //A missing file keeps key 0, its read failure is journaled
+         BatchJournalFileKey(files[i].c_str(), journal_opts, T.jkey);
+
+         if(BatchJournalDone(*Opts.journal, T.jkey, files[i], &T.Res, sizeof(T.Res))){
+
+            T.Res.cached = 0;
+            T.Res.resumed = 1;
+            return (T.Res.read_ok);
+
+         }
+
+         if(BatchJournalBegins(*Opts.journal, T.jkey, files[i]) >= BatchJournalMaxBegins){
+
+            T.Res.crashed = 1;
+            return (0);
+
+         }
+
+      }
+
+      if(NULL != Opts.cache){
+
+         if(!FitCacheFileHash(Opts.cache, files[i].c_str(), content)){ return (0); }
+         T.key = FitCacheKey(content, cache_opts);
+
+         if(FitCacheGet(Opts.cache, T.key, &T.Res, sizeof(T.Res), T.output)){
+
+            T.Res.write_ok = 0;
+            T.Res.cached = 1;
+            return (1);
+
+         }
+
+      }
+
+      if(NULL != Opts.journal){ BatchJournalBegin(*Opts.journal, T.jkey, files[i]); }
+
+      if(Opts.adc_bytes > 0){
+
+         if(!ReadADCTrace(files[i].c_str(), Opts.adc_bytes, Opts.cal, T.Raw)){ return (0); }
+
+         if(Opts.mixed){
+
+            T.V.resize(T.Raw.Nsamples);
+            T.I.resize(T.Raw.Nsamples);
+            for(unsigned long k = 0; k < T.Raw.Nsamples; k++){
+
+               T.V[k] = ADCX(T.Raw, k);
+               T.I[k] = ADCY(T.Raw, k);
+
+            }
+
+         }
+
+         T.Res.Npoints = T.Raw.Nsamples;
+
+      }else{
+
+         if(!(Opts.mixed ? ReadIVData(files[i].c_str(), T.V, T.I, T.S)
+                         : ReadIVData(files[i].c_str(), T.G, T.V, T.I, T.S))){ return (0); }
+         SigmaToWeights(T.S, T.W);
+         T.Res.Npoints = T.I.size();
+
+      }
+
+      if(Opts.triage){
+
+         struct TriageStats Tri;
+
+         if(T.G.N > 0){ IVTriage(T.G, T.I, Tri); }else{ IVTriage(T.V, T.I, T.Raw, Tri); }
+         T.Res.triage = Tri.reason;
+
+      }
+
+      T.Res.read_ok = 1;
+      return (1);
+
+   };
+
+   auto fit = [&](unsigned int i, struct IVBatchItem &T){
+
+      if(!T.Res.read_ok || (TRIAGE_OK != T.Res.triage)){ return (0); }
+      if(T.Res.cached || T.Res.resumed){ return (T.Res.fit_ok); }
+
+      std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+      T.Res.fit_ok = Opts.mixed ? IVFit2NLLSMixed(T.I, T.V, T.W, Max, Tol, T.Res.FitParams)
+                   : (T.G.N > 0) ? IVFit2NLLS(T.I, T.G, T.W, Max, Tol, T.Res.FitParams)
+                   : T.V.empty() ? IVFit2NLLSADC(T.Raw, Max, Tol, T.Res.FitParams)
+                                 : IVFit2NLLS(T.I, T.V, T.W, Max, Tol, T.Res.FitParams);
+
+      T.Res.t_fit = std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                                                - t0).count();
+
+      return (T.Res.fit_ok);
+
+   };
+
+   //The item, and its trace, is freed when the writer is done with it.
+   //Only this thread appends to the store.
+   auto write = [&](unsigned int i, struct IVBatchItem &T){
+
+      std::string output_filename;
+      std::vector<struct ResultsRow> Row(1);
+
+      if(T.Res.resumed || T.Res.crashed){
+
+         Results[i] = T.Res;
+         return (T.Res.write_ok);
+
+      }
+
+      if(T.Res.cached){
+
+         output_filename = InputStem(files[i].c_str()) + "_fit.dat";
+         T.Res.write_ok = FitCacheWriteOutput(output_filename.c_str(), T.output);
+
+      }else if(T.Res.read_ok && (TRIAGE_OK == T.Res.triage)){
+
+         T.Res.write_ok = WriteIVFit(files[i].c_str(), T.V, T.G, T.Raw,
+                                     T.Res.FitParams, output_filename);
+
+         if(T.Res.write_ok && (NULL != Opts.cache)){
+
+            FitCachePut(Opts.cache, T.key, &T.Res, sizeof(T.Res),
+                        output_filename.c_str());
+
+         }
+
+      }
+
+      if(T.Res.read_ok && (NULL != Opts.store)){
+
+         IVResultsRow(files[i].c_str(), -1, Opts.channel, T.Res, Row[0]);
+         T.Res.write_ok = ResultsAppend(Opts.store, Row) && T.Res.write_ok;
+
+      }
+
+      //An output that could not be written is retried by the next run, a
+      //file that cannot be read or fitted is not
+      if((NULL != Opts.journal) && (T.Res.write_ok || !T.Res.read_ok || !T.Res.fit_ok)){
+
+         BatchJournalEnd(*Opts.journal, T.jkey, files[i], &T.Res, sizeof(T.Res));
+
+      }
+
+      Results[i] = T.Res;
+      return (T.Res.write_ok);
+
+   };
+
+   RunPipeline<struct IVBatchItem>(files.size(), Opts.Pipe, read, fit, write, Stats);
+
+   for(unsigned int i = 0; i < files.size(); i++){
+
+      res = res && Results[i].read_ok && Results[i].fit_ok && Results[i].write_ok;
+
+   }
+
+   return (res);
+
+}//End function IVBatch
+
+/************************************************************************/
+int IVBatchTune(const char *tune_file, const char *input_filename,
+                const struct IVBatchOptions &Opts, const struct IVFit2Params &Guess,
+                struct AutoTuneConfig &C){
+
+   std::vector<double> V, I, S, W; //The first trace
+   struct IVGrid G = {0, 0.0, 0.0};
+   struct ADCTrace Raw;
+   std::string key;
+   double Isat = 0.0,
+          Te   = 0.0;
+   uint64_t state = 12345;
+
+   //The shape of the input: its length, voltages and weights. Raw codes
+   //are tried as doubles.
+   if(Opts.adc_bytes > 0){
+
+      if(!ReadADCTrace(input_filename, Opts.adc_bytes, Opts.cal, Raw)){ return (0); }
+
+      V.resize(Raw.Nsamples);
+      I.resize(Raw.Nsamples);
+      for(unsigned long k = 0; k < Raw.Nsamples; k++){
+
+         V[k] = ADCX(Raw, k);
+         I[k] = ADCY(Raw, k);
+
+      }
+
+   }else{
+
+      if(!ReadIVData(input_filename, G, V, I, S)){ return (0); }
+      SigmaToWeights(S, W);
+
+   }
+
+   if(I.size() < 2){
+
+      std::cerr << "No trace to tune on in file " << input_filename << std::endl;
+      return (0);
+
+   }
+
+   key = AutoTuneKey("DoubleProbeAnalysis", I.size());
+   if(AutoTuneLoad(tune_file, key, C)){
+
+      std::cout << "Tuned configuration of " << key << " read from " << tune_file;
+      std::cout << std::endl;
+      return (1);
+
+   }
+
+   //The mixed precision fit needs the voltage column
+   if(G.N > 0){
+
+      V.resize(G.N);
+      for(unsigned long k = 0; k < G.N; k++){ V[k] = G.start + k * G.step; }
+
+   }
+
+   //The model on those voltages, through max|I| with Te = max|V| / 8,
+   //plus 1% noise
+   for(unsigned long k = 0; k < I.size(); k++){
+
+      Isat = std::max(Isat, fabs(I[k]));
+      Te   = std::max(Te, fabs(V[k]) / 8.0);
+
+   }
+   if(!(Isat > 0.0)){ Isat = 1.0E-6; }
+   if(!(Te > 0.0)){ Te = 1.0; }
+   for(unsigned long k = 0; k < I.size(); k++){
+
+      const double u = ldexp((double)(SplitMix64(state) >> 11), -53) - 0.5;
+
+      I[k] = Iv(V[k], Isat, Te) + 0.02 * Isat * u;
+
+   }
+
+   std::cout << "Tuning " << key << " on synthetic traces..." << std::endl;
+
+   //Ntraces copies of the trace through the pipeline, as IVBatch holds
+   //and fits them, without the files
+   auto trial = [&](const struct AutoTuneConfig &T, const unsigned int &Ntraces,
+                    double &t_wall){
+
+      const struct PipelineOptions Pipe = {Opts.Pipe.Nreaders, T.Nworkers, T.Nqueue};
+      struct PipelineStats Stats;
+
+      auto read = [&](unsigned int i, struct IVBatchItem &B){
+
+         B.G.N = 0;
+         if((G.N > 0) && !T.mixed){ B.G = G; }else{ B.V = V; }
+         B.I = I;
+         B.W = W;
+         B.Res.FitParams = Guess;
+         return (1);
+
+      };
+
+      auto fit = [&](unsigned int i, struct IVBatchItem &B){
+
+         struct IVFit2Params &P = B.Res.FitParams;
+
+         return (T.mixed ? IVFit2NLLSMixed(B.I, B.V, B.W, Max, Tol, P)
+                 : (B.G.N > 0) ? IVFit2NLLS(B.I, B.G, B.W, Max, Tol, P)
+                               : IVFit2NLLS(B.I, B.V, B.W, Max, Tol, P));
+
+      };
+
+      auto write = [&](unsigned int i, struct IVBatchItem &B){ return (1); };
+
+      RunPipeline<struct IVBatchItem>(Ntraces, Pipe, read, fit, write, Stats);
+      t_wall = Stats.t_wall;
+
+      return (int)(0 == Stats.stage[1].Nfailed);
+
+   };
+
+   if(!AutoTune(trial, C)){
+
+      std::cerr << "ERROR: the synthetic trace did not fit, not tuned" << std::endl;
+      return (0);
+
+   }
+
+   return (AutoTuneSave(tune_file, key, C));
+
+}//End function IVBatchTune
+
+#ifdef WITH_MPI
+/************************************************************************/
+int IVBatchMPI(const std::vector<std::string> &files,
+               const struct IVBatchOptions &Opts, const struct IVFit2Params &Guess,
+               std::vector<struct IVBatchResult> &Results,
+               std::vector<struct MPIRankStats> &RankStats){
+
+   struct IVBatchOptions RankOpts = Opts;
+   struct MPIBatchOptions MPIOpts = {1, 2.0};
+   std::vector<unsigned int> mine;
+   int res  = 1,
+       rank = 0;
+
+   if(0 == RankOpts.Pipe.Nworkers){ RankOpts.Pipe.Nworkers = 1; }
+
+   Results.assign(files.size(), IVBatchResult());
+
+   //A chunk runs as a batch of its own on this rank
+   auto run = [&](const unsigned int &lo, const unsigned int &hi){
+
+      std::vector<std::string> chunk(files.begin() + lo, files.begin() + hi);
+      std::vector<struct IVBatchResult> R;
+      struct PipelineStats Stats;
+
+      IVBatch(chunk, RankOpts, Guess, R, Stats);
+
+      for(unsigned int k = 0; k < R.size(); k++){
+
+         Results[lo + k] = R[k];
+         mine.push_back(lo + k);
+
+      }
+
+   };
+
+   MPIBatch(files.size(), MPIOpts, run, RankStats);
+   MPIGatherResults(Results, mine);
+
+   //Rank 0 has every result, the other ranks their own
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+   for(unsigned int i = 0; i < files.size(); i++){
+
+      if((0 == rank) || (std::find(mine.begin(), mine.end(), i) != mine.end())){
+
+         res = res && Results[i].read_ok && Results[i].fit_ok && Results[i].write_ok;
+
+      }
+
+   }
+
+   return (res);
+
+}//End function IVBatchMPI
+#endif
@@ -0,0 +1,193 @@
+// -----------------------------------------------------------------------
+//
+//                                       IVBatch.h V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef IVBatch_h
+#define IVBatch_h
+
+#include <vector>
+#include <string>
+
+#include "DoubleProbeAnalysis.h"
+#include "IVDataReader.h"
+#include "nlls_utils/adc_input.h"
+#include "nlls_utils/pipeline.h"
+#include "nlls_utils/results_store.h"
+#include "nlls_utils/batch_journal.h"
+#include "nlls_utils/auto_tune.h"
+#ifdef WITH_MPI
+#include "nlls_utils/mpi_batch.h"
+#endif
+
+/*
+ * Options of a batch of traces, see IVBatch(...)
+ */
+struct IVBatchOptions{
+
+   struct PipelineOptions Pipe; //Reader / fit threads, queue sizes
+   int mixed;                   //Mixed precision fits
+   int adc_bytes;               //Raw ADC codes of 2 or 4 bytes (0 = ASCII)
+   struct ADCCalibration cal;   //Calibration of raw ADC codes
+   const char *store;           //Results store directory (NULL = none)
+   int32_t channel;             //Channel of every file in the store
+   const char *cache;           //Fit cache directory (NULL = none)
+   struct BatchJournal *journal;//Journal to resume from (NULL = none)
+   int triage;                  //Reject bad traces before fitting them
+
+};
+
+/*
+ * Fit of one trace of a batch
+ */
+struct IVBatchResult{
+
+   int read_ok;                  //The trace was read
+   int fit_ok;                   //The fit succeeded
+   int write_ok;                 //The _fit.dat file was written
+   int cached;                   //Taken from the fit cache, not fitted
+   int resumed;                  //Done by an earlier run (journal), not fitted
+   int crashed;                  //Not begun, it crashed earlier runs (journal)
+   int triage;                   //TRIAGE_OK or why the trace was not fitted
+   unsigned long Npoints;        //# samples of the trace
+   double t_fit;                 //Wall time of the fit [s]
+   struct IVFit2Params FitParams;//The fit
+
+};
+
+/************************************************************************/
+/*
+ * IVBATCH(...) fits every file of a batch with the fused Gauss-Newton
+ * fit of DoubleProbeAnalysis and writes <file>_fit.dat for each, as a
+ * pipeline (see nlls_utils/pipeline.h): reader threads parse the next
+ * files while the fit threads work on the parsed ones and one writer
+ * thread writes the results, so disk and CPU are busy at the same time.
+ * Every fit starts from Guess. With Opts.store the writer also appends
+ * every fit to the results store, the shot number taken from the file
+ * name (see IVResultsRow).
+ *
+ * With Opts.cache a file whose content and fit options (guess,
+ * tolerance, mixed, ADC input) were fitted before is neither parsed nor
+ * fitted: the readers hash it (nlls_utils/fit_cache.h) and the writer
+ * restores its result and _fit.dat from the cache.
+ *
+ * With Opts.journal (see nlls_utils/batch_journal.h) a batch that was
+ * killed resumes where it stopped: a file the journal has a result for,
+ * under the same options and unchanged, is neither read nor fitted nor
+ * written again. The writer journals every file once its _fit.dat and
+ * store row are written, or once it failed to read or fit (a failure of
+ * the input, final), but not when the output could not be written. A
+ * file begun BatchJournalMaxBegins times without a result crashed every
+ * run that tried it and is skipped.
+ *
+ * With Opts.triage the readers classify every trace as they parse it
+ * (see IVTriage in IVDataReader.h) and a trace that cannot fit is not
+ * fitted: its Results[i].triage says why, no _fit.dat is written and
+ * its store row has the negative reason as status.
+ *
+ * A trace whose voltages are on a uniform grid (see ReadIVData) is kept
+ * as the grid while it waits in the queues, without its voltage column,
+ * and fitted in +/-V pairs; not for Opts.mixed, which needs the column.
+ *
+ *      @param[in] std::vector files: the input files
+ *      @param[in] struct IVBatchOptions Opts: pipeline and input options
+ *      @param[in] struct IVFit2Params Guess: initial guess of every fit
+ *      @param[out] std::vector Results: one per file, in input order
+ *      @param[out] struct PipelineStats Stats: time spent by every stage
+ *      @return int 1 if every file was read, fitted and written
+ *
+ */
+int IVBatch(const std::vector<std::string> &files,
+            const struct IVBatchOptions &Opts, const struct IVFit2Params &Guess,
+            std::vector<struct IVBatchResult> &Results,
+            struct PipelineStats &Stats);
+
+/************************************************************************/
+/*
+ * IVBATCHTUNE(...) picks the solver variant (double or mixed precision),
+ * the # fit threads and the queue capacity of IVBatch for traces shaped
+ * as the first of a batch (its length, voltage grid or column and
+ * weights), see nlls_utils/auto_tune.h. A configuration tuned before on
+ * this host for traces of that length (to a power of 2) is read from
+ * tune_file. Else AutoTune times batches of a synthetic trace, the model
+ * on the voltages of the first trace plus 1% noise, through the
+ * pipeline, and the fastest configuration is appended to tune_file.
+ *
+ *      @param[in] char *tune_file: the tune file
+ *      @param[in] char *input_filename: the first file of the batch
+ *      @param[in] struct IVBatchOptions Opts: input options and readers
+ *      @param[in] struct IVFit2Params Guess: initial guess of every fit
+ *      @param[out] struct AutoTuneConfig C: the configuration
+ *      @return int success/failure
+ *
+ */
+int IVBatchTune(const char *tune_file, const char *input_filename,
+                const struct IVBatchOptions &Opts, const struct IVFit2Params &Guess,
+                struct AutoTuneConfig &C);
+
+#ifdef WITH_MPI
+/************************************************************************/
+/*
+ * IVBATCHMPI(...) is IVBatch(...) over the MPI ranks: rank 0 hands out
+ * chunks of files (see MPIBatch), every rank fits its chunks with
+ * IVBatch, writing the _fit.dat files and appending to Opts.store
+ * itself, and the results are gathered on rank 0. Each rank runs
+ * Opts.Pipe.Nworkers fit threads, 1 if 0 (one rank per core).
+ *
+ *      @param[in] std::vector files: the input files
+ *      @param[in] struct IVBatchOptions Opts: pipeline and input options
+ *      @param[in] struct IVFit2Params Guess: initial guess of every fit
+ *      @param[out] std::vector Results: on rank 0 one per file, in input
+ *                  order
+ *      @param[out] std::vector RankStats: on rank 0 the time spent by
+ *                  every rank
+ *      @return int 1 if every file (of this rank) was read, fitted and
+ *              written
+ *
+ */
+int IVBatchMPI(const std::vector<std::string> &files,
+               const struct IVBatchOptions &Opts, const struct IVFit2Params &Guess,
+               std::vector<struct IVBatchResult> &Results,
+               std::vector<struct MPIRankStats> &RankStats);
+#endif
+
+/************************************************************************/
+/*
+ * WRITEIVFIT(...) writes the fitted trace I(V) at every input voltage to
+ * <input stem>_fit.dat (see InputStem)
+ *
+ *      @param[in] char *input_filename: the input file
+ *      @param[in] std::vector V: the voltages, or empty to take them from
+ *      @param[in] struct IVGrid G: a voltage grid (G.N > 0), else from
+ *      @param[in] struct ADCTrace Raw: a raw ADC trace
+ *      @param[in] struct IVFit2Params FitParams: the fit
+ *      @param[out] std::string output_filename: the file written
+ *      @return int success/failure
+ *
+ */
+int WriteIVFit(const char *input_filename, const std::vector<double> &V,
+               const struct IVGrid &G, const struct ADCTrace &Raw,
+               const struct IVFit2Params &FitParams, std::string &output_filename);
+
+/************************************************************************/
+/*
+ * IVRESULTSROW(...) fills a results store row (nlls_utils/results_store.h)
+ * from a fit. The time of the shot is the modification time of the
+ * input file.
+ *
+ *      @param[in] char *input_filename: the input file
+ *      @param[in] int64_t shot: shot number (-1: from the file name)
+ *      @param[in] int32_t channel: channel
+ *      @param[in] struct IVBatchResult R: the fit, its status and time,
+ *                  the status of a trace rejected by triage is -R.triage
+ *      @param[out] struct ResultsRow Row: the row
+ *
+ */
+void IVResultsRow(const char *input_filename, const int64_t &shot,
+                  const int32_t &channel, const struct IVBatchResult &R,
+                  struct ResultsRow &Row);
+
+#endif
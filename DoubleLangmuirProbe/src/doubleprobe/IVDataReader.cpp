@@ -0,0 +1,283 @@
+// -----------------------------------------------------------------------
+//
+//                                   IVDataReader.cpp V 0.01
+//
+//                                 (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <math.h>
+#include <new>
+
+#include "IVDataReader.h"
+#include "nlls_utils/input_stream.h"
+
+/*
+ * What IVTriage asks of a trace: 2 samples per parameter, a sweep
+ * through V = 0. The full scale of an ASCII trace is not known.
+ */
+static const struct TriageOptions IVTriageOpts = {4, TriageSatFrac, TriageSNRMin,
+                                                  TRIAGE_COVER_ZERO,
+                                                  -HUGE_VAL, HUGE_VAL};
+
+/************************************************************************/
+/*
+ * Adds the voltage v as sample G.N of the grid G, or returns 0 if it is
+ * off the grid. The step is refitted through the first and the latest
+ * voltage, so the rounding of the first step does not add up along a
+ * long sweep.
+ */
+static int IVGridAdd(struct IVGrid &G, const double &v){
+
+   if(0 == G.N){
+
+      G.start = v;
+      G.step  = 0.0;
+
+   }else if(1 == G.N){
+
+      G.step = v - G.start;
+      if(!(fabs(G.step) > 0.0)){ return (0); }
+
+   }else{
+
+      if(!(fabs(v - (G.start + G.N * G.step)) <= IVGridTol * fabs(G.step))){ return (0); }
+      G.step = (v - G.start) / G.N;
+
+   }
+
+   G.N++;
+   return (1);
+
+}
+
+/*
+ * Appends the voltages of the grid G to V
+ */
+static int IVGridFill(const struct IVGrid &G, std::vector<double> &V){
+
+   try{
+
+      V.reserve(V.size() + G.N);
+      for(unsigned long k = 0; k < G.N; k++){ V.push_back(G.start + k * G.step); }
+
+   }catch(std::bad_alloc& ba){
+
+      std::cerr << "ERROR: IVGridFill: " << ba.what() << std::endl;
+      return (0);
+
+   }
+
+   return (1);
+
+}
+
+/************************************************************************/
+/*
+ * Both ReadIVData(...), G = NULL keeps every voltage in V
+ */
+static int ReadIV(const char *filename, struct IVGrid *G, std::vector<double> &V,
+                  std::vector<double> &I, std::vector<double> &sigma){
+
+   struct InputStream input_file;
+   struct IVGrid Gs = {0, 0.0, 0.0}; //The grid so far
+
+   std::string line;
+
+   int Ncol    = 0,          //# columns found on the first data line
+       on_grid = (NULL != G), //The voltages so far are on Gs
+       res     = 1;
+
+   V.clear();
+   I.clear();
+   sigma.clear();
+
+   //Plain, gzip or zstd, decompressed ahead on the stream's own thread
+   if(!OpenInputStream(filename, input_file)){ return (0); }
+
+   while(InputStreamGetline(input_file, line)){
+
+      const char *c = line.c_str();
+      char *end = NULL;
+      double col[3] = {0.0, 0.0, 0.0};
+      int n = 0;
+
+      //Parse up to 3 numbers from the line
+      for(n = 0; n < 3; n++){
+
+         col[n] = strtod(c, &end);
+         if(end == c){ break; }
+         c = end;
+
+      }
+
+      //Blank and '#' comment lines do not parse
+      if(0 == n){ continue; }
+
+      if(0 == Ncol){ Ncol = n; }
+
+      if((n < Ncol) || (Ncol < 2)){
+
+         std::cerr << "Malformed line in file " << filename << ": ";
+         std::cerr << line << std::endl;
+         res = 0;
+         break;
+
+      }
+
+      //A nan or inf would make the fit report nan as converged
+      if(!isfinite(col[0]) || !isfinite(col[1]) || !isfinite(col[2])){
+
+         std::cerr << "Non-finite value in file " << filename << ": ";
+         std::cerr << line << std::endl;
+         res = 0;
+         break;
+
+      }
+
+      //Off the grid, the column so far is filled in from it
+      if(on_grid && !IVGridAdd(Gs, col[0])){
+
+         on_grid = 0;
+         if(!IVGridFill(Gs, V)){ res = 0; break; }
+
+      }
+
+      try{
+
+         if(!on_grid){ V.push_back(col[0]); }
+         I.push_back(col[1]);
+         if(3 == Ncol){ sigma.push_back(col[2]); }
+
+      }catch(std::bad_alloc& ba){
+
+         std::cerr << "ERROR: file " << filename << " does not fit in memory: ";
+         std::cerr << ba.what() << std::endl;
+         res = 0;
+         break;
+
+      }
+
+   }
+
+   //A truncated or corrupt compressed file is an error
+   if(!CloseInputStream(input_file)){ res = 0; }
+
+   //A single voltage is no grid
+   if(on_grid && (Gs.N < 2)){
+
+      on_grid = 0;
+      if(!IVGridFill(Gs, V)){ res = 0; }
+
+   }
+
+   if(NULL != G){
+
+      *G = Gs;
+      if(!on_grid){ G->N = 0; }
+
+   }
+
+   return (res);
+
+}//End function ReadIV
+
+/************************************************************************/
+int ReadIVData(const char *filename, std::vector<double> &V,
+               std::vector<double> &I, std::vector<double> &sigma){
+
+   return (ReadIV(filename, NULL, V, I, sigma));
+
+}//End function ReadIVData
+
+/************************************************************************/
+int ReadIVData(const char *filename, struct IVGrid &G, std::vector<double> &V,
+               std::vector<double> &I, std::vector<double> &sigma){
+
+   return (ReadIV(filename, &G, V, I, sigma));
+
+}//End function ReadIVData
+
+/************************************************************************/
+int IVUniformGrid(const std::vector<double> &V, struct IVGrid &G){
+
+   G.N = 0;
+
+   for(unsigned long i = 0; i < V.size(); i++){
+
+      if(!IVGridAdd(G, V[i])){ G.N = 0; return (0); }
+
+   }
+
+   if(G.N < 2){ G.N = 0; }
+
+   return (G.N > 0);
+
+}//End function IVUniformGrid
+
+/************************************************************************/
+int SigmaToWeights(const std::vector<double> &sigma, std::vector<double> &W){
+
+   W.clear();
+
+   for(unsigned int i = 0; i < sigma.size(); i++){
+
+      if(!(sigma[i] > 0.0)){
+
+         W.clear();
+         return (0);
+
+      }
+
+      W.push_back(1.0 / (sigma[i] * sigma[i]));
+
+   }
+
+   return (!W.empty());
+
+}//End function SigmaToWeights
+
+/************************************************************************/
+int IVTriage(const std::vector<double> &V, const std::vector<double> &I,
+             const struct ADCTrace &Raw, struct TriageStats &T){
+
+   struct TriageOptions Opts = IVTriageOpts;
+
+   if(!V.empty()){ return (Triage(ArraySamples(&V[0], &I[0], NULL), V.size(), Opts, T)); }
+
+   //Raw codes clip on the extreme codes of the digitizer
+   if(Raw.Nsamples > 0){ ADCFullScaleY(Raw, Opts.full_lo, Opts.full_hi); }
+
+   if(2 == Raw.bytes){
+
+      return (Triage(ADCSamples<int16_t>(&Raw.code16[0], Raw.cal), Raw.Nsamples, Opts, T));
+
+   }
+
+   if(4 == Raw.bytes){
+
+      return (Triage(ADCSamples<int32_t>(&Raw.code32[0], Raw.cal), Raw.Nsamples, Opts, T));
+
+   }
+
+   return (Triage(ArraySamples(NULL, NULL, NULL), 0, Opts, T));
+
+}//End function IVTriage
+
+/************************************************************************/
+int IVTriage(const struct IVGrid &G, const std::vector<double> &I,
+             struct TriageStats &T){
+
+   if((0 == G.N) || (I.size() != G.N)){
+
+      return (Triage(ArraySamples(NULL, NULL, NULL), 0, IVTriageOpts, T));
+
+   }
+
+   return (Triage(GridSamples(G.start, G.step, &I[0], NULL), G.N, IVTriageOpts, T));
+
+}//End function IVTriage
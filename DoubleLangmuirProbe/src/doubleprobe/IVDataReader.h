@@ -0,0 +1,131 @@
+// -----------------------------------------------------------------------
+//
+//                                    IVDataReader.h V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef IVDataReader_h
+#define IVDataReader_h
+
+#include <vector>
+
+#include "nlls_utils/adc_input.h"
+#include "nlls_utils/triage.h"
+
+/*
+ * A voltage column on a uniform grid, V[i] = start + i * step. N = 0:
+ * the voltages are not on a grid and are kept as a column.
+ */
+struct IVGrid{
+
+   unsigned long N; //# samples
+   double start;    //First voltage [V]
+   double step;     //Voltage step [V]
+
+};
+
+/*
+ * Largest distance of a voltage from its grid point, in steps, for the
+ * column to be a grid
+ */
+const double IVGridTol = 1.0E-9;
+
+/************************************************************************/
+/*
+ * READIVDATA(...) reads a whitespace separated I-V trace. Every line
+ * holds the voltage, the current and optionally the uncertainty
+ * (standard deviation) of the current:
+ *
+ *      V [V]   I [A]   [sigma_I [A]]
+ *
+ * The number of columns is taken from the first data line. Blank lines
+ * and lines starting with '#' are skipped.
+ *
+ *      @param[in] char *filename: input file name
+ *      @param[out] std::vector V: voltage measurements
+ *      @param[out] std::vector I: current measurements
+ *      @param[out] std::vector sigma: current uncertainties (empty if the
+ *                                     file only has 2 columns)
+ *      @return int success/failure
+ *
+ */
+int ReadIVData(const char *filename, std::vector<double> &V,
+               std::vector<double> &I, std::vector<double> &sigma);
+
+/************************************************************************/
+/*
+ * READIVDATA(...) as above, but a voltage column on a uniform grid (a
+ * sweep in fixed steps, within IVGridTol steps) is stored as G instead
+ * of V, which is then left empty. The column is only filled in, from
+ * G, once a voltage leaves the grid, so a gridded trace never holds it.
+ *
+ *      @param[in] char *filename: input file name
+ *      @param[out] struct IVGrid G: the grid (G.N = 0 if there is none)
+ *      @param[out] std::vector V: voltage measurements, empty on a grid
+ *      @param[out] std::vector I: current measurements
+ *      @param[out] std::vector sigma: current uncertainties
+ *      @return int success/failure
+ *
+ */
+int ReadIVData(const char *filename, struct IVGrid &G, std::vector<double> &V,
+               std::vector<double> &I, std::vector<double> &sigma);
+
+/************************************************************************/
+/*
+ * IVUNIFORMGRID(...) finds the grid of a voltage column that is already
+ * stored, the test of ReadIVData(...)
+ *
+ *      @param[in] std::vector V: voltage measurements
+ *      @param[out] struct IVGrid G: the grid (G.N = 0 if there is none)
+ *      @return int 1 if V is on a grid
+ *
+ */
+int IVUniformGrid(const std::vector<double> &V, struct IVGrid &G);
+
+/************************************************************************/
+/*
+ * SIGMATOWEIGHTS(...) converts uncertainties into least squares weights
+ * W = 1 / sigma^2. If any sigma is not positive no weights are returned
+ * (W is left empty) so the fit falls back to equal weights.
+ *
+ *      @param[in] std::vector sigma: uncertainties
+ *      @param[out] std::vector W: weights
+ *      @return int 1 if weights were produced, 0 otherwise
+ *
+ */
+int SigmaToWeights(const std::vector<double> &sigma, std::vector<double> &W);
+
+/************************************************************************/
+/*
+ * IVTRIAGE(...) classifies a trace before its fit (see
+ * nlls_utils/triage.h): at least 2 samples per parameter, finite, not
+ * flat nor clipped, a sweep through V = 0 (the model is odd) and a
+ * current above the noise. A raw ADC trace is read as its codes and is
+ * clipped on the extreme codes of its digitizer.
+ *
+ *      @param[in] std::vector V: the voltages, or empty to take them from
+ *      @param[in] std::vector I: the currents
+ *      @param[in] struct ADCTrace Raw: a raw ADC trace
+ *      @param[out] struct TriageStats T: what was found, T.reason
+ *      @return int 1 if the trace is to be fitted
+ *
+ */
+int IVTriage(const std::vector<double> &V, const std::vector<double> &I,
+             const struct ADCTrace &Raw, struct TriageStats &T);
+
+/************************************************************************/
+/*
+ * IVTriage(...) of a trace with its voltages on a grid
+ *
+ *      @param[in] struct IVGrid G: the voltages
+ *      @param[in] std::vector I: the currents
+ *      @param[out] struct TriageStats T: what was found, T.reason
+ *      @return int 1 if the trace is to be fitted
+ *
+ */
+int IVTriage(const struct IVGrid &G, const std::vector<double> &I,
+             struct TriageStats &T);
+
+#endif
@@ -10,10 +10,44 @@
 #include <vector>
 #include <iostream>
 #include <new>
+#include <algorithm>
 
 #include "IVFit2NLLS.h"
 #include "DoubleProbeAnalysis.h"
+#include "DoubleProbeModel.h"
 #include "matrix_utils/matrix_ops.h"
+#include "nlls_utils/nlls_solver.h"
+#include "nlls_utils/adc_input.h"
+
+/************************************************************************/
+/*
+ * Copies the parameters and the statistics of a fit into FitParams
+ */
+static void IVFit2Store(const double *param, const struct NLLSStats &Stats,
+                        struct IVFit2Params &FitParams){
+
+   const unsigned int Npar = DoubleProbeModel::Npar;
+
+   FitParams.Isat = param[0];
+   FitParams.Te   = param[1];
+
+   FitParams.Stats.chi2      = Stats.chi2;
+   FitParams.Stats.chi2_red  = Stats.chi2_red;
+   FitParams.Stats.R2        = Stats.R2;
+   FitParams.Stats.dparam2   = Stats.dparam2;
+   FitParams.Stats.step      = Stats.step;
+   FitParams.Stats.stop      = Stats.stop;
+   FitParams.Stats.Niter     = Stats.Niter;
+   FitParams.Stats.Niter_f32 = 0;
+   FitParams.Stats.scale     = Stats.scale;
+   FitParams.Stats.Noutliers = Stats.Noutliers;
+   for(unsigned int i = 0; i < Npar; i++){
+
+      FitParams.Stats.err[i] = sqrt(fabs(FitParams.Stats.cov[i * Npar + i]));
+
+   }
+
+}//End function IVFit2Store
 
 /************************************************************************/
 /*
@@ -23,189 +57,322 @@
 int IVFit2NLLS(const std::vector<double> &Ii, const std::vector<double> &V,
                        const unsigned int &Ntries, const double &TOLERANCE,
                                            struct IVFit2Params &FitParams){
+
+   //Unweighted fit, all points have weight 1
+   return(IVFit2NLLS(Ii, V, std::vector<double>(), Ntries, TOLERANCE,
+                                                           FitParams));
+
+}//End function IVFit2NNLS
+
+/************************************************************************/
+/*
+ * 2 parameter weighted nonlinear least squares fitting, NLLSFit(...)
+ * specialized to the double probe model.
+ */
+int IVFit2NLLS(const std::vector<double> &Ii, const std::vector<double> &V,
+               const std::vector<double> &W,
+                       const unsigned int &Ntries, const double &TOLERANCE,
+                                           struct IVFit2Params &FitParams){
 //std::cout << "BEGIN IVFit2NLLS" << std::endl;
 
    int res  = 0;
-   
+
+   unsigned int Npoi = V.size(); //# data points in I and V
+
+   double param[DoubleProbeModel::Npar] = {FitParams.Isat, FitParams.Te};
+
+   struct NLLSStats Stats;
+
+   //Make sure number of read points for Ii and V are the same
+   if((Ii.size() != V.size()) || (!W.empty() && (W.size() != V.size())) ||
+      (0 == Npoi)){
+      
+      std::cout << "Passed incompatible arrays for I, V and W input data";
+      std::cout << std::endl;
+      res = 0;
+      return(res);
+     
+   }
+
+   res = NLLSFit<DoubleProbeModel>(&V[0], &Ii[0], W.empty() ? NULL : &W[0],
+                                   Npoi, Ntries, TOLERANCE, param,
+                                   FitParams.Stats.cov, Stats, &FitParams.Loss);
+   if(!res){ return (res); }
+
+   //Store the results
+   IVFit2Store(param, Stats, FitParams);
+
+//std::cout << "END IVFit2NLLS" << std::endl;
+return (res);
+}//End function IVFit2NNLS
+
+/************************************************************************/
+/*
+ * 2 parameter weighted nonlinear least squares fitting on a voltage
+ * grid, the +/-V pairs are found by NLLSMirror(...)
+ */
+int IVFit2NLLS(const std::vector<double> &Ii, const struct IVGrid &G,
+               const std::vector<double> &W,
+                       const unsigned int &Ntries, const double &TOLERANCE,
+                                           struct IVFit2Params &FitParams){
+
+   int res = 0;
+
+   double param[DoubleProbeModel::Npar] = {FitParams.Isat, FitParams.Te};
+
+   struct NLLSStats Stats;
+
+   if((Ii.size() != G.N) || (!W.empty() && (W.size() != G.N)) || (0 == G.N)){
+
+      std::cout << "Passed incompatible grid, I and W input data";
+      std::cout << std::endl;
+      return (0);
+
+   }
+
+   res = NLLSFitSamples<DoubleProbeModel>(GridSamples(G.start, G.step, &Ii[0],
+                                                      W.empty() ? NULL : &W[0]),
+                                          G.N, Ntries, TOLERANCE, param,
+                                          FitParams.Stats.cov, Stats, &FitParams.Loss);
+   if(!res){ return (res); }
+
+   //Store the results
+   IVFit2Store(param, Stats, FitParams);
+
+   return (res);
+
+}//End function IVFit2NLLS
+
+/************************************************************************/
+/*
+ * 2 parameter nonlinear least squares fitting on a raw ADC trace,
+ * NLLSFitADC(...) specialized to the double probe model.
+ */
+int IVFit2NLLSADC(const struct ADCTrace &T, const unsigned int &Ntries,
+                  const double &TOLERANCE, struct IVFit2Params &FitParams){
+//std::cout << "BEGIN IVFit2NLLSADC" << std::endl;
+
+   int res  = 0;
+
+   double param[DoubleProbeModel::Npar] = {FitParams.Isat, FitParams.Te};
+
+   struct NLLSStats Stats;
+
+   res = NLLSFitADC<DoubleProbeModel>(T, Ntries, TOLERANCE, param,
+                                      FitParams.Stats.cov, Stats, &FitParams.Loss);
+   if(!res){ return (res); }
+
+   //Store the results
+   IVFit2Store(param, Stats, FitParams);
+
+//std::cout << "END IVFit2NLLSADC" << std::endl;
+return (res);
+}//End function IVFit2NLLSADC
+
+/************************************************************************/
+/*
+ * 2 parameter nonlinear least squares fitting in mixed precision. The
+ * float32 stage stops once the relative parameter step is below what
+ * float32 can resolve, IVFit2NLLS then finishes the fit in double. The
+ * float32 stage is least squares, a robust loss only applies to the
+ * double stage, which reweights from the float32 solution.
+ */
+int IVFit2NLLSMixed(const std::vector<double> &Ii,
+                    const std::vector<double> &V,
+                    const unsigned int &Ntries, const double &TOLERANCE,
+                                           struct IVFit2Params &FitParams){
+
+   //Unweighted fit, all points have weight 1
+   return(IVFit2NLLSMixed(Ii, V, std::vector<double>(), Ntries, TOLERANCE,
+                                                               FitParams));
+
+}//End function IVFit2NLLSMixed
+
+/************************************************************************/
+/*
+ * Weighted version of the mixed precision fit. The weights are scaled
+ * by their maximum for the float32 stage, which only rescales the
+ * normal equations and leaves the step unchanged.
+ */
+int IVFit2NLLSMixed(const std::vector<double> &Ii,
+                    const std::vector<double> &V,
+                    const std::vector<double> &W,
+                    const unsigned int &Ntries, const double &TOLERANCE,
+                                           struct IVFit2Params &FitParams){
+//std::cout << "BEGIN IVFit2NLLSMixed" << std::endl;
+
+   const float MIXED_TOL = 1.0E-4f; //Relative step resolved in float32
+
+   int res  = 0;
+
    unsigned int it   = 0,
                 Npar = FitParams.Npar, //# fit parameters [2 in this case]
                 Npoi = V.size();       //# data points stored in I and V
-       
-   double Ivt     = 0.0,  //Temporary collected current
-          Vt      = 0.0,  //Temporary voltage measurement
-          *dIi    = NULL, //Difference between fit and data
-          *R2     = NULL, //Sum of squared residuals
+
+   double Vs      = 0.0,  //Voltage scale max|V|
+          Is      = 0.0,  //Current scale max|I|
+          Ws      = 1.0,  //Weight scale max(W)
+          step    = 1.0,  //Largest relative parameter step
           *dparam = NULL, //Difference between new and old parameters
-          *A      = NULL, //A matrix
-          *AT     = NULL, //Tranposed A matrix
-          *a      = NULL, //Product of AT * A
+          *a      = NULL, //Normal matrix AT * A
           *ainv   = NULL, //Inverse of AT * A
-          *I      = NULL, //Identity matrix can be used for diagnostics
-          *b      = NULL, //Product of AT * dIi
-          *param  = NULL; //Parameter array storing struc IVFIT2Params info
-      
-   //Function pointer to help setup the A and AT matrices
-   double (*IVds[])(const double &,const double &, const double &) =
-                                                 {dIvdIsat, dIvdTe};
-   
+          *b      = NULL; //Product of AT * dIi
+
+   float *Vf     = NULL, //Scaled voltage
+         *If     = NULL, //Scaled current
+         *Wf     = NULL, //Scaled weights
+         *param  = NULL, //Scaled fit parameters
+         grad[2] = {0.0f, 0.0f}, //Gradient of I(V) at one point
+         dIf     = 0.0f; //Difference between fit and data
+
+   struct CompensatedSum *as = NULL, //Compensated sums for a
+                         *bs = NULL; //Compensated sums for b
+
    //Make sure number of read points for Ii and V are the same
-   if(Ii.size() != V.size()){
-      
-      std::cout << "Passed incompatible arrays for I and V input data";
+   if((Ii.size() != V.size()) || (!W.empty() && (W.size() != V.size()))){
+
+      std::cout << "Passed incompatible arrays for I, V and W input data";
       std::cout << std::endl;
       res = 0;
       return(res);
-     
+
+   }
+
+   for(unsigned int row = 0; row < Npoi; row++){
+
+      Vs = std::max(Vs, fabs(V[row]));
+      Is = std::max(Is, fabs(Ii[row]));
+
+   }
+
+   if(!W.empty()){ Ws = *std::max_element(W.begin(), W.end()); }
+
+   //Scaling is undefined, let the double precision fit deal with it
+   if((0.0 == Vs) || (0.0 == Is) || !(Ws > 0.0)){
+
+      return(IVFit2NLLS(Ii, V, W, Ntries, TOLERANCE, FitParams));
+
    }
-   
-   //Since there may be ALOT of data points, make sure new[] is successful
+
    try{
-      
-      dIi    = new double[Npoi],
-      R2     = new double[Ntries],
+
       dparam = new double[Npar],
-      A      = new double[Npoi * Npar],
-      AT     = new double[Npar * Npoi],
       a      = new double[Npar * Npar],
       ainv   = new double[Npar * Npar],
-      I      = new double[Npar * Npar],
       b      = new double[Npar],
-      param  = new double[Npar];
-      
+      Vf     = new float[Npoi],
+      If     = new float[Npoi],
+      Wf     = new float[Npoi],
+      param  = new float[Npar],
+      as     = new struct CompensatedSum[Npar * Npar],
+      bs     = new struct CompensatedSum[Npar];
+
    }catch(std::bad_alloc& ba){
-      
-      std::cerr << "ERROR: IVFIT2NLLS initialization: " << ba.what();
+
+      std::cerr << "ERROR: IVFIT2NLLSMIXED initialization: " << ba.what();
       std::cerr << std::endl;
       res = 0;
       goto cleanup;
-      
+
    }
-   
-   //Set the initial fit parameters
-   param[0] = FitParams.Isat;
-   param[1] = FitParams.Te;
-   R2[0] = 1.0;
-    
-   while((it < Ntries) && (R2[it] > TOLERANCE)){
-      
-      //Calculate the A Matrix
+
+   //Scale the data and the initial fit parameters
+   for(unsigned int row = 0; row < Npoi; row++){
+
+      Vf[row] = (float)(V[row] / Vs);
+      If[row] = (float)(Ii[row] / Is);
+      Wf[row] = W.empty() ? 1.0f : (float)(W[row] / Ws);
+
+   }
+
+   param[0] = (float)(FitParams.Isat / Is);
+   param[1] = (float)(FitParams.Te / Vs);
+
+   while((it < Ntries) && (step > MIXED_TOL)){
+
+      for(unsigned int i = 0; i < Npar * Npar; i++){ as[i].sum = as[i].c = 0.0f; }
+      for(unsigned int i = 0; i < Npar; i++){ bs[i].sum = bs[i].c = 0.0f; }
+
+      //Accumulate AT * A and AT * dIi directly, A is never stored
       for(unsigned int row = 0; row < Npoi; row++){
-         
-         Vt = V.at(row);
-         Ivt = Iv(Vt,param[0],param[1]);
-         dIi[row] = (Ii.at(row)-Ivt);
-         
-         for(unsigned int col = 0; col < Npar; col++){
-            
-            A[row * Npar + col] = IVds[col](Vt,param[0],param[1]);
-            
+
+         dIf = If[row] - DoubleProbeModel::EvalGrad(Vf[row], param, grad);
+
+         for(unsigned int i = 0; i < Npar; i++){
+
+            CompensatedAdd(bs[i], Wf[row] * grad[i] * dIf);
+
+            for(unsigned int j = i; j < Npar; j++){
+
+               CompensatedAdd(as[i * Npar + j], Wf[row] * grad[i] * grad[j]);
+
+            }
+
          }
 
       }
-      
-      //Now find the transpose of A
-      if(!TransposeMatrix(A, Npoi, Npar, &AT)){
-       
-         std::cerr << "ERROR: transposing matrix failed: A" << std::endl;
-         res = 0;
-         goto cleanup;
-         
-      }
-       
-      //Product of a = AT * A. a is the matrix we need to invert
-      if(!MultiplyMatrix(AT, Npar, Npoi, A, Npoi, Npar, &a)){
-       
-         std::cerr << "ERROR: matrix multiplication failed: AT * A";
-         std::cerr << std::endl;
-         res = 0;
-         goto cleanup;
-         
+
+      for(unsigned int i = 0; i < Npar; i++){
+
+         b[i] = bs[i].sum;
+
+         for(unsigned int j = i; j < Npar; j++){
+
+            a[i * Npar + j] = a[j * Npar + i] = as[i * Npar + j].sum;
+
+         }
+
       }
-      
-      //Calculate the inverse matrix ainv
+
+      //The 2 x 2 solve itself is done in double
       if(!InvertMatrix(a, Npar, &ainv)){
-       
+
          std::cerr << "ERROR: matrix inversion failed: ainv" << std::endl;
          res = 0;
          goto cleanup;
-         
-      }
-      
-      /*
-       * Calculate the product of ainv * a [should be the identity matrix].
-       * If trouble with routine, could be used as diagnostic.
-       */
-      if(!MultiplyMatrix(ainv, Npar, Npar, a, Npar, Npar, &I)){
-       
-         std::cerr << "ERROR: matrix multiplication failed: ainv * a";
-         std::cerr << std::endl;
-         PrintMatrix(I, Npar, Npar);
-         res = 0;
-         goto cleanup;
-         
-      }
-      
-      /*
-       * Product of AT and the difference between data and model.
-       */
-      if(!MultiplyMatrix(AT, Npar, Npoi, dIi, Npoi, 1, &b)){
-       
-         std::cerr << "ERROR: matrix multiplication failed: AT * dIi";
-         std::cerr << std::endl;
-         res = 0;
-         goto cleanup;
-         
+
       }
-    
-      //Calculate the small increment toward convergence
+
       if(!MultiplyMatrix(ainv, Npar, Npar, b, Npar, 1, &dparam)){
-       
+
          std::cerr << "ERROR: matrix multiplication failed:  ainv * b";
          std::cerr << std::endl;
          res = 0;
          goto cleanup;
-         
+
       }
-    
-      /* 
-       * Final update tasks:
-       *        1) Increment the iteration #
-       *        2) New param values by applying offset
-       *        3) The sum of squared residuals to check convergence
-       */
+
       ++it;
-      R2[it] = 0.0;
+      step = 0.0;
       for(unsigned int i = 0; i < Npar; i++){
-         
-         param[i] += dparam[i];
-         R2[it] += dparam[i] * dparam[i];  
-         
+
+         param[i] += (float)dparam[i];
+         step = std::max(step, fabs(dparam[i]) / (fabs(param[i]) + 1.0E-30));
+
       }
-  
-   }//End while loop checking convergence tolerance or max iterations
-   
-   res = 1;
-   
-   //Print Results
-   FitParams.Isat = param[0];
-   FitParams.Te   = param[1];
-   std::cout << " R^2         : " << R2[it] << std::endl;
-   std::cout << " # iterations: " << it << std::endl;
-   
+
+   }//End while loop for the float32 stage
+
+   //Undo the scaling and refine the float32 solution in double
+   FitParams.Isat = param[0] * Is;
+   FitParams.Te   = param[1] * Vs;
+   res = IVFit2NLLS(Ii, V, W, Ntries, TOLERANCE, FitParams);
+   FitParams.Stats.Niter_f32 = it;
+
 //Memory cleanup
 cleanup:
-   
-   delete[] dIi;
-   delete[] R2;
+
    delete[] dparam;
-   delete[] A;
-   delete[] AT;
    delete[] a;
    delete[] ainv;
-   delete[] I;
    delete[] b;
+   delete[] Vf;
+   delete[] If;
+   delete[] Wf;
    delete[] param;
-  
-//std::cout << "END IVFit2NLLS" << std::endl;
+   delete[] as;
+   delete[] bs;
+
+//std::cout << "END IVFit2NLLSMixed" << std::endl;
 return (res);
-}//End function IVFit2NNLS
\ No newline at end of file
+}//End function IVFit2NLLSMixed
@@ -10,6 +10,9 @@
 #define IVFit2NLLS_h
 
 #include "DoubleProbeAnalysis.h"
+#include "DoubleProbeModel.h"
+#include "nlls_utils/adc_input.h"
+#include "IVDataReader.h"
 
 /************************************************************************/
 /*
@@ -29,11 +32,104 @@ int IVFit2NLLS(const std::vector<double> &Ii, const std::vector<double> &V,
                        const unsigned int &Ntries, const double &TOLERANCE,
                                            struct IVFit2Params &FitParams);
 
+/************************************************************************/
+/*
+ * Weighted version of IVFIT2NLLS(...). Each squared residual is
+ * multiplied by its weight, normally W = 1 / sigma^2.
+ *
+ *      @param[in] std::vector Ii: an input vector of current measurements
+ *      @param[in] std::vector V: an input vector of voltage measurements
+ *      @param[in] std::vector W: an input vector of weights (empty = 1)
+ *      @param[in] int Ntries: maximum # attempts to curve fit
+ *      @param[in] double TOLERANCE: convergence tolerance
+ *      @param[in/out] struct IVFit2Params Fitparams: input guess / output
+ *                                                    final fit paramters
+ *      @return int success/failure
+ *
+ */
+int IVFit2NLLS(const std::vector<double> &Ii, const std::vector<double> &V,
+               const std::vector<double> &W,
+                       const unsigned int &Ntries, const double &TOLERANCE,
+                                           struct IVFit2Params &FitParams);
+
+/************************************************************************/
+/*
+ * IVFit2NLLS(...) of a trace with its voltages on a uniform grid (see
+ * ReadIVData). A grid symmetric about V = 0, as -60 ... 60 V in 0.5 V
+ * steps, is fitted in +/-V pairs: the model is odd, so one tanh serves
+ * both samples of a pair.
+ *
+ *      @param[in] std::vector Ii: an input vector of current measurements
+ *      @param[in] struct IVGrid G: the voltages
+ *      @param[in] std::vector W: an input vector of weights (empty = 1)
+ *      @param[in] int Ntries: maximum # attempts to curve fit
+ *      @param[in] double TOLERANCE: convergence tolerance
+ *      @param[in/out] struct IVFit2Params Fitparams: input guess / output
+ *                                                    final fit paramters
+ *      @return int success/failure
+ *
+ */
+int IVFit2NLLS(const std::vector<double> &Ii, const struct IVGrid &G,
+               const std::vector<double> &W,
+                       const unsigned int &Ntries, const double &TOLERANCE,
+                                           struct IVFit2Params &FitParams);
+
+/************************************************************************/
+/*
+ * IVFIT2NLLSADC(...) performs the IVFit2NLLS fit directly on a raw ADC
+ * trace (x = V, y = I). The codes are calibrated inside the fit loop,
+ * so the trace is never stored as doubles.
+ *
+ *      @param[in] struct ADCTrace T: raw trace and its calibration
+ *      @param[in] int Ntries: maximum # attempts to curve fit
+ *      @param[in] double TOLERANCE: convergence tolerance
+ *      @param[in/out] struct IVFit2Params Fitparams: input guess / output
+ *                                                    final fit paramters
+ *      @return int success/failure
+ *
+ */
+int IVFit2NLLSADC(const struct ADCTrace &T, const unsigned int &Ntries,
+                  const double &TOLERANCE, struct IVFit2Params &FitParams);
+
+/************************************************************************/
+/*
+ * IVFIT2NLLSMIXED(...) performs the same 2 parameter fit as IVFit2NLLS
+ * in mixed precision. The data are scaled to V / max|V| and I / max|I|
+ * so the model stays O(1), the Jacobian and normal equations are then
+ * accumulated in float32 with compensated sums. The float32 solution is
+ * refined to full accuracy by IVFit2NLLS in double precision.
+ *
+ *      @param[in] std::vector Ii: an input vector of current measurements
+ *      @param[in] std::vector V: an input vector of voltage measurements
+ *      @param[in] int Ntries: maximum # attempts to curve fit
+ *      @param[in] double TOLERANCE: convergence tolerance (double stage)
+ *      @param[in/out] struct IVFit2Params Fitparams: input guess / output
+ *                                                    final fit paramters
+ *      @return int success/failure
+ *
+ */
+int IVFit2NLLSMixed(const std::vector<double> &Ii,
+                    const std::vector<double> &V,
+                    const unsigned int &Ntries, const double &TOLERANCE,
+                                           struct IVFit2Params &FitParams);
+
+/************************************************************************/
+/*
+ * Weighted version of IVFIT2NLLSMIXED(...), W as in IVFit2NLLS(...)
+ */
+int IVFit2NLLSMixed(const std::vector<double> &Ii,
+                    const std::vector<double> &V,
+                    const std::vector<double> &W,
+                    const unsigned int &Ntries, const double &TOLERANCE,
+                                           struct IVFit2Params &FitParams);
+
 /************************************************************************/
 /*
  * The typical double probe characteristic trace is given by:
  * 
  *      I(V) = Isat * tanh(0.5 * e * V / Te)
+ *
+ * The fits use DoubleProbeModel, which also returns the gradient.
  *     
  *      @param[in] double Isat: the ion saturation current in Amps 
  *      @param[in] double V: the voltage difference between the probe tips in Volts
@@ -51,52 +147,4 @@ inline double Iv(const double &V, const double &Isat, const double &Te){
       
 }
 
-/************************************************************************/
-/*
- * The partial derivative of I(V) w.r.t Isat:
- * 
- *      d(I(V))/d(Isat) = tanh(0.5 * e * V / Te)
- *         
- *      @param[in] Isat: the ion saturation current in Amps   
- *      @param[in]    V: the voltage difference between the probe tips in Volts
- *      @param[in]   Te: the electron temperature in eV
- *      @return  double: The partial derivative of I(V) w.r.t Isa
- * 
- */
-inline double dIvdIsat(const double &V, const double &Isat,
-                                         const double &Te){
-  
-   double result = 0.0;
-   
-   result = tanh(0.5 * V / Te);
-   
-   return (result);
-   
-}
-
-/************************************************************************/
-/*
- * The partial derivative of I(V) w.r.t Te:
- * 
- *      d(I(V))/d(Te) = - Isat * 0.5 * V * (1.0 - pow(tanh(0.5 * V / Te),2.0))
- *                      / pow(Te,2.0)
- *              
- *      @param[in] Isat: the ion saturation current in Amps
- *      @param[in]    V: the voltage difference between the probe tips in Volts
- *      @param[in]   Te: the electron temperature in eV
- *      @return  double: The partial derivative of I(V) w.r.t Te
- * 
- */
-inline double dIvdTe(const double &V, const double &Isat,
-                                       const double &Te){
-  
-   double result = 0.0;
-   
-   result  = Isat * 0.5 * V * (1.0 - pow(tanh(0.5 * V / Te),2.0));
-   result *= -1.0 / (Te * Te);
-   
-   return (result);
-   
-}
-
 #endif
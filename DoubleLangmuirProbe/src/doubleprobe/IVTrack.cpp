@@ -0,0 +1,231 @@
+// -----------------------------------------------------------------------
+//
+//                                     IVTrack.cpp V 0.01
+//
+//                                 (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#include <math.h>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+#include "IVTrack.h"
+#include "IVFit2NLLS.h"
+#include "DoubleProbeAnalysis.h"
+#include "DoubleProbeModel.h"
+
+/*
+ * Window sums of the model linearized at pref, and the Jacobian row,
+ * residual and weight of every window sample in a ring buffer so a
+ * leaving sample can be subtracted again without reevaluating it.
+ */
+struct IVTrackSums{
+
+   double pref[2];          //Linearization point (Isat, Te)
+   double a00, a01, a11;    //JT * W * J
+   double b0, b1;           //JT * W * r
+   double rr;               //rT * W * r
+   std::vector<double> ring;//(J0, J1, r, w) per window slot
+
+};
+
+/************************************************************************/
+/*
+ * Adds (sign = 1) or subtracts (sign = -1) sample i, stored in slot s
+ */
+static inline void IVTrackAdd(struct IVTrackSums &S, const double &sign,
+                              const unsigned long &s){
+
+   const double *q = &S.ring[4 * s];
+
+   S.a00 += sign * q[3] * q[0] * q[0];
+   S.a01 += sign * q[3] * q[0] * q[1];
+   S.a11 += sign * q[3] * q[1] * q[1];
+   S.b0  += sign * q[3] * q[0] * q[2];
+   S.b1  += sign * q[3] * q[1] * q[2];
+   S.rr  += sign * q[3] * q[2] * q[2];
+
+}
+
+/************************************************************************/
+/*
+ * Linearizes sample i at pref into slot s
+ */
+static inline void IVTrackEval(struct IVTrackSums &S,
+                               const std::vector<double> &Ii,
+                               const std::vector<double> &V,
+                               const std::vector<double> &W,
+                               const unsigned long &i, const unsigned long &s){
+
+   double *q = &S.ring[4 * s];
+
+   q[2] = Ii[i] - DoubleProbeModel::EvalGrad(V[i], S.pref, q);
+   q[3] = W.empty() ? 1.0 : W[i];
+
+}
+
+/************************************************************************/
+/*
+ * Relinearizes the window [lo, lo + Nw) at pref and rebuilds the sums
+ */
+static void IVTrackRebuild(struct IVTrackSums &S,
+                           const std::vector<double> &Ii,
+                           const std::vector<double> &V,
+                           const std::vector<double> &W,
+                           const unsigned long &lo, const unsigned long &Nw){
+
+   S.a00 = S.a01 = S.a11 = S.b0 = S.b1 = S.rr = 0.0;
+
+   for(unsigned long i = lo; i < lo + Nw; i++){
+
+      IVTrackEval(S, Ii, V, W, i, i % Nw);
+      IVTrackAdd(S, 1.0, i % Nw);
+
+   }
+
+}
+
+/************************************************************************/
+/*
+ * Gauss-Newton step from pref with the 2 x 2 normal equations solved in
+ * closed form. Returns 0 if the window does not determine (Isat, Te).
+ */
+static int IVTrackSolve(const struct IVTrackSums &S, const unsigned long &Nw,
+                        const int &weighted, struct IVTrackPoint &P){
+
+   double det = S.a00 * S.a11 - S.a01 * S.a01,
+          d0  = 0.0,
+          d1  = 0.0,
+          chi2 = 0.0,
+          scale = 1.0;
+
+   if(!(fabs(det) > 1.0E-300) || !std::isfinite(det)){ return (0); }
+
+   d0 = ( S.a11 * S.b0 - S.a01 * S.b1) / det;
+   d1 = (-S.a01 * S.b0 + S.a00 * S.b1) / det;
+
+   //chi^2 at the step of the linearized model
+   chi2  = std::max(S.rr - (d0 * S.b0 + d1 * S.b1), 0.0);
+   scale = weighted ? 1.0 : chi2 / (Nw - 2);
+
+   P.Isat     = S.pref[0] + d0;
+   P.Te       = S.pref[1] + d1;
+   P.err[0]   = sqrt(fabs(scale * S.a11 / det));
+   P.err[1]   = sqrt(fabs(scale * S.a00 / det));
+   P.chi2_red = chi2 / (Nw - 2);
+
+   return (1);
+
+}
+
+/************************************************************************/
+/*
+ * Sliding window tracking of (Isat, Te) by recursive least squares on
+ * the linearized window sums
+ */
+int IVTrack(const std::vector<double> &Ii, const std::vector<double> &V,
+            const std::vector<double> &W, const struct IVTrackOptions &Opts,
+            const struct IVFit2Params &Guess,
+            std::vector<struct IVTrackPoint> &Track, unsigned long &Nrelin){
+//std::cout << "BEGIN IVTrack" << std::endl;
+
+   const int    Max = 100;    //Maximum iterations of the first window fit
+   const double Tol = 1.0E-8; //Tolerance of the first window fit
+   const int    MaxRelin = 10;//Maximum relinearizations per output
+
+   const unsigned long Npoi   = V.size(),
+                       Nw     = Opts.Nwindow,
+                       stride = std::max(1u, Opts.stride);
+
+   const int weighted = !W.empty();
+
+   unsigned long lo    = 0, //First sample of the window
+                 built = 0; //lo of the last rebuild of the sums
+
+   struct IVTrackSums S;
+   struct IVTrackPoint P;
+   struct IVFit2Params First = Guess;
+
+   Track.clear();
+   Nrelin = 0;
+
+   if((Ii.size() != Npoi) || (weighted && (W.size() != Npoi)) ||
+      (Nw < 3) || (Nw > Npoi)){
+
+      std::cerr << "ERROR: IVTrack needs 3 <= window <= # samples and";
+      std::cerr << " compatible I, V and W arrays" << std::endl;
+      return (0);
+
+   }
+
+   //Converged fit of the first window as the first linearization point
+   if(!IVFit2NLLS(std::vector<double>(Ii.begin(), Ii.begin() + Nw),
+                  std::vector<double>(V.begin(), V.begin() + Nw),
+                  weighted ? std::vector<double>(W.begin(), W.begin() + Nw)
+                           : std::vector<double>(), Max, Tol, First)){
+
+      std::cerr << "ERROR: IVTrack fit of the first window failed" << std::endl;
+      return (0);
+
+   }
+
+   S.pref[0] = First.Isat;
+   S.pref[1] = First.Te;
+   S.ring.assign(4 * Nw, 0.0);
+   IVTrackRebuild(S, Ii, V, W, lo, Nw);
+
+   while(1){
+
+      //Relinearize while the step moves too far from pref
+      int ok = IVTrackSolve(S, Nw, weighted, P);
+
+      for(int k = 0; ok && (k < MaxRelin) &&
+          ((fabs(P.Isat - S.pref[0]) > Opts.drift * fabs(S.pref[0])) ||
+           (fabs(P.Te   - S.pref[1]) > Opts.drift * fabs(S.pref[1]))); k++){
+
+         S.pref[0] = P.Isat;
+         S.pref[1] = P.Te;
+         IVTrackRebuild(S, Ii, V, W, lo, Nw);
+         built = lo;
+         ++Nrelin;
+         ok = IVTrackSolve(S, Nw, weighted, P);
+
+      }
+
+      if(!ok){
+
+         std::cerr << "ERROR: IVTrack singular window at sample " << lo;
+         std::cerr << std::endl;
+         return (0);
+
+      }
+
+      P.center = lo + Nw / 2;
+      Track.push_back(P);
+
+      if(lo + Nw + stride > Npoi){ break; }
+
+      //Slide by stride: sample lo leaves, lo + Nw takes over its slot
+      for(unsigned long k = 0; k < stride; k++, lo++){
+
+         IVTrackAdd(S, -1.0, lo % Nw);
+         IVTrackEval(S, Ii, V, W, lo + Nw, lo % Nw);
+         IVTrackAdd(S, 1.0, lo % Nw);
+
+      }
+
+      //Flush the round-off of the running sums
+      if(lo - built >= Nw){
+
+         IVTrackRebuild(S, Ii, V, W, lo, Nw);
+         built = lo;
+
+      }
+
+   }
+
+//std::cout << "END IVTrack" << std::endl;
+return (1);
+}//End function IVTrack
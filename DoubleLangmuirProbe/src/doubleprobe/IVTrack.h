@@ -0,0 +1,48 @@
+// -----------------------------------------------------------------------
+//
+//                                       IVTrack.h V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef IVTrack_h
+#define IVTrack_h
+
+#include <vector>
+
+#include "DoubleProbeAnalysis.h"
+
+/************************************************************************/
+/*
+ * IVTRACK(...) follows Isat and Te along a long I-V record with a
+ * window of Opts.Nwindow samples that moves by Opts.stride samples per
+ * output. Instead of refitting every window from scratch, the model is
+ * linearized once at reference parameters p_ref and the window sums
+ *
+ *      JT * W * J,  JT * W * r,  rT * W * r   (r = I - I(V; p_ref))
+ *
+ * are updated as samples enter and leave. Each output is the
+ * Gauss-Newton step p = p_ref + (JT W J)^-1 JT W r from those sums, so
+ * it costs O(stride). Only when p moves more than Opts.drift (relative)
+ * away from p_ref is the window relinearized at p, which costs
+ * O(Nwindow). The sums are also rebuilt once every Nwindow samples to
+ * flush the round-off of the subtractions.
+ *
+ *      @param[in] std::vector Ii: an input vector of current measurements
+ *      @param[in] std::vector V: an input vector of voltage measurements
+ *      @param[in] std::vector W: an input vector of weights (empty = 1)
+ *      @param[in] struct IVTrackOptions Opts: window, stride and drift
+ *      @param[in] struct IVFit2Params Guess: initial guess, refined on
+ *                                            the first window
+ *      @param[out] std::vector Track: one point per output
+ *      @param[out] unsigned long Nrelin: # relinearizations
+ *      @return int success/failure
+ *
+ */
+int IVTrack(const std::vector<double> &Ii, const std::vector<double> &V,
+            const std::vector<double> &W, const struct IVTrackOptions &Opts,
+            const struct IVFit2Params &Guess,
+            std::vector<struct IVTrackPoint> &Track, unsigned long &Nrelin);
+
+#endif
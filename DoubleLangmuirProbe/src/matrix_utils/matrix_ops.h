@@ -92,4 +92,37 @@ int TransposeMatrix(const double *A, const int &ANROW, const int &ANCOL,
  */
 int PrintMatrix(const double *A, const int &ANROW, const int &ANCOL);
 
+/************************************************************************/
+/*
+ * CompensatedSum is a single precision running sum with a Kahan
+ * correction term. It recovers most of the accuracy lost when many
+ * float32 terms of similar size are accumulated, e.g. the entries of
+ * the normal equations in the mixed precision curve fits.
+ *
+ */
+struct CompensatedSum{
+
+   float sum; //Running sum
+   float c;   //Running compensation (lost low order bits)
+
+};
+
+/************************************************************************/
+/*
+ * CompensatedAdd(...) adds v to the compensated sum S
+ *
+ *      @param[in/out] CompensatedSum S: running sum
+ *      @param[in] float v: value to add
+ *
+ */
+inline void CompensatedAdd(struct CompensatedSum &S, const float &v){
+
+   float y = v - S.c,
+         t = S.sum + y;
+
+   S.c   = (t - S.sum) - y;
+   S.sum = t;
+
+}
+
 #endif
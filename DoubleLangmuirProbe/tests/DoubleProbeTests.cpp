@@ -0,0 +1,793 @@
+// -----------------------------------------------------------------------
+//
+//                                 DoubleProbeTests.cpp V 0.01
+//
+//                                 (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <getopt.h>
+
+#include "doubleprobe/IVFit2NLLS.h"
+#include "doubleprobe/IVDataReader.h"
+#include "nlls_utils/bootstrap.h"
+#include "nlls_utils/adc_input.h"
+#include "nlls_utils/input_stream.h"
+
+/*
+ * Every allocation of the process, LAPACK's and the standard library's
+ * included, goes through these, so a case can count what one fit
+ * allocates. glibc exports the allocator under __libc_*.
+ */
+extern "C" void *__libc_malloc(size_t n);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *p, size_t n);
+extern "C" void __libc_free(void *p);
+
+static std::atomic<unsigned long> Nalloc(0); //# allocations
+static std::atomic<unsigned long> Nbytes(0); //# bytes allocated
+
+extern "C" void *malloc(size_t n){ Nalloc++; Nbytes += n; return (__libc_malloc(n)); }
+
+extern "C" void *calloc(size_t n, size_t size){
+
+   Nalloc++;
+   Nbytes += n * size;
+   return (__libc_calloc(n, size));
+
+}
+
+extern "C" void *realloc(void *p, size_t n){ Nalloc++; Nbytes += n; return (__libc_realloc(p, n)); }
+
+extern "C" void free(void *p){ __libc_free(p); }
+
+static const int    Max = 100;    //Maximum number of iterations while fitting
+static const double Tol = 1.0E-8; //Tolerance for convergence of the curve fit
+
+//The synthetic traces: Isat * tanh(V / 2Te) over +/- V_max
+static const double Is_true = 5.0E-6; //Ion saturation current [A]
+static const double Te_true = 7.5;    //Electron temperature   [eV]
+static const double V_max   = 60.0;   //Voltage sweep +/- V_max [V]
+
+/*
+ * A golden value: the value with its relative tolerance, or a budget
+ * the value must not exceed
+ */
+struct GoldenValue{
+
+   double value;
+   double rtol;
+   int    budget; //1: value is an upper bound
+
+};
+
+typedef std::map<std::string, struct GoldenValue> GoldenCase;
+
+/*
+ * The quantities a case computes, in order
+ */
+typedef std::vector<std::pair<std::string, double> > CaseValues;
+
+/************************************************************************/
+/*
+ * Reads the golden file, lines of
+ *      <case> <quantity> <value> <rtol>
+ *      <case> <quantity> <= <budget>
+ */
+static int ReadGolden(const char *filename, std::map<std::string, GoldenCase> &G){
+
+   std::ifstream in(filename);
+   std::string line;
+
+   if(!in.is_open()){
+
+      std::cerr << "Error opening file:" << filename << std::endl;
+      return (0);
+
+   }
+
+   while(std::getline(in, line)){
+
+      std::istringstream s(line);
+      std::string name, quantity, a, b;
+      struct GoldenValue v = {0.0, 0.0, 0};
+
+      if(line.empty() || ('#' == line[0])){ continue; }
+
+      if(!(s >> name >> quantity >> a >> b)){
+
+         std::cerr << "ERROR: bad golden line: " << line << std::endl;
+         return (0);
+
+      }
+
+      v.budget = ("<=" == a);
+      v.value  = atof(v.budget ? b.c_str() : a.c_str());
+      v.rtol   = v.budget ? 0.0 : atof(b.c_str());
+      G[name][quantity] = v;
+
+   }
+
+   return (1);
+
+}
+
+/************************************************************************/
+/*
+ * Gaussian noise from SplitMix64 (Box-Muller), the same on every host
+ */
+static double Gauss(uint64_t &state){
+
+   const double u1 = ldexp((double)(SplitMix64(state) >> 11) + 0.5, -53),
+                u2 = ldexp((double)(SplitMix64(state) >> 11), -53);
+
+   return (sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2));
+
+}
+
+/*
+ * Synthetic trace of Npoi samples with Gaussian noise of rel * Is_true,
+ * sigma (if not NULL) is the noise of every sample, which grows from
+ * rel / 2 at V = 0 to 2 rel at |V| = V_max. Every spike-th sample gets
+ * an arc of +3 Is_true (spike = 0: none).
+ */
+static void SyntheticTrace(const unsigned int &Npoi, const double &rel,
+                           const unsigned int &spike, uint64_t seed,
+                           std::vector<double> &V, std::vector<double> &I,
+                           std::vector<double> *sigma){
+
+   V.resize(Npoi);
+   I.resize(Npoi);
+   if(NULL != sigma){ sigma->resize(Npoi); }
+
+   for(unsigned int i = 0; i < Npoi; i++){
+
+      double s = rel * Is_true;
+
+      V[i] = V_max * (2.0 * i / (Npoi - 1) - 1.0);
+      if(NULL != sigma){
+
+         s *= 0.5 + 1.5 * fabs(V[i]) / V_max;
+         (*sigma)[i] = s;
+
+      }
+      I[i] = Iv(V[i], Is_true, Te_true) + s * Gauss(seed);
+      if((spike > 0) && (spike / 2 == i % spike)){ I[i] += 3.0 * Is_true; }
+
+   }
+
+}
+
+/************************************************************************/
+/*
+ * Runs one fit Nrep times from the same guess. The values are those of
+ * the first fit, time_ms the fastest fit (the least disturbed by the
+ * rest of the machine) and allocs / kbytes what the first fit allocated.
+ */
+template<class Fit>
+static int TimedFit(Fit fit, const unsigned int &Nrep, struct IVFit2Params &P,
+                    CaseValues &values){
+
+   const struct IVFit2Params Guess = P;
+
+   double t_min = 1.0E30;
+   unsigned long Na = 0,
+                 Nb = 0;
+
+   for(unsigned int r = 0; r < Nrep; r++){
+
+      struct IVFit2Params Q = Guess;
+      unsigned long a0 = Nalloc, b0 = Nbytes;
+      std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+      if(!fit(Q)){ std::cerr << "ERROR: fit failed" << std::endl; return (0); }
+
+      t_min = std::min(t_min, std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - t0).count());
+      if(0 == r){ P = Q; Na = Nalloc - a0; Nb = Nbytes - b0; }
+
+   }
+
+   values.push_back(std::make_pair("Isat", P.Isat));
+   values.push_back(std::make_pair("Te", P.Te));
+   values.push_back(std::make_pair("chi2_red", P.Stats.chi2_red));
+   values.push_back(std::make_pair("Niter", (double)P.Stats.Niter));
+   values.push_back(std::make_pair("time_ms", 1.0E3 * t_min));
+   values.push_back(std::make_pair("allocs", (double)Na));
+   values.push_back(std::make_pair("kbytes", Nb / 1024.0));
+
+   return (1);
+
+}
+
+/*
+ * A fit of a synthetic trace must also find the truth, within 5 of its
+ * standard errors
+ */
+static int CheckTruth(const struct IVFit2Params &P){
+
+   const int ok = (fabs(P.Isat - Is_true) < 5.0 * P.Stats.err[0]) &&
+                  (fabs(P.Te - Te_true) < 5.0 * P.Stats.err[1]);
+
+   if(!ok){
+
+      std::cerr << "FAIL: (" << P.Isat << ", " << P.Te << ") is not within 5";
+      std::cerr << " standard errors of the truth (" << Is_true << ", " << Te_true;
+      std::cerr << ")" << std::endl;
+
+   }
+
+   return (ok);
+
+}
+
+/************************************************************************/
+/*
+ * The cases, see golden/params.txt
+ */
+static int RunCase(const std::string &name, const char *input, CaseValues &values){
+
+   std::vector<double> V, I, S, W;
+   struct IVFit2Params P = {3.3E-6, 3.0, 2};
+   struct ADCTrace Raw;
+
+   //The initial guess of DoubleProbeAnalysis on the example trace
+   if(("example" == name) || ("example_mixed" == name)){
+
+      if((NULL == input) || !ReadIVData(input, V, I, S)){ return (0); }
+
+      auto fit = [&](struct IVFit2Params &Q){
+
+         return (("example" == name) ? IVFit2NLLS(I, V, Max, Tol, Q)
+                                     : IVFit2NLLSMixed(I, V, Max, Tol, Q));
+
+      };
+
+      return (TimedFit(fit, 20, P, values));
+
+   }
+
+   P.Isat = 3.0E-6;
+   P.Te   = 5.0;
+
+   if("synthetic" == name){
+
+      SyntheticTrace(2001, 0.01, 0, 1, V, I, NULL);
+
+      auto fit = [&](struct IVFit2Params &Q){ return (IVFit2NLLS(I, V, Max, Tol, Q)); };
+
+      return (TimedFit(fit, 20, P, values) && CheckTruth(P));
+
+   }
+
+   if("synthetic_weighted" == name){
+
+      SyntheticTrace(2001, 0.01, 0, 2, V, I, &S);
+      SigmaToWeights(S, W);
+
+      auto fit = [&](struct IVFit2Params &Q){ return (IVFit2NLLS(I, V, W, Max, Tol, Q)); };
+
+      return (TimedFit(fit, 20, P, values) && CheckTruth(P));
+
+   }
+
+   //Arcs on 2% of the samples, which the robust fit ignores
+   if("spikes_tukey" == name){
+
+      SyntheticTrace(2001, 0.01, 50, 3, V, I, NULL);
+      NLLSLossParse("tukey", P.Loss);
+
+      auto fit = [&](struct IVFit2Params &Q){ return (IVFit2NLLS(I, V, Max, Tol, Q)); };
+
+      return (TimedFit(fit, 20, P, values) && CheckTruth(P));
+
+   }
+
+   //The trace as int16 codes of a 12 bit digitizer
+   if("adc" == name){
+
+      const struct ADCCalibration cal = {{V_max / 2047.0, 2.0 * Is_true / 2047.0},
+                                         {0.0, 0.0}};
+
+      SyntheticTrace(2001, 0.01, 0, 4, V, I, NULL);
+      Raw.bytes    = 2;
+      Raw.Nsamples = V.size();
+      Raw.cal      = cal;
+      Raw.code16.resize(2 * V.size());
+      for(unsigned int i = 0; i < V.size(); i++){
+
+         Raw.code16[2 * i]     = (int16_t)lround(V[i] / cal.gain[0]);
+         Raw.code16[2 * i + 1] = (int16_t)lround(I[i] / cal.gain[1]);
+
+      }
+
+      auto fit = [&](struct IVFit2Params &Q){ return (IVFit2NLLSADC(Raw, Max, Tol, Q)); };
+
+      return (TimedFit(fit, 20, P, values) && CheckTruth(P));
+
+   }
+
+   //Throughput of the solver on a long record
+   if("long" == name){
+
+      SyntheticTrace(200000, 0.01, 0, 5, V, I, NULL);
+
+      auto fit = [&](struct IVFit2Params &Q){ return (IVFit2NLLS(I, V, Max, Tol, Q)); };
+
+      return (TimedFit(fit, 3, P, values) && CheckTruth(P));
+
+   }
+
+   //The long record as a voltage grid, fitted in +/-V pairs, and the
+   //example read as a grid
+   if("grid" == name){
+
+      struct IVGrid G;
+
+      if((NULL == input) || !ReadIVData(input, G, V, I, S)){ return (0); }
+      values.push_back(std::make_pair("example_N", (double)G.N));
+      values.push_back(std::make_pair("example_V", (double)V.size()));
+
+      SyntheticTrace(200000, 0.01, 0, 5, V, I, NULL);
+      if(!IVUniformGrid(V, G)){ std::cerr << "ERROR: no voltage grid" << std::endl; return (0); }
+      std::vector<double>().swap(V);
+
+      auto fit = [&](struct IVFit2Params &Q){ return (IVFit2NLLS(I, G, W, Max, Tol, Q)); };
+
+      return (TimedFit(fit, 3, P, values) && CheckTruth(P));
+
+   }
+
+   //Parsing a long ASCII trace, then its fit
+   if("read" == name){
+
+      const char *filename = "read_trace.dat";
+      std::ofstream out(filename);
+
+      SyntheticTrace(200000, 0.01, 0, 6, V, I, NULL);
+      out << std::scientific << std::setprecision(9);
+      for(unsigned int i = 0; i < V.size(); i++){ out << V[i] << " " << I[i] << "\n"; }
+      out.close();
+      if(out.fail()){ std::cerr << "ERROR: cannot write " << filename << std::endl; return (0); }
+
+      auto fit = [&](struct IVFit2Params &Q){
+
+         return (ReadIVData(filename, V, I, S) && IVFit2NLLS(I, V, Max, Tol, Q));
+
+      };
+
+      return (TimedFit(fit, 3, P, values) && CheckTruth(P));
+
+   }
+
+   //The reason IVTriage finds for good and for broken traces, and its
+   //cost on a long record
+   if("triage" == name){
+
+      struct TriageStats Tri;
+      std::vector<double> Vb, Ib;
+      double t_min = 1.0E30;
+      unsigned long Na = 0;
+
+      auto reason = [&](const char *quantity, const std::vector<double> &Vt,
+                        const std::vector<double> &It){
+
+         IVTriage(Vt, It, Raw, Tri);
+         values.push_back(std::make_pair(quantity, (double)Tri.reason));
+
+      };
+
+      if((NULL == input) || !ReadIVData(input, V, I, S)){ return (0); }
+      reason("example", V, I);
+
+      SyntheticTrace(2001, 0.01, 0, 7, V, I, NULL);
+      reason("good", V, I);
+
+      Vb.assign(V.begin(), V.begin() + 3);
+      Ib.assign(I.begin(), I.begin() + 3);
+      reason("short", Vb, Ib);
+
+      Ib = I;
+      Ib[1000] = NAN;
+      reason("nonfinite", V, Ib);
+
+      Ib.assign(I.size(), 1.0E-6);
+      reason("flat", V, Ib);
+
+      //A digitizer clipping at 80% of Isat
+      for(unsigned int i = 0; i < I.size(); i++){
+
+         Ib[i] = std::max(-0.8 * Is_true, std::min(0.8 * Is_true, I[i]));
+
+      }
+      reason("clipped", V, Ib);
+
+      //A sweep that never crosses V = 0
+      Vb.resize(V.size());
+      for(unsigned int i = 0; i < V.size(); i++){ Vb[i] = V[i] + V_max; }
+      reason("one_sided", Vb, I);
+
+      //A trace of noise, the probe not biased
+      for(unsigned int i = 0; i < I.size(); i++){ Ib[i] = I[i] - Iv(V[i], Is_true, Te_true); }
+      reason("noise", V, Ib);
+
+      //A noise-free sweep of Te = 2 eV, its +/- Isat plateaus over a third
+      //of the samples each, written with 3 and with 7 digits: the plateaus
+      //are not clipping
+      Vb.resize(241);
+      Ib.resize(Vb.size());
+      for(int digits = 3; digits <= 7; digits += 4){
+
+         char num[32];
+
+         for(unsigned int i = 0; i < Vb.size(); i++){
+
+            Vb[i] = V_max * (2.0 * i / (Vb.size() - 1) - 1.0);
+            snprintf(num, sizeof(num), "%.*e", digits - 1, Iv(Vb[i], Is_true, 2.0));
+            Ib[i] = atof(num);
+
+         }
+         reason((3 == digits) ? "plateau_3" : "plateau_7", Vb, Ib);
+
+      }
+
+      //Raw codes of a 16 bit digitizer whose full scale is 80% of Isat
+      Raw.bytes    = 2;
+      Raw.Nsamples = V.size();
+      Raw.cal.gain[0] = V_max / INT16_MAX;
+      Raw.cal.gain[1] = 0.8 * Is_true / INT16_MAX;
+      Raw.cal.offset[0] = Raw.cal.offset[1] = 0.0;
+      Raw.code16.resize(2 * V.size());
+      for(unsigned int i = 0; i < V.size(); i++){
+
+         const long code = lround(I[i] / Raw.cal.gain[1]);
+
+         Raw.code16[2 * i]     = (int16_t)lround(V[i] / Raw.cal.gain[0]);
+         Raw.code16[2 * i + 1] = (int16_t)std::max((long)INT16_MIN,
+                                                   std::min((long)INT16_MAX, code));
+
+      }
+      Vb.clear();
+      reason("adc_clip", Vb, Ib);
+      Raw.Nsamples = 0;
+
+      SyntheticTrace(200000, 0.01, 0, 5, V, I, NULL);
+      for(unsigned int r = 0; r < 5; r++){
+
+         unsigned long a0 = Nalloc;
+         std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+         IVTriage(V, I, Raw, Tri);
+         t_min = std::min(t_min, std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now() - t0).count());
+         if(0 == r){ Na = Nalloc - a0; }
+
+      }
+      values.push_back(std::make_pair("long", (double)Tri.reason));
+      values.push_back(std::make_pair("time_ms", 1.0E3 * t_min));
+      values.push_back(std::make_pair("allocs", (double)Na));
+
+      return (1);
+
+   }
+
+   std::cerr << "ERROR: no case " << name << std::endl;
+   return (0);
+
+}
+
+/************************************************************************/
+/*
+ * Checks the values of a case against its golden values. Every value
+ * needs one, so a new quantity cannot go unchecked.
+ */
+static int CheckCase(const std::string &name, const CaseValues &values,
+                     const GoldenCase &G){
+
+   int ok = 1;
+
+   std::cout << std::setprecision(9);
+   for(unsigned int k = 0; k < values.size(); k++){
+
+      GoldenCase::const_iterator g = G.find(values[k].first);
+      const double v = values[k].second;
+      int pass = 0;
+
+      std::cout << " " << std::left << std::setw(9) << values[k].first;
+      std::cout << std::right << ": " << std::setw(16) << v;
+
+      if(G.end() == g){
+
+         std::cout << "  no golden value" << std::endl;
+         ok = 0;
+         continue;
+
+      }
+
+      if(g->second.budget){
+
+         pass = (v <= g->second.value);
+         std::cout << "  budget " << g->second.value;
+
+      }else{
+
+         pass = (fabs(v - g->second.value) <= g->second.rtol * fabs(g->second.value));
+         std::cout << "  golden " << g->second.value << " +/- " << g->second.rtol;
+
+      }
+      std::cout << (pass ? "" : "  FAIL") << std::endl;
+      ok = ok && pass;
+
+   }
+
+   for(GoldenCase::const_iterator g = G.begin(); g != G.end(); g++){
+
+      int found = 0;
+
+      for(unsigned int k = 0; k < values.size(); k++){ found |= (g->first == values[k].first); }
+      if(!found){
+
+         std::cout << " " << g->first << ": golden value, but not computed  FAIL";
+         std::cout << std::endl;
+         ok = 0;
+
+      }
+
+   }
+
+   std::cout << name << (ok ? " passed" : " FAILED") << std::endl;
+
+   return (ok);
+
+}
+
+/************************************************************************/
+/*
+ * Compares two _fit.dat files number by number
+ */
+static int CompareFiles(const char *output, const char *reference, const double &rtol){
+
+   std::ifstream a(output),
+                 b(reference);
+   double x = 0.0,
+          y = 0.0;
+   unsigned long n = 0,
+                 Nbad = 0;
+
+   if(!a.is_open() || !b.is_open()){
+
+      std::cerr << "Error opening file:" << (a.is_open() ? reference : output);
+      std::cerr << std::endl;
+      return (0);
+
+   }
+
+   while(b >> y){
+
+      if(!(a >> x)){
+
+         std::cout << output << " is shorter than " << reference << std::endl;
+         return (0);
+
+      }
+
+      if(fabs(x - y) > rtol * std::max(fabs(y), 1.0E-300)){
+
+         if(Nbad++ < 5){
+
+            std::cout << " value " << n << ": " << x << " instead of " << y << std::endl;
+
+         }
+
+      }
+      n++;
+
+   }
+
+   if(a >> x){
+
+      std::cout << output << " is longer than " << reference << std::endl;
+      return (0);
+
+   }
+
+   std::cout << n << " values, " << Nbad << " differ by more than " << rtol;
+   std::cout << std::endl;
+
+   return ((0 == Nbad) && (n > 0));
+
+}
+
+/************************************************************************/
+/*
+ * Writes synthetic traces and a list of them into dir, for a batch run
+ */
+static int WriteTraces(const std::string &dir){
+
+   std::ofstream list((dir + "/list.txt").c_str());
+
+   if(!list.is_open()){
+
+      std::cerr << "Error opening file:" << dir << "/list.txt" << std::endl;
+      return (0);
+
+   }
+
+   for(unsigned int k = 0; k < 16; k++){
+
+      std::ostringstream name;
+      std::vector<double> V, I, S;
+
+      name << dir << "/trace_" << k << ".dat";
+      SyntheticTrace(241 + 40 * k, 0.01, (k % 4) ? 0 : 60, 100 + k, V, I,
+                     (k % 2) ? &S : NULL);
+
+      std::ofstream out(name.str().c_str());
+
+      out << std::scientific << std::setprecision(9);
+      for(unsigned int i = 0; i < V.size(); i++){
+
+         out << V[i] << " " << I[i];
+         if(!S.empty()){ out << " " << S[i]; }
+         out << "\n";
+
+      }
+      out.close();
+      if(out.fail()){ std::cerr << "ERROR: cannot write " << name.str() << std::endl; return (0); }
+
+      list << name.str() << "\n";
+
+   }
+
+   list.close();
+
+   return (!list.fail());
+
+}
+
+/*
+ * The _fit.dat file the batch wrote for every listed trace must be that
+ * of a fit of the trace on its own, as DoubleProbeAnalysis runs it
+ */
+static int CheckBatch(const char *list_filename, const double &rtol){
+
+   std::ifstream list(list_filename);
+   std::string filename;
+   int ok = 1;
+
+   if(!list.is_open()){
+
+      std::cerr << "Error opening file:" << list_filename << std::endl;
+      return (0);
+
+   }
+
+   while(std::getline(list, filename)){
+
+      std::vector<double> V, I, S, W;
+      struct IVFit2Params P = {3.3E-6, 3.0, 2};
+      std::string output = InputStem(filename.c_str()) + "_fit.dat",
+                  expect = InputStem(filename.c_str()) + "_expect.dat";
+
+      if(!ReadIVData(filename.c_str(), V, I, S)){ return (0); }
+      SigmaToWeights(S, W);
+      if(!IVFit2NLLS(I, V, W, Max, Tol, P)){ return (0); }
+
+      std::ofstream out(expect.c_str());
+
+      out << std::scientific;
+      for(unsigned int i = 0; i < V.size(); i++){
+
+         out << V[i] << " " << Iv(V[i], P.Isat, P.Te) << std::endl;
+
+      }
+      out.close();
+
+      std::cout << filename << ": ";
+      ok = CompareFiles(output.c_str(), expect.c_str(), rtol) && ok;
+
+   }
+
+   return (ok);
+
+}
+
+/************************************************************************/
+int main(int argc, char** argv){
+
+   int opt   = 0,
+       print = 0;
+   double rtol = 1.0E-5;
+   const char *golden    = NULL,
+              *input     = NULL,
+              *case_name = NULL,
+              *output    = NULL,
+              *reference = NULL,
+              *trace_dir = NULL,
+              *batch     = NULL;
+
+   std::map<std::string, GoldenCase> G;
+   CaseValues values;
+
+   while((opt = getopt(argc, argv, "g:i:c:pf:r:t:w:b:")) != -1){
+
+      switch (opt) {
+
+         case 'g' : golden    = optarg; break; //golden values
+         case 'i' : input     = optarg; break; //the example trace
+         case 'c' : case_name = optarg; break; //case to run
+         case 'p' : print     = 1;      break; //print golden lines instead
+         case 'f' : output    = optarg; break; //_fit.dat to compare ...
+         case 'r' : reference = optarg; break; //... with this one
+         case 't' : rtol = atof(optarg); break; //relative tolerance
+         case 'w' : trace_dir = optarg; break; //write synthetic traces
+         case 'b' : batch     = optarg; break; //check a batch of them
+
+         default :
+
+            std::cout << "Usage:" << std::endl;
+            std::cout << "DoubleProbeTests -g golden -c case [-i example] [-p]";
+            std::cout << std::endl;
+            std::cout << "DoubleProbeTests -f output -r reference [-t rtol]";
+            std::cout << std::endl;
+            std::cout << "DoubleProbeTests -w dir | -b list [-t rtol]" << std::endl;
+            return (EXIT_FAILURE);
+
+      }
+
+   }
+
+   if(NULL != output){
+
+      return (CompareFiles(output, reference, rtol) ? 0 : EXIT_FAILURE);
+
+   }
+
+   if(NULL != trace_dir){ return (WriteTraces(trace_dir) ? 0 : EXIT_FAILURE); }
+
+   if(NULL != batch){ return (CheckBatch(batch, rtol) ? 0 : EXIT_FAILURE); }
+
+   if((NULL == case_name) || (!print && ((NULL == golden) || !ReadGolden(golden, G)))){
+
+      std::cerr << "ERROR: -c case and -g golden file needed" << std::endl;
+      return (EXIT_FAILURE);
+
+   }
+
+   if(!RunCase(case_name, input, values)){
+
+      std::cout << case_name << " FAILED" << std::endl;
+      return (EXIT_FAILURE);
+
+   }
+
+   //Lines to paste into the golden file after an intended change
+   if(print){
+
+      std::cout << std::setprecision(9);
+      for(unsigned int k = 0; k < values.size(); k++){
+
+         std::cout << std::left << std::setw(20) << case_name << std::setw(10);
+         std::cout << values[k].first << std::right << values[k].second << std::endl;
+
+      }
+      return (0);
+
+   }
+
+   return (CheckCase(case_name, values, G[case_name]) ? 0 : EXIT_FAILURE);
+
+}
@@ -0,0 +1,128 @@
+// -----------------------------------------------------------------------
+//
+//                                     faddeeva.h V 0.01
+//
+//                                (c) Brian Lynch March, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef lif_faddeeva_h
+#define lif_faddeeva_h
+
+#include <math.h>
+#include <cmath>
+
+/************************************************************************/
+/*
+ * Faddeeva(...) evaluates the Faddeeva function
+ *
+ *      w(z) = exp(-z^2) erfc(-i z),   z = x + i y,   y >= 0
+ *
+ * with Weideman's rational approximation (SIAM J. Numer. Anal. 31,
+ * 1497, 1994) of N = 32 terms:
+ *
+ *      w(z) = 2 p(Z) / (L - i z)^2 + 1 / (sqrt(pi) (L - i z))
+ *      Z    = (L + i z) / (L - i z),   L = sqrt(N / sqrt(2))
+ *
+ * p is a polynomial of degree 31 whose coefficients are the Fourier
+ * coefficients of exp(-t^2) (L^2 + t^2) on t = L tan(theta / 2). Every
+ * z costs one division and 34 complex multiply adds, with no branches
+ * and no special functions. It is written out in real arithmetic so it
+ * inlines into the fit loop, T can also be float or a Dual number.
+ *
+ * Measured against quadrature of the Voigt integrals (see LIFBenchmark)
+ * the error of w is below 5e-14 absolute and 4e-13 relative for
+ * 0 <= y <= 10 and |x| <= 10. On the real axis Re w(x) = exp(-x^2), so
+ * y = 0 gives the Gaussian.
+ *
+ *      @param[in] T x: real part of z
+ *      @param[in] T y: imaginary part of z, y >= 0
+ *      @param[out] T u: Re w(z)
+ *      @param[out] T v: Im w(z)
+ *
+ */
+template<class T>
+inline void Faddeeva(const T &x, const T &y, T &u, T &v){
+
+   const int    N = 32;
+   const double L = 4.756828460010884; // sqrt(N / sqrt(2))
+
+   // Polynomial coefficients of p(Z), highest degree first
+   static const double a[N] = {
+      -1.30255212179359728e-12, +3.73948788601197180e-12,
+      +8.03388258696635660e-12, -2.15421985805264171e-11,
+      -5.54383136619485128e-11, +1.16582701825684865e-10,
+      +4.15378280382849852e-10, -5.23100597560333114e-10,
+      -3.20801434028350485e-09, +8.12494058144430653e-10,
+      +2.37975647937593848e-08, +2.29304413096320658e-08,
+      -1.48130787760991645e-07, -4.18407636509909864e-07,
+      +4.25583312466115693e-07, +4.40153173071611281e-06,
+      +6.82103194306338256e-06, -2.14096192034385346e-05,
+      -1.30754492546292234e-04, -2.45329802703447841e-04,
+      +3.92591360699801051e-04, +4.51954110534813491e-03,
+      +1.90061557848446028e-02, +5.73044035298355819e-02,
+      +1.40607162268936381e-01, +2.95444510715085928e-01,
+      +5.46013972063932540e-01, +9.01925489364799216e-01,
+      +1.34554416923454379e+00, +1.82566962963248103e+00,
+      +2.26353729990026631e+00, +2.57225340812456871e+00
+   };
+
+   // r = 1 / (L - i z) = (L + y + i x) / ((L + y)^2 + x^2)
+   const T qr = T(L) + y,
+           n  = T(1.0) / (qr * qr + x * x),
+           rr = qr * n,
+           ri = x * n;
+
+   // Z = (L + i z) * r = (L - y + i x) * r
+   const T ar = T(L) - y,
+           Zr = ar * rr - x * ri,
+           Zi = ar * ri + x * rr;
+
+   // p(Z) = P0(Z^4) Z^3 + P1(Z^4) Z^2 + P2(Z^4) Z + P3(Z^4), four
+   // independent Horner chains of 8 terms instead of one of 32, so the
+   // multiply adds of the chains overlap in the pipeline
+   const T Z2r = Zr * Zr - Zi * Zi,
+           Z2i = T(2.0) * Zr * Zi,
+           Z4r = Z2r * Z2r - Z2i * Z2i,
+           Z4i = T(2.0) * Z2r * Z2i;
+
+   T Pr[4], Pi[4];
+
+   for(int j = 0; j < 4; j++){ Pr[j] = T(a[j]); Pi[j] = T(0.0); }
+
+   for(int k = 4; k < N; k += 4){
+
+      for(int j = 0; j < 4; j++){
+
+         const T t = Pr[j] * Z4r - Pi[j] * Z4i + T(a[k + j]);
+
+         Pi[j] = Pr[j] * Z4i + Pi[j] * Z4r;
+         Pr[j] = t;
+
+      }
+
+   }
+
+   // Combine, ((P0 Z + P1) Z + P2) Z + P3
+   T pr = Pr[0],
+     pi = Pi[0];
+
+   for(int j = 1; j < 4; j++){
+
+      const T t = pr * Zr - pi * Zi + Pr[j];
+
+      pi = pr * Zi + pi * Zr + Pi[j];
+      pr = t;
+
+   }
+
+   // w = r * (2 p r + 1 / sqrt(pi))
+   const T sr = T(2.0) * (pr * rr - pi * ri) + T(0.5 * M_2_SQRTPI),
+           si = T(2.0) * (pr * ri + pi * rr);
+
+   u = sr * rr - si * ri;
+   v = sr * ri + si * rr;
+
+}
+
+#endif
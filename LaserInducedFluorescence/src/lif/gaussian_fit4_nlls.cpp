@@ -10,10 +10,13 @@
 #include <vector>
 #include <iostream>
 #include <new>
+#include <algorithm>
 
 #include "gaussian_fit4_nlls.h"
 #include "lif_analysis.h"
+#include "gaussian_model.h"
 #include "matrix_utils/matrix_ops.h"
+#include "nlls_utils/nlls_solver.h"
 
 /************************************************************************/
 /*
@@ -23,187 +26,273 @@
 int gauss_fit4_nlls(double **x, double **fx,
                     const unsigned int &Npoints, const unsigned int &Ntries,
                       const double &TOL, struct GaussFit4Params &FitParams){
+
+   // Unweighted fit, all points have weight 1
+   return (gauss_fit4_nlls(x, fx, NULL, Npoints, Ntries, TOL, FitParams));
+
+}// End function gaussian_fit4_nlls
+
+/************************************************************************/
+/*
+ * 4 parameter weighted nonlinear least squares fitting, NLLSFit(...)
+ * specialized to the Gaussian model.
+ */
+int gauss_fit4_nlls(double **x, double **fx, double **w,
+                    const unsigned int &Npoints, const unsigned int &Ntries,
+                      const double &TOL, struct GaussFit4Params &FitParams){
 //std::cout << "BEGIN gaussian_fit4_nlls" << std::endl;
 
    int res  = 0;
    
+   unsigned int Npar = GaussianModel::Npar; //# fit parameters [4]
+
+   double param[GaussianModel::Npar] = {FitParams.x0, FitParams.sigma2,
+                                        FitParams.Ao, FitParams.Bo};
+
+   struct NLLSStats Stats;
+
+   // Weights, w or *w may be NULL for an unweighted fit
+   const double *wp = (NULL == w) ? NULL : *w;
+
+   res = NLLSFit<GaussianModel>(*x, *fx, wp, Npoints, Ntries, TOL, param,
+                                FitParams.Stats.cov, Stats, &FitParams.Loss);
+   if(!res){ return (res); }
+
+   // Store the results
+   FitParams.x0     = param[0];
+   FitParams.sigma2 = param[1]; 
+   FitParams.Ao     = param[2];
+   FitParams.Bo     = param[3];
+
+   FitParams.Stats.chi2      = Stats.chi2;
+   FitParams.Stats.chi2_red  = Stats.chi2_red;
+   FitParams.Stats.R2        = Stats.R2;
+   FitParams.Stats.dparam2   = Stats.dparam2;
+   FitParams.Stats.step      = Stats.step;
+   FitParams.Stats.stop      = Stats.stop;
+   FitParams.Stats.Niter     = Stats.Niter;
+   FitParams.Stats.Niter_f32 = 0;
+   FitParams.Stats.scale     = Stats.scale;
+   FitParams.Stats.Noutliers = Stats.Noutliers;
+   for(unsigned int i = 0; i < Npar; i++){
+
+      FitParams.Stats.err[i] = sqrt(fabs(FitParams.Stats.cov[i * Npar + i]));
+
+   }
+
+//std::cout << "END gaussian_fit4_nlls" << std::endl;
+return (res);
+}// End function gaussian_fit4_nlls
+
+/************************************************************************/
+/*
+ * 4 parameter nonlinear least squares fitting in mixed precision. The
+ * float32 stage stops once the relative parameter step is below what
+ * float32 can resolve, gauss_fit4_nlls then finishes the fit in double.
+ * The float32 stage is least squares, a robust loss only applies to the
+ * double stage, which reweights from the float32 solution.
+ */
+int gauss_fit4_nlls_mixed(double **x, double **fx,
+                    const unsigned int &Npoints, const unsigned int &Ntries,
+                      const double &TOL, struct GaussFit4Params &FitParams){
+
+   // Unweighted fit, all points have weight 1
+   return (gauss_fit4_nlls_mixed(x, fx, NULL, Npoints, Ntries, TOL, FitParams));
+
+}// End function gaussian_fit4_nlls_mixed
+
+/************************************************************************/
+/*
+ * Weighted version of the mixed precision fit. The weights are scaled
+ * by their maximum for the float32 stage, which only rescales the
+ * normal equations and leaves the step unchanged.
+ */
+int gauss_fit4_nlls_mixed(double **x, double **fx, double **w,
+                    const unsigned int &Npoints, const unsigned int &Ntries,
+                      const double &TOL, struct GaussFit4Params &FitParams){
+//std::cout << "BEGIN gaussian_fit4_nlls_mixed" << std::endl;
+
+   const float MIXED_TOL = 1.0E-4f; // Relative step resolved in float32
+
+   int res  = 0;
+
    unsigned int it   = 0,
                 Npar = FitParams.Npar; //# fit parameters [4 in this case]
-       
-   double xt      = 0.0,  // Temporary Counts
-          fxt     = 0.0,  // Temporary Lambda
-          *dFx    = NULL, // Difference between fit and data
-          *R2     = NULL, // Sum of squared residuals
+
+   double xc      = 0.0,  // Wavelength center (mean)
+          xs      = 0.0,  // Wavelength scale (standard deviation)
+          ys      = 0.0,  // Counts scale max|fx|
+          ws      = 0.0,  // Weight scale max(w)
+          step    = 1.0,  // Largest relative parameter step
           *dparam = NULL, // Difference between new and old parameters
-          *A      = NULL, // A matrix
-          *AT     = NULL, // Tranposed A matrix
-          *a      = NULL, // Product of AT * A
+          *a      = NULL, // Normal matrix AT * A
           *ainv   = NULL, // Inverse of AT * A
-          *I      = NULL, // Identity matrix can be used for diagnostics
-          *b      = NULL, // Product of AT * dFx
-          *param  = NULL; // Parameter array storing struc GaussFit4Params info
-      
-   // Function pointer to help setup the A and AT matrices
-   double (*FXds[])(const double &, const double &, const double &,
-                                  const double &, const double &) =
-                                   {dFxdxo, dFxdsig2, dFxdA, dFxdB};
-   
-   // Since there may be ALOT of data points, make sure new[] is successful
+          *b      = NULL; // Product of AT * dFx
+
+   // Weights, w or *w may be NULL for an unweighted fit
+   const double *wp = (NULL == w) ? NULL : *w;
+
+   float *xf     = NULL, // Centered and scaled wavelengths
+         *yf     = NULL, // Scaled counts
+         *wf     = NULL, // Scaled weights
+         *param  = NULL, // Scaled fit parameters
+         grad[4] = {0.0f, 0.0f, 0.0f, 0.0f}, // Gradient of Fxa at one point
+         dFx     = 0.0f; // Difference between fit and data
+
+   struct CompensatedSum *as = NULL, // Compensated sums for a
+                         *bs = NULL; // Compensated sums for b
+
+   for(unsigned int row = 0; row < Npoints; row++){
+
+      xc += (*x)[row];
+      ys  = std::max(ys, fabs((*fx)[row]));
+      ws  = std::max(ws, (NULL == wp) ? 1.0 : wp[row]);
+
+   }
+
+   xc /= Npoints;
+
+   for(unsigned int row = 0; row < Npoints; row++){
+
+      xs += ((*x)[row] - xc) * ((*x)[row] - xc);
+
+   }
+
+   xs = sqrt(xs / Npoints);
+
+   // Scaling is undefined, let the double precision fit deal with it
+   if((0.0 == xs) || (0.0 == ys) || !(ws > 0.0)){
+
+      return(gauss_fit4_nlls(x, fx, w, Npoints, Ntries, TOL, FitParams));
+
+   }
+
    try{
-      
-      dFx    = new double[Npoints],
-      R2     = new double[Ntries],
+
       dparam = new double[Npar],
-      A      = new double[Npoints * Npar],
-      AT     = new double[Npar * Npoints],
       a      = new double[Npar * Npar],
       ainv   = new double[Npar * Npar],
-      I      = new double[Npar * Npar],
       b      = new double[Npar],
-      param  = new double[Npar];
-      
+      xf     = new float[Npoints],
+      yf     = new float[Npoints],
+      wf     = new float[Npoints],
+      param  = new float[Npar],
+      as     = new struct CompensatedSum[Npar * Npar],
+      bs     = new struct CompensatedSum[Npar];
+
    }catch(std::bad_alloc& ba){
-      
-      std::cerr << "ERROR: gaussian_fit4_nlls initialization: " << ba.what();
+
+      std::cerr << "ERROR: gaussian_fit4_nlls_mixed initialization: " << ba.what();
       std::cerr << std::endl;
       res = 0;
       goto cleanup;
-      
+
    }
-   
-   // Set the initial fit parameters
-   param[0] = FitParams.x0;
-   param[1] = FitParams.sigma2;
-   param[2] = FitParams.Ao;
-   param[3] = FitParams.Bo;
-   R2[0] = 1.0;
-    
-   while((it < Ntries) && (R2[it] > TOL)){
-      
-      // Calculate the A Matrix
+
+   // Center and scale the data and the initial fit parameters
+   for(unsigned int row = 0; row < Npoints; row++){
+
+      xf[row] = (float)(((*x)[row] - xc) / xs);
+      yf[row] = (float)((*fx)[row] / ys);
+      wf[row] = (NULL == wp) ? 1.0f : (float)(wp[row] / ws);
+
+   }
+
+   param[0] = (float)((FitParams.x0 - xc) / xs);
+   param[1] = (float)(FitParams.sigma2 / (xs * xs));
+   param[2] = (float)(FitParams.Ao / ys);
+   param[3] = (float)(FitParams.Bo / ys);
+
+   while((it < Ntries) && (step > MIXED_TOL)){
+
+      for(unsigned int i = 0; i < Npar * Npar; i++){ as[i].sum = as[i].c = 0.0f; }
+      for(unsigned int i = 0; i < Npar; i++){ bs[i].sum = bs[i].c = 0.0f; }
+
+      // Accumulate AT * A and AT * dFx directly, A is never stored
       for(unsigned int row = 0; row < Npoints; row++){
-         
-         xt       = (*x)[row];
-         fxt      = Fxa(xt,param[0],param[1],param[2],param[3]);
-         dFx[row] = (*fx)[row] - fxt;
-         
-         for(unsigned int col = 0; col < Npar; col++){
-            
-            A[row * Npar + col] = FXds[col](xt,param[0],param[1],param[2],param[3]);
-            
+
+         dFx = yf[row] - GaussianModel::EvalGrad(xf[row], param, grad);
+
+         for(unsigned int i = 0; i < Npar; i++){
+
+            CompensatedAdd(bs[i], wf[row] * grad[i] * dFx);
+
+            for(unsigned int j = i; j < Npar; j++){
+
+               CompensatedAdd(as[i * Npar + j], wf[row] * grad[i] * grad[j]);
+
+            }
+
          }
 
       }
-      
-      // Now find the transpose of A
-      if(!TransposeMatrix(A, Npoints, Npar, &AT)){
-       
-         std::cerr << "ERROR: transposing matrix failed: A" << std::endl;
-         res = 0;
-         goto cleanup;
-         
-      }
-       
-      // Product of a = AT * A. a is the matrix we need to invert
-      if(!MultiplyMatrix(AT, Npar, Npoints, A, Npoints, Npar, &a)){
-       
-         std::cerr << "ERROR: matrix multiplication failed: AT * A";
-         std::cerr << std::endl;
-         res = 0;
-         goto cleanup;
-         
+
+      for(unsigned int i = 0; i < Npar; i++){
+
+         b[i] = bs[i].sum;
+
+         for(unsigned int j = i; j < Npar; j++){
+
+            a[i * Npar + j] = a[j * Npar + i] = as[i * Npar + j].sum;
+
+         }
+
       }
-      
-      // Calculate the inverse matrix ainv
+
+      // The 4 x 4 solve itself is done in double
       if(!InvertMatrix(a, Npar, &ainv)){
-       
+
          std::cerr << "ERROR: matrix inversion failed: ainv" << std::endl;
-         PrintMatrix(ainv,Npar,Npar);
-         std::cerr << "\n";
-         PrintMatrix(a,Npar,Npar);
-         res = 0;
-         goto cleanup;
-         
-      }
-      
-      /*
-       * Calculate the product of ainv * a [should be the identity matrix].
-       * If trouble with routine, could be used as diagnostic.
-       */
-      if(!MultiplyMatrix(ainv, Npar, Npar, a, Npar, Npar, &I)){
-       
-         std::cerr << "ERROR: matrix multiplication failed: ainv * a";
-         std::cerr << std::endl;
-         PrintMatrix(I, Npar, Npar);
-         res = 0;
-         goto cleanup;
-         
-      }
-      
-      /*
-       * Product of AT and the difference between data and model.
-       */
-      if(!MultiplyMatrix(AT, Npar, Npoints, dFx, Npoints, 1, &b)){
-       
-         std::cerr << "ERROR: matrix multiplication failed: AT * dIi";
-         std::cerr << std::endl;
          res = 0;
          goto cleanup;
-         
+
       }
-    
-      // Calculate the small increment toward convergence
+
       if(!MultiplyMatrix(ainv, Npar, Npar, b, Npar, 1, &dparam)){
-       
+
          std::cerr << "ERROR: matrix multiplication failed:  ainv * b";
          std::cerr << std::endl;
          res = 0;
          goto cleanup;
-         
+
       }
-    
-      /* 
-       * Final update tasks:
-       *        1) Increment the iteration #
-       *        2) New param values by applying offset
-       *        3) The sum of squared residuals to check convergence
-       */
+
+      // The centered x0 may legitimately be ~0, so compare it to the
+      // scaled wavelength range (1) instead of to itself
       ++it;
-      R2[it] = 0.0;
+      step = 0.0;
       for(unsigned int i = 0; i < Npar; i++){
-         
-         param[i] += dparam[i];
-         R2[it] += dparam[i] * dparam[i];  
-         
+
+         param[i] += (float)dparam[i];
+         step = std::max(step, fabs(dparam[i]) /
+                         (0 == i ? 1.0 : fabs(param[i]) + 1.0E-30));
+
       }
-  
-   }// End while loop checking convergence tolerance or max iterations
-   
-   res = 1;
-   
-   // Print Results
-   // Set the initial fit parameters
-   FitParams.x0     = param[0];
-   FitParams.sigma2 = param[1]; 
-   FitParams.Ao     = param[2];
-   FitParams.Bo     = param[3];
-   std::cout << " R^2         : " << R2[it] << std::endl;
-   std::cout << " # iterations: " << it << std::endl;
-   
+
+   }// End while loop for the float32 stage
+
+   // Undo the scaling and refine the float32 solution in double
+   FitParams.x0     = param[0] * xs + xc;
+   FitParams.sigma2 = param[1] * xs * xs;
+   FitParams.Ao     = param[2] * ys;
+   FitParams.Bo     = param[3] * ys;
+   res = gauss_fit4_nlls(x, fx, w, Npoints, Ntries, TOL, FitParams);
+   FitParams.Stats.Niter_f32 = it;
+
 // Memory cleanup
 cleanup:
-   
-   delete[] dFx;
-   delete[] R2;
+
    delete[] dparam;
-   delete[] A;
-   delete[] AT;
    delete[] a;
    delete[] ainv;
-   delete[] I;
    delete[] b;
+   delete[] xf;
+   delete[] yf;
+   delete[] wf;
    delete[] param;
-  
-//std::cout << "END gaussian_fit4_nlls" << std::endl;
+   delete[] as;
+   delete[] bs;
+
+//std::cout << "END gaussian_fit4_nlls_mixed" << std::endl;
 return (res);
-}// End function gaussian_fit4_nlls
\ No newline at end of file
+}// End function gaussian_fit4_nlls_mixed
@@ -32,107 +32,75 @@ int gauss_fit4_nlls(double **x, double **fx,
 
 /************************************************************************/
 /*
- * The typical LIF characteristic trace is given by:
- * 
- *      = A * exp(-0.5 * (x - xo) * (x - xo) / sig2) + B
- *     
- *      @param[in] x    : independent variable
- *      @param[in] xo   : mean
- *      @param[in] sig2 : standard deviation
- *      @param[in] A    : amplitude
- *      @param[in] B    : background noise offset
- *      @return Fxa
- * 
- */
-inline double Fxa(const double &x, const double &xo, const double &sig2,
-                                      const double &A, const double &B){
-       
-   return (A * exp(-0.5 * (x - xo) * (x - xo) / sig2) + B);
-      
-}
-
-/************************************************************************/
-/*
- * Partial derivative of Fxa w.r.t. Ao:
- * 
- *      = exp(-0.5 * (x - x0) * (x - x0) / sig2)
- *     
- *      @param[in] x    : independent variable
- *      @param[in] xo   : mean
- *      @param[in] sig2 : standard deviation
- *      @param[in] A    : amplitude
- *      @param[in] B    : background noise offset
- *      @return dFxdA 
- * 
+ * Weighted version of gauss_fit4_nlls(...). Each squared residual is
+ * multiplied by its weight, normally w = 1 / sigma^2.
+ *
+ *      @param[in] x            : input array of wavelengths
+ *      @param[in] fx           : input array of # counts
+ *      @param[in] w            : input array of weights (NULL = 1)
+ *      @param[in] Npoints      : length of input arrays
+ *      @param[in] Ntries       : maximum # attempts to curve fit
+ *      @param[in] TOL          : convergence tolerance
+ *      @param[in/out] Fitparams: input guess / output final fit paramters
+ *      @return int success/failure
+ *
  */
-inline double dFxdA(const double &x, const double &xo, const double &sig2,
-                                        const double &A, const double &B){
-   
-   return (exp(-0.5 * (x - xo) * (x - xo) / sig2));
-   
-}
+int gauss_fit4_nlls(double **x, double **fx, double **w,
+                    const unsigned int &Npoints, const unsigned int &Ntries,
+                      const double &TOL, struct GaussFit4Params &FitParams);
 
 /************************************************************************/
 /*
- * Partial derivative of Fxa w.r.t. xo:
- * 
- *      = A * (x - xo) * exp(-0.5 * (x - xo) * (x - xo) / sig2) / sig2
- *     
- *      @param[in] x    : independent variable
- *      @param[in] xo   : mean
- *      @param[in] sig2 : standard deviation
- *      @param[in] A    : amplitude
- *      @param[in] B    : background noise offset
- *      @return dFxdxo 
- * 
+ * gauss_fit4_nlls_mixed(...) performs the same 4 parameter fit as
+ * gauss_fit4_nlls in mixed precision. The wavelengths are centered and
+ * scaled, (x - mean) / std, and the counts are divided by max|fx|, so
+ * x0 ~ 668 nm and sigma2 ~ 5e-7 nm^2 both become O(1). The Jacobian and
+ * normal equations are then accumulated in float32 with compensated
+ * sums and the result is refined by gauss_fit4_nlls in double.
+ *
+ *      @param[in] x            : input array of wavelengths
+ *      @param[in] fx           : input array of # counts
+ *      @param[in] Npoints      : length of input arrays
+ *      @param[in] Ntries       : maximum # attempts to curve fit
+ *      @param[in] TOL          : convergence tolerance (double stage)
+ *      @param[in/out] Fitparams: input guess / output final fit paramters
+ *      @return int success/failure
+ *
  */
-inline double dFxdxo(const double &x, const double &xo, const double &sig2,
-                                         const double &A, const double &B){
-   
-   return (A * (x - xo) * exp(-0.5 * (x - xo) * (x - xo) / sig2) / sig2);
-   
-}
+int gauss_fit4_nlls_mixed(double **x, double **fx,
+                    const unsigned int &Npoints, const unsigned int &Ntries,
+                      const double &TOL, struct GaussFit4Params &FitParams);
 
 /************************************************************************/
 /*
- * Partial derivative of Fxa w.r.t. sig2:
- * 
- *      = A * 0.5 * (x - xo) * (x - xo) * exp(-0.5 * (x - xo) * (x - xo) / sig2) / (sig2 * sig2)
- *     
- *      @param[in] x    : independent variable
- *      @param[in] xo   : mean
- *      @param[in] sig2 : standard deviation
- *      @param[in] A    : amplitude
- *      @param[in] B    : background noise offset
- *      @return dFxdsig2
- * 
+ * Weighted version of gauss_fit4_nlls_mixed(...), w as in
+ * gauss_fit4_nlls(...)
  */
-inline double dFxdsig2(const double &x, const double &xo, const double &sig2,
-                                           const double &A, const double &B){
-   
-   return (A * 0.5 * (x - xo) * (x - xo) * exp(-0.5 * (x - xo) * (x - xo) / sig2) / (sig2 * sig2));
-   
-}
+int gauss_fit4_nlls_mixed(double **x, double **fx, double **w,
+                    const unsigned int &Npoints, const unsigned int &Ntries,
+                      const double &TOL, struct GaussFit4Params &FitParams);
 
 /************************************************************************/
 /*
- * Partial derivative of Fxa w.r.t. Bo:
+ * The typical LIF characteristic trace is given by:
  * 
- *      = 1.0
+ *      = A * exp(-0.5 * (x - xo) * (x - xo) / sig2) + B
+ *
+ * The fits use GaussianModel, which also returns the gradient.
  *     
  *      @param[in] x    : independent variable
  *      @param[in] xo   : mean
  *      @param[in] sig2 : standard deviation
  *      @param[in] A    : amplitude
  *      @param[in] B    : background noise offset
- *      @return dFxdB
+ *      @return Fxa
  * 
  */
-inline double dFxdB(const double &x, const double &xo, const double &sig2,
-                                        const double &A, const double &B){
-   
-   return (1.0);
-   
+inline double Fxa(const double &x, const double &xo, const double &sig2,
+                                      const double &A, const double &B){
+       
+   return (A * exp(-0.5 * (x - xo) * (x - xo) / sig2) + B);
+      
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,403 @@
+// -----------------------------------------------------------------------
+//
+//                                gaussian_fitN_nlls.cpp V 0.01
+//
+//                                 (c) Brian Lynch March, 2015
+//
+// -----------------------------------------------------------------------
+
+#include <math.h>
+#include <vector>
+#include <iostream>
+#include <new>
+#include <algorithm>
+
+#include "gaussian_fitN_nlls.h"
+#include "lif_analysis.h"
+#include "matrix_utils/matrix_ops.h"
+#include "nlls_utils/nlls_solver.h"
+
+/************************************************************************/
+int gauss_fitN_init(struct GaussFitNParams &FitParams, const unsigned int &K){
+
+   FitParams.K          = K;
+   FitParams.Npar       = 3 * K + 1;
+   FitParams.param      = NULL;
+   FitParams.Stats.err  = NULL;
+
+   if(0 == K){
+
+      std::cerr << "ERROR: gauss_fitN_init needs K > 0" << std::endl;
+      return (0);
+
+   }
+
+   try{
+
+      FitParams.param     = new double[FitParams.Npar](),
+      FitParams.Stats.err = new double[FitParams.Npar]();
+
+   }catch(std::bad_alloc& ba){
+
+      std::cerr << "ERROR: gauss_fitN_init initialization: " << ba.what();
+      std::cerr << std::endl;
+      gauss_fitN_free(FitParams);
+      return (0);
+
+   }
+
+   return (1);
+
+}// End function gauss_fitN_init
+
+/************************************************************************/
+void gauss_fitN_free(struct GaussFitNParams &FitParams){
+
+   delete[] FitParams.param;
+   delete[] FitParams.Stats.err;
+   FitParams.param     = NULL;
+   FitParams.Stats.err = NULL;
+
+}// End function gauss_fitN_free
+
+/************************************************************************/
+/*
+ * Greedy peak finding on the residual of the guesses so far
+ */
+int gauss_fitN_guess(double **x, double **fx, const unsigned int &Npoints,
+                                       struct GaussFitNParams &FitParams){
+
+   if((Npoints < 3) || (NULL == FitParams.param)){ return (0); }
+
+   const unsigned int K = FitParams.K;
+
+   std::vector<double> r((*fx), (*fx) + Npoints);
+   double *p = FitParams.param,
+          Bo = 0.0;
+
+   // Median of the counts as the background
+   std::nth_element(r.begin(), r.begin() + Npoints / 2, r.end());
+   Bo = r[Npoints / 2];
+   p[3 * K] = Bo;
+
+   for(unsigned int i = 0; i < Npoints; i++){ r[i] = (*fx)[i] - Bo; }
+
+   for(unsigned int k = 0; k < K; k++){
+
+      unsigned int ipk = std::max_element(r.begin(), r.end()) - r.begin(),
+                   il  = ipk,
+                   ir  = ipk;
+      double half = 0.5 * r[ipk],
+             sd   = 0.0;
+
+      for(; (il > 0) && (r[il] > half); il--){}
+      for(; (ir + 1 < Npoints) && (r[ir] > half); ir++){}
+
+      // FWHM = 2 sqrt(2 ln 2) sigma, one sample spacing at least
+      sd = ((*x)[ir] - (*x)[il]) / 2.3548;
+      if(!(sd > 0.0)){ sd = ((*x)[Npoints-1] - (*x)[0]) / Npoints; }
+
+      p[3*k]   = (*x)[ipk];
+      p[3*k+1] = sd * sd;
+      p[3*k+2] = r[ipk];
+
+      for(unsigned int i = 0; i < Npoints; i++){
+
+         r[i] -= p[3*k+2] * exp(-0.5 * ((*x)[i] - p[3*k]) * ((*x)[i] - p[3*k])
+                                                               / p[3*k+1]);
+
+      }
+
+   }
+
+   return (1);
+
+}// End function gauss_fitN_guess
+
+/************************************************************************/
+/*
+ * 3K + 1 parameter nonlinear least squares fitting with per component
+ * windows and a block structured normal matrix.
+ */
+int gauss_fitN_nlls(double **x, double **fx, double **w,
+                    const unsigned int &Npoints, const unsigned int &Ntries,
+                      const double &TOL, struct GaussFitNParams &FitParams){
+//std::cout << "BEGIN gaussian_fitN_nlls" << std::endl;
+
+   const double NSIG = 5.0; // Half width of a component window [sigma]
+
+   int res  = 0;
+
+   const unsigned int K    = FitParams.K,
+                      Npar = FitParams.Npar, // 3K + 1
+                      iB   = 3 * K;          // Index of the background
+
+   unsigned int it = 0;
+
+   int stop = NLLS_STOP_MAXITER; // Why the fit stopped
+
+   unsigned long Nrows = 0; // # Jacobian rows of the last iteration
+
+   double wt      = 1.0,  // Temporary weight
+          rt      = 0.0,  // Temporary residual
+          chi2    = 0.0,  // Sum of w * r^2
+          sw      = 0.0,  // Sum of w
+          swy     = 0.0,  // Sum of w * fx
+          swy2    = 0.0,  // Sum of w * fx^2
+          sstot   = 0.0,  // Total weighted sum of squares about the mean
+          chi2p   = -1.0, // chi2 of the last pass, < 0 = none
+          dparam2 = 1.0,  // Squared norm of the last parameter step
+          step    = 0.0,  // Largest |dparam| in standard errors
+          *a      = NULL, // Product of AT * W * A
+          *an     = NULL, // AT * W * A scaled to a unit diagonal
+          *d      = NULL, // 1 / sqrt(diagonal of AT * W * A)
+          *ainv   = NULL, // Inverse of AT * W * A
+          *b      = NULL, // Product of AT * W * r
+          *dparam = NULL, // Difference between new and old parameters
+          *p      = FitParams.param;
+
+   // Weights, w or *w may be NULL for an unweighted fit
+   const double *wp = (NULL == w) ? NULL : *w;
+
+   std::vector<unsigned int> lo(K), // First index in the window of k
+                             hi(K), // One past the last index
+                             off(K);// Offset of the rows of k in J
+   std::vector<double> J,           // Jacobian rows, 3 per window point
+                       r(Npoints);  // Model, then residual at every point
+
+   if((NULL == p) || (Npar != 3 * K + 1) || (Npoints <= Npar)){
+
+      std::cerr << "ERROR: gauss_fitN_nlls needs initialized parameters and";
+      std::cerr << " more points than parameters" << std::endl;
+      return (0);
+
+   }
+
+   try{
+
+      a      = new double[Npar * Npar],
+      an     = new double[Npar * Npar],
+      d      = new double[Npar],
+      ainv   = new double[Npar * Npar](),
+      b      = new double[Npar],
+      dparam = new double[Npar];
+
+   }catch(std::bad_alloc& ba){
+
+      std::cerr << "ERROR: gaussian_fitN_nlls initialization: " << ba.what();
+      std::cerr << std::endl;
+      res = 0;
+      goto cleanup;
+
+   }
+
+   while((it < Ntries) && (NLLS_STOP_MAXITER == stop)){
+
+      for(unsigned int i = 0; i < Npar * Npar; i++){ a[i] = 0.0; }
+      for(unsigned int i = 0; i < Npar; i++){ b[i] = 0.0; }
+      chi2 = sw = swy = swy2 = 0.0;
+      Nrows = 0;
+
+      // Window of every component on the sorted wavelengths
+      for(unsigned int k = 0; k < K; k++){
+
+         double hw = NSIG * sqrt(fabs(p[3*k+1]));
+
+         lo[k]  = std::lower_bound(*x, *x + Npoints, p[3*k] - hw) - *x;
+         hi[k]  = std::upper_bound(*x, *x + Npoints, p[3*k] + hw) - *x;
+         off[k] = Nrows;
+         Nrows += hi[k] - lo[k];
+
+      }
+
+      J.resize(3 * Nrows);
+
+      // Model and Jacobian rows, each component only on its window
+      for(unsigned int i = 0; i < Npoints; i++){ r[i] = p[iB]; }
+
+      for(unsigned int k = 0; k < K; k++){
+
+         double *Jk = &J[3 * off[k]];
+
+         for(unsigned int i = lo[k]; i < hi[k]; i++, Jk += 3){
+
+            double dx = (*x)[i] - p[3*k],
+                    e = exp(-0.5 * dx * dx / p[3*k+1]);
+
+            r[i] += p[3*k+2] * e;
+            Jk[0] = p[3*k+2] * dx * e / p[3*k+1];
+            Jk[1] = p[3*k+2] * 0.5 * dx * dx * e / (p[3*k+1] * p[3*k+1]);
+            Jk[2] = e;
+
+         }
+
+      }
+
+      // Residuals, statistics and the background row (dF/dBo = 1)
+      for(unsigned int i = 0; i < Npoints; i++){
+
+         wt   = (NULL == wp) ? 1.0 : wp[i];
+         r[i] = (*fx)[i] - r[i];
+
+         chi2 += wt * r[i] * r[i];
+         sw   += wt;
+         swy  += wt * (*fx)[i];
+         swy2 += wt * (*fx)[i] * (*fx)[i];
+         b[iB] += wt * r[i];
+
+      }
+
+      a[iB * Npar + iB] = sw;
+
+      // Diagonal blocks, coupling to the background and AT * W * r
+      for(unsigned int k = 0; k < K; k++){
+
+         const double *Jk = &J[3 * off[k]];
+
+         for(unsigned int i = lo[k]; i < hi[k]; i++, Jk += 3){
+
+            wt = (NULL == wp) ? 1.0 : wp[i];
+            rt = r[i];
+
+            for(unsigned int m = 0; m < 3; m++){
+
+               b[3*k+m] += wt * Jk[m] * rt;
+               a[(3*k+m) * Npar + iB] += wt * Jk[m];
+
+               for(unsigned int n = m; n < 3; n++){
+
+                  a[(3*k+m) * Npar + 3*k+n] += wt * Jk[m] * Jk[n];
+
+               }
+
+            }
+
+         }
+
+      }
+
+      // Off diagonal blocks, only where two windows overlap
+      for(unsigned int k = 0; k < K; k++){
+
+         for(unsigned int l = k + 1; l < K; l++){
+
+            unsigned int i0 = std::max(lo[k], lo[l]),
+                         i1 = std::min(hi[k], hi[l]);
+
+            for(unsigned int i = i0; i < i1; i++){
+
+               const double *Jk = &J[3 * (off[k] + i - lo[k])],
+                            *Jl = &J[3 * (off[l] + i - lo[l])];
+
+               wt = (NULL == wp) ? 1.0 : wp[i];
+
+               for(unsigned int m = 0; m < 3; m++){
+
+                  for(unsigned int n = 0; n < 3; n++){
+
+                     a[(3*k+m) * Npar + 3*l+n] += wt * Jk[m] * Jl[n];
+
+                  }
+
+               }
+
+            }
+
+         }
+
+      }
+
+      // Only the upper triangle was accumulated
+      for(unsigned int i = 0; i < Npar; i++){
+
+         for(unsigned int j = 0; j < i; j++){ a[i * Npar + j] = a[j * Npar + i]; }
+
+      }
+
+      // Invert the normalized matrix, ainv = D * an^-1 * D
+      for(unsigned int i = 0; i < Npar; i++){
+
+         d[i] = (a[i * Npar + i] > 0.0) ? 1.0 / sqrt(a[i * Npar + i]) : 1.0;
+
+      }
+      for(unsigned int i = 0; i < Npar * Npar; i++){ an[i] = a[i] * d[i / Npar] * d[i % Npar]; }
+
+      if(!InvertMatrix(an, Npar, &ainv)){
+
+         std::cerr << "ERROR: matrix inversion failed: ainv" << std::endl;
+         res = 0;
+         goto cleanup;
+
+      }
+      for(unsigned int i = 0; i < Npar * Npar; i++){ ainv[i] *= d[i / Npar] * d[i % Npar]; }
+
+      // Calculate the small increment toward convergence
+      if(!MultiplyMatrix(ainv, Npar, Npar, b, Npar, 1, &dparam)){
+
+         std::cerr << "ERROR: matrix multiplication failed:  ainv * b";
+         std::cerr << std::endl;
+         res = 0;
+         goto cleanup;
+
+      }
+
+      stop = NLLSStopTest(Npar, a, ainv, b, dparam, chi2, chi2p, swy2,
+                          (NULL == wp) ? chi2 / (Npoints - Npar) : 1.0, TOL, step);
+      chi2p = chi2;
+
+      ++it;
+      dparam2 = 0.0;
+      for(unsigned int i = 0; i < Npar; i++){
+
+         p[i]    += dparam[i];
+         dparam2 += dparam[i] * dparam[i];
+
+      }
+
+   }// End while loop checking convergence tolerance or max iterations
+
+   res = 1;
+
+   // Statistics from the sums of the last iteration, as gauss_fit4_nlls
+   sstot = (sw > 0.0) ? swy2 - swy * swy / sw : 0.0;
+   FitParams.Stats.chi2     = chi2;
+   FitParams.Stats.chi2_red = chi2 / (Npoints - Npar);
+   FitParams.Stats.R2       = (sstot > 0.0) ? 1.0 - chi2 / sstot : 0.0;
+   FitParams.Stats.dparam2  = dparam2;
+   FitParams.Stats.step     = step;
+   FitParams.Stats.stop     = stop;
+   FitParams.Stats.Niter    = it;
+   FitParams.Stats.Nrows    = Nrows;
+   for(unsigned int i = 0; i < Npar; i++){
+
+      FitParams.Stats.err[i] = sqrt(fabs(ainv[i * Npar + i] *
+                         ((NULL == wp) ? FitParams.Stats.chi2_red : 1.0)));
+
+   }
+
+   // Return the components sorted by x0 (insertion sort of the triples)
+   for(unsigned int k = 1; k < K; k++){
+
+      for(unsigned int l = k; (l > 0) && (p[3*l] < p[3*(l-1)]); l--){
+
+         std::swap_ranges(p + 3*l, p + 3*l + 3, p + 3*(l-1));
+         std::swap_ranges(FitParams.Stats.err + 3*l, FitParams.Stats.err + 3*l + 3,
+                          FitParams.Stats.err + 3*(l-1));
+
+      }
+
+   }
+
+// Memory cleanup
+cleanup:
+
+   delete[] a;
+   delete[] an;
+   delete[] d;
+   delete[] ainv;
+   delete[] b;
+   delete[] dparam;
+
+//std::cout << "END gaussian_fitN_nlls" << std::endl;
+return (res);
+}// End function gaussian_fitN_nlls
@@ -0,0 +1,111 @@
+// -----------------------------------------------------------------------
+//
+//                                gaussian_fitN_nlls.h V 0.01
+//
+//                                (c) Brian Lynch March, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef lif_gaussian_fitN_nlls_h
+#define lif_gaussian_fitN_nlls_h
+
+#include <math.h>
+#include "lif_analysis.h"
+
+/************************************************************************/
+/*
+ * gauss_fitN_init(...) allocates the parameters and standard errors of
+ * a K component fit, all set to 0
+ *
+ *      @param[out] FitParams: N component fit parameters
+ *      @param[in] K         : number of Gaussian components (>= 1)
+ *      @return int success/failure
+ *
+ */
+int gauss_fitN_init(struct GaussFitNParams &FitParams, const unsigned int &K);
+
+/************************************************************************/
+/*
+ * gauss_fitN_free(...) releases the storage of gauss_fitN_init(...)
+ *
+ *      @param[in/out] FitParams: N component fit parameters
+ *
+ */
+void gauss_fitN_free(struct GaussFitNParams &FitParams);
+
+/************************************************************************/
+/*
+ * gauss_fitN_guess(...) finds initial guesses for all K components.
+ * The background is the median of the counts. The peaks are then found
+ * one at a time: the largest remaining residual gives x0 and Ao, its
+ * half maximum width gives sigma2, and the guessed Gaussian is
+ * subtracted before looking for the next peak.
+ *
+ *      @param[in] x            : sorted array of wavelengths
+ *      @param[in] fx           : array of # counts
+ *      @param[in] Npoints      : length of input arrays
+ *      @param[in/out] Fitparams: initialized parameters / initial guess
+ *      @return int success/failure
+ *
+ */
+int gauss_fitN_guess(double **x, double **fx, const unsigned int &Npoints,
+                                       struct GaussFitNParams &FitParams);
+
+/************************************************************************/
+/*
+ * gauss_fitN_nlls(...) performs a 3K + 1 parameter (weighted) nonlinear
+ * least squares fit of K Gaussians on a common background.
+ *
+ * A component only contributes within +/- 5 sigma of its peak (beyond
+ * that it is < 4e-6 of its amplitude), so its Jacobian columns are only
+ * evaluated on that window of the sorted data. The normal matrix is
+ * built block by block: the 3 x 3 block of a component from its own
+ * window, the coupling block of two components only where their
+ * windows overlap, and the background row from the component windows.
+ * The cost of a pass is therefore ~ N + sum of the window lengths,
+ * linear in K for separated components, instead of N * (3K + 1)^2.
+ * The dense (3K + 1)^2 solve does not depend on N, it is normalized and
+ * stopped as in NLLSFitSamples (nlls_utils/nlls_solver.h). The
+ * components are returned sorted by x0.
+ *
+ *      @param[in] x            : sorted array of wavelengths
+ *      @param[in] fx           : array of # counts
+ *      @param[in] w            : array of weights (NULL = 1)
+ *      @param[in] Npoints      : length of input arrays
+ *      @param[in] Ntries       : maximum # attempts to curve fit
+ *      @param[in] TOL          : convergence tolerance, see NLLSStopTest
+ *      @param[in/out] Fitparams: input guess / output final fit paramters
+ *      @return int success/failure
+ *
+ */
+int gauss_fitN_nlls(double **x, double **fx, double **w,
+                    const unsigned int &Npoints, const unsigned int &Ntries,
+                      const double &TOL, struct GaussFitNParams &FitParams);
+
+/************************************************************************/
+/*
+ * FxaN(...) evaluates the K component trace
+ *
+ *      = sum_k Ao_k * exp(-0.5 * (x - xo_k)^2 / sig2_k) + Bo
+ *
+ *      @param[in] x         : independent variable
+ *      @param[in] FitParams : N component fit parameters
+ *      @return FxaN
+ *
+ */
+inline double FxaN(const double &x, const struct GaussFitNParams &FitParams){
+
+   const double *p = FitParams.param;
+   double result = p[3 * FitParams.K];
+
+   for(unsigned int k = 0; k < FitParams.K; k++){
+
+      result += p[3*k+2] * exp(-0.5 * (x - p[3*k]) * (x - p[3*k]) / p[3*k+1]);
+
+   }
+
+   return (result);
+
+}
+
+#endif
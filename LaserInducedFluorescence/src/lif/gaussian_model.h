@@ -0,0 +1,100 @@
+// -----------------------------------------------------------------------
+//
+//                                  gaussian_model.h V 0.01
+//
+//                                (c) Brian Lynch March, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef lif_gaussian_model_h
+#define lif_gaussian_model_h
+
+#include <math.h>
+#include <cmath>
+
+#include "nlls_utils/dual.h"
+
+/************************************************************************/
+/*
+ * The typical LIF characteristic trace as a fit model (see
+ * nlls_utils/nlls_solver.h), parameters p = (xo, sig2, A, B):
+ *
+ *      F(x)         = A * exp(-0.5 * (x - xo) * (x - xo) / sig2) + B
+ *
+ *      dF/d(xo)     = A * (x - xo) * exp(...) / sig2
+ *      dF/d(sig2)   = A * 0.5 * (x - xo) * (x - xo) * exp(...) / sig2^2
+ *      dF/d(A)      = exp(...)
+ *      dF/d(B)      = 1
+ *
+ */
+struct GaussianModel{
+
+   enum{ Npar = 4 };
+
+   static const char *Name(const unsigned int &k){
+
+      static const char *names[Npar] = {"Rest Wavelength", "Sigma^2",
+                                        "Amplitude", "Background"};
+      return (names[k]);
+
+   }
+
+   static const char *Unit(const unsigned int &k){
+
+      static const char *units[Npar] = {"nm", "nm^2", "", ""};
+      return (units[k]);
+
+   }
+
+   /*
+    *      @param[in] T x   : independent variable
+    *      @param[in] T *p  : (xo, sig2, A, B)
+    *      @param[out] T *grad: dF/d(xo), dF/d(sig2), dF/d(A), dF/d(B)
+    *      @return T: F(x)
+    */
+   template<class T>
+   static inline T EvalGrad(const T &x, const T *p, T *grad){
+
+      const T d = x - p[0],
+              e = exp(T(-0.5) * d * d / p[1]);
+
+      grad[0] = p[2] * d * e / p[1];
+      grad[1] = p[2] * T(0.5) * d * d * e / (p[1] * p[1]);
+      grad[2] = e;
+      grad[3] = T(1.0);
+
+      return (p[2] * e + p[3]);
+
+   }
+
+};
+
+/************************************************************************/
+/*
+ * The same trace written only as an expression. ADModel differentiates
+ * it automatically, GaussianModelAD is a drop in replacement for
+ * GaussianModel (see LIFBenchmark). New line shapes can be added this
+ * way without writing derivative code.
+ */
+struct GaussianExpr{
+
+   enum{ Npar = GaussianModel::Npar };
+
+   static const char *Name(const unsigned int &k){ return (GaussianModel::Name(k)); }
+
+   static const char *Unit(const unsigned int &k){ return (GaussianModel::Unit(k)); }
+
+   template<class X, class P>
+   static inline P Eval(const X &x, const P *p){
+
+      P d = x - p[0];
+
+      return (p[2] * exp(X(-0.5) * d * d / p[1]) + p[3]);
+
+   }
+
+};
+
+typedef ADModel<GaussianExpr> GaussianModelAD;
+
+#endif
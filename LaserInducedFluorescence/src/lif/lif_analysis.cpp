@@ -12,15 +12,46 @@
 #include <stdlib.h>
 #include <vector>
 #include <math.h>
+#include <cmath>
 #include <getopt.h>
 #include <iomanip>
+#include <chrono>
 
 #include "gaussian_fit4_nlls.h"
+#include "gaussian_fitN_nlls.h"
+#include "voigt_fit5_nlls.h"
+#include "lif_preprocess.h"
+#include "lif_data_reader.h"
+#include "lif_batch.h"
+#include "lif_cube.h"
+#include "nlls_utils/bootstrap.h"
+#include "nlls_utils/multistart.h"
+#include "nlls_utils/adc_input.h"
+#include "nlls_utils/input_stream.h"
 #include "lif_analysis.h"
 
+// Batch of files, defined after main
+static int run_batch(const std::vector<std::string> &input_files,
+                     const struct LIFBatchOptions &Opts,
+                     const struct GaussFit4Params &Guess);
+
+// Data cube of a spatial scan, defined after main
+static int run_cube(const char *cube_filename, const struct LIFCubeOptions &Opts);
+
+#ifdef WITH_MPI
+static const int mpi_batch = 1; // Every run is a batch over the MPI ranks
+#else
+static const int mpi_batch = 0;
+#endif
+
 /************************************************************************/
 int main(int argc, char** argv){
 
+#ifdef WITH_MPI
+   // Every rank runs main, only rank 0 prints
+   if(MPIBatchInit(&argc, &argv) > 0){ std::cout.setstate(std::ios::failbit); }
+#endif
+
 std::cout << "-- BEGIN lif_analysis --" << std::endl;
 
    /*
@@ -35,8 +66,41 @@ std::cout << "-- BEGIN lif_analysis --" << std::endl;
    const int    Max = 100;    // Maximum number of iterations while fitting
    const double Tol = 1.0E-8; // Tolerance for convergence of the curve fit
 
-   int opt = 0;                 // Command line option parser variable
+   int opt   = 0;               // Command line option parser variable
+   int mixed = 0;               // Command line option mixed precision fit
+   int fold  = 0;               // Command line option sort the sweeps
+   int voigt = 0;               // Command line option Voigt profile fit
+   int adc_bytes = 0;           // Command line option raw ADC code size
+   int triage    = 1;           // Command line option triage before fitting
+   unsigned int Nbins = 0;      // Command line option # bins (0 = none)
+   double Nsig = 0.0;           // Command line option window (0 = none)
+   unsigned int Ncomp = 1;      // Command line option # Gaussian components
    char *input_filename = NULL; // Command line option input file
+   char *list_filename  = NULL; // Command line option file of input files
+   char *store_dir      = NULL; // Command line option results store
+   char *cache_dir      = NULL; // Command line option fit cache
+   char *journal_file   = NULL; // Command line option batch journal
+   char *tune_file      = NULL; // Command line option auto-tune file
+   char *cube_filename  = NULL; // Command line option data cube
+   int64_t shot    = -1;        // Command line option shot number
+   int32_t channel = 0;         // Command line option channel
+
+   // Robust loss of the fit (zero = least squares)
+   struct NLLSLoss Loss = {NLLS_LOSS_L2, 0.0};
+
+   // Batch of files: every -f plus the files listed in -l
+   std::vector<std::string> input_files;
+
+   // Bootstrap options: # resampled fits (0 = off), threads, seed, scheme
+   struct BootstrapOptions BootOpts = {0, 0, 12345, BOOT_RESIDUALS, 0.95};
+
+   // Multi-start options: # initial guesses (0 = off), threads, seed,
+   // truncated iterations, # polished candidates, noise floor tolerance
+   struct MultiStartOptions MSOpts = {0, 0, 12345, 5, 4, 1.0};
+
+   // Raw ADC input: lambda = gain[0] * code + offset[0], counts =
+   // gain[1] * code + offset[1]
+   struct ADCCalibration Cal = {{1.0, 1.0}, {0.0, 0.0}};
 
    // Parse the command line
    if(1 == argc){
@@ -46,16 +110,150 @@ std::cout << "-- BEGIN lif_analysis --" << std::endl;
        
    }
       
-   while((opt = getopt(argc, argv,"-f:")) != -1) {
+   while((opt = getopt(argc, argv,"-f:l:msb:w:n:VB:PS:j:M:a:g:D:N:C:K:J:A:c:R:Q")) != -1) {
      
       switch (opt) {
          
          case 'f' : // Input filename option
             
             input_filename = optarg;
+            input_files.push_back(optarg);
             std::cout << "Input Filename: " << input_filename;
             std::cout << std::endl;
             break;
+
+         case 'l' : // File with a list of input files option
+
+            list_filename = optarg;
+            break;
+
+         case 'D' : // Results store directory option
+
+            store_dir = optarg;
+            break;
+
+         case 'K' : // Fit cache directory option
+
+            cache_dir = optarg;
+            break;
+
+         case 'J' : // Batch journal option
+
+            journal_file = optarg;
+            break;
+
+         case 'A' : // Auto-tune file option
+
+            tune_file = optarg;
+            break;
+
+         case 'c' : // Data cube option
+
+            cube_filename = optarg;
+            break;
+
+         case 'N' : // Shot number option
+
+            shot = strtoll(optarg, NULL, 10);
+            break;
+
+         case 'C' : // Channel option
+
+            channel = atoi(optarg);
+            break;
+
+         case 'm' : // Mixed precision fit option
+
+            mixed = 1;
+            std::cout << "Mixed precision fit" << std::endl;
+            break;
+
+         case 'Q' : // Fit without triage option
+
+            triage = 0;
+            std::cout << "No triage, every scan is fitted" << std::endl;
+            break;
+
+         case 'R' : // Robust loss option
+
+            if(!NLLSLossParse(optarg, Loss)){
+
+               std::cerr << "Robust loss must be huber[,c] or tukey[,c]" << std::endl;
+               print_usage();
+               return (-1);
+
+            }
+            std::cout << "Robust fit: " << NLLSLossName(Loss) << ", c = ";
+            std::cout << Loss.c << std::endl;
+            break;
+
+         case 's' : // Sort (fold) the back and forth sweeps option
+
+            fold = 1;
+            break;
+
+         case 'b' : // Bin the data onto a uniform grid option
+
+            Nbins = atoi(optarg);
+            break;
+
+         case 'w' : // Window the data around the peak option
+
+            Nsig = atof(optarg);
+            break;
+
+         case 'n' : // Number of Gaussian components option
+
+            Ncomp = std::max(1, atoi(optarg));
+            break;
+
+         case 'V' : // Voigt profile fit option
+
+            voigt = 1;
+            break;
+
+         case 'B' : // Bootstrap # resampled fits option
+
+            BootOpts.Nboot = atoi(optarg);
+            break;
+
+         case 'P' : // Bootstrap resampling of (lambda, counts) pairs option
+
+            BootOpts.mode = BOOT_PAIRS;
+            break;
+
+         case 'S' : // Bootstrap random seed option
+
+            BootOpts.seed = strtoull(optarg, NULL, 10);
+            MSOpts.seed   = BootOpts.seed;
+            break;
+
+         case 'j' : // Number of threads option
+
+            BootOpts.Nthreads = atoi(optarg);
+            MSOpts.Nthreads   = BootOpts.Nthreads;
+            break;
+
+         case 'M' : // Multi-start # initial guesses option
+
+            MSOpts.Nstart = atoi(optarg);
+            break;
+
+         case 'a' : // Raw ADC input, bits per code option
+
+            adc_bytes = atoi(optarg) / 8;
+            break;
+
+         case 'g' : // Raw ADC calibration option
+
+            if(!ParseADCCalibration(optarg, Cal)){
+
+               std::cerr << "Calibration must be gL,oL,gC,oC" << std::endl;
+               print_usage();
+               return (-1);
+
+            }
+            break;
             
          case '?': // Unrecognized command line option
             
@@ -75,16 +273,138 @@ std::cout << "-- BEGIN lif_analysis --" << std::endl;
         
    }
    
+   // A cube fits every pixel on the threads of this process
+   if(NULL != cube_filename){
+
+      struct LIFCubeOptions CubeOpts = {BootOpts.Nthreads, 16, mixed, 1, Loss,
+                                        triage};
+
+      if(mpi_batch){
+
+         std::cerr << "-c runs with LIFAnalysis, not over MPI" << std::endl;
+         return (-1);
+
+      }
+
+      return (run_cube(cube_filename, CubeOpts));
+
+   }
+
+   // Several files are fitted as a read -> fit -> write pipeline, and so
+   // is any file looked up in the fit cache or the journal, auto-tuned or
+   // fitted over MPI
+   if((NULL != list_filename) || (input_files.size() > 1) || (NULL != cache_dir) ||
+      (NULL != journal_file) || (NULL != tune_file) || mpi_batch){
+
+      struct GaussFit4Params Guess = {xo_guess, sig2_guess, Ao_guess, Bo_guess, 4,
+                                      Loss};
+      struct BatchJournal Journal;
+      std::vector<std::string> listed;
+      int res = 0;
+
+      // Two readers keep a fit thread busy while the other waits on the disk
+      struct LIFBatchOptions Opts = {{2, BootOpts.Nthreads, 0}, mixed, fold,
+                                     Nbins, Nsig, adc_bytes, Cal, store_dir,
+                                     channel, cache_dir, NULL, triage};
+
+      if((NULL != list_filename) && !ReadFileList(list_filename, listed)){
+
+         return (-1);
+
+      }
+      input_files.insert(input_files.end(), listed.begin(), listed.end());
+
+      if((Ncomp > 1) || voigt || (BootOpts.Nboot > 0) || (MSOpts.Nstart > 0) ||
+         (shot >= 0)){
+
+         std::cerr << "-n, -V, -B, -M and -N only apply to a single file without";
+         std::cerr << " -K, -J (or MPI), ignored";
+         std::cerr << std::endl;
+
+      }
+
+      // -m and -j given on the command line win over the tuned values
+      if((NULL != tune_file) && !input_files.empty()){
+
+         struct AutoTuneConfig Tune;
+
+         if(mpi_batch){
+
+            std::cerr << "-A tunes the threads of one process, not over MPI, ignored";
+            std::cerr << std::endl;
+
+         }else if(lif_batch_tune(tune_file, input_files[0].c_str(), Opts, Guess, Tune)){
+
+            if(!mixed){ Opts.mixed = Tune.mixed; }
+            if(0 == Opts.Pipe.Nworkers){ Opts.Pipe.Nworkers = Tune.Nworkers; }
+            Opts.Pipe.Nqueue = Opts.Pipe.Nworkers * (Tune.Nqueue / Tune.Nworkers);
+
+            std::cout << "Auto-tuned: " << (Opts.mixed ? "mixed precision" : "double");
+            std::cout << " fit, " << Opts.Pipe.Nworkers << " fit threads, queues of ";
+            std::cout << Opts.Pipe.Nqueue << " scans (" << 1.0E3 * Tune.t_trace;
+            std::cout << " ms / scan)" << std::endl;
+
+         }else{
+
+            std::cerr << "Auto-tuning failed, default configuration" << std::endl;
+
+         }
+
+      }
+
+      if(NULL != journal_file){
+
+         if(!OpenBatchJournal(journal_file, Journal)){ return (-1); }
+         Opts.journal = &Journal;
+
+      }
+
+      res = run_batch(input_files, Opts, Guess);
+      if(NULL != journal_file){ CloseBatchJournal(Journal); }
+
+      return (res);
+
+   }
+
+   if((NLLS_LOSS_L2 != Loss.type) && ((Ncomp > 1) || voigt)){
+
+      std::cerr << "-R only applies to the single Gaussian fit, not to -n and -V";
+      std::cerr << std::endl;
+
+   }
+
    std::vector<double> lambda, // Input wavelength
-                       counts; // Input counts
+                       counts, // Input counts
+                       sigmas; // Input count uncertainties (optional)
                        
    double *la = NULL, // Array for input lambdas
-          *ca = NULL; // Array for input counts
+          *ca = NULL, // Array for input counts
+          *sa = NULL, // Array for count uncertainties (input or binned)
+          *wa = NULL; // Array for weights 1 / sigma^2
           
    unsigned int Na = 0; // Size of input arrays
 
+   double lambda_first = 0.0, // First wavelength of the scan as read
+          lambda_end   = 0.0; // Largest wavelength of the scan as read
+
+   double full_lo = -HUGE_VAL, // Full scale of the counts, raw ADC codes only
+          full_hi = HUGE_VAL;
+
    // Array used to store initial fit parameter guesses
-   struct GaussFit4Params FitParams = {xo_guess, sig2_guess, Ao_guess, Bo_guess, 4};
+   struct GaussFit4Params FitParams = {xo_guess, sig2_guess, Ao_guess, Bo_guess, 4,
+                                       Loss};
+
+   // Parameters of the K component fit (-n K, K > 1)
+   struct GaussFitNParams FitN = {0, 0, NULL};
+
+   // Parameters of the Voigt fit (-V), set once it succeeded
+   struct VoigtFit5Params VFit = {0.0, 0.0, 0.0, 0.0, 0.0, 5};
+   int voigt_ok = 0;
+
+   // Status and wall time [s] of the fits for the results store (-D)
+   struct LIFBatchResult Res = {1, 0, 1, 0, 0, 0, TRIAGE_OK, 0, 0.0};
+   double t_voigt = 0.0;
+   std::chrono::steady_clock::time_point t0;
    std::cout.precision(7);
    std::cout << "Initial fit parameters: " << std::endl;
    std::cout << " Rest Wavelength        [nm]  : " << xo_guess << std::endl;
@@ -92,51 +412,321 @@ std::cout << "-- BEGIN lif_analysis --" << std::endl;
    std::cout << " Amplitude               []   : " << Ao_guess << std::endl;
    std::cout << " Background              []   : " << Bo_guess << std::endl;
    
-   // Input and Output string information
-   std::string input_filename_s(input_filename);
-   std::ifstream input_file(input_filename_s.c_str(), std::ifstream::in);
-   
-   // Attempt to read the input file
-   if(input_file.is_open()){
-     
+   // Attempt to read the input file, a third column holds sigma
+   if(adc_bytes > 0){
+
+      // Raw codes are calibrated straight into the arrays, the ASCII
+      // vectors are not used
+      struct ADCTrace Raw;
+
+      std::cout << "Reading raw ADC data (" << 8 * adc_bytes;
+      std::cout << " bit codes)..." << std::endl;
+      if(!ReadADCTrace(input_filename, adc_bytes, Cal, Raw)){
+
+         return (-1);
+
+      }
+
+      Na = Raw.Nsamples;
+      la = new double[Na];
+      ca = new double[Na];
+      for(unsigned int i = 0; i < Na; i++){
+
+         la[i] = ADCX(Raw, i);
+         ca[i] = ADCY(Raw, i);
+
+      }
+      ADCFullScaleY(Raw, full_lo, full_hi);
+
+   }else{
+
       std::cout << "Reading data..." << std::endl;
-      double col1 = 0.0,
-             col2 = 0.0;
-     
-      while(input_file.good()){
-        
-         input_file >> col1 >> col2;
-        
-         if(!input_file.eof()){ //Last line is not stored twice
-           
-            lambda.push_back(col1);
-            counts.push_back(col2);
-           
+      if(!read_lif_data(input_filename, lambda, counts, sigmas)){
+
+         return (-1);
+
+      }
+   
+      //Copy the vectors used to read file into arrays
+      Na = lambda.size();
+      la = new double[Na];
+      ca = new double[Na];
+      std::copy(lambda.begin(), lambda.end(), la);
+      std::copy(counts.begin(), counts.end(), ca);
+
+      if(!sigmas.empty()){
+
+         sa = new double[Na];
+         std::copy(sigmas.begin(), sigmas.end(), sa);
+
+      }
+
+   }
+
+   if(0 == Na){
+
+      std::cerr << "No data in file " << input_filename << std::endl;
+      return (-1);
+
+   }
+
+   lambda_first = la[0];
+   lambda_end   = *std::max_element(la, la + Na);
+
+   // A scan that cannot fit is not fitted
+   if(triage){
+
+      struct TriageStats Tri;
+
+      lif_triage(la, ca, Na, full_lo, full_hi, Tri);
+      std::cout << "Triage: " << TriageName(Tri.reason) << " (peak at " << Tri.xpeak;
+      std::cout << " nm";
+      if((TRIAGE_OK == Tri.reason) || (TRIAGE_LOW_SNR == Tri.reason)){
+
+         std::cout << ", signal / noise " << Tri.snr;
+
+      }
+      std::cout << ")" << std::endl;
+      if(TRIAGE_OK != Tri.reason){
+
+         std::cerr << "Scan rejected, not fitted (-Q fits it anyway)" << std::endl;
+         return (-1);
+
+      }
+
+   }
+
+   // Optional preprocessing: fold the sweeps, bin and window the data
+   if(fold || Nbins || (Nsig > 0.0)){
+
+      std::cout << "Preprocessing data..." << std::endl;
+      std::cout << " # input samples : " << Na << std::endl;
+
+   }
+
+   if(Nbins > 0){
+
+      struct LIFBinGrid grid;
+      double *lb = NULL,
+             *cb = NULL,
+             *sb = NULL;
+
+      if(lif_bin_init(grid, *std::min_element(la, la + Na),
+                            *std::max_element(la, la + Na), Nbins)){
+
+         for(unsigned int i = 0; i < Na; i++){ lif_bin_add(grid, la[i], ca[i]); }
+
+         if(lif_bin_finish(grid, &lb, &cb, &sb, Na)){
+
+            delete[] la;
+            delete[] ca;
+            delete[] sa;
+            la = lb;
+            ca = cb;
+            sa = sb;
+
          }
-       
+
       }
-     
-   }else{
-     
-      std::cerr << "Error opening file:" << input_filename_s.c_str();
+
+      lif_bin_free(grid);
+      std::cout << " # non-empty bins: " << Na << std::endl;
+
+   }else if(fold || (Nsig > 0.0) || (Ncomp > 1)){
+
+      lif_fold_scan(&la, &ca, &sa, Na);
+
+   }
+
+   if(Nsig > 0.0){
+
+      lif_window(&la, &ca, &sa, Na, Nsig, 2 * FitParams.Npar);
+      std::cout << " # windowed      : " << Na << std::endl;
+
+   }
+
+   // Weight the fit with 1 / sigma^2 from column 3 or from the binning
+   if(sigma_to_weights(sa, Na, &wa)){
+
+      std::cout << "Weighted fit using 1 / sigma^2" << std::endl;
+
+   }else if(NULL != sa){
+
+      std::cerr << "Non-positive sigma found, using equal weights";
       std::cerr << std::endl;
-      return (-1);
-      
-   }//Done attempting to read file
-   
-   input_file.close();
-   
-   //Copy the vectors used to read file into arrays
-   Na = lambda.size();
-   la = new double[Na];
-   ca = new double[Na];
-   std::copy(lambda.begin(), lambda.end(), la);
-   std::copy(counts.begin(), counts.end(), ca);
+
+   }
       
+   /*
+    * K component fit on the sorted data, it replaces the single Gaussian
+    * fit (and its multi-start and bootstrap options).
+    */
+   if(Ncomp > 1){
+
+      std::cout << "Performing " << Ncomp << " component curve fit..." << std::endl;
+
+      if(!gauss_fitN_init(FitN, Ncomp) ||
+         !gauss_fitN_guess(&la, &ca, Na, FitN)){
+
+         std::cout << "Curve fit FAILED!" << std::endl;
+         goto write_output;
+
+      }
+
+      if(gauss_fitN_nlls(&la, &ca, &wa, Na, Max, Tol, FitN)){
+
+         std::cout << " # iterations: " << FitN.Stats.Niter << std::endl;
+         std::cout << " |dparam|^2  : " << FitN.Stats.dparam2 << std::endl;
+         std::cout << " step / err  : " << FitN.Stats.step << std::endl;
+         std::cout << " stopped on  : " << NLLSStopName(FitN.Stats.stop) << std::endl;
+         std::cout << " chi^2       : " << FitN.Stats.chi2 << std::endl;
+         std::cout << " chi^2 / dof : " << FitN.Stats.chi2_red << std::endl;
+         std::cout << " R^2         : " << FitN.Stats.R2 << std::endl;
+         std::cout << " Jacobian rows / (points * components): ";
+         std::cout << (double)FitN.Stats.Nrows / ((double)Na * Ncomp);
+         std::cout << std::endl;
+         std::cout << "Curve fit successful!" << std::endl;
+
+      }else{
+
+         std::cout << "Curve fit FAILED!" << std::endl;
+
+      }
+
+      std::cout.precision(7);
+      std::cout << "Final fit parameters: " << std::endl;
+      for(unsigned int k = 0; k < Ncomp; k++){
+
+         std::cout << " Component " << k + 1 << ":" << std::endl;
+         std::cout << "  Rest Wavelength        [nm]  : " << FitN.param[3*k];
+         std::cout << " +/- " << FitN.Stats.err[3*k] << std::endl;
+         std::cout << "  Sigma^2               [nm^2] : " << FitN.param[3*k+1];
+         std::cout << " +/- " << FitN.Stats.err[3*k+1] << std::endl;
+         std::cout << "  Amplitude               []   : " << FitN.param[3*k+2];
+         std::cout << " +/- " << FitN.Stats.err[3*k+2] << std::endl;
+
+      }
+      std::cout << " Background              []   : " << FitN.param[3*Ncomp];
+      std::cout << " +/- " << FitN.Stats.err[3*Ncomp] << std::endl;
+
+      goto write_output;
+
+   }
+
+   /*
+    * Multi-start search for the initial guess. The box is set by the
+    * data: x0 anywhere in the scan, sigma from 1/500 to 1/2 of the scan
+    * width, A within a factor 5 of the count range (log sampled) and B
+    * between the lowest and the mean counts.
+    */
+   if((MSOpts.Nstart > 0) && (Na > 0)){
+
+      double xlo = *std::min_element(la, la + Na),
+             xhi = *std::max_element(la, la + Na),
+             ylo = *std::min_element(ca, ca + Na),
+             yhi = *std::max_element(ca, ca + Na),
+             ym  = 0.0;
+
+      for(unsigned int i = 0; i < Na; i++){ ym += ca[i] / Na; }
+
+      std::vector<double> xv(la, la + Na),
+                          yv(ca, ca + Na),
+                          wv,
+                          p0(4), lo(4), hi(4), best;
+      std::vector<int> logscale(4, 1);
+      struct MultiStartResult MS;
+
+      if(NULL != wa){ wv.assign(wa, wa + Na); }
+
+      p0[0] = FitParams.x0;     lo[0] = xlo;
+                                hi[0] = xhi;
+      p0[1] = FitParams.sigma2; lo[1] = pow((xhi - xlo) / 500.0, 2.0);
+                                hi[1] = pow((xhi - xlo) / 2.0, 2.0);
+      p0[2] = FitParams.Ao;     lo[2] = 0.2 * (yhi - ylo);
+                                hi[2] = 5.0 * (yhi - ylo);
+      p0[3] = FitParams.Bo;     lo[3] = ylo;
+                                hi[3] = ym;
+      logscale[0] = logscale[3] = 0;
+
+      // Niter = 0 runs the fit to convergence. The guesses are ranked by
+      // the least squares chi^2, only the final fit is robust.
+      auto fit = [&](double *param, unsigned int Niter, double &chi2){
+
+         struct GaussFit4Params P = {param[0], param[1], param[2], param[3], 4};
+
+         if(!gauss_fit4_nlls(&la, &ca, &wa, Na, (0 == Niter) ? Max : Niter,
+                                                                  Tol, P)){
+
+            return (0);
+
+         }
+
+         param[0] = P.x0;
+         param[1] = P.sigma2;
+         param[2] = P.Ao;
+         param[3] = P.Bo;
+         chi2 = P.Stats.chi2;
+
+         return (int)(std::isfinite(P.x0) && std::isfinite(P.sigma2) &&
+                      std::isfinite(P.Ao) && std::isfinite(P.Bo));
+
+      };
+
+      std::cout << "Multi-start search (" << MSOpts.Nstart;
+      std::cout << " initial guesses)..." << std::endl;
+
+      if(MultiStart(p0, lo, hi, logscale, NoiseFloorChi2(xv, yv, wv, 4), fit,
+                                                        MSOpts, best, MS)){
+
+         FitParams.x0     = best[0];
+         FitParams.sigma2 = best[1];
+         FitParams.Ao     = best[2];
+         FitParams.Bo     = best[3];
+         std::cout << " # truncated fits: " << MS.Nrun;
+         std::cout << (MS.early ? " (stopped at noise floor)" : "");
+         std::cout << std::endl;
+         std::cout << " noise floor  : " << MS.floor << std::endl;
+         std::cout << " best chi^2   : " << MS.chi2 << " (guess #";
+         std::cout << MS.best << ")" << std::endl;
+
+      }else{
+
+         std::cout << "Multi-start search failed, using initial guess";
+         std::cout << std::endl;
+
+      }
+
+   }
+
    //Perform the double probe curve fit using non-linear least squares
    std::cout << "Performing curve fit..." << std::endl;
-   if(gauss_fit4_nlls(&la, &ca, Na, Max, Tol, FitParams)){
-      
+   t0 = std::chrono::steady_clock::now();
+   Res.fit_ok = mixed ? gauss_fit4_nlls_mixed(&la, &ca, &wa, Na, Max, Tol, FitParams)
+                      : gauss_fit4_nlls(&la, &ca, &wa, Na, Max, Tol, FitParams);
+   Res.t_fit  = std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                                              - t0).count();
+
+   if(Res.fit_ok){
+
+      if(mixed){
+
+         std::cout << " # float32 iterations: " << FitParams.Stats.Niter_f32;
+         std::cout << std::endl;
+
+      }
+      std::cout << " # iterations: " << FitParams.Stats.Niter << std::endl;
+      std::cout << " |dparam|^2  : " << FitParams.Stats.dparam2 << std::endl;
+      std::cout << " step / err  : " << FitParams.Stats.step << std::endl;
+      std::cout << " stopped on  : " << NLLSStopName(FitParams.Stats.stop) << std::endl;
+      std::cout << " chi^2       : " << FitParams.Stats.chi2 << std::endl;
+      std::cout << " chi^2 / dof : " << FitParams.Stats.chi2_red << std::endl;
+      std::cout << " R^2         : " << FitParams.Stats.R2 << std::endl;
+      if(NLLS_LOSS_L2 != Loss.type){
+
+         std::cout << " scale       : " << FitParams.Stats.scale << std::endl;
+         std::cout << " # outliers  : " << FitParams.Stats.Noutliers << std::endl;
+
+      }
       std::cout << "Curve fit successful!" << std::endl;
       
    }else{
@@ -148,49 +738,208 @@ std::cout << "-- BEGIN lif_analysis --" << std::endl;
    //Print the fitted parameters
    std::cout.precision(7);
    std::cout << "Final fit parameters: " << std::endl;
-   std::cout << " Rest Wavelength        [nm]  : " << FitParams.x0 << std::endl;
-   std::cout << " Sigma^2               [nm^2] : " << FitParams.sigma2 << std::endl;
-   std::cout << " Amplitude               []   : " << FitParams.Ao << std::endl;
-   std::cout << " Background              []   : " << FitParams.Bo << std::endl;
+   std::cout << " Rest Wavelength        [nm]  : " << FitParams.x0;
+   std::cout << " +/- " << FitParams.Stats.err[0] << std::endl;
+   std::cout << " Sigma^2               [nm^2] : " << FitParams.sigma2;
+   std::cout << " +/- " << FitParams.Stats.err[1] << std::endl;
+   std::cout << " Amplitude               []   : " << FitParams.Ao;
+   std::cout << " +/- " << FitParams.Stats.err[2] << std::endl;
+   std::cout << " Background              []   : " << FitParams.Bo;
+   std::cout << " +/- " << FitParams.Stats.err[3] << std::endl;
+
+   /*
+    * Voigt profile fit, warm started from the Gaussian fit with a
+    * Lorentzian half width of a tenth of its standard deviation.
+    */
+   if(voigt){
+
+      VFit.x0     = FitParams.x0;
+      VFit.sigma2 = FitParams.sigma2;
+      VFit.gamma  = 0.1 * sqrt(fabs(FitParams.sigma2));
+      VFit.Ao     = FitParams.Ao;
+      VFit.Bo     = FitParams.Bo;
+
+      std::cout << "Performing Voigt curve fit..." << std::endl;
+      t0 = std::chrono::steady_clock::now();
+      voigt_ok = voigt_fit5_nlls(&la, &ca, &wa, Na, Max, Tol, VFit);
+      t_voigt  = std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                                               - t0).count();
+
+      if(voigt_ok){
+
+         std::cout << " # iterations: " << VFit.Stats.Niter << std::endl;
+         std::cout << " |dparam|^2  : " << VFit.Stats.dparam2 << std::endl;
+         std::cout << " step / err  : " << VFit.Stats.step << std::endl;
+         std::cout << " stopped on  : " << NLLSStopName(VFit.Stats.stop) << std::endl;
+         std::cout << " chi^2       : " << VFit.Stats.chi2 << std::endl;
+         std::cout << " chi^2 / dof : " << VFit.Stats.chi2_red << std::endl;
+         std::cout << " R^2         : " << VFit.Stats.R2 << std::endl;
+         std::cout << "Curve fit successful!" << std::endl;
+
+      }else{
+
+         std::cout << "Curve fit FAILED!" << std::endl;
+
+      }
+
+      std::cout << "Final Voigt fit parameters: " << std::endl;
+      std::cout << " Rest Wavelength        [nm]  : " << VFit.x0;
+      std::cout << " +/- " << VFit.Stats.err[0] << std::endl;
+      std::cout << " Sigma^2               [nm^2] : " << VFit.sigma2;
+      std::cout << " +/- " << VFit.Stats.err[1] << std::endl;
+      std::cout << " Lorentz HWHM           [nm]  : " << VFit.gamma;
+      std::cout << " +/- " << VFit.Stats.err[2] << std::endl;
+      std::cout << " Amplitude               []   : " << VFit.Ao;
+      std::cout << " +/- " << VFit.Stats.err[3] << std::endl;
+      std::cout << " Background              []   : " << VFit.Bo;
+      std::cout << " +/- " << VFit.Stats.err[4] << std::endl;
+
+   }
    
-   //Declare and write the output file
-   std::string output_filename_s(input_filename);
-   output_filename_s.resize(output_filename_s.length()-4);
-   output_filename_s.append("_fit.dat");
-   std::ofstream output_file(output_filename_s.c_str(), std::ofstream::out);
-   output_file << std::scientific;
+   // Bootstrap percentile intervals of the fitted parameters
+   if(BootOpts.Nboot > 0){
+
+      std::vector<double> xv(la, la + Na),
+                          yv(ca, ca + Na),
+                          wv,
+                          yf(Na),
+                          p0(4);
+      struct BootstrapResult Boot;
+      const char *names[4] = {" Rest Wavelength        [nm]  : ",
+                              " Sigma^2               [nm^2] : ",
+                              " Amplitude               []   : ",
+                              " Background              []   : "};
+
+      if(NULL != wa){ wv.assign(wa, wa + Na); }
+      for(unsigned int i = 0; i < Na; i++){
+
+         yf[i] = Fxa(la[i], FitParams.x0, FitParams.sigma2, FitParams.Ao,
+                                                           FitParams.Bo);
+
+      }
+      p0[0] = FitParams.x0;
+      p0[1] = FitParams.sigma2;
+      p0[2] = FitParams.Ao;
+      p0[3] = FitParams.Bo;
+
+      // Refit one resampled data set, warm started from the nominal fit
+      auto refit = [&](const std::vector<double> &xb,
+                       const std::vector<double> &yb,
+                       const std::vector<double> &wb, double *param){
+
+         struct GaussFit4Params P = {param[0], param[1], param[2], param[3], 4, Loss};
+         double *xp = const_cast<double *>(&xb[0]),
+                *yp = const_cast<double *>(&yb[0]),
+                *wp = wb.empty() ? NULL : const_cast<double *>(&wb[0]);
+
+         if(!gauss_fit4_nlls(&xp, &yp, &wp, xb.size(), Max, Tol, P)){ return (0); }
+
+         param[0] = P.x0;
+         param[1] = P.sigma2;
+         param[2] = P.Ao;
+         param[3] = P.Bo;
+
+         return (int)(std::isfinite(P.x0) && std::isfinite(P.sigma2) &&
+                      std::isfinite(P.Ao) && std::isfinite(P.Bo));
+
+      };
+
+      std::cout << "Bootstrap (" << BootOpts.Nboot << " resampled fits, ";
+      std::cout << ((BOOT_PAIRS == BootOpts.mode) ? "pairs" : "residuals");
+      std::cout << ", seed " << BootOpts.seed << ")..." << std::endl;
+
+      if(Bootstrap(xv, yv, wv, yf, p0, refit, BootOpts, Boot)){
+
+         std::cout << " # successful fits: " << Boot.Nok << std::endl;
+         std::cout << " " << 100.0 * BootOpts.CL;
+         std::cout << "% percentile intervals: " << std::endl;
+         for(unsigned int k = 0; k < 4; k++){
+
+            std::cout << names[k] << "[" << Boot.lo[k] << ", ";
+            std::cout << Boot.hi[k] << "]" << std::endl;
+
+         }
+
+      }else{
+
+         std::cout << "Bootstrap failed" << std::endl;
+
+      }
+
+   }
+
+   //Declare and write the output file (scoped, the K component fit
+   //jumps here)
+write_output:
+   {
+      std::string output_filename_s(InputStem(input_filename));
+      output_filename_s.append("_fit.dat");
+      std::ofstream output_file(output_filename_s.c_str(), std::ofstream::out);
+      output_file << std::scientific;
    
-   //Attempt to open the output file
-   if(output_file.is_open()){
+      //Attempt to open the output file
+      if(output_file.is_open()){
      
-      std::cout << "Writing fit data to file: " << output_filename_s.c_str();
-      std::cout << std::endl;
-      double col1       = lambda.at(0),
-             col2       = 0.0,
-             lambda_end = *std::max_element(lambda.begin(),lambda.end());
+         std::cout << "Writing fit data to file: " << output_filename_s.c_str();
+         std::cout << std::endl;
+         double col1 = lambda_first,
+                col2 = 0.0,
+                step = std::max(0.0001, (lambda_end - lambda_first) / LIF_FIT_GRID_MAX);
+         unsigned long k = 0;
      
-      while(col1 < lambda_end){
+         while((col1 < lambda_end) && (k++ < LIF_FIT_GRID_MAX)){
             
-         // Since the input data scans back and forth, lets only
-         // use the values from forward back of scan.
-         col2 = Fxa(col1, FitParams.x0, FitParams.sigma2, FitParams.Ao,
-                                                            FitParams.Bo);
-         output_file << col1 << " ";
-         output_file << col2 << std::endl;
-         col1 += 0.0001;
+            // Since the input data scans back and forth, lets only
+            // use the values from forward back of scan.
+            col2 = (NULL != FitN.param) ? FxaN(col1, FitN)
+                   : voigt_ok ? Vxa(col1, VFit)
+                   : Fxa(col1, FitParams.x0, FitParams.sigma2, FitParams.Ao,
+                                                               FitParams.Bo);
+            output_file << col1 << " ";
+            output_file << col2 << std::endl;
+            col1 += step;
          
-      }
+         }
      
-   }else{
+      }else{
      
-      std::cerr << "Error opening file:" << output_filename_s.c_str();
-      std::cerr << std::endl;
-      return (-1);
+         std::cerr << "Error opening file:" << output_filename_s.c_str();
+         std::cerr << std::endl;
+         return (-1);
       
-   }//Done writing output file
+      }//Done writing output file
    
-   output_file.close();
+      output_file.close();
+   }
+
+   // Append the single Gaussian fit, and the Voigt fit, to the results
+   // store, the K component fit has no row layout
+   if((NULL != store_dir) && (NULL == FitN.param)){
+
+      std::vector<struct ResultsRow> Rows(voigt ? 2 : 1);
+
+      Res.Npoints   = Na;
+      Res.FitParams = FitParams;
+      lif_results_row(input_filename, shot, channel, Res, Rows[0]);
+      if(voigt){
+
+         lif_voigt_results_row(input_filename, shot, channel, VFit, Na,
+                               voigt_ok, t_voigt, Rows[1]);
+
+      }
+
+      if(!ResultsAppend(store_dir, Rows)){ return (-1); }
+      std::cout << "Appended the fit to the store: " << store_dir << std::endl;
+
+   }else if(NULL != store_dir){
 
+      std::cerr << "-D stores single Gaussian and Voigt fits, not -n" << std::endl;
+
+   }
+
+   gauss_fitN_free(FitN);
+   delete[] wa;
+   delete[] sa;
    delete[] ca;
    delete[] la;
  
@@ -199,11 +948,213 @@ return(0);
 
 }
 
+/************************************************************************/
+/*
+ * Fits a batch of files (see lif_batch) and prints one line per file and
+ * the time spent by every pipeline stage
+ */
+static int run_batch(const std::vector<std::string> &input_files,
+                     const struct LIFBatchOptions &Opts,
+                     const struct GaussFit4Params &Guess){
+
+   std::vector<struct LIFBatchResult> Results;
+   unsigned int Ncached  = 0,
+                Nresumed = 0,
+                Ncrashed = 0,
+                Nrejected = 0;
+   int ok = 0;
+#ifdef WITH_MPI
+   std::vector<struct MPIRankStats> RankStats;
+#else
+   struct PipelineStats Stats;
+#endif
+
+   std::cout << "Batch of " << input_files.size() << " files..." << std::endl;
+
+#ifdef WITH_MPI
+   ok = lif_batch_mpi(input_files, Opts, Guess, Results, RankStats);
+#else
+   ok = lif_batch(input_files, Opts, Guess, Results, Stats);
+#endif
+
+   std::cout.precision(7);
+   std::cout << "#file Npoints x0[nm] dx0[nm] sigma2[nm^2] dsigma2[nm^2] Ao dAo";
+   std::cout << " Bo dBo chi2/dof status" << std::endl;
+   for(unsigned int i = 0; i < input_files.size(); i++){
+
+      const struct GaussFit4Params &P = Results[i].FitParams;
+
+      std::cout << input_files[i] << " " << Results[i].Npoints << " ";
+      std::cout << P.x0 << " " << P.Stats.err[0] << " ";
+      std::cout << P.sigma2 << " " << P.Stats.err[1] << " ";
+      std::cout << P.Ao << " " << P.Stats.err[2] << " ";
+      std::cout << P.Bo << " " << P.Stats.err[3] << " ";
+      std::cout << P.Stats.chi2_red << " ";
+      std::cout << (Results[i].crashed ? "crashed"
+                    : !Results[i].read_ok ? "read_failed"
+                    : (TRIAGE_OK != Results[i].triage) ? "rejected:"
+                    : !Results[i].fit_ok ? "fit_failed"
+                    : !Results[i].write_ok ? "write_failed"
+                    : Results[i].resumed ? "resumed"
+                    : Results[i].cached ? "cached" : "ok");
+      if(!Results[i].crashed && Results[i].read_ok && (TRIAGE_OK != Results[i].triage)){
+
+         std::cout << TriageName(Results[i].triage);
+         Nrejected++;
+
+      }
+      std::cout << std::endl;
+      Ncached  += Results[i].cached;
+      Nresumed += Results[i].resumed;
+      Ncrashed += Results[i].crashed;
+
+   }
+
+   if(Opts.triage){
+
+      std::cout << "Triage: " << Nrejected << " of " << input_files.size();
+      std::cout << " files rejected, not fitted" << std::endl;
+
+   }
+
+   if(NULL != Opts.cache){
+
+      std::cout << "Fit cache: " << Ncached << " of " << input_files.size();
+      std::cout << " files unchanged, not fitted" << std::endl;
+
+   }
+   if(NULL != Opts.journal){
+
+      std::cout << "Journal: " << Nresumed << " of " << input_files.size();
+      std::cout << " files done by an earlier run, not fitted" << std::endl;
+      if(Ncrashed > 0){
+
+         std::cout << "Journal: " << Ncrashed << " files crashed ";
+         std::cout << BatchJournalMaxBegins << " runs, skipped" << std::endl;
+
+      }
+      if(Opts.journal->Nskipped > 0){
+
+         std::cout << "Journal: skipped " << Opts.journal->Nskipped;
+         std::cout << " bytes of torn records" << std::endl;
+
+      }
+
+   }
+#ifdef WITH_MPI
+   PrintMPIRankStats(RankStats);
+#else
+   PrintPipelineStats(Stats);
+#endif
+
+std::cout << "-- END lif_analysis --" << std::endl;
+return (ok ? 0 : -1);
+
+}
+
+/************************************************************************/
+/*
+ * Fits every pixel of a data cube (see lif_cube_fit) and writes the
+ * parameter maps to <cube stem>_x0.dat, ..._sigma2.dat, ..._Ao.dat,
+ * ..._Bo.dat and ..._chi2.dat, and the triage reasons to ..._triage.dat
+ */
+static int run_cube(const char *cube_filename, const struct LIFCubeOptions &Opts){
+
+   struct LIFCube C;
+   struct LIFCubeMaps Maps;
+   struct LIFCubeStats Stats;
+   int ok = 0;
+
+   if(!lif_cube_open(cube_filename, C)){ return (-1); }
+
+   std::cout << "Cube of " << C.nx << " x " << C.ny << " pixels, " << C.nl;
+   std::cout << " wavelengths (" << ((LIF_CUBE_PIXELS == C.order) ? "pixel" : "frame");
+   std::cout << " major)..." << std::endl;
+
+   ok = lif_cube_fit(C, Opts, Maps, Stats);
+
+   std::cout.precision(4);
+   std::cout << " pixels fitted       : " << Stats.Nfit << std::endl;
+   std::cout << " failed              : " << Stats.Nfailed << std::endl;
+   if(Opts.triage){
+
+      std::cout << " rejected by triage  : " << Stats.Nrejected << std::endl;
+
+   }
+   std::cout << " neighbor starts     : " << Stats.Nwarm << " (" << Stats.Nretry;
+   std::cout << " refitted cold)" << std::endl;
+   std::cout << " iterations / pixel  : ";
+   std::cout << (double)Stats.Niter / std::max(1UL, Stats.Nfit - Stats.Nfailed);
+   std::cout << std::endl;
+   std::cout << " wall time [s]       : " << Stats.t_wall << " (";
+   std::cout << Stats.Nfit / std::max(Stats.t_wall, 1.0E-9) << " pixels/s)";
+   std::cout << std::endl;
+
+   ok = lif_cube_write_maps(InputStem(cube_filename).c_str(), C, Maps) && ok;
+   lif_cube_close(C);
+
+std::cout << "-- END lif_analysis --" << std::endl;
+return (ok ? 0 : -1);
+
+}
+
 /************************************************************************/
 void print_usage(){
    
    std::cout << "Usage:" << std::endl;
-   std::cout << "build/bin/LIFAnalysis -f <filename>" << std::endl;
+   std::cout << "build/bin/LIFAnalysis -f <filename> [-f <filename> ...] [-l <list>]";
+   std::cout << " [-m] [-R loss] [-s] [-b Nbins] [-w Nsig] [-n K] [-V]";
+   std::cout << " [-M N] [-B N [-P] [-S seed] [-j N]] [-a 16|32 [-g gL,oL,gC,oC]]";
+   std::cout << " [-D store [-N shot] [-C channel]] [-K cache] [-J journal] [-A tune]";
+   std::cout << " [-Q]" << std::endl;
+   std::cout << "build/bin/LIFAnalysis -c <cube> [-m] [-R loss] [-j N] [-Q]" << std::endl;
+   std::cout << "   -l <list>  : fit every file listed in <list> (one per line)";
+   std::cout << std::endl;
+   std::cout << "                several files run as a read -> fit -> write pipeline";
+   std::cout << std::endl;
+   std::cout << "   -m : mixed precision (float32 + double refinement) fit";
+   std::cout << std::endl;
+   std::cout << "   -R <loss>  : robust Gaussian fit, huber[,c] or tukey[,c] (c in";
+   std::cout << " units of the residual scale)" << std::endl;
+   std::cout << "   -s : sort (fold) the back and forth wavelength sweeps";
+   std::cout << std::endl;
+   std::cout << "   -b <Nbins> : bin the samples onto a uniform grid";
+   std::cout << std::endl;
+   std::cout << "   -w <Nsig>  : keep only +/- Nsig std deviations of the peak";
+   std::cout << std::endl;
+   std::cout << "   -n <K>     : fit K Gaussian components on a common background";
+   std::cout << std::endl;
+   std::cout << "   -V         : also fit a Voigt profile (Gaussian + Lorentzian)";
+   std::cout << std::endl;
+   std::cout << "   -M <N>     : multi-start search over N initial guesses";
+   std::cout << std::endl;
+   std::cout << "   -B <N>     : bootstrap percentile intervals from N refits";
+   std::cout << std::endl;
+   std::cout << "   -P         : bootstrap resamples (lambda, counts) pairs";
+   std::cout << " (default: residuals)" << std::endl;
+   std::cout << "   -S <seed>  : bootstrap / multi-start random seed" << std::endl;
+   std::cout << "   -j <N>     : # threads (default: all cores)" << std::endl;
+   std::cout << "   -a <bits>  : raw interleaved (lambda, counts) int16 / int32 ADC codes";
+   std::cout << std::endl;
+   std::cout << "   -g <cal>   : ADC calibration gL,oL,gC,oC (lambda = gL * code + oL)";
+   std::cout << std::endl;
+   std::cout << "   -D <dir>   : append every fit to the results store <dir>";
+   std::cout << std::endl;
+   std::cout << "   -N <shot>  : shot number (default: digits of the file name)";
+   std::cout << std::endl;
+   std::cout << "   -C <ch>    : channel (default: 0)" << std::endl;
+   std::cout << "   -K <dir>   : fit cache, unchanged files are not fitted again";
+   std::cout << std::endl;
+   std::cout << "   -J <file>  : batch journal, a killed batch resumes where it stopped";
+   std::cout << std::endl;
+   std::cout << "   -A <file>  : auto-tune -m, -j and the queues for this host, cached";
+   std::cout << " in <file>" << std::endl;
+   std::cout << "   -c <cube>  : fit every pixel of a (x, y, wavelength) data cube";
+   std::cout << std::endl;
+   std::cout << "                and write the x0, sigma2, Ao, Bo, chi2 and triage maps";
+   std::cout << std::endl;
+   std::cout << "   -Q         : fit every scan / pixel, no triage of flat, clipped,";
+   std::cout << " noisy ... spectra" << std::endl;
    std::cout << "build/bin/LIFAnalysis -f ExampleData/ExampleData.dat";
    std::cout << std::endl;
    
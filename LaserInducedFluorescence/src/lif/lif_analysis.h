@@ -9,6 +9,31 @@
 #ifndef lif_lif_analysis_h
 #define lif_lif_analysis_h
 
+#include "nlls_utils/robust_loss.h"
+
+/*
+ * Goodness of fit statistics and parameter uncertainties. gauss_fit4_nlls
+ * computes them from the sums of its last iteration, so they cost no
+ * extra pass over the data. They are evaluated at the parameters of
+ * that iteration, i.e. before the final (converged) step is applied.
+ */
+struct GaussFit4Stats{
+
+   double err[4]  ; // Standard errors of (x0, sigma2, Ao, Bo)
+   double cov[16] ; // Covariance matrix of (x0, sigma2, Ao, Bo), row major
+   double chi2    ; // Weighted sum of squared residuals
+   double chi2_red; // Reduced chi^2, chi2 / (# points - Npar)
+   double R2      ; // Coefficient of determination
+   double dparam2 ; // Squared norm of the last parameter step
+   double step    ; // Largest |step| of the last iteration [standard errors]
+   int    stop    ; // Why the fit stopped, NLLS_STOP_*
+   int    Niter   ; // Number of iterations
+   int    Niter_f32; // Number of float32 iterations (mixed precision fit)
+   double scale   ; // Robust scale of the residuals (robust loss)
+   int    Noutliers; // # residuals beyond c * scale (robust loss)
+
+};
+
 struct GaussFit4Params{
   
    double x0     ; // Rest wavelength              [m]
@@ -16,9 +41,83 @@ struct GaussFit4Params{
    double Ao     ; // Amplitude of arbitary counts []
    double Bo     ; // Amplitude of background      []
    int    Npar   ; // Number of parameters (4)
+   struct NLLSLoss Loss; // Robust loss of the fit (zero = least squares)
+
+   struct GaussFit4Stats Stats; // Output: fit statistics
    
 };
 
+/*
+ * Statistics of the N component fit, see gauss_fitN_nlls(...)
+ */
+struct GaussFitNStats{
+
+   double *err     ; // Standard errors of all Npar parameters
+   double chi2     ; // Weighted sum of squared residuals
+   double chi2_red ; // Reduced chi^2, chi2 / (# points - Npar)
+   double R2       ; // Coefficient of determination
+   double dparam2  ; // Squared norm of the last parameter step
+   double step     ; // Largest |step| of the last iteration [standard errors]
+   int    stop     ; // Why the fit stopped, NLLS_STOP_*
+   int    Niter    ; // Number of iterations
+   unsigned long Nrows; // # Jacobian rows (point, component) evaluated
+                        // in the last iteration
+
+};
+
+/*
+ * K Gaussian components on a common background. The parameters are
+ * stored flat, component k at param[3k ... 3k+2] = (x0, sigma2, Ao) and
+ * the background Bo last at param[3K]. Allocate with gauss_fitN_init.
+ */
+struct GaussFitNParams{
+
+   unsigned int K  ; // Number of Gaussian components
+   int    Npar     ; // Number of parameters (3K + 1)
+   double *param   ; // (x0 [nm], sigma2 [nm^2], Ao []) per component, Bo []
+
+   struct GaussFitNStats Stats; // Output: fit statistics
+
+};
+
+/*
+ * Voigt profile fit, see voigt_fit5_nlls(...) and voigt_model.h
+ */
+struct VoigtFit5Stats{
+
+   double err[5]  ; // Standard errors of (x0, sigma2, gamma, Ao, Bo)
+   double cov[25] ; // Covariance matrix of the parameters, row major
+   double chi2    ; // Weighted sum of squared residuals
+   double chi2_red; // Reduced chi^2, chi2 / (# points - Npar)
+   double R2      ; // Coefficient of determination
+   double dparam2 ; // Squared norm of the last parameter step
+   double step    ; // Largest |step| of the last iteration [standard errors]
+   int    stop    ; // Why the fit stopped, NLLS_STOP_*
+   int    Niter   ; // Number of iterations
+
+};
+
+struct VoigtFit5Params{
+
+   double x0     ; // Rest wavelength                [nm]
+   double sigma2 ; // Gaussian (Doppler) variance    [nm^2]
+   double gamma  ; // Lorentzian half width, HWHM    [nm]
+   double Ao     ; // Amplitude of the Gaussian part []
+   double Bo     ; // Amplitude of background        []
+   int    Npar   ; // Number of parameters (5)
+
+   struct VoigtFit5Stats Stats; // Output: fit statistics
+
+};
+
+/*
+ * The fitted profile is written to _fit.dat every 0.0001 of wavelength,
+ * on at most LIF_FIT_GRID_MAX points: a corrupt wavelength would make
+ * it range / 0.0001 lines long, or endless once 0.0001 is below the
+ * resolution of the wavelengths
+ */
+const unsigned long LIF_FIT_GRID_MAX = 1000000;
+
 /************************************************************************/
 /*
  * Usage function used to display example calling commands.
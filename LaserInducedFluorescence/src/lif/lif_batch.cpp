@@ -0,0 +1,622 @@
+// -----------------------------------------------------------------------
+//
+//                                    lif_batch.cpp V 0.01
+//
+//                                 (c) Brian Lynch March, 2015
+//
+// -----------------------------------------------------------------------
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <math.h>
+
+#include "lif_batch.h"
+#include "lif_data_reader.h"
+#include "lif_preprocess.h"
+#include "gaussian_fit4_nlls.h"
+#include "nlls_utils/input_stream.h"
+#include "nlls_utils/fit_cache.h"
+#include "nlls_utils/bootstrap.h"
+
+static const int    Max = 100;    // Maximum number of iterations while fitting
+static const double Tol = 1.0E-8; // Tolerance for convergence of the curve fit
+
+/*
+ * A scan on its way through the pipeline, the arrays are new[]
+ * allocated as in LIFAnalysis and freed by the writer
+ */
+struct LIFBatchItem{
+
+   double *la, *ca, *sa, *wa; // Wavelengths, counts, sigma, weights
+   double lambda_first,       // First wavelength of the scan as read
+          lambda_end;         // Largest wavelength of the scan as read
+   double full_lo, full_hi;   // Full scale of the counts (raw ADC codes)
+   struct LIFBatchResult Res;
+   uint64_t key;              // Fit cache key (Opts.cache)
+   std::string output;        // Cached content of the _fit.dat file
+   uint64_t jkey;             // Journal key (Opts.journal)
+
+};
+
+/************************************************************************/
+static void lif_batch_item_free(struct LIFBatchItem &T){
+
+   delete[] T.la;
+   delete[] T.ca;
+   delete[] T.sa;
+   delete[] T.wa;
+   T.la = T.ca = T.sa = T.wa = NULL;
+
+}
+
+/************************************************************************/
+void lif_results_row(const char *input_filename, const int64_t &shot,
+                     const int32_t &channel, const struct LIFBatchResult &R,
+                     struct ResultsRow &Row){
+
+   const struct GaussFit4Params &P = R.FitParams;
+
+   Row.shot     = (shot >= 0) ? shot : ResultsShotFromName(input_filename);
+   Row.t_shot   = ResultsFileTime(input_filename);
+   Row.t_run    = ResultsNow();
+   Row.Npoints  = R.Npoints;
+   Row.channel  = channel;
+   Row.tool     = TOOL_LIF_GAUSS;
+   Row.Niter    = P.Stats.Niter;
+   Row.status   = (TRIAGE_OK != R.triage) ? -R.triage : R.fit_ok;
+   Row.t_fit    = R.t_fit;
+   Row.chi2     = P.Stats.chi2;
+   Row.chi2_red = P.Stats.chi2_red;
+   Row.R2       = P.Stats.R2;
+
+   for(int k = 0; k < ResultsRow::MAXPAR; k++){ Row.p[k] = Row.err[k] = NAN; }
+
+   Row.p[0] = P.x0;
+   Row.p[1] = P.sigma2;
+   Row.p[2] = P.Ao;
+   Row.p[3] = P.Bo;
+   for(int k = 0; k < 4; k++){ Row.err[k] = P.Stats.err[k]; }
+
+}// End function lif_results_row
+
+/************************************************************************/
+void lif_voigt_results_row(const char *input_filename, const int64_t &shot,
+                           const int32_t &channel, const struct VoigtFit5Params &VFit,
+                           const unsigned int &Npoints, const int &fit_ok,
+                           const double &t_fit, struct ResultsRow &Row){
+
+   Row.shot     = (shot >= 0) ? shot : ResultsShotFromName(input_filename);
+   Row.t_shot   = ResultsFileTime(input_filename);
+   Row.t_run    = ResultsNow();
+   Row.Npoints  = Npoints;
+   Row.channel  = channel;
+   Row.tool     = TOOL_LIF_VOIGT;
+   Row.Niter    = VFit.Stats.Niter;
+   Row.status   = fit_ok;
+   Row.t_fit    = t_fit;
+   Row.chi2     = VFit.Stats.chi2;
+   Row.chi2_red = VFit.Stats.chi2_red;
+   Row.R2       = VFit.Stats.R2;
+
+   for(int k = 0; k < ResultsRow::MAXPAR; k++){ Row.p[k] = Row.err[k] = NAN; }
+
+   Row.p[0] = VFit.x0;
+   Row.p[1] = VFit.sigma2;
+   Row.p[2] = VFit.gamma;
+   Row.p[3] = VFit.Ao;
+   Row.p[4] = VFit.Bo;
+   for(int k = 0; k < 5; k++){ Row.err[k] = VFit.Stats.err[k]; }
+
+}// End function lif_voigt_results_row
+
+/************************************************************************/
+int lif_batch(const std::vector<std::string> &files,
+              const struct LIFBatchOptions &Opts,
+              const struct GaussFit4Params &Guess,
+              std::vector<struct LIFBatchResult> &Results,
+              struct PipelineStats &Stats){
+
+   int res = 1;
+
+   // Everything the fit of a file depends on besides its content
+   const double opts[] = {TOOL_LIF_GAUSS, Guess.x0, Guess.sigma2, Guess.Ao,
+                          Guess.Bo, Max, Tol, (double)Opts.mixed,
+                          (double)Opts.fold, (double)Opts.Nbins, Opts.Nsig,
+                          (double)Opts.adc_bytes,
+                          Opts.cal.gain[0], Opts.cal.offset[0],
+                          Opts.cal.gain[1], Opts.cal.offset[1],
+                          (double)Guess.Loss.type, Guess.Loss.c,
+                          (double)Opts.triage};
+   const std::vector<double> cache_opts(opts, opts + sizeof(opts) / sizeof(double));
+   const uint64_t journal_opts = FitCacheKey(0, cache_opts);
+
+   Results.assign(files.size(), LIFBatchResult());
+
+   // Parse the scan into new[] arrays as LIFAnalysis does and triage it
+   // while it is in cache, a cached file is only hashed, a journaled one
+   // not even opened
+   auto read = [&](unsigned int i, struct LIFBatchItem &T){
+
+      std::vector<double> lambda, counts, sigmas;
+      struct ADCTrace Raw;
+      uint64_t content = 0;
+
+      T.la = T.ca = T.sa = T.wa = NULL;
+      T.lambda_first = T.lambda_end = 0.0;
+      T.full_lo = -HUGE_VAL;
+      T.full_hi = HUGE_VAL;
+      T.Res.read_ok = T.Res.fit_ok = T.Res.write_ok = T.Res.cached = 0;
+      T.Res.resumed = T.Res.crashed = 0;
+      T.Res.triage = TRIAGE_OK;
+      T.Res.Npoints = 0;
+      T.Res.t_fit = 0.0;
+      T.Res.FitParams = Guess;
+      T.jkey = 0;
+
+      if(NULL != Opts.journal){
+
+         // A missing file keeps key 0, its read failure is journaled
+         BatchJournalFileKey(files[i].c_str(), journal_opts, T.jkey);
+
+         if(BatchJournalDone(*Opts.journal, T.jkey, files[i], &T.Res, sizeof(T.Res))){
+
+            T.Res.cached = 0;
+            T.Res.resumed = 1;
+            return (T.Res.read_ok);
+
+         }
+
+         if(BatchJournalBegins(*Opts.journal, T.jkey, files[i]) >= BatchJournalMaxBegins){
+
+            T.Res.crashed = 1;
+            return (0);
+
+         }
+
+      }
+
+      if(NULL != Opts.cache){
+
+         if(!FitCacheFileHash(Opts.cache, files[i].c_str(), content)){ return (0); }
+         T.key = FitCacheKey(content, cache_opts);
+
+         if(FitCacheGet(Opts.cache, T.key, &T.Res, sizeof(T.Res), T.output)){
+
+            T.Res.write_ok = 0;
+            T.Res.cached = 1;
+            return (1);
+
+         }
+
+      }
+
+      if(NULL != Opts.journal){ BatchJournalBegin(*Opts.journal, T.jkey, files[i]); }
+
+      try{
+
+         if(Opts.adc_bytes > 0){
+
+            if(!ReadADCTrace(files[i].c_str(), Opts.adc_bytes, Opts.cal, Raw)){ return (0); }
+
+            T.Res.Npoints = Raw.Nsamples;
+            T.la = new double[T.Res.Npoints];
+            T.ca = new double[T.Res.Npoints];
+            for(unsigned int k = 0; k < T.Res.Npoints; k++){
+
+               T.la[k] = ADCX(Raw, k);
+               T.ca[k] = ADCY(Raw, k);
+
+            }
+            ADCFullScaleY(Raw, T.full_lo, T.full_hi);
+
+         }else{
+
+            if(!read_lif_data(files[i].c_str(), lambda, counts, sigmas)){ return (0); }
+
+            T.Res.Npoints = lambda.size();
+            T.la = new double[T.Res.Npoints];
+            T.ca = new double[T.Res.Npoints];
+            std::copy(lambda.begin(), lambda.end(), T.la);
+            std::copy(counts.begin(), counts.end(), T.ca);
+
+            if(!sigmas.empty()){
+
+               T.sa = new double[T.Res.Npoints];
+               std::copy(sigmas.begin(), sigmas.end(), T.sa);
+
+            }
+
+         }
+
+      }catch(std::bad_alloc& ba){
+
+         std::cerr << "ERROR: lif_batch allocation: " << ba.what() << std::endl;
+         lif_batch_item_free(T);
+         return (0);
+
+      }
+
+      if(0 == T.Res.Npoints){
+
+         std::cerr << "No data in file " << files[i] << std::endl;
+         return (0);
+
+      }
+
+      T.lambda_first = T.la[0];
+      T.lambda_end   = *std::max_element(T.la, T.la + T.Res.Npoints);
+      T.Res.read_ok  = 1;
+
+      if(Opts.triage){
+
+         struct TriageStats Tri;
+
+         lif_triage(T.la, T.ca, T.Res.Npoints, T.full_lo, T.full_hi, Tri);
+         T.Res.triage = Tri.reason;
+
+      }
+
+      return (1);
+
+   };
+
+   // Preprocess as LIFAnalysis -s -b -w and fit
+   auto fit = [&](unsigned int i, struct LIFBatchItem &T){
+
+      unsigned int &Na = T.Res.Npoints;
+
+      if(!T.Res.read_ok || (TRIAGE_OK != T.Res.triage)){ return (0); }
+      if(T.Res.cached || T.Res.resumed){ return (T.Res.fit_ok); }
+
+      if(Opts.Nbins > 0){
+
+         struct LIFBinGrid grid;
+         double *lb = NULL,
+                *cb = NULL,
+                *sb = NULL;
+
+         if(lif_bin_init(grid, *std::min_element(T.la, T.la + Na),
+                               *std::max_element(T.la, T.la + Na), Opts.Nbins)){
+
+            for(unsigned int k = 0; k < Na; k++){ lif_bin_add(grid, T.la[k], T.ca[k]); }
+
+            if(lif_bin_finish(grid, &lb, &cb, &sb, Na)){
+
+               delete[] T.la;
+               delete[] T.ca;
+               delete[] T.sa;
+               T.la = lb;
+               T.ca = cb;
+               T.sa = sb;
+
+            }
+
+         }
+
+         lif_bin_free(grid);
+
+      }else if(Opts.fold || (Opts.Nsig > 0.0)){
+
+         lif_fold_scan(&T.la, &T.ca, &T.sa, Na);
+
+      }
+
+      if(Opts.Nsig > 0.0){
+
+         lif_window(&T.la, &T.ca, &T.sa, Na, Opts.Nsig, 2 * Guess.Npar);
+
+      }
+
+      sigma_to_weights(T.sa, Na, &T.wa);
+
+      std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+      T.Res.fit_ok = Opts.mixed
+                   ? gauss_fit4_nlls_mixed(&T.la, &T.ca, &T.wa, Na, Max, Tol, T.Res.FitParams)
+                   : gauss_fit4_nlls(&T.la, &T.ca, &T.wa, Na, Max, Tol, T.Res.FitParams);
+
+      T.Res.t_fit = std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                                                - t0).count();
+
+      return (T.Res.fit_ok);
+
+   };
+
+   // Same grid as LIFAnalysis, the item is freed once it is written.
+   // Only this thread appends to the store.
+   auto write = [&](unsigned int i, struct LIFBatchItem &T){
+
+      const struct GaussFit4Params &P = T.Res.FitParams;
+      std::vector<struct ResultsRow> Row(1);
+
+      std::string output_filename_s(InputStem(files[i].c_str()));
+
+      output_filename_s.append("_fit.dat");
+
+      if(T.Res.resumed || T.Res.crashed){
+
+         Results[i] = T.Res;
+         return (T.Res.write_ok);
+
+      }
+
+      if(T.Res.cached){
+
+         T.Res.write_ok = FitCacheWriteOutput(output_filename_s.c_str(), T.output);
+
+      }else if(T.Res.read_ok && (TRIAGE_OK == T.Res.triage)){
+
+         std::ofstream output_file(output_filename_s.c_str(), std::ofstream::out);
+
+         if(output_file.is_open()){
+
+            const double step = std::max(0.0001, (T.lambda_end - T.lambda_first)
+                                                 / LIF_FIT_GRID_MAX);
+            unsigned long k = 0;
+
+            output_file << std::scientific;
+            for(double col1 = T.lambda_first; (col1 < T.lambda_end) &&
+                                              (k++ < LIF_FIT_GRID_MAX); col1 += step){
+
+               output_file << col1 << " ";
+               output_file << Fxa(col1, P.x0, P.sigma2, P.Ao, P.Bo) << std::endl;
+
+            }
+            output_file.close();
+            T.Res.write_ok = !output_file.fail();
+
+         }else{
+
+            std::cerr << "Error opening file:" << output_filename_s.c_str();
+            std::cerr << std::endl;
+
+         }
+
+         if(T.Res.write_ok && (NULL != Opts.cache)){
+
+            FitCachePut(Opts.cache, T.key, &T.Res, sizeof(T.Res),
+                        output_filename_s.c_str());
+
+         }
+
+      }
+
+      if(T.Res.read_ok && (NULL != Opts.store)){
+
+         lif_results_row(files[i].c_str(), -1, Opts.channel, T.Res, Row[0]);
+         T.Res.write_ok = ResultsAppend(Opts.store, Row) && T.Res.write_ok;
+
+      }
+
+      // An output that could not be written is retried by the next run, a
+      // file that cannot be read or fitted is not
+      if((NULL != Opts.journal) && (T.Res.write_ok || !T.Res.read_ok || !T.Res.fit_ok)){
+
+         BatchJournalEnd(*Opts.journal, T.jkey, files[i], &T.Res, sizeof(T.Res));
+
+      }
+
+      lif_batch_item_free(T);
+      Results[i] = T.Res;
+
+      return (T.Res.write_ok);
+
+   };
+
+   RunPipeline<struct LIFBatchItem>(files.size(), Opts.Pipe, read, fit, write, Stats);
+
+   for(unsigned int i = 0; i < files.size(); i++){
+
+      res = res && Results[i].read_ok && Results[i].fit_ok && Results[i].write_ok;
+
+   }
+
+   return (res);
+
+}// End function lif_batch
+
+/************************************************************************/
+int lif_batch_tune(const char *tune_file, const char *input_filename,
+                   const struct LIFBatchOptions &Opts,
+                   const struct GaussFit4Params &Guess, struct AutoTuneConfig &C){
+
+   std::vector<double> lambda, counts, sigmas; // The first scan
+   struct ADCTrace Raw;
+   std::string key;
+   unsigned long ipeak = 0;
+   double cmin = 0.0,
+          cmax = 0.0;
+   uint64_t state = 12345;
+
+   // The shape of the input: its length, wavelengths and weights
+   if(Opts.adc_bytes > 0){
+
+      if(!ReadADCTrace(input_filename, Opts.adc_bytes, Opts.cal, Raw)){ return (0); }
+
+      lambda.resize(Raw.Nsamples);
+      counts.resize(Raw.Nsamples);
+      for(unsigned long k = 0; k < Raw.Nsamples; k++){
+
+         lambda[k] = ADCX(Raw, k);
+         counts[k] = ADCY(Raw, k);
+
+      }
+
+   }else{
+
+      if(!read_lif_data(input_filename, lambda, counts, sigmas)){ return (0); }
+
+   }
+
+   if(counts.size() < 2){
+
+      std::cerr << "No scan to tune on in file " << input_filename << std::endl;
+      return (0);
+
+   }
+
+   key = AutoTuneKey("LIFAnalysis", counts.size());
+   if(AutoTuneLoad(tune_file, key, C)){
+
+      std::cout << "Tuned configuration of " << key << " read from " << tune_file;
+      std::cout << std::endl;
+      return (1);
+
+   }
+
+   // A Gaussian of the guessed width on the peak of the scan, from its
+   // background up to its maximum, plus 1% noise
+   ipeak = std::max_element(counts.begin(), counts.end()) - counts.begin();
+   cmin  = *std::min_element(counts.begin(), counts.end());
+   cmax  = counts[ipeak];
+   if(!(cmax > cmin)){ cmax = cmin + 1.0; }
+   for(unsigned long k = 0; k < counts.size(); k++){
+
+      const double u = ldexp((double)(SplitMix64(state) >> 11), -53) - 0.5;
+
+      counts[k] = Fxa(lambda[k], lambda[ipeak], Guess.sigma2, cmax - cmin, cmin)
+                + 0.02 * (cmax - cmin) * u;
+
+   }
+
+   std::cout << "Tuning " << key << " on synthetic scans..." << std::endl;
+
+   // Ntraces copies of the scan through the pipeline, as lif_batch holds
+   // and fits them, without the files
+   auto trial = [&](const struct AutoTuneConfig &T, const unsigned int &Ntraces,
+                    double &t_wall){
+
+      const struct PipelineOptions Pipe = {Opts.Pipe.Nreaders, T.Nworkers, T.Nqueue};
+      struct PipelineStats Stats;
+
+      auto read = [&](unsigned int i, struct LIFBatchItem &B){
+
+         B.la = B.ca = B.sa = B.wa = NULL;
+         B.Res.Npoints = counts.size();
+         B.Res.FitParams = Guess;
+
+         try{
+
+            B.la = new double[B.Res.Npoints];
+            B.ca = new double[B.Res.Npoints];
+            std::copy(lambda.begin(), lambda.end(), B.la);
+            std::copy(counts.begin(), counts.end(), B.ca);
+
+            if(!sigmas.empty()){
+
+               B.sa = new double[B.Res.Npoints];
+               std::copy(sigmas.begin(), sigmas.end(), B.sa);
+
+            }
+
+         }catch(std::bad_alloc& ba){
+
+            std::cerr << "ERROR: lif_batch_tune allocation: " << ba.what() << std::endl;
+            lif_batch_item_free(B);
+            return (0);
+
+         }
+
+         return (1);
+
+      };
+
+      auto fit = [&](unsigned int i, struct LIFBatchItem &B){
+
+         unsigned int &Na = B.Res.Npoints;
+
+         if(NULL == B.la){ return (0); }
+
+         sigma_to_weights(B.sa, Na, &B.wa);
+
+         return (T.mixed
+                 ? gauss_fit4_nlls_mixed(&B.la, &B.ca, &B.wa, Na, Max, Tol, B.Res.FitParams)
+                 : gauss_fit4_nlls(&B.la, &B.ca, &B.wa, Na, Max, Tol, B.Res.FitParams));
+
+      };
+
+      auto write = [&](unsigned int i, struct LIFBatchItem &B){
+
+         lif_batch_item_free(B);
+         return (1);
+
+      };
+
+      RunPipeline<struct LIFBatchItem>(Ntraces, Pipe, read, fit, write, Stats);
+      t_wall = Stats.t_wall;
+
+      return (int)(0 == Stats.stage[1].Nfailed);
+
+   };
+
+   if(!AutoTune(trial, C)){
+
+      std::cerr << "ERROR: the synthetic scan did not fit, not tuned" << std::endl;
+      return (0);
+
+   }
+
+   return (AutoTuneSave(tune_file, key, C));
+
+}// End function lif_batch_tune
+
+#ifdef WITH_MPI
+/************************************************************************/
+int lif_batch_mpi(const std::vector<std::string> &files,
+                  const struct LIFBatchOptions &Opts,
+                  const struct GaussFit4Params &Guess,
+                  std::vector<struct LIFBatchResult> &Results,
+                  std::vector<struct MPIRankStats> &RankStats){
+
+   struct LIFBatchOptions RankOpts = Opts;
+   struct MPIBatchOptions MPIOpts = {1, 2.0};
+   std::vector<unsigned int> mine;
+   int res  = 1,
+       rank = 0;
+
+   if(0 == RankOpts.Pipe.Nworkers){ RankOpts.Pipe.Nworkers = 1; }
+
+   Results.assign(files.size(), LIFBatchResult());
+
+   // A chunk runs as a batch of its own on this rank
+   auto run = [&](const unsigned int &lo, const unsigned int &hi){
+
+      std::vector<std::string> chunk(files.begin() + lo, files.begin() + hi);
+      std::vector<struct LIFBatchResult> R;
+      struct PipelineStats Stats;
+
+      lif_batch(chunk, RankOpts, Guess, R, Stats);
+
+      for(unsigned int k = 0; k < R.size(); k++){
+
+         Results[lo + k] = R[k];
+         mine.push_back(lo + k);
+
+      }
+
+   };
+
+   MPIBatch(files.size(), MPIOpts, run, RankStats);
+   MPIGatherResults(Results, mine);
+
+   // Rank 0 has every result, the other ranks their own
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+   for(unsigned int i = 0; i < files.size(); i++){
+
+      if((0 == rank) || (std::find(mine.begin(), mine.end(), i) != mine.end())){
+
+         res = res && Results[i].read_ok && Results[i].fit_ok && Results[i].write_ok;
+
+      }
+
+   }
+
+   return (res);
+
+}// End function lif_batch_mpi
+#endif
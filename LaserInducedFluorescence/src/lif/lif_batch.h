@@ -0,0 +1,178 @@
+// -----------------------------------------------------------------------
+//
+//                                     lif_batch.h V 0.01
+//
+//                                 (c) Brian Lynch March, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef lif_lif_batch_h
+#define lif_lif_batch_h
+
+#include <vector>
+#include <string>
+
+#include "lif_analysis.h"
+#include "nlls_utils/adc_input.h"
+#include "nlls_utils/pipeline.h"
+#include "nlls_utils/results_store.h"
+#include "nlls_utils/batch_journal.h"
+#include "nlls_utils/auto_tune.h"
+#ifdef WITH_MPI
+#include "nlls_utils/mpi_batch.h"
+#endif
+
+/*
+ * Options of a batch of scans, see lif_batch(...)
+ */
+struct LIFBatchOptions{
+
+   struct PipelineOptions Pipe; // Reader / fit threads, queue sizes
+   int mixed;                   // Mixed precision fits
+   int fold;                    // Sort (fold) the sweeps
+   unsigned int Nbins;          // Bin onto Nbins bins (0 = none)
+   double Nsig;                 // Window of +/- Nsig sigma (0 = none)
+   int adc_bytes;               // Raw ADC codes of 2 or 4 bytes (0 = ASCII)
+   struct ADCCalibration cal;   // Calibration of raw ADC codes
+   const char *store;           // Results store directory (NULL = none)
+   int32_t channel;             // Channel of every file in the store
+   const char *cache;           // Fit cache directory (NULL = none)
+   struct BatchJournal *journal;// Journal to resume from (NULL = none)
+   int triage;                  // Reject bad scans before fitting them
+
+};
+
+/*
+ * Fit of one scan of a batch
+ */
+struct LIFBatchResult{
+
+   int read_ok;                      // The scan was read
+   int fit_ok;                       // The fit succeeded
+   int write_ok;                     // The _fit.dat file was written
+   int cached;                       // Taken from the fit cache, not fitted
+   int resumed;                      // Done by an earlier run (journal)
+   int crashed;                      // Not begun, it crashed earlier runs
+   int triage;                       // TRIAGE_OK or why the scan was not fitted
+   unsigned int Npoints;             // # samples fitted
+   double t_fit;                     // Wall time of the fit [s]
+   struct GaussFit4Params FitParams; // The fit
+
+};
+
+/************************************************************************/
+/*
+ * lif_batch(...) preprocesses and fits every file of a batch as
+ * LIFAnalysis does for one file (single Gaussian) and writes
+ * <file>_fit.dat for each, as a pipeline (see nlls_utils/pipeline.h):
+ * reader threads parse the next files while the fit threads work on
+ * the parsed ones and one writer thread writes the results, so disk and
+ * CPU are busy at the same time. Every fit starts from Guess. With
+ * Opts.store every fit is also appended to that results store. With
+ * Opts.cache a file whose content and options were fitted before is
+ * only hashed, its result and _fit.dat come from the fit cache (see
+ * nlls_utils/fit_cache.h).
+ *
+ * With Opts.journal (see nlls_utils/batch_journal.h) a killed batch
+ * resumes where it stopped: a file journaled as done, unchanged and
+ * with the same options, is neither read nor fitted nor written again.
+ * A file is journaled once written, or once it failed to read or fit,
+ * but not when its output could not be written (it is retried). A file
+ * begun BatchJournalMaxBegins times without a result is skipped.
+ *
+ * With Opts.triage the readers classify every scan as they parse it
+ * (see lif_triage in lif_preprocess.h) and a scan that cannot fit is
+ * not fitted: its Results[i].triage says why, no _fit.dat is written
+ * and its store row has the negative reason as status.
+ *
+ *      @param[in] files   : the input files
+ *      @param[in] Opts    : pipeline, preprocessing and input options
+ *      @param[in] Guess   : initial guess of every fit
+ *      @param[out] Results: one per file, in input order
+ *      @param[out] Stats  : time spent by every stage
+ *      @return int 1 if every file was read, fitted and written
+ *
+ */
+int lif_batch(const std::vector<std::string> &files,
+              const struct LIFBatchOptions &Opts,
+              const struct GaussFit4Params &Guess,
+              std::vector<struct LIFBatchResult> &Results,
+              struct PipelineStats &Stats);
+
+/************************************************************************/
+/*
+ * lif_batch_tune(...) picks the solver variant (double or mixed
+ * precision), the # fit threads and the queue capacity of lif_batch for
+ * scans shaped as the first of a batch (its length, wavelengths and
+ * weights), see nlls_utils/auto_tune.h. A configuration tuned before on
+ * this host for scans of that length (to a power of 2) is read from
+ * tune_file. Else AutoTune times batches of a synthetic scan, a Gaussian
+ * of width Guess.sigma2 on the peak and background of the first scan
+ * plus 1% noise, through the pipeline, and the fastest configuration is
+ * appended to tune_file. The scans are fitted as read, without -s, -b
+ * or -w.
+ *
+ *      @param[in] tune_file      : the tune file
+ *      @param[in] input_filename : the first file of the batch
+ *      @param[in] Opts           : input options and readers
+ *      @param[in] Guess          : initial guess of every fit
+ *      @param[out] C             : the configuration
+ *      @return int success/failure
+ *
+ */
+int lif_batch_tune(const char *tune_file, const char *input_filename,
+                   const struct LIFBatchOptions &Opts,
+                   const struct GaussFit4Params &Guess, struct AutoTuneConfig &C);
+
+#ifdef WITH_MPI
+/************************************************************************/
+/*
+ * lif_batch_mpi(...) is lif_batch(...) over the MPI ranks: rank 0 hands
+ * out chunks of files (see MPIBatch), every rank runs lif_batch on its
+ * chunks, writing the _fit.dat files and appending to Opts.store itself,
+ * and the results are gathered on rank 0. Each rank runs
+ * Opts.Pipe.Nworkers fit threads, 1 if 0 (one rank per core).
+ *
+ *      @param[in] files      : the input files
+ *      @param[in] Opts       : pipeline, preprocessing and input options
+ *      @param[in] Guess      : initial guess of every fit
+ *      @param[out] Results   : on rank 0 one per file, in input order
+ *      @param[out] RankStats : on rank 0 the time spent by every rank
+ *      @return int 1 if every file (of this rank) was read, fitted and
+ *              written
+ *
+ */
+int lif_batch_mpi(const std::vector<std::string> &files,
+                  const struct LIFBatchOptions &Opts,
+                  const struct GaussFit4Params &Guess,
+                  std::vector<struct LIFBatchResult> &Results,
+                  std::vector<struct MPIRankStats> &RankStats);
+#endif
+
+/************************************************************************/
+/*
+ * lif_results_row(...) fills the results store row of a Gaussian fit
+ * (TOOL_LIF_GAUSS), lif_voigt_results_row(...) that of a Voigt fit
+ * (TOOL_LIF_VOIGT), see nlls_utils/results_store.h
+ *
+ *      @param[in] input_filename: the input file, its time and shot #
+ *      @param[in] shot          : shot number (-1 = from input_filename)
+ *      @param[in] channel       : channel
+ *      @param[in] R / VFit      : the fit
+ *      @param[in] Npoints       : # samples fitted
+ *      @param[in] fit_ok        : the fit succeeded (R: -R.triage if the
+ *                                 scan was rejected by triage)
+ *      @param[in] t_fit         : wall time of the fit [s]
+ *      @param[out] Row          : the row
+ *
+ */
+void lif_results_row(const char *input_filename, const int64_t &shot,
+                     const int32_t &channel, const struct LIFBatchResult &R,
+                     struct ResultsRow &Row);
+
+void lif_voigt_results_row(const char *input_filename, const int64_t &shot,
+                           const int32_t &channel, const struct VoigtFit5Params &VFit,
+                           const unsigned int &Npoints, const int &fit_ok,
+                           const double &t_fit, struct ResultsRow &Row);
+
+#endif
@@ -0,0 +1,248 @@
+// -----------------------------------------------------------------------
+//
+//                                   lif_benchmark.cpp V 0.01
+//
+//                                 (c) Brian Lynch March, 2015
+//
+// -----------------------------------------------------------------------
+
+#include <iostream>
+#include <stdlib.h>
+#include <vector>
+#include <math.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <chrono>
+#include <algorithm>
+
+#include "gaussian_model.h"
+#include "voigt_model.h"
+#include "nlls_utils/model_bench.h"
+#include "nlls_utils/bootstrap.h"
+
+/************************************************************************/
+/*
+ * Reference value of the Faddeeva function for y > 0 from the Voigt
+ * integrals
+ *
+ *      Re w = y / pi * int exp(-t^2) / ((x - t)^2 + y^2) dt
+ *      Im w = 1 / pi * int (x - t) exp(-t^2) / ((x - t)^2 + y^2) dt
+ *
+ * by the trapezoidal rule on |t| <= 12. The integrands are analytic
+ * within y of the real axis, so a step of y / 10 makes the error
+ * ~exp(-20 pi). This is the slow numerical convolution the fit avoids.
+ */
+static void FaddeevaQuad(const double &x, const double &y, double &u, double &v){
+
+   const double T = 12.0,
+                h = std::min(0.1 * y, 0.01);
+   const long   n = (long)(2.0 * T / h);
+
+   u = v = 0.0;
+   for(long j = 0; j <= n; j++){
+
+      double t = -T + j * h,
+             e = exp(-t * t) / ((x - t) * (x - t) + y * y);
+
+      u += e;
+      v += (x - t) * e;
+
+   }
+
+   u *= y * h / M_PI;
+   v *= h / M_PI;
+
+}
+
+/************************************************************************/
+/*
+ * Compares the hand-written GaussianModel with the automatically
+ * differentiated GaussianModelAD on a synthetic scan: agreement of the
+ * gradients and the time of one fused Gauss-Newton pass. The Voigt
+ * model is checked the same way, its Faddeeva function against
+ * quadrature, and timed against the Gaussian.
+ */
+int main(int argc, char** argv){
+
+std::cout << "-- BEGIN lif_benchmark --" << std::endl;
+
+   const double xo_true   = 668.6138;  // Rest wavelength [nm]
+   const double sig2_true = 5.0E-7;    // Variance [nm^2]
+   const double Ao_true   = 4.0;       // Signal amplitude
+   const double Bo_true   = 0.5;       // Signal background
+   const double x_span    = 0.01;      // Scan +/- x_span around xo [nm]
+
+   int opt = 0;                   // Command line option parser variable
+   unsigned int Npoi  = 200000,   // Command line option # data points
+                Npass = 20;       // Command line option # passes timed
+
+   while((opt = getopt(argc, argv, "n:r:")) != -1){
+
+      switch (opt) {
+
+         case 'n' : // Number of data points option
+
+            Npoi = atoi(optarg);
+            break;
+
+         case 'r' : // Number of timed passes option
+
+            Npass = atoi(optarg);
+            break;
+
+         default :
+
+            std::cout << "Usage:" << std::endl;
+            std::cout << "build/bin/LIFBenchmark [-n Npoints] [-r Npasses]";
+            std::cout << std::endl;
+            return (-1);
+
+      }
+
+   }
+
+   if(Npoi < 2){ Npoi = 2; }
+
+   std::vector<double> x(Npoi),
+                       fx(Npoi),
+                       maxrel;
+   double p[GaussianModel::Npar] = {xo_true, sig2_true, Ao_true, Bo_true},
+          grad[GaussianModel::Npar];
+   uint64_t state = 12345;
+
+   // Synthetic scan with uniform noise of 5% of the amplitude
+   for(unsigned int i = 0; i < Npoi; i++){
+
+      double u = ldexp((double)(SplitMix64(state) >> 11), -53) - 0.5;
+
+      x[i]  = xo_true + x_span * (2.0 * i / (Npoi - 1) - 1.0);
+      fx[i] = GaussianModel::EvalGrad(x[i], p, grad) + 0.1 * Ao_true * u;
+
+   }
+
+   std::cout << "Points: " << Npoi << ", passes: " << Npass << std::endl;
+
+   GradientAgreement<GaussianModel, GaussianModelAD>(x, p, maxrel);
+   std::cout.precision(3);
+   std::cout << "Hand-written vs AD, max relative difference:" << std::endl;
+   std::cout << " F(x)            : " << maxrel[GaussianModel::Npar];
+   std::cout << std::endl;
+   for(unsigned int k = 0; k < GaussianModel::Npar; k++){
+
+      std::cout << " d/d " << GaussianModel::Name(k) << " [";
+      std::cout << GaussianModel::Unit(k) << "] : " << maxrel[k] << std::endl;
+
+   }
+
+   double t_hand = TimeFitPass<GaussianModel>(x, fx, p, Npass),
+          t_ad   = TimeFitPass<GaussianModelAD>(x, fx, p, Npass);
+
+   std::cout << "Fused Gauss-Newton pass [ns / point]:" << std::endl;
+   std::cout << " hand-written : " << t_hand << std::endl;
+   std::cout << " AD           : " << t_ad;
+   std::cout << " (x" << t_ad / t_hand << ")" << std::endl;
+
+   // Faddeeva function against quadrature, Re w(x) = exp(-x^2) for y = 0
+   const double ys[6] = {0.0, 0.01, 0.1, 1.0, 3.0, 10.0};
+   double abs_err = 0.0,
+          rel_err = 0.0;
+
+   for(unsigned int j = 0; j < 6; j++){
+
+      for(int i = -200; i <= 200; i++){
+
+         double xw = 0.05 * i,
+                u = 0.0, v = 0.0, ur = 0.0, vr = 0.0;
+
+         Faddeeva(xw, ys[j], u, v);
+         if(ys[j] > 0.0){
+
+            FaddeevaQuad(xw, ys[j], ur, vr);
+
+         }else{
+
+            ur = exp(-xw * xw);
+            vr = v;
+
+         }
+
+         double e = sqrt((u - ur) * (u - ur) + (v - vr) * (v - vr));
+
+         abs_err = std::max(abs_err, e);
+         rel_err = std::max(rel_err, e / sqrt(ur * ur + vr * vr));
+
+      }
+
+   }
+
+   std::cout << "Faddeeva w(x + iy) vs quadrature, |x| <= 10, 0 <= y <= 10:";
+   std::cout << std::endl;
+   std::cout << " max |error|       : " << abs_err << std::endl;
+   std::cout << " max |error| / |w| : " << rel_err << std::endl;
+
+   // Voigt model with a Lorentzian half width of 0.3 sigma
+   double pv[VoigtModel::Npar] = {xo_true, sig2_true, 0.3 * sqrt(sig2_true),
+                                  Ao_true, Bo_true};
+
+   GradientAgreement<VoigtModel, VoigtModelAD>(x, pv, maxrel);
+   std::cout << "Voigt analytic vs AD, max relative difference:" << std::endl;
+   std::cout << " F(x)            : " << maxrel[VoigtModel::Npar] << std::endl;
+   for(unsigned int k = 0; k < VoigtModel::Npar; k++){
+
+      std::cout << " d/d " << VoigtModel::Name(k) << " [";
+      std::cout << VoigtModel::Unit(k) << "] : " << maxrel[k] << std::endl;
+
+   }
+
+   // Line shape kernels alone, exp(...) vs w(z)
+   std::vector<double> ub(Npoi);
+   double s2 = 1.0 / sqrt(2.0 * sig2_true),
+          vb = 0.0;
+
+   std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+   for(unsigned int r = 0; r < Npass; r++){
+
+      for(unsigned int i = 0; i < Npoi; i++){
+
+         double z = (x[i] - xo_true) * s2;
+
+         ub[i] += exp(-z * z);
+
+      }
+
+   }
+   std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+   for(unsigned int r = 0; r < Npass; r++){
+
+      for(unsigned int i = 0; i < Npoi; i++){
+
+         double u = 0.0;
+
+         Faddeeva((x[i] - xo_true) * s2, pv[2] * s2, u, vb);
+         ub[i] += u;
+
+      }
+
+   }
+   std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+
+   double t_exp = std::chrono::duration<double, std::nano>(t1 - t0).count() /
+                                                 ((double)Npoi * Npass),
+          t_w   = std::chrono::duration<double, std::nano>(t2 - t1).count() /
+                                                 ((double)Npoi * Npass),
+          t_vgt = TimeFitPass<VoigtModel>(x, fx, pv, Npass);
+
+   std::cout << "Line shape kernel [ns / point]:" << std::endl;
+   std::cout << " exp(-z^2)    : " << t_exp << std::endl;
+   std::cout << " w(z)         : " << t_w;
+   std::cout << " (x" << t_w / t_exp << ")" << std::endl;
+   std::cout << "Fused Gauss-Newton pass [ns / point]:" << std::endl;
+   std::cout << " Gaussian     : " << t_hand << std::endl;
+   std::cout << " Voigt        : " << t_vgt;
+   std::cout << " (x" << t_vgt / t_hand << ")" << std::endl;
+   std::cout << " (checksum " << ub[Npoi / 2] + vb << ")" << std::endl;
+
+std::cout << "-- END lif_benchmark --" << std::endl;
+return (0);
+
+}
@@ -0,0 +1,427 @@
+// -----------------------------------------------------------------------
+//
+//                                    lif_cube.cpp V 0.01
+//
+//                                 (c) Brian Lynch March, 2015
+//
+// -----------------------------------------------------------------------
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "lif_cube.h"
+#include "lif_preprocess.h"
+#include "gaussian_fit4_nlls.h"
+#include "nlls_utils/parallel_for.h"
+
+static const char LIFCubeMagic[8] = {'L', 'I', 'F', 'C', 'U', 'B', 'E', '1'};
+
+struct LIFCubeHeader{
+
+   char magic[8];
+   uint32_t nx, ny, nl;
+   uint32_t type, order, reserved;
+
+};
+
+/************************************************************************/
+int lif_cube_open(const char *filename, struct LIFCube &C){
+
+   const size_t Nhead = sizeof(struct LIFCubeHeader);
+
+   struct LIFCubeHeader H;
+   struct stat st;
+   uint64_t Nneed = 0,
+            tsize = 0;
+   int fd = open(filename, O_RDONLY);
+
+   C.map = NULL;
+   C.Nmap = 0;
+   C.counts = NULL;
+   C.lambda.clear();
+
+   if((fd < 0) || (0 != fstat(fd, &st))){
+
+      std::cerr << "Error opening file:" << filename << std::endl;
+      if(fd >= 0){ close(fd); }
+      return (0);
+
+   }
+
+   if((size_t)st.st_size >= Nhead){
+
+      C.map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      if(MAP_FAILED == C.map){ C.map = NULL; }
+
+   }
+   close(fd);
+
+   if(NULL == C.map){
+
+      std::cerr << "ERROR: " << filename << " is not a LIF cube" << std::endl;
+      return (0);
+
+   }
+
+   C.Nmap = st.st_size;
+   memcpy(&H, C.map, Nhead);
+
+   tsize = (LIF_CUBE_U16 == H.type) ? 2 : (LIF_CUBE_F32 == H.type) ? 4
+         : (LIF_CUBE_F64 == H.type) ? 8 : 0;
+   Nneed = Nhead + (uint64_t)H.nl * sizeof(double) +
+           (uint64_t)H.nx * H.ny * H.nl * tsize;
+
+   if((0 != memcmp(H.magic, LIFCubeMagic, 8)) || (0 == tsize) ||
+      ((LIF_CUBE_PIXELS != H.order) && (LIF_CUBE_FRAMES != H.order)) ||
+      (0 == H.nx) || (0 == H.ny) || (H.nl < 5) || (Nneed > C.Nmap)){
+
+      std::cerr << "ERROR: " << filename << " is not a LIF cube, or is truncated";
+      std::cerr << std::endl;
+      lif_cube_close(C);
+      return (0);
+
+   }
+
+   C.nx    = H.nx;
+   C.ny    = H.ny;
+   C.nl    = H.nl;
+   C.type  = H.type;
+   C.order = H.order;
+   C.lambda.resize(C.nl);
+   memcpy(&C.lambda[0], (const char *)C.map + Nhead, C.nl * sizeof(double));
+   C.counts = (const unsigned char *)C.map + Nhead + C.nl * sizeof(double);
+
+   // Every tile reads the whole cube once
+   madvise(C.map, C.Nmap, MADV_WILLNEED);
+
+   return (1);
+
+}// End function lif_cube_open
+
+/************************************************************************/
+void lif_cube_close(struct LIFCube &C){
+
+   if(NULL != C.map){ munmap(C.map, C.Nmap); }
+
+   C.map = NULL;
+   C.Nmap = 0;
+   C.counts = NULL;
+
+}// End function lif_cube_close
+
+/************************************************************************/
+/*
+ * Copies the spectra of the w x h pixels of a tile at (x0, y0) into buf,
+ * pixel (i, j) at [(j * w + i) * nl]. A frame major cube is read a row
+ * of w pixels of every frame at a time.
+ */
+template<class T>
+static void lif_cube_load(const struct LIFCube &C, const T *counts,
+                          const unsigned int &x0, const unsigned int &y0,
+                          const unsigned int &w, const unsigned int &h,
+                          std::vector<double> &buf){
+
+   const size_t nx = C.nx, ny = C.ny, nl = C.nl;
+
+   if(LIF_CUBE_PIXELS == C.order){
+
+      for(unsigned int j = 0; j < h; j++){
+
+         const T *p = counts + ((y0 + j) * nx + x0) * nl;
+
+         for(size_t k = 0; k < w * nl; k++){ buf[j * w * nl + k] = p[k]; }
+
+      }
+
+   }else{
+
+      for(size_t l = 0; l < nl; l++){
+
+         for(unsigned int j = 0; j < h; j++){
+
+            const T *p = counts + (l * ny + y0 + j) * nx + x0;
+
+            for(unsigned int i = 0; i < w; i++){ buf[(j * w + i) * nl + l] = p[i]; }
+
+         }
+
+      }
+
+   }
+
+}
+
+/*
+ * Guess of a spectrum of its own: the peak, the half width at half
+ * maximum, the maximum and the minimum, as lif_window estimates them
+ */
+static void lif_cube_guess(const double *la, const double *ca, const unsigned int &nl,
+                           struct GaussFit4Params &P){
+
+   unsigned int ipk = 0,
+                il  = 0,
+                ir  = 0;
+   double lo = ca[0],
+          half = 0.0,
+          sd = 0.0;
+
+   for(unsigned int l = 1; l < nl; l++){
+
+      if(ca[l] > ca[ipk]){ ipk = l; }
+      lo = std::min(lo, ca[l]);
+
+   }
+
+   half = 0.5 * (ca[ipk] + lo);
+   for(il = ipk; (il > 0) && (ca[il] > half); il--){}
+   for(ir = ipk; (ir + 1 < nl) && (ca[ir] > half); ir++){}
+
+   // FWHM = 2 sqrt(2 ln 2) sigma, at least one wavelength step
+   sd = std::max(fabs(la[ir] - la[il]) / 2.3548, fabs(la[1] - la[0]));
+
+   P.x0     = la[ipk];
+   P.sigma2 = sd * sd;
+   P.Ao     = ca[ipk] - lo;
+   P.Bo     = lo;
+   P.Npar   = 4;
+
+}
+
+/************************************************************************/
+int lif_cube_fit(const struct LIFCube &C, const struct LIFCubeOptions &Opts,
+                 struct LIFCubeMaps &Maps, struct LIFCubeStats &Stats){
+
+   const int    Max = 100;    // Maximum number of iterations while fitting
+   const double Tol = 1.0E-8; // Tolerance for convergence of the curve fit
+
+   // A uint16 camera saturates on its largest code, 0 counts are only a
+   // dark pixel
+   const double full_hi = (LIF_CUBE_U16 == C.type) ? (double)UINT16_MAX : HUGE_VAL;
+
+   const unsigned int tile = (0 == Opts.tile) ? 16 : Opts.tile,
+                      Ntx  = (C.nx + tile - 1) / tile,
+                      Nty  = (C.ny + tile - 1) / tile;
+   const size_t Npix = (size_t)C.nx * C.ny;
+
+   std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+   std::mutex stats_lock;
+
+   Maps.x0.assign(Npix, NAN);
+   Maps.sigma2.assign(Npix, NAN);
+   Maps.Ao.assign(Npix, NAN);
+   Maps.Bo.assign(Npix, NAN);
+   Maps.chi2_red.assign(Npix, NAN);
+   Maps.Niter.assign(Npix, 0);
+   Maps.triage.assign(Npix, TRIAGE_OK);
+   Stats.Nfit = Stats.Nfailed = Stats.Nrejected = Stats.Nwarm = Stats.Nretry = 0;
+   Stats.Niter = 0;
+
+   auto fit_tile = [&](unsigned int t, unsigned int thread){
+
+      const unsigned int x0 = (t % Ntx) * tile,
+                         y0 = (t / Ntx) * tile,
+                         w  = std::min(tile, C.nx - x0),
+                         h  = std::min(tile, C.ny - y0);
+
+      struct LIFCubeStats S = {0, 0, 0, 0, 0, 0, 0.0};
+      std::vector<double> buf((size_t)w * h * C.nl),
+                          la(C.lambda);
+      double *lp = &la[0];
+
+      switch(C.type){
+
+         case LIF_CUBE_U16: lif_cube_load(C, (const uint16_t *)C.counts, x0, y0, w, h, buf); break;
+         case LIF_CUBE_F32: lif_cube_load(C, (const float *)C.counts, x0, y0, w, h, buf); break;
+         default:           lif_cube_load(C, (const double *)C.counts, x0, y0, w, h, buf); break;
+
+      }
+
+      for(unsigned int j = 0; j < h; j++){
+
+         for(unsigned int i = 0; i < w; i++){
+
+            const size_t k = (size_t)(y0 + j) * C.nx + x0 + i;
+            double *cp = &buf[(j * w + i) * C.nl];
+            struct GaussFit4Params P;
+            int Nseed = 0,
+                ok    = 0;
+
+            P.x0 = P.sigma2 = P.Ao = P.Bo = 0.0;
+            P.Npar = 4;
+            P.Loss = Opts.Loss;
+
+            // A rejected pixel stays NAN, so it does not seed its neighbors
+            if(Opts.triage){
+
+               struct TriageStats Tri;
+
+               lif_triage(lp, cp, C.nl, -HUGE_VAL, full_hi, Tri);
+               Maps.triage[k] = Tri.reason;
+               if(TRIAGE_OK != Tri.reason){ S.Nrejected++; continue; }
+
+            }
+
+            // The fitted left and upper neighbors in the tile
+            for(int n = 0; Opts.warm && (n < 2); n++){
+
+               if((0 == n) ? (0 == i) : (0 == j)){ continue; }
+
+               const size_t kn = (0 == n) ? k - 1 : k - C.nx;
+
+               if(isnan(Maps.x0[kn])){ continue; }
+
+               P.x0     += Maps.x0[kn];
+               P.sigma2 += Maps.sigma2[kn];
+               P.Ao     += Maps.Ao[kn];
+               P.Bo     += Maps.Bo[kn];
+               Nseed++;
+
+            }
+
+            if(Nseed > 0){
+
+               P.x0 /= Nseed;
+               P.sigma2 /= Nseed;
+               P.Ao /= Nseed;
+               P.Bo /= Nseed;
+               S.Nwarm++;
+
+            }else{
+
+               lif_cube_guess(lp, cp, C.nl, P);
+
+            }
+
+            for(int attempt = 0; attempt < 2; attempt++){
+
+               ok = Opts.mixed ? gauss_fit4_nlls_mixed(&lp, &cp, C.nl, Max, Tol, P)
+                               : gauss_fit4_nlls(&lp, &cp, C.nl, Max, Tol, P);
+               ok = ok && isfinite(P.x0) && isfinite(P.Stats.chi2_red) &&
+                          (P.sigma2 > 0.0);
+
+               if(ok || (0 == Nseed)){ break; }
+
+               // A warm start that failed is refitted from its own guess
+               lif_cube_guess(lp, cp, C.nl, P);
+               Nseed = 0;
+               S.Nretry++;
+
+            }
+
+            S.Nfit++;
+            if(!ok){ S.Nfailed++; continue; }
+
+            S.Niter          += P.Stats.Niter;
+            Maps.x0[k]        = P.x0;
+            Maps.sigma2[k]    = P.sigma2;
+            Maps.Ao[k]        = P.Ao;
+            Maps.Bo[k]        = P.Bo;
+            Maps.chi2_red[k]  = P.Stats.chi2_red;
+            Maps.Niter[k]     = P.Stats.Niter;
+
+         }
+
+      }
+
+      std::lock_guard<std::mutex> guard(stats_lock);
+      Stats.Nfit      += S.Nfit;
+      Stats.Nfailed   += S.Nfailed;
+      Stats.Nrejected += S.Nrejected;
+      Stats.Nwarm     += S.Nwarm;
+      Stats.Nretry    += S.Nretry;
+      Stats.Niter     += S.Niter;
+
+   };
+
+   ParallelFor(Ntx * Nty, Opts.Nthreads, fit_tile);
+
+   Stats.t_wall = std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                                                    - t0).count();
+
+   return (0 == Stats.Nfailed);
+
+}// End function lif_cube_fit
+
+/************************************************************************/
+int lif_cube_write_maps(const char *stem, const struct LIFCube &C,
+                        const struct LIFCubeMaps &Maps){
+
+   const char *names[5] = {"x0", "sigma2", "Ao", "Bo", "chi2"};
+   const std::vector<double> *maps[5] = {&Maps.x0, &Maps.sigma2, &Maps.Ao,
+                                         &Maps.Bo, &Maps.chi2_red};
+
+   for(int m = 0; m < 5; m++){
+
+      std::string output_filename_s = std::string(stem) + "_" + names[m] + ".dat";
+      std::ofstream output_file(output_filename_s.c_str(), std::ofstream::out);
+
+      if(!output_file.is_open()){
+
+         std::cerr << "Error opening file:" << output_filename_s.c_str();
+         std::cerr << std::endl;
+         return (0);
+
+      }
+
+      std::cout << "Writing " << names[m] << " map to file: " << output_filename_s;
+      std::cout << std::endl;
+
+      output_file << std::scientific << std::setprecision(9);
+      for(unsigned int y = 0; y < C.ny; y++){
+
+         for(unsigned int x = 0; x < C.nx; x++){
+
+            output_file << (*maps[m])[(size_t)y * C.nx + x];
+            output_file << ((x + 1 < C.nx) ? " " : "\n");
+
+         }
+
+      }
+
+      output_file.close();
+      if(output_file.fail()){ return (0); }
+
+   }
+
+   // The TRIAGE_ reason of every pixel
+   std::string output_filename_s = std::string(stem) + "_triage.dat";
+   std::ofstream output_file(output_filename_s.c_str(), std::ofstream::out);
+
+   if(!output_file.is_open()){
+
+      std::cerr << "Error opening file:" << output_filename_s.c_str();
+      std::cerr << std::endl;
+      return (0);
+
+   }
+
+   std::cout << "Writing triage map to file: " << output_filename_s << std::endl;
+   for(unsigned int y = 0; y < C.ny; y++){
+
+      for(unsigned int x = 0; x < C.nx; x++){
+
+         output_file << Maps.triage[(size_t)y * C.nx + x];
+         output_file << ((x + 1 < C.nx) ? " " : "\n");
+
+      }
+
+   }
+
+   output_file.close();
+
+   return (!output_file.fail());
+
+}// End function lif_cube_write_maps
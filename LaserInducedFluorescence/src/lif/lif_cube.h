@@ -0,0 +1,156 @@
+// -----------------------------------------------------------------------
+//
+//                                     lif_cube.h V 0.01
+//
+//                                 (c) Brian Lynch March, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef lif_lif_cube_h
+#define lif_lif_cube_h
+
+#include <vector>
+#include <stdint.h>
+
+#include "lif_analysis.h"
+
+/*
+ * Data cube of a spatial scan: a spectrum of nl wavelengths at every
+ * pixel of an nx by ny grid. The file (little endian) is
+ *
+ *      char     magic[8]   "LIFCUBE1"
+ *      uint32_t nx, ny, nl
+ *      uint32_t type       counts as LIF_CUBE_U16, _F32 or _F64
+ *      uint32_t order      LIF_CUBE_PIXELS: [y][x][l], a spectrum per
+ *                          pixel; LIF_CUBE_FRAMES: [l][y][x], an image
+ *                          per wavelength, as a camera records them
+ *      uint32_t reserved   0
+ *      double   lambda[nl] the wavelengths [nm]
+ *               counts[nx * ny * nl]
+ *
+ * The file is memory mapped, counts points into the mapping.
+ */
+enum{ LIF_CUBE_U16 = 0,
+      LIF_CUBE_F32 = 1,
+      LIF_CUBE_F64 = 2
+};
+
+enum{ LIF_CUBE_PIXELS = 0,
+      LIF_CUBE_FRAMES = 1
+};
+
+struct LIFCube{
+
+   unsigned int nx, ny, nl;    // Pixels along x and y, # wavelengths
+   int type;                   // LIF_CUBE_U16, _F32 or _F64
+   int order;                  // LIF_CUBE_PIXELS or _FRAMES
+   std::vector<double> lambda; // The wavelengths [nm]
+   const unsigned char *counts;// The counts, in the mapping
+   void *map;                  // The mapping of the file
+   size_t Nmap;                // Its size
+
+};
+
+/*
+ * Options of a cube fit, see lif_cube_fit(...)
+ */
+struct LIFCubeOptions{
+
+   unsigned int Nthreads; // Fit threads (0 = all cores)
+   unsigned int tile;     // Tiles of tile x tile pixels (0 = 16)
+   int mixed;             // Mixed precision fits
+   int warm;              // Start from the fitted neighbors
+   struct NLLSLoss Loss;  // Robust loss of the fits (zero = least squares)
+   int triage;            // Do not fit the spectra lif_triage rejects
+
+};
+
+/*
+ * Parameter maps of a cube, nx * ny values each, row y at [y * nx]. A
+ * pixel whose fit failed or that was rejected is NAN in every map.
+ */
+struct LIFCubeMaps{
+
+   std::vector<double> x0, sigma2, Ao, Bo; // The parameters
+   std::vector<double> chi2_red;           // chi^2 / dof
+   std::vector<int>    Niter;              // # iterations of the fit
+   std::vector<int>    triage;             // TRIAGE_OK or why it was not fitted
+
+};
+
+/*
+ * Work done by a cube fit
+ */
+struct LIFCubeStats{
+
+   unsigned long Nfit;      // # pixels fitted
+   unsigned long Nfailed;   // # pixels whose fit failed
+   unsigned long Nrejected; // # pixels rejected by triage, not fitted
+   unsigned long Nwarm;     // # fits started from the neighbors
+   unsigned long Nretry;    // # warm starts that failed and were refitted cold
+   unsigned long Niter;     // # iterations of all fits
+   double t_wall;           // Wall time [s]
+
+};
+
+/************************************************************************/
+/*
+ * lif_cube_open(...) maps a cube file and checks its header and size
+ *
+ *      @param[in] filename: the cube file
+ *      @param[out] C      : the cube
+ *      @return int success/failure
+ *
+ */
+int lif_cube_open(const char *filename, struct LIFCube &C);
+
+/************************************************************************/
+/*
+ * lif_cube_close(...) unmaps a cube
+ *
+ *      @param[in/out] C: the cube
+ *
+ */
+void lif_cube_close(struct LIFCube &C);
+
+/************************************************************************/
+/*
+ * lif_cube_fit(...) fits the spectrum of every pixel with
+ * gauss_fit4_nlls. The pixels are split in square tiles handed out to
+ * the threads (ParallelFor), a thread copies the spectra of its tile
+ * into one buffer (for a frame major cube, one row of every frame at a
+ * time) and fits them in raster order. With Opts.warm a pixel starts
+ * from the mean of its fitted left and upper neighbors in the tile, a
+ * few iterations from the minimum on a smooth plasma, and is refitted
+ * from a guess of its own if that fails. The first pixel of a tile
+ * starts from the peak, half width, maximum and minimum of its spectrum.
+ * Tiles only seed within themselves, so the maps do not depend on the
+ * # threads. With Opts.triage a spectrum is classified (lif_triage) as
+ * it is copied and one that cannot fit is not fitted nor used as a seed.
+ *
+ *      @param[in] C      : the cube
+ *      @param[in] Opts   : threads, tile size, mixed precision, warm starts,
+ *                          robust loss, triage
+ *      @param[out] Maps  : the parameter maps
+ *      @param[out] Stats : work done
+ *      @return int 1 if every pixel was fitted
+ *
+ */
+int lif_cube_fit(const struct LIFCube &C, const struct LIFCubeOptions &Opts,
+                 struct LIFCubeMaps &Maps, struct LIFCubeStats &Stats);
+
+/************************************************************************/
+/*
+ * lif_cube_write_maps(...) writes every map to <stem>_<name>.dat, ny
+ * lines of nx values (gnuplot "matrix"), the triage reasons too
+ *
+ *      @param[in] stem: prefix of the files
+ *      @param[in] C   : the cube
+ *      @param[in] Maps: the parameter maps
+ *      @return int success/failure
+ *
+ */
+int lif_cube_write_maps(const char *stem, const struct LIFCube &C,
+                        const struct LIFCubeMaps &Maps);
+
+#endif
@@ -0,0 +1,135 @@
+// -----------------------------------------------------------------------
+//
+//                                lif_data_reader.cpp V 0.01
+//
+//                                 (c) Brian Lynch March, 2015
+//
+// -----------------------------------------------------------------------
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <math.h>
+#include <new>
+
+#include "lif_data_reader.h"
+#include "nlls_utils/input_stream.h"
+
+/************************************************************************/
+int read_lif_data(const char *filename, std::vector<double> &lambda,
+                  std::vector<double> &counts, std::vector<double> &sigma){
+
+   struct InputStream input_file;
+   std::string line;
+
+   int Ncol = 0, // # columns found on the first data line
+       res  = 1;
+
+   lambda.clear();
+   counts.clear();
+   sigma.clear();
+
+   // Plain, gzip or zstd, decompressed ahead on the stream's own thread
+   if(!OpenInputStream(filename, input_file)){ return (0); }
+
+   while(InputStreamGetline(input_file, line)){
+
+      const char *c = line.c_str();
+      char *end = NULL;
+      double col[3] = {0.0, 0.0, 0.0};
+      int n = 0;
+
+      // Parse up to 3 numbers from the line
+      for(n = 0; n < 3; n++){
+
+         col[n] = strtod(c, &end);
+         if(end == c){ break; }
+         c = end;
+
+      }
+
+      // Blank and '#' comment lines do not parse
+      if(0 == n){ continue; }
+
+      if(0 == Ncol){ Ncol = n; }
+
+      if((n < Ncol) || (Ncol < 2)){
+
+         std::cerr << "Malformed line in file " << filename << ": ";
+         std::cerr << line << std::endl;
+         res = 0;
+         break;
+
+      }
+
+      // A nan or inf would make the fit report nan as converged
+      if(!isfinite(col[0]) || !isfinite(col[1]) || !isfinite(col[2])){
+
+         std::cerr << "Non-finite value in file " << filename << ": ";
+         std::cerr << line << std::endl;
+         res = 0;
+         break;
+
+      }
+
+      try{
+
+         lambda.push_back(col[0]);
+         counts.push_back(col[1]);
+         if(3 == Ncol){ sigma.push_back(col[2]); }
+
+      }catch(std::bad_alloc& ba){
+
+         std::cerr << "ERROR: file " << filename << " does not fit in memory: ";
+         std::cerr << ba.what() << std::endl;
+         res = 0;
+         break;
+
+      }
+
+   }
+
+   // A truncated or corrupt compressed file is an error
+   if(!CloseInputStream(input_file)){ res = 0; }
+
+   return (res);
+
+}// End function read_lif_data
+
+/************************************************************************/
+int sigma_to_weights(const double *sig, const unsigned int &Npoints,
+                                                            double **w){
+
+   *w = NULL;
+
+   if((NULL == sig) || (0 == Npoints)){ return (0); }
+
+   for(unsigned int i = 0; i < Npoints; i++){
+
+      if(!(sig[i] > 0.0)){ return (0); }
+
+   }
+
+   try{
+
+      *w = new double[Npoints];
+
+   }catch(std::bad_alloc& ba){
+
+      std::cerr << "ERROR: sigma_to_weights initialization: " << ba.what();
+      std::cerr << std::endl;
+      *w = NULL;
+      return (0);
+
+   }
+
+   for(unsigned int i = 0; i < Npoints; i++){
+
+      (*w)[i] = 1.0 / (sig[i] * sig[i]);
+
+   }
+
+   return (1);
+
+}// End function sigma_to_weights
@@ -0,0 +1,51 @@
+// -----------------------------------------------------------------------
+//
+//                                 lif_data_reader.h V 0.01
+//
+//                                (c) Brian Lynch March, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef lif_lif_data_reader_h
+#define lif_lif_data_reader_h
+
+#include <vector>
+
+/************************************************************************/
+/*
+ * read_lif_data(...) reads a whitespace separated LIF scan. Every line
+ * holds the wavelength, the counts and optionally the uncertainty
+ * (standard deviation) of the counts:
+ *
+ *      lambda [nm]   counts []   [sigma []]
+ *
+ * The number of columns is taken from the first data line. Blank lines
+ * and lines starting with '#' are skipped.
+ *
+ *      @param[in] filename : input file name
+ *      @param[out] lambda  : wavelengths
+ *      @param[out] counts  : counts
+ *      @param[out] sigma   : count uncertainties (empty for 2 columns)
+ *      @return int success/failure
+ *
+ */
+int read_lif_data(const char *filename, std::vector<double> &lambda,
+                  std::vector<double> &counts, std::vector<double> &sigma);
+
+/************************************************************************/
+/*
+ * sigma_to_weights(...) converts Npoints uncertainties into new[]
+ * allocated least squares weights w = 1 / sigma^2. If any sigma is not
+ * positive no weights are returned (*w = NULL) so the fit falls back to
+ * equal weights.
+ *
+ *      @param[in] sig     : uncertainties
+ *      @param[in] Npoints : length of sig
+ *      @param[out] w      : weights
+ *      @return int 1 if weights were produced, 0 otherwise
+ *
+ */
+int sigma_to_weights(const double *sig, const unsigned int &Npoints,
+                                                            double **w);
+
+#endif
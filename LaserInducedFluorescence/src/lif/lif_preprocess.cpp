@@ -0,0 +1,289 @@
+// -----------------------------------------------------------------------
+//
+//                                 lif_preprocess.cpp V 0.01
+//
+//                                 (c) Brian Lynch March, 2015
+//
+// -----------------------------------------------------------------------
+
+#include <math.h>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <new>
+
+#include "lif_preprocess.h"
+#include "nlls_utils/nlls_solver.h"
+
+/************************************************************************/
+int lif_bin_init(struct LIFBinGrid &grid, const double &lo, const double &hi,
+                                                  const unsigned int &Nbins){
+
+   grid.x_lo  = lo;
+   grid.dx    = (hi - lo) / Nbins;
+   grid.Nbins = Nbins;
+   grid.n     = NULL;
+   grid.xm    = NULL;
+   grid.ym    = NULL;
+   grid.M2    = NULL;
+
+   if((0 == Nbins) || !(hi > lo)){
+
+      std::cerr << "ERROR: lif_bin_init needs Nbins > 0 and hi > lo";
+      std::cerr << std::endl;
+      return (0);
+
+   }
+
+   try{
+
+      grid.n  = new unsigned int[Nbins](),
+      grid.xm = new double[Nbins](),
+      grid.ym = new double[Nbins](),
+      grid.M2 = new double[Nbins]();
+
+   }catch(std::bad_alloc& ba){
+
+      std::cerr << "ERROR: lif_bin_init initialization: " << ba.what();
+      std::cerr << std::endl;
+      lif_bin_free(grid);
+      return (0);
+
+   }
+
+   return (1);
+
+}// End function lif_bin_init
+
+/************************************************************************/
+void lif_bin_add(struct LIFBinGrid &grid, const double &x, const double &fx){
+
+   double u = (x - grid.x_lo) / grid.dx,
+          d = 0.0;
+
+   // The last bin is closed so that x = hi is kept
+   if((u < 0.0) || (u > grid.Nbins)){ return; }
+
+   unsigned int k = std::min((unsigned int)u, grid.Nbins - 1);
+
+   // Welford update of the running mean and squared deviations
+   grid.n[k]  += 1;
+   grid.xm[k] += (x - grid.xm[k]) / grid.n[k];
+   d           = fx - grid.ym[k];
+   grid.ym[k] += d / grid.n[k];
+   grid.M2[k] += d * (fx - grid.ym[k]);
+
+}// End function lif_bin_add
+
+/************************************************************************/
+int lif_bin_finish(const struct LIFBinGrid &grid, double **x, double **fx,
+                                     double **sig, unsigned int &Npoints){
+
+   // A variance from a handful of samples is too noisy to weight with,
+   // so every bin variance is shrunk towards the pooled variance as if
+   // the pooled estimate contributed NU0 extra degrees of freedom
+   const double NU0 = 4.0;
+
+   unsigned int Nb   = 0,  // # non-empty bins
+                dof  = 0;  // Degrees of freedom of the pooled variance
+
+   double pooled = 0.0;    // Within bin variance pooled over all bins
+
+   for(unsigned int k = 0; k < grid.Nbins; k++){
+
+      if(grid.n[k] > 0){ ++Nb; }
+      if(grid.n[k] > 1){ pooled += grid.M2[k]; dof += grid.n[k] - 1; }
+
+   }
+
+   pooled = (dof > 0) ? pooled / dof : 0.0;
+
+   *x = *fx = *sig = NULL;
+   Npoints = 0;
+
+   try{
+
+      *x   = new double[Nb],
+      *fx  = new double[Nb],
+      *sig = new double[Nb];
+
+   }catch(std::bad_alloc& ba){
+
+      std::cerr << "ERROR: lif_bin_finish initialization: " << ba.what();
+      std::cerr << std::endl;
+      delete[] *x;
+      delete[] *fx;
+      delete[] *sig;
+      *x = *fx = *sig = NULL;
+      return (0);
+
+   }
+
+   for(unsigned int k = 0; k < grid.Nbins; k++){
+
+      if(0 == grid.n[k]){ continue; }
+
+      (*x)[Npoints]   = grid.xm[k];
+      (*fx)[Npoints]  = grid.ym[k];
+      (*sig)[Npoints] = sqrt((grid.M2[k] + NU0 * pooled) /
+                             (grid.n[k] - 1 + NU0) / grid.n[k]);
+      ++Npoints;
+
+   }
+
+   return (1);
+
+}// End function lif_bin_finish
+
+/************************************************************************/
+void lif_bin_free(struct LIFBinGrid &grid){
+
+   delete[] grid.n;
+   delete[] grid.xm;
+   delete[] grid.ym;
+   delete[] grid.M2;
+   grid.n  = NULL;
+   grid.xm = grid.ym = grid.M2 = NULL;
+
+}// End function lif_bin_free
+
+/************************************************************************/
+int lif_fold_scan(double **x, double **fx, double **sig,
+                                            const unsigned int &Npoints){
+
+   if(Npoints < 2){ return (1); }
+
+   // (wavelength, original index) so that fx and sig can follow along
+   std::vector<std::pair<double, unsigned int> > pts(Npoints);
+   std::vector<unsigned int> edges; // Start index of every sweep
+   std::vector<double> tmp(Npoints);
+
+   for(unsigned int i = 0; i < Npoints; i++){
+
+      pts[i] = std::make_pair((*x)[i], i);
+
+   }
+
+   // Split into monotonic sweeps and make every sweep ascending
+   unsigned int start = 0;
+   int dir = 0;
+   for(unsigned int i = 1; i <= Npoints; i++){
+
+      int d = (i < Npoints) ? ((pts[i].first > pts[i-1].first) -
+                               (pts[i].first < pts[i-1].first)) : 0;
+
+      if((i == Npoints) || (d != 0 && dir != 0 && d != dir)){
+
+         if(dir < 0){ std::reverse(pts.begin() + start, pts.begin() + i); }
+         edges.push_back(start);
+         start = i;
+         dir = 0;
+
+      }else if(d != 0){
+
+         dir = d;
+
+      }
+
+   }
+   edges.push_back(Npoints);
+
+   // Merge neighbouring sweeps until only one is left
+   while(edges.size() > 2){
+
+      std::vector<unsigned int> merged;
+      for(unsigned int k = 0; k + 2 < edges.size(); k += 2){
+
+         std::inplace_merge(pts.begin() + edges[k], pts.begin() + edges[k+1],
+                                                    pts.begin() + edges[k+2]);
+         merged.push_back(edges[k]);
+
+      }
+      if(0 == (edges.size() % 2)){ merged.push_back(edges[edges.size()-2]); }
+      merged.push_back(Npoints);
+      edges.swap(merged);
+
+   }
+
+   for(unsigned int i = 0; i < Npoints; i++){ (*x)[i] = pts[i].first; }
+
+   for(unsigned int i = 0; i < Npoints; i++){ tmp[i] = (*fx)[pts[i].second]; }
+   std::copy(tmp.begin(), tmp.end(), *fx);
+
+   if((NULL != sig) && (NULL != *sig)){
+
+      for(unsigned int i = 0; i < Npoints; i++){ tmp[i] = (*sig)[pts[i].second]; }
+      std::copy(tmp.begin(), tmp.end(), *sig);
+
+   }
+
+   return (1);
+
+}// End function lif_fold_scan
+
+/************************************************************************/
+int lif_window(double **x, double **fx, double **sig, unsigned int &Npoints,
+                               const double &Nsig, const unsigned int &Nmin){
+
+   if(0 == Npoints){ return (0); }
+
+   unsigned int ipk = 0, // Index of the peak
+                il  = 0, // Index of the left half max crossing
+                ir  = 0, // Index of the right half max crossing
+                Nw  = 0; // # samples kept
+
+   double lo = (*fx)[0], // Background estimate (minimum)
+          half = 0.0,    // Half maximum above background
+          sd   = 0.0;    // Standard deviation estimate
+
+   for(unsigned int i = 1; i < Npoints; i++){
+
+      if((*fx)[i] > (*fx)[ipk]){ ipk = i; }
+      lo = std::min(lo, (*fx)[i]);
+
+   }
+
+   half = 0.5 * ((*fx)[ipk] + lo);
+   for(il = ipk; (il > 0) && ((*fx)[il] > half); il--){}
+   for(ir = ipk; (ir + 1 < Npoints) && ((*fx)[ir] > half); ir++){}
+
+   // FWHM = 2 sqrt(2 ln 2) sigma
+   sd = ((*x)[ir] - (*x)[il]) / 2.3548;
+   if(!(sd > 0.0)){ return (1); }
+
+   for(unsigned int i = 0; i < Npoints; i++){
+
+      if(fabs((*x)[i] - (*x)[ipk]) <= Nsig * sd){ ++Nw; }
+
+   }
+
+   if(Nw < Nmin){ return (1); }
+
+   Nw = 0;
+   for(unsigned int i = 0; i < Npoints; i++){
+
+      if(fabs((*x)[i] - (*x)[ipk]) > Nsig * sd){ continue; }
+
+      (*x)[Nw]  = (*x)[i];
+      (*fx)[Nw] = (*fx)[i];
+      if((NULL != sig) && (NULL != *sig)){ (*sig)[Nw] = (*sig)[i]; }
+      ++Nw;
+
+   }
+
+   Npoints = Nw;
+
+   return (1);
+
+}// End function lif_window
+
+/************************************************************************/
+int lif_triage(const double *la, const double *ca, const unsigned int &Npoints,
+               const double &full_lo, const double &full_hi, struct TriageStats &T){
+
+   const struct TriageOptions Opts = {8, TriageSatFrac, TriageSNRMin,
+                                      TRIAGE_COVER_PEAK, full_lo, full_hi};
+
+   return (Triage(ArraySamples(la, ca, NULL), Npoints, Opts, T));
+
+}// End function lif_triage
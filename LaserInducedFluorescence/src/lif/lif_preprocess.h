@@ -0,0 +1,148 @@
+// -----------------------------------------------------------------------
+//
+//                                  lif_preprocess.h V 0.01
+//
+//                                (c) Brian Lynch March, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef lif_lif_preprocess_h
+#define lif_lif_preprocess_h
+
+#include "nlls_utils/triage.h"
+
+/************************************************************************/
+/*
+ * Streaming accumulator that bins (wavelength, counts) samples onto a
+ * uniform wavelength grid. Each bin keeps a running (Welford) mean and
+ * sum of squared deviations, so samples can be added one at a time in
+ * any order. Forward and backward sweeps of a scan therefore fold onto
+ * the same grid without sorting.
+ *
+ */
+struct LIFBinGrid{
+
+   double        x_lo ; // Lower edge of the first bin    [nm]
+   double        dx   ; // Bin width                      [nm]
+   unsigned int  Nbins; // Number of bins
+   unsigned int *n    ; // Samples per bin
+   double       *xm   ; // Running mean wavelength per bin [nm]
+   double       *ym   ; // Running mean counts per bin     []
+   double       *M2   ; // Running sum of squared count deviations
+
+};
+
+/************************************************************************/
+/*
+ * lif_bin_init(...) allocates an empty grid of Nbins bins on [lo, hi]
+ *
+ *      @param[out] grid : bin grid
+ *      @param[in] lo    : lowest wavelength on the grid
+ *      @param[in] hi    : highest wavelength on the grid
+ *      @param[in] Nbins : number of bins
+ *      @return int success/failure
+ *
+ */
+int lif_bin_init(struct LIFBinGrid &grid, const double &lo, const double &hi,
+                                                  const unsigned int &Nbins);
+
+/************************************************************************/
+/*
+ * lif_bin_add(...) adds one sample to the grid. Samples outside of the
+ * grid are ignored.
+ *
+ *      @param[in/out] grid : bin grid
+ *      @param[in] x        : wavelength
+ *      @param[in] fx       : counts
+ *
+ */
+void lif_bin_add(struct LIFBinGrid &grid, const double &x, const double &fx);
+
+/************************************************************************/
+/*
+ * lif_bin_finish(...) copies the non-empty bins into new[] allocated
+ * arrays of bin mean wavelength, mean counts and the standard error of
+ * the mean counts. Each bin variance is shrunk towards the variance
+ * pooled over all bins, so bins holding only one or two samples still
+ * get a sensible uncertainty. The caller owns (delete[]) the output
+ * arrays.
+ *
+ *      @param[in] grid      : bin grid
+ *      @param[out] x        : bin mean wavelengths
+ *      @param[out] fx       : bin mean counts
+ *      @param[out] sig      : standard error of the bin mean counts
+ *      @param[out] Npoints  : number of non-empty bins
+ *      @return int success/failure
+ *
+ */
+int lif_bin_finish(const struct LIFBinGrid &grid, double **x, double **fx,
+                                     double **sig, unsigned int &Npoints);
+
+/************************************************************************/
+/*
+ * lif_bin_free(...) releases the grid storage
+ *
+ *      @param[in/out] grid : bin grid
+ *
+ */
+void lif_bin_free(struct LIFBinGrid &grid);
+
+/************************************************************************/
+/*
+ * lif_fold_scan(...) sorts a back and forth wavelength scan in place.
+ * The scan is split into monotonic sweeps, descending sweeps are
+ * reversed and the sweeps are merged pairwise, O(N log(# sweeps)).
+ *
+ *      @param[in/out] x  : wavelengths
+ *      @param[in/out] fx : counts
+ *      @param[in/out] sig: count uncertainties (may be NULL)
+ *      @param[in] Npoints: length of input arrays
+ *      @return int success/failure
+ *
+ */
+int lif_fold_scan(double **x, double **fx, double **sig,
+                                            const unsigned int &Npoints);
+
+/************************************************************************/
+/*
+ * lif_window(...) keeps only the sorted samples within +/- Nsig
+ * standard deviations of the peak. The peak position and width are
+ * estimated from the maximum and the half maximum crossings. The arrays
+ * are compacted in place. If fewer than Nmin samples would remain, the
+ * data are left untouched.
+ *
+ *      @param[in/out] x      : sorted wavelengths
+ *      @param[in/out] fx     : counts
+ *      @param[in/out] sig    : count uncertainties (may be NULL)
+ *      @param[in/out] Npoints: length of the arrays
+ *      @param[in] Nsig       : half width of the window in std deviations
+ *      @param[in] Nmin       : minimum # samples to keep
+ *      @return int success/failure
+ *
+ */
+int lif_window(double **x, double **fx, double **sig, unsigned int &Npoints,
+                               const double &Nsig, const unsigned int &Nmin);
+
+/************************************************************************/
+/*
+ * lif_triage(...) classifies a scan as read, before any preprocessing
+ * and fit (see nlls_utils/triage.h): at least 2 samples per parameter of
+ * the single Gaussian, finite, not flat nor clipped, the line inside the
+ * scan (below half its peak on both sides) and above the noise. Counts
+ * on or beyond the full scale of the digitizer, if known, are clipped.
+ *
+ *      @param[in] la      : wavelengths
+ *      @param[in] ca      : counts
+ *      @param[in] Npoints : # samples
+ *      @param[in] full_lo : smallest count the digitizer records
+ *                           (-HUGE_VAL = not known)
+ *      @param[in] full_hi : largest count the digitizer records
+ *                           (HUGE_VAL = not known)
+ *      @param[out] T      : what was found, T.reason
+ *      @return int 1 if the scan is to be fitted
+ *
+ */
+int lif_triage(const double *la, const double *ca, const unsigned int &Npoints,
+               const double &full_lo, const double &full_hi, struct TriageStats &T);
+
+#endif
@@ -0,0 +1,206 @@
+// -----------------------------------------------------------------------
+//
+//                                voigt_fit5_nlls.cpp V 0.01
+//
+//                                 (c) Brian Lynch March, 2015
+//
+// -----------------------------------------------------------------------
+
+#include <math.h>
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+
+#include "voigt_fit5_nlls.h"
+#include "lif_analysis.h"
+#include "voigt_model.h"
+#include "gaussian_model.h"
+#include "nlls_utils/nlls_solver.h"
+
+/************************************************************************/
+/*
+ * Weighted sum of squared residuals of the Voigt model at p, NaN if p
+ * is outside the model domain (sigma2 <= 0).
+ */
+static double voigt_chi2(const double *x, const double *fx, const double *w,
+                         const unsigned int &Npoints, const double *p){
+
+   double grad[VoigtModel::Npar],
+          chi2 = 0.0,
+          rt   = 0.0;
+
+   if(!(p[1] > 0.0)){ return (NAN); }
+
+   for(unsigned int i = 0; i < Npoints; i++){
+
+      rt    = fx[i] - VoigtModel::EvalGrad(x[i], p, grad);
+      chi2 += ((NULL == w) ? 1.0 : w[i]) * rt * rt;
+
+   }
+
+   return (chi2);
+
+}
+
+/************************************************************************/
+/*
+ * 5 parameter weighted nonlinear least squares fitting, NLLSFit(...)
+ * specialized to the Voigt model. The Lorentzian width is often poorly
+ * constrained, so every Gauss-Newton step is projected onto gamma >= 0
+ * and halved (up to MAXHALF times) until chi^2 does not increase and
+ * sigma2 stays positive. The Gaussian fit (gamma = 0) is tried last,
+ * so data without a measurable Lorentzian width give the Gaussian fit.
+ */
+int voigt_fit5_nlls(double **x, double **fx, double **w,
+                    const unsigned int &Npoints, const unsigned int &Ntries,
+                      const double &TOL, struct VoigtFit5Params &FitParams){
+//std::cout << "BEGIN voigt_fit5_nlls" << std::endl;
+
+   const int MAXHALF = 20; // Maximum # step halvings
+
+   int res  = 0;
+
+   unsigned int it   = 0,
+                Npar = VoigtModel::Npar; //# fit parameters [5]
+
+   int stop = NLLS_STOP_MAXITER; // Why the fit stopped
+
+   double param[VoigtModel::Npar] = {FitParams.x0, FitParams.sigma2,
+                                     FitParams.gamma, FitParams.Ao,
+                                     FitParams.Bo},
+          trial[VoigtModel::Npar],  // Full Gauss-Newton step from param
+          ptry[VoigtModel::Npar],   // Projected and halved step
+          chi2    = 0.0,  // chi^2 at param
+          chi2t   = 0.0,  // chi^2 at the (halved) step
+          lambda  = 1.0,  // Step length
+          dparam2 = 1.0,  // Squared norm of the last parameter step
+          step    = 0.0;  // Largest full step in standard errors
+
+   struct NLLSStats Stats;
+
+   // Weights, w or *w may be NULL for an unweighted fit
+   const double *wp = (NULL == w) ? NULL : *w;
+
+   chi2 = voigt_chi2(*x, *fx, wp, Npoints, param);
+   if(!std::isfinite(chi2)){
+
+      std::cerr << "ERROR: voigt_fit5_nlls initial guess outside the model";
+      std::cerr << std::endl;
+      return (0);
+
+   }
+
+   while((it < Ntries) && (NLLS_STOP_MAXITER == stop)){
+
+      // One Gauss-Newton step, Stats and cov are those at param
+      for(unsigned int i = 0; i < Npar; i++){ trial[i] = param[i]; }
+      if(!NLLSFit<VoigtModel>(*x, *fx, wp, Npoints, 1, -1.0, trial,
+                              FitParams.Stats.cov, Stats)){ return (0); }
+      ++it;
+
+      for(unsigned int i = 0; i < Npar; i++){ trial[i] -= param[i]; }
+
+      for(lambda = 1.0; lambda > ldexp(1.0, -MAXHALF); lambda *= 0.5){
+
+         for(unsigned int i = 0; i < Npar; i++){ ptry[i] = param[i] + lambda * trial[i]; }
+         ptry[2] = std::max(ptry[2], 0.0);
+
+         chi2t = voigt_chi2(*x, *fx, wp, Npoints, ptry);
+         if(chi2t <= chi2){ break; }
+
+      }
+
+      // No step decreases chi^2, param is converged as far as it goes
+      if(!(chi2t <= chi2)){ dparam2 = 0.0; stop = NLLS_STOP_RESIDUAL; break; }
+
+      // Convergence is judged on the full (projected) step, a halved
+      // step is small without the fit being converged
+      dparam2 = 0.0;
+      for(unsigned int i = 0; i < Npar; i++){
+
+         double dp = (2 == i) ? std::max(param[i] + trial[i], 0.0) - param[i]
+                              : trial[i];
+
+         dparam2 += dp * dp;
+         param[i] = ptry[i];
+
+      }
+
+      // The full step in standard errors and the decrease of chi^2, as
+      // NLLSStopTest judges them
+      step = Stats.step;
+      if(step <= sqrt(TOL)){
+
+         stop = NLLS_STOP_STEP;
+
+      }else if(chi2 - chi2t <= TOL * chi2t){
+
+         stop = NLLS_STOP_RESIDUAL;
+
+      }
+      chi2 = chi2t;
+
+   }
+
+   // On the boundary gamma = 0 the Voigt profile is the Gaussian. The
+   // projected steps approach it slowly, so the Gaussian fit is tried
+   // and kept if it is better, with the statistics (including the error
+   // of gamma) taken there
+   {
+
+      double pg[GaussianModel::Npar] = {param[0], param[1], param[3], param[4]},
+             covg[GaussianModel::Npar * GaussianModel::Npar];
+      struct NLLSStats StatsG;
+
+      if(NLLSFit<GaussianModel>(*x, *fx, wp, Npoints, Ntries, TOL, pg, covg,
+                                                                 StatsG)){
+
+         trial[0] = pg[0];
+         trial[1] = pg[1];
+         trial[2] = 0.0;
+         trial[3] = pg[2];
+         trial[4] = pg[3];
+
+         if(voigt_chi2(*x, *fx, wp, Npoints, trial) <= chi2){
+
+            for(unsigned int i = 0; i < Npar; i++){ param[i] = trial[i]; }
+            NLLSFit<VoigtModel>(*x, *fx, wp, Npoints, 1, -1.0, trial,
+                                FitParams.Stats.cov, Stats);
+            it     += StatsG.Niter;
+            dparam2 = StatsG.dparam2;
+            step    = StatsG.step;
+            stop    = StatsG.stop;
+
+         }
+
+      }
+
+   }
+
+   res = 1;
+   for(unsigned int i = 0; i < Npar; i++){ res &= (int)std::isfinite(param[i]); }
+   if(!res){ return (res); }
+
+   // Store the results, the profile only depends on |gamma|
+   FitParams.x0     = param[0];
+   FitParams.sigma2 = param[1];
+   FitParams.gamma  = fabs(param[2]);
+   FitParams.Ao     = param[3];
+   FitParams.Bo     = param[4];
+
+   FitParams.Stats.chi2     = Stats.chi2;
+   FitParams.Stats.chi2_red = Stats.chi2_red;
+   FitParams.Stats.R2       = Stats.R2;
+   FitParams.Stats.dparam2  = dparam2;
+   FitParams.Stats.step     = step;
+   FitParams.Stats.stop     = stop;
+   FitParams.Stats.Niter    = it;
+   for(unsigned int i = 0; i < Npar; i++){
+
+      FitParams.Stats.err[i] = sqrt(fabs(FitParams.Stats.cov[i * Npar + i]));
+
+   }
+
+//std::cout << "END voigt_fit5_nlls" << std::endl;
+return (res);
+}// End function voigt_fit5_nlls
@@ -0,0 +1,55 @@
+// -----------------------------------------------------------------------
+//
+//                                  voigt_fit5_nlls.h V 0.01
+//
+//                                (c) Brian Lynch March, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef lif_voigt_fit5_nlls_h
+#define lif_voigt_fit5_nlls_h
+
+#include "lif_analysis.h"
+#include "voigt_model.h"
+
+/************************************************************************/
+/*
+ * voigt_fit5_nlls(...) performs a 5 parameter weighted nonlinear least
+ * squares fit of the Voigt profile (VoigtModel). The Gaussian fit is a
+ * good initial guess, with gamma a small fraction of sqrt(sigma2). The
+ * returned gamma is >= 0.
+ *
+ *      @param[in] x            : input array of wavelengths
+ *      @param[in] fx           : input array of # counts
+ *      @param[in] w            : input array of weights (NULL = 1)
+ *      @param[in] Npoints      : length of input arrays
+ *      @param[in] Ntries       : maximum # attempts to curve fit
+ *      @param[in] TOL          : convergence tolerance
+ *      @param[in/out] Fitparams: input guess / output final fit paramters
+ *      @return int success/failure
+ *
+ */
+int voigt_fit5_nlls(double **x, double **fx, double **w,
+                    const unsigned int &Npoints, const unsigned int &Ntries,
+                      const double &TOL, struct VoigtFit5Params &FitParams);
+
+/************************************************************************/
+/*
+ * The Voigt profile A * Re w(z) + B, see voigt_model.h
+ *
+ *      @param[in] x         : independent variable
+ *      @param[in] FitParams : fitted parameters
+ *      @return Vxa
+ *
+ */
+inline double Vxa(const double &x, const struct VoigtFit5Params &FitParams){
+
+   double p[VoigtModel::Npar] = {FitParams.x0, FitParams.sigma2,
+                                 FitParams.gamma, FitParams.Ao, FitParams.Bo},
+          grad[VoigtModel::Npar];
+
+   return (VoigtModel::EvalGrad(x, p, grad));
+
+}
+
+#endif
@@ -0,0 +1,127 @@
+// -----------------------------------------------------------------------
+//
+//                                    voigt_model.h V 0.01
+//
+//                                (c) Brian Lynch March, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef lif_voigt_model_h
+#define lif_voigt_model_h
+
+#include <math.h>
+#include <cmath>
+
+#include "faddeeva.h"
+#include "nlls_utils/dual.h"
+
+/************************************************************************/
+/*
+ * The LIF line with a Lorentzian (natural, pressure or laser) width as
+ * a fit model (see nlls_utils/nlls_solver.h), the Voigt profile with
+ * parameters p = (xo, sig2, gam, A, B):
+ *
+ *      F(x)       = A * Re w(z) + B,   z = (x - xo + i gam) / s,
+ *                                      s = sqrt(2 sig2)
+ *
+ * w is the Faddeeva function (faddeeva.h) and gam the Lorentzian half
+ * width at half maximum. For gam = 0, Re w(z) = exp(-0.5 (x - xo)^2 /
+ * sig2) and F is GaussianModel, so sig2 and A keep their meaning. With
+ * w'(z) = -2 z w(z) + 2 i / sqrt(pi) the derivatives are
+ *
+ *      dF/d(xo)   = - A * Re w'(z) / s
+ *      dF/d(sig2) = - A * Re(z w'(z)) / s^2
+ *      dF/d(gam)  = - A * Im w'(z) / s
+ *      dF/d(A)    = Re w(z)
+ *      dF/d(B)    = 1
+ *
+ * The profile only depends on |gam|, a negative gam is folded back.
+ */
+struct VoigtModel{
+
+   enum{ Npar = 5 };
+
+   static const char *Name(const unsigned int &k){
+
+      static const char *names[Npar] = {"Rest Wavelength", "Sigma^2",
+                                        "Lorentz HWHM", "Amplitude",
+                                        "Background"};
+      return (names[k]);
+
+   }
+
+   static const char *Unit(const unsigned int &k){
+
+      static const char *units[Npar] = {"nm", "nm^2", "nm", "", ""};
+      return (units[k]);
+
+   }
+
+   /*
+    *      @param[in] T x   : independent variable
+    *      @param[in] T *p  : (xo, sig2, gam, A, B)
+    *      @param[out] T *grad: dF/d(xo), dF/d(sig2), dF/d(gam), dF/d(A),
+    *                           dF/d(B)
+    *      @return T: F(x)
+    */
+   template<class T>
+   static inline T EvalGrad(const T &x, const T *p, T *grad){
+
+      const T sg = (p[2] < T(0.0)) ? T(-1.0) : T(1.0),
+              is = T(1.0) / sqrt(T(2.0) * p[1]),
+              zr = (x - p[0]) * is,
+              zi = sg * p[2] * is;
+
+      T u, v;
+
+      Faddeeva(zr, zi, u, v);
+
+      // w'(z)
+      const T dr = T(-2.0) * (zr * u - zi * v),
+              di = T(-2.0) * (zr * v + zi * u) + T(M_2_SQRTPI);
+
+      grad[0] = -p[3] * dr * is;
+      grad[1] = -p[3] * (zr * dr - zi * di) * is * is;
+      grad[2] = -sg * p[3] * di * is;
+      grad[3] = u;
+      grad[4] = T(1.0);
+
+      return (p[3] * u + p[4]);
+
+   }
+
+};
+
+/************************************************************************/
+/*
+ * The same profile written only as an expression, for gam >= 0. The
+ * ADModel version differentiates the N = 32 approximation of w itself,
+ * so comparing VoigtModelAD with VoigtModel checks the analytic
+ * derivatives and how well the approximation obeys w' = -2 z w + 2 i /
+ * sqrt(pi) (see LIFBenchmark).
+ */
+struct VoigtExpr{
+
+   enum{ Npar = VoigtModel::Npar };
+
+   static const char *Name(const unsigned int &k){ return (VoigtModel::Name(k)); }
+
+   static const char *Unit(const unsigned int &k){ return (VoigtModel::Unit(k)); }
+
+   template<class X, class P>
+   static inline P Eval(const X &x, const P *p){
+
+      P is = X(1.0) / sqrt(X(2.0) * p[1]),
+        u, v;
+
+      Faddeeva(P((x - p[0]) * is), P(p[2] * is), u, v);
+
+      return (p[3] * u + p[4]);
+
+   }
+
+};
+
+typedef ADModel<VoigtExpr> VoigtModelAD;
+
+#endif
@@ -0,0 +1,913 @@
+// -----------------------------------------------------------------------
+//
+//                                   lif_tests.cpp V 0.01
+//
+//                                 (c) Brian Lynch March, 2015
+//
+// -----------------------------------------------------------------------
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <getopt.h>
+
+#include "lif/lif_analysis.h"
+#include "lif/gaussian_fit4_nlls.h"
+#include "lif/lif_data_reader.h"
+#include "lif/lif_cube.h"
+#include "lif/lif_preprocess.h"
+#include "nlls_utils/bootstrap.h"
+#include "nlls_utils/input_stream.h"
+
+/*
+ * Every allocation of the process, LAPACK's and the standard library's
+ * included, goes through these, so a case can count what one fit
+ * allocates. glibc exports the allocator under __libc_*.
+ */
+extern "C" void *__libc_malloc(size_t n);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *p, size_t n);
+extern "C" void __libc_free(void *p);
+
+static std::atomic<unsigned long> Nalloc(0); // # allocations
+static std::atomic<unsigned long> Nbytes(0); // # bytes allocated
+
+extern "C" void *malloc(size_t n){ Nalloc++; Nbytes += n; return (__libc_malloc(n)); }
+
+extern "C" void *calloc(size_t n, size_t size){
+
+   Nalloc++;
+   Nbytes += n * size;
+   return (__libc_calloc(n, size));
+
+}
+
+extern "C" void *realloc(void *p, size_t n){ Nalloc++; Nbytes += n; return (__libc_realloc(p, n)); }
+
+extern "C" void free(void *p){ __libc_free(p); }
+
+static const int    Max = 100;    // Maximum number of iterations while fitting
+static const double Tol = 1.0E-8; // Tolerance for convergence of the curve fit
+
+// The synthetic scans: Ao exp(-(lambda - x0)^2 / 2 sigma2) + Bo over
+// x0 +/- half_width
+static const double x0_true     = 668.6138; // Rest wavelength [nm]
+static const double sigma2_true = 5.0E-7;   // Sigma^2         [nm^2]
+static const double Ao_true     = 4.0;      // Amplitude       []
+static const double Bo_true     = 0.5;      // Background      []
+static const double half_width  = 0.005;    // Scan +/- half_width [nm]
+
+/*
+ * A golden value: the value with its relative tolerance, or a budget
+ * the value must not exceed
+ */
+struct golden_value{
+
+   double value;
+   double rtol;
+   int    budget; // 1: value is an upper bound
+
+};
+
+typedef std::map<std::string, struct golden_value> golden_case;
+
+/*
+ * The quantities a case computes, in order
+ */
+typedef std::vector<std::pair<std::string, double> > case_values;
+
+/************************************************************************/
+/*
+ * Reads the golden file, lines of
+ *      <case> <quantity> <value> <rtol>
+ *      <case> <quantity> <= <budget>
+ */
+static int read_golden(const char *filename, std::map<std::string, golden_case> &G){
+
+   std::ifstream in(filename);
+   std::string line;
+
+   if(!in.is_open()){
+
+      std::cerr << "Error opening file:" << filename << std::endl;
+      return (0);
+
+   }
+
+   while(std::getline(in, line)){
+
+      std::istringstream s(line);
+      std::string name, quantity, a, b;
+      struct golden_value v = {0.0, 0.0, 0};
+
+      if(line.empty() || ('#' == line[0])){ continue; }
+
+      if(!(s >> name >> quantity >> a >> b)){
+
+         std::cerr << "ERROR: bad golden line: " << line << std::endl;
+         return (0);
+
+      }
+
+      v.budget = ("<=" == a);
+      v.value  = atof(v.budget ? b.c_str() : a.c_str());
+      v.rtol   = v.budget ? 0.0 : atof(b.c_str());
+      G[name][quantity] = v;
+
+   }
+
+   return (1);
+
+}
+
+/************************************************************************/
+/*
+ * Gaussian noise from SplitMix64 (Box-Muller), the same on every host
+ */
+static double gauss_noise(uint64_t &state){
+
+   const double u1 = ldexp((double)(SplitMix64(state) >> 11) + 0.5, -53),
+                u2 = ldexp((double)(SplitMix64(state) >> 11), -53);
+
+   return (sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2));
+
+}
+
+/*
+ * Poisson counts of mean m from SplitMix64 (Knuth), the same on every
+ * host
+ */
+static double poisson_counts(const double &m, uint64_t &state){
+
+   const double L = exp(-m);
+   double p = 1.0;
+   unsigned int k = 0;
+
+   while((p *= ldexp((double)(SplitMix64(state) >> 11), -53)) > L){ k++; }
+
+   return ((double)k);
+
+}
+
+/*
+ * Synthetic scan of Npoi wavelengths with Gaussian noise of rel * Ao_true,
+ * sigma (if not NULL) is the noise of every sample, which grows from
+ * rel / 2 in the wings to 2 rel on the peak. Every spike-th sample gets
+ * a cosmic of +3 Ao_true (spike = 0: none).
+ */
+static void synthetic_scan(const unsigned int &Npoi, const double &rel,
+                           const unsigned int &spike, uint64_t seed,
+                           std::vector<double> &lambda, std::vector<double> &counts,
+                           std::vector<double> *sigma){
+
+   lambda.resize(Npoi);
+   counts.resize(Npoi);
+   if(NULL != sigma){ sigma->resize(Npoi); }
+
+   for(unsigned int i = 0; i < Npoi; i++){
+
+      double s = rel * Ao_true,
+             f = 0.0;
+
+      lambda[i] = x0_true + half_width * (2.0 * i / (Npoi - 1) - 1.0);
+      f = Fxa(lambda[i], x0_true, sigma2_true, Ao_true, Bo_true);
+      if(NULL != sigma){
+
+         s *= 0.5 + 1.5 * (f - Bo_true) / Ao_true;
+         (*sigma)[i] = s;
+
+      }
+      counts[i] = f + s * gauss_noise(seed);
+      if((spike > 0) && (spike / 2 == i % spike)){ counts[i] += 3.0 * Ao_true; }
+
+   }
+
+}
+
+/*
+ * Unweighted (sigma empty) or weighted fit of a scan, as LIFAnalysis
+ * runs it
+ */
+static int fit_scan(std::vector<double> &lambda, std::vector<double> &counts,
+                    const std::vector<double> &sigma, const int &mixed,
+                    struct GaussFit4Params &P){
+
+   double *la = &lambda[0],
+          *ca = &counts[0],
+          *wa = NULL;
+   int ok = 0;
+
+   if(!sigma.empty()){ sigma_to_weights(&sigma[0], sigma.size(), &wa); }
+
+   ok = mixed ? gauss_fit4_nlls_mixed(&la, &ca, &wa, lambda.size(), Max, Tol, P)
+              : gauss_fit4_nlls(&la, &ca, &wa, lambda.size(), Max, Tol, P);
+
+   delete[] wa;
+
+   return (ok);
+
+}
+
+/************************************************************************/
+/*
+ * Runs one fit Nrep times from the same guess. The values are those of
+ * the first fit, time_ms the fastest fit (the least disturbed by the
+ * rest of the machine) and allocs / kbytes what the first fit allocated.
+ */
+template<class Fit>
+static int timed_fit(Fit fit, const unsigned int &Nrep, struct GaussFit4Params &P,
+                     case_values &values){
+
+   const struct GaussFit4Params Guess = P;
+
+   double t_min = 1.0E30;
+   unsigned long Na = 0,
+                 Nb = 0;
+
+   for(unsigned int r = 0; r < Nrep; r++){
+
+      struct GaussFit4Params Q = Guess;
+      unsigned long a0 = Nalloc, b0 = Nbytes;
+      std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+      if(!fit(Q)){ std::cerr << "ERROR: fit failed" << std::endl; return (0); }
+
+      t_min = std::min(t_min, std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - t0).count());
+      if(0 == r){ P = Q; Na = Nalloc - a0; Nb = Nbytes - b0; }
+
+   }
+
+   values.push_back(std::make_pair("x0", P.x0));
+   values.push_back(std::make_pair("sigma2", P.sigma2));
+   values.push_back(std::make_pair("Ao", P.Ao));
+   values.push_back(std::make_pair("Bo", P.Bo));
+   values.push_back(std::make_pair("chi2_red", P.Stats.chi2_red));
+   values.push_back(std::make_pair("Niter", (double)P.Stats.Niter));
+   values.push_back(std::make_pair("time_ms", 1.0E3 * t_min));
+   values.push_back(std::make_pair("allocs", (double)Na));
+   values.push_back(std::make_pair("kbytes", Nb / 1024.0));
+
+   return (1);
+
+}
+
+/*
+ * A fit of a synthetic scan must also find the truth, within 5 of its
+ * standard errors
+ */
+static int check_truth(const struct GaussFit4Params &P){
+
+   const double p[4] = {P.x0, P.sigma2, P.Ao, P.Bo},
+                t[4] = {x0_true, sigma2_true, Ao_true, Bo_true};
+   int ok = 1;
+
+   for(int k = 0; k < 4; k++){ ok = ok && (fabs(p[k] - t[k]) < 5.0 * P.Stats.err[k]); }
+
+   if(!ok){
+
+      std::cerr << "FAIL: (" << p[0] << ", " << p[1] << ", " << p[2] << ", " << p[3];
+      std::cerr << ") is not within 5 standard errors of the truth (" << t[0] << ", ";
+      std::cerr << t[1] << ", " << t[2] << ", " << t[3] << ")" << std::endl;
+
+   }
+
+   return (ok);
+
+}
+
+/************************************************************************/
+/*
+ * Writes a nx x ny frame major float32 cube of synthetic spectra: the
+ * line shifts along x and the amplitude falls off from the center
+ */
+static int write_cube(const char *filename, const unsigned int &nx, const unsigned int &ny,
+                      const unsigned int &nl){
+
+   const uint32_t head[6] = {nx, ny, nl, LIF_CUBE_F32, LIF_CUBE_FRAMES, 0};
+
+   std::ofstream out(filename, std::ofstream::binary);
+   std::vector<double> lambda(nl);
+   std::vector<float> frame((size_t)nx * ny);
+   uint64_t seed = 7;
+
+   if(!out.is_open()){
+
+      std::cerr << "Error opening file:" << filename << std::endl;
+      return (0);
+
+   }
+
+   for(unsigned int l = 0; l < nl; l++){
+
+      lambda[l] = x0_true + half_width * (2.0 * l / (nl - 1) - 1.0);
+
+   }
+
+   out.write("LIFCUBE1", 8);
+   out.write((const char *)head, sizeof(head));
+   out.write((const char *)&lambda[0], nl * sizeof(double));
+
+   for(unsigned int l = 0; l < nl; l++){
+
+      for(unsigned int y = 0; y < ny; y++){
+
+         for(unsigned int x = 0; x < nx; x++){
+
+            const double dx = x - 0.5 * nx,
+                         dy = y - 0.5 * ny,
+                         A  = Ao_true * exp(-(dx * dx + dy * dy) / (0.5 * nx * nx)),
+                         x0 = x0_true + 4.0E-4 * dx / nx;
+
+            frame[(size_t)y * nx + x] = (float)(Fxa(lambda[l], x0, sigma2_true, A,
+                                                    Bo_true) + 0.01 * gauss_noise(seed));
+
+         }
+
+      }
+      out.write((const char *)&frame[0], frame.size() * sizeof(float));
+
+   }
+
+   out.close();
+
+   return (!out.fail());
+
+}
+
+/************************************************************************/
+/*
+ * The cases, see golden/params.txt
+ */
+static int run_case(const std::string &name, const char *input, case_values &values){
+
+   std::vector<double> lambda, counts, sigma;
+
+   // The initial guess of LIFAnalysis on the example scan
+   struct GaussFit4Params P = {668.6138, 0.0000006, 4.0, 0.5, 4};
+
+   if(("example" == name) || ("example_mixed" == name)){
+
+      const int mixed = ("example_mixed" == name);
+
+      if((NULL == input) || !read_lif_data(input, lambda, counts, sigma)){ return (0); }
+
+      auto fit = [&](struct GaussFit4Params &Q){ return (fit_scan(lambda, counts, sigma,
+                                                                  mixed, Q)); };
+
+      return (timed_fit(fit, 20, P, values));
+
+   }
+
+   P.x0     = x0_true - 5.0E-4;
+   P.sigma2 = 1.0E-6;
+   P.Ao     = 3.0;
+   P.Bo     = 0.3;
+
+   if("synthetic" == name){
+
+      synthetic_scan(201, 0.02, 0, 1, lambda, counts, NULL);
+
+      auto fit = [&](struct GaussFit4Params &Q){ return (fit_scan(lambda, counts, sigma,
+                                                                  0, Q)); };
+
+      return (timed_fit(fit, 20, P, values) && check_truth(P));
+
+   }
+
+   if("synthetic_weighted" == name){
+
+      synthetic_scan(201, 0.02, 0, 2, lambda, counts, &sigma);
+
+      auto fit = [&](struct GaussFit4Params &Q){ return (fit_scan(lambda, counts, sigma,
+                                                                  0, Q)); };
+
+      return (timed_fit(fit, 20, P, values) && check_truth(P));
+
+   }
+
+   // Cosmics on 2% of the wavelengths, which the robust fit ignores
+   if("spikes_tukey" == name){
+
+      synthetic_scan(201, 0.02, 50, 3, lambda, counts, NULL);
+      NLLSLossParse("tukey", P.Loss);
+
+      auto fit = [&](struct GaussFit4Params &Q){ return (fit_scan(lambda, counts, sigma,
+                                                                  0, Q)); };
+
+      return (timed_fit(fit, 20, P, values) && check_truth(P));
+
+   }
+
+   // Throughput of the solver on a long scan
+   if("long" == name){
+
+      synthetic_scan(200000, 0.02, 0, 5, lambda, counts, NULL);
+
+      auto fit = [&](struct GaussFit4Params &Q){ return (fit_scan(lambda, counts, sigma,
+                                                                  0, Q)); };
+
+      return (timed_fit(fit, 3, P, values) && check_truth(P));
+
+   }
+
+   // Parsing a long ASCII scan, then its fit
+   if("read" == name){
+
+      const char *filename = "read_scan.dat";
+      std::ofstream out(filename);
+
+      synthetic_scan(200000, 0.02, 0, 6, lambda, counts, NULL);
+      out << std::scientific << std::setprecision(9);
+      for(unsigned int i = 0; i < lambda.size(); i++){
+
+         out << lambda[i] << " " << counts[i] << "\n";
+
+      }
+      out.close();
+      if(out.fail()){ std::cerr << "ERROR: cannot write " << filename << std::endl; return (0); }
+
+      auto fit = [&](struct GaussFit4Params &Q){
+
+         return (read_lif_data(filename, lambda, counts, sigma) &&
+                 fit_scan(lambda, counts, sigma, 0, Q));
+
+      };
+
+      return (timed_fit(fit, 3, P, values) && check_truth(P));
+
+   }
+
+   // A 64 x 64 pixel cube on one thread, with warm starts: the mean of
+   // the maps, the work done and its time and allocations
+   if("cube" == name){
+
+      const char *filename = "cube.lifc";
+      const struct LIFCubeOptions Opts = {1, 16, 0, 1, {NLLS_LOSS_L2, 0.0}, 1};
+
+      struct LIFCube C;
+      struct LIFCubeMaps Maps;
+      struct LIFCubeStats Stats;
+      double x0_mean = 0.0,
+             sigma2_mean = 0.0;
+      unsigned long a0 = 0,
+                    b0 = 0;
+      int ok = 0;
+
+      if(!write_cube(filename, 64, 64, 41) || !lif_cube_open(filename, C)){ return (0); }
+
+      a0 = Nalloc;
+      b0 = Nbytes;
+      ok = lif_cube_fit(C, Opts, Maps, Stats);
+      a0 = Nalloc - a0;
+      b0 = Nbytes - b0;
+
+      for(size_t k = 0; k < Maps.x0.size(); k++){
+
+         x0_mean     += Maps.x0[k] / Maps.x0.size();
+         sigma2_mean += Maps.sigma2[k] / Maps.x0.size();
+
+      }
+
+      values.push_back(std::make_pair("x0_mean", x0_mean));
+      values.push_back(std::make_pair("sigma2_mean", sigma2_mean));
+      values.push_back(std::make_pair("Nfailed", (double)Stats.Nfailed));
+      values.push_back(std::make_pair("Nrejected", (double)Stats.Nrejected));
+      values.push_back(std::make_pair("Nretry", (double)Stats.Nretry));
+      values.push_back(std::make_pair("Niter", (double)Stats.Niter));
+      values.push_back(std::make_pair("time_ms", 1.0E3 * Stats.t_wall));
+      values.push_back(std::make_pair("allocs", (double)a0));
+      values.push_back(std::make_pair("kbytes", b0 / 1024.0));
+      lif_cube_close(C);
+
+      return (ok);
+
+   }
+
+   // The reason lif_triage finds for good and for broken scans, and its
+   // cost on a long scan
+   if("triage" == name){
+
+      struct TriageStats Tri;
+      std::vector<double> lb, cb;
+      double t_min = 1.0E30,
+             full_hi = HUGE_VAL;
+      unsigned long Na = 0;
+      uint64_t state = 3;
+
+      auto reason = [&](const char *quantity, const std::vector<double> &l,
+                        const std::vector<double> &c){
+
+         lif_triage(&l[0], &c[0], l.size(), -HUGE_VAL, full_hi, Tri);
+         values.push_back(std::make_pair(quantity, (double)Tri.reason));
+
+      };
+
+      if((NULL == input) || !read_lif_data(input, lambda, counts, sigma)){ return (0); }
+      reason("example", lambda, counts);
+
+      synthetic_scan(2001, 0.01, 0, 8, lambda, counts, NULL);
+      reason("good", lambda, counts);
+
+      lb.assign(lambda.begin(), lambda.begin() + 3);
+      cb.assign(counts.begin(), counts.begin() + 3);
+      reason("short", lb, cb);
+
+      cb = counts;
+      cb[1000] = NAN;
+      reason("nonfinite", lambda, cb);
+
+      cb.assign(counts.size(), Bo_true);
+      reason("flat", lambda, cb);
+
+      // A detector saturating at 80% of the peak
+      for(unsigned int i = 0; i < counts.size(); i++){
+
+         cb[i] = std::min(0.8 * (Ao_true + Bo_true), counts[i]);
+
+      }
+      reason("clipped", lambda, cb);
+
+      // A scan that stops short of the line
+      lb.resize(lambda.size());
+      for(unsigned int i = 0; i < lambda.size(); i++){
+
+         lb[i] = lambda[i] + 1.2 * half_width;
+         cb[i] = counts[i] - Fxa(lambda[i], x0_true, sigma2_true, Ao_true, Bo_true)
+                           + Fxa(lb[i], x0_true, sigma2_true, Ao_true, Bo_true);
+
+      }
+      reason("off_line", lb, cb);
+
+      // The background alone, the laser off the line
+      for(unsigned int i = 0; i < counts.size(); i++){
+
+         cb[i] = counts[i] - Fxa(lambda[i], x0_true, sigma2_true, Ao_true, 0.0);
+
+      }
+      reason("noise", lambda, cb);
+
+      // Photon counting: a 200 count line on a background of 1 and of 0.1
+      // count, a third and most of the samples 0. The zeros are the floor
+      // of the counts, not clipping.
+      synthetic_scan(400, 0.0, 0, 1, lb, cb, NULL);
+      for(int dark = 0; dark < 2; dark++){
+
+         for(unsigned int i = 0; i < lb.size(); i++){
+
+            cb[i] = poisson_counts(Fxa(lb[i], x0_true, sigma2_true, 200.0,
+                                       dark ? 0.1 : 1.0), state);
+
+         }
+         reason(dark ? "dark" : "counting", lb, cb);
+
+      }
+
+      // The same counts from a detector whose full scale is 150 counts
+      for(unsigned int i = 0; i < lb.size(); i++){ cb[i] = std::min(cb[i], 150.0); }
+      full_hi = 150.0;
+      reason("full_scale", lb, cb);
+      full_hi = HUGE_VAL;
+
+      synthetic_scan(200000, 0.02, 0, 5, lambda, counts, NULL);
+      for(unsigned int r = 0; r < 5; r++){
+
+         unsigned long a0 = Nalloc;
+         std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+         lif_triage(&lambda[0], &counts[0], lambda.size(), -HUGE_VAL, HUGE_VAL, Tri);
+         t_min = std::min(t_min, std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now() - t0).count());
+         if(0 == r){ Na = Nalloc - a0; }
+
+      }
+      values.push_back(std::make_pair("long", (double)Tri.reason));
+      values.push_back(std::make_pair("time_ms", 1.0E3 * t_min));
+      values.push_back(std::make_pair("allocs", (double)Na));
+
+      return (1);
+
+   }
+
+   std::cerr << "ERROR: no case " << name << std::endl;
+   return (0);
+
+}
+
+/************************************************************************/
+/*
+ * Checks the values of a case against its golden values. Every value
+ * needs one, so a new quantity cannot go unchecked.
+ */
+static int check_case(const std::string &name, const case_values &values,
+                      const golden_case &G){
+
+   int ok = 1;
+
+   std::cout << std::setprecision(12);
+   for(unsigned int k = 0; k < values.size(); k++){
+
+      golden_case::const_iterator g = G.find(values[k].first);
+      const double v = values[k].second;
+      int pass = 0;
+
+      std::cout << " " << std::left << std::setw(11) << values[k].first;
+      std::cout << std::right << ": " << std::setw(16) << v;
+
+      if(G.end() == g){
+
+         std::cout << "  no golden value" << std::endl;
+         ok = 0;
+         continue;
+
+      }
+
+      if(g->second.budget){
+
+         pass = (v <= g->second.value);
+         std::cout << "  budget " << g->second.value;
+
+      }else{
+
+         pass = (fabs(v - g->second.value) <= g->second.rtol * fabs(g->second.value));
+         std::cout << "  golden " << g->second.value << " +/- " << g->second.rtol;
+
+      }
+      std::cout << (pass ? "" : "  FAIL") << std::endl;
+      ok = ok && pass;
+
+   }
+
+   for(golden_case::const_iterator g = G.begin(); g != G.end(); g++){
+
+      int found = 0;
+
+      for(unsigned int k = 0; k < values.size(); k++){ found |= (g->first == values[k].first); }
+      if(!found){
+
+         std::cout << " " << g->first << ": golden value, but not computed  FAIL";
+         std::cout << std::endl;
+         ok = 0;
+
+      }
+
+   }
+
+   std::cout << name << (ok ? " passed" : " FAILED") << std::endl;
+
+   return (ok);
+
+}
+
+/************************************************************************/
+/*
+ * Compares two _fit.dat files number by number
+ */
+static int compare_files(const char *output, const char *reference, const double &rtol){
+
+   std::ifstream a(output),
+                 b(reference);
+   double x = 0.0,
+          y = 0.0;
+   unsigned long n = 0,
+                 Nbad = 0;
+
+   if(!a.is_open() || !b.is_open()){
+
+      std::cerr << "Error opening file:" << (a.is_open() ? reference : output);
+      std::cerr << std::endl;
+      return (0);
+
+   }
+
+   while(b >> y){
+
+      if(!(a >> x)){
+
+         std::cout << output << " is shorter than " << reference << std::endl;
+         return (0);
+
+      }
+
+      if(fabs(x - y) > rtol * std::max(fabs(y), 1.0E-300)){
+
+         if(Nbad++ < 5){
+
+            std::cout << " value " << n << ": " << x << " instead of " << y << std::endl;
+
+         }
+
+      }
+      n++;
+
+   }
+
+   if(a >> x){
+
+      std::cout << output << " is longer than " << reference << std::endl;
+      return (0);
+
+   }
+
+   std::cout << n << " values, " << Nbad << " differ by more than " << rtol;
+   std::cout << std::endl;
+
+   return ((0 == Nbad) && (n > 0));
+
+}
+
+/************************************************************************/
+/*
+ * Writes synthetic scans and a list of them into dir, for a batch run
+ */
+static int write_scans(const std::string &dir){
+
+   std::ofstream list((dir + "/list.txt").c_str());
+
+   if(!list.is_open()){
+
+      std::cerr << "Error opening file:" << dir << "/list.txt" << std::endl;
+      return (0);
+
+   }
+
+   for(unsigned int k = 0; k < 16; k++){
+
+      std::ostringstream name;
+      std::vector<double> lambda, counts, sigma;
+
+      name << dir << "/scan_" << k << ".dat";
+      synthetic_scan(61 + 20 * k, 0.02, 0, 100 + k, lambda, counts,
+                     (k % 2) ? &sigma : NULL);
+
+      std::ofstream out(name.str().c_str());
+
+      out << std::scientific << std::setprecision(9);
+      for(unsigned int i = 0; i < lambda.size(); i++){
+
+         out << lambda[i] << " " << counts[i];
+         if(!sigma.empty()){ out << " " << sigma[i]; }
+         out << "\n";
+
+      }
+      out.close();
+      if(out.fail()){ std::cerr << "ERROR: cannot write " << name.str() << std::endl; return (0); }
+
+      list << name.str() << "\n";
+
+   }
+
+   list.close();
+
+   return (!list.fail());
+
+}
+
+/*
+ * The _fit.dat file the batch wrote for every listed scan must be that
+ * of a fit of the scan on its own, as LIFAnalysis runs it and on the
+ * same wavelength grid
+ */
+static int check_batch(const char *list_filename, const double &rtol){
+
+   std::ifstream list(list_filename);
+   std::string filename;
+   int ok = 1;
+
+   if(!list.is_open()){
+
+      std::cerr << "Error opening file:" << list_filename << std::endl;
+      return (0);
+
+   }
+
+   while(std::getline(list, filename)){
+
+      std::vector<double> lambda, counts, sigma;
+      struct GaussFit4Params P = {668.6138, 0.0000006, 4.0, 0.5, 4};
+      std::string output = InputStem(filename.c_str()) + "_fit.dat",
+                  expect = InputStem(filename.c_str()) + "_expect.dat";
+
+      if(!read_lif_data(filename.c_str(), lambda, counts, sigma) ||
+         !fit_scan(lambda, counts, sigma, 0, P)){ return (0); }
+
+      const double lambda_first = lambda[0],
+                   lambda_end   = *std::max_element(lambda.begin(), lambda.end()),
+                   step = std::max(0.0001, (lambda_end - lambda_first) / LIF_FIT_GRID_MAX);
+      unsigned long k = 0;
+
+      std::ofstream out(expect.c_str());
+
+      out << std::scientific;
+      for(double col1 = lambda_first; (col1 < lambda_end) &&
+                                      (k++ < LIF_FIT_GRID_MAX); col1 += step){
+
+         out << col1 << " " << Fxa(col1, P.x0, P.sigma2, P.Ao, P.Bo) << std::endl;
+
+      }
+      out.close();
+
+      std::cout << filename << ": ";
+      ok = compare_files(output.c_str(), expect.c_str(), rtol) && ok;
+
+   }
+
+   return (ok);
+
+}
+
+/************************************************************************/
+int main(int argc, char** argv){
+
+   int opt   = 0,
+       print = 0;
+   double rtol = 1.0E-5;
+   const char *golden    = NULL,
+              *input     = NULL,
+              *case_name = NULL,
+              *output    = NULL,
+              *reference = NULL,
+              *scan_dir  = NULL,
+              *batch     = NULL;
+
+   std::map<std::string, golden_case> G;
+   case_values values;
+
+   while((opt = getopt(argc, argv, "g:i:c:pf:r:t:w:b:")) != -1){
+
+      switch (opt) {
+
+         case 'g' : golden    = optarg; break; // Golden values
+         case 'i' : input     = optarg; break; // The example scan
+         case 'c' : case_name = optarg; break; // Case to run
+         case 'p' : print     = 1;      break; // Print golden lines instead
+         case 'f' : output    = optarg; break; // _fit.dat to compare ...
+         case 'r' : reference = optarg; break; // ... with this one
+         case 't' : rtol = atof(optarg); break; // Relative tolerance
+         case 'w' : scan_dir  = optarg; break; // Write synthetic scans
+         case 'b' : batch     = optarg; break; // Check a batch of them
+
+         default :
+
+            std::cout << "Usage:" << std::endl;
+            std::cout << "LIFTests -g golden -c case [-i example] [-p]" << std::endl;
+            std::cout << "LIFTests -f output -r reference [-t rtol]" << std::endl;
+            std::cout << "LIFTests -w dir | -b list [-t rtol]" << std::endl;
+            return (EXIT_FAILURE);
+
+      }
+
+   }
+
+   if(NULL != output){
+
+      return (compare_files(output, reference, rtol) ? 0 : EXIT_FAILURE);
+
+   }
+
+   if(NULL != scan_dir){ return (write_scans(scan_dir) ? 0 : EXIT_FAILURE); }
+
+   if(NULL != batch){ return (check_batch(batch, rtol) ? 0 : EXIT_FAILURE); }
+
+   if((NULL == case_name) || (!print && ((NULL == golden) || !read_golden(golden, G)))){
+
+      std::cerr << "ERROR: -c case and -g golden file needed" << std::endl;
+      return (EXIT_FAILURE);
+
+   }
+
+   if(!run_case(case_name, input, values)){
+
+      std::cout << case_name << " FAILED" << std::endl;
+      return (EXIT_FAILURE);
+
+   }
+
+   // Lines to paste into the golden file after an intended change, x0
+   // needs 12 digits for ~1e-10
+   if(print){
+
+      std::cout << std::setprecision(12);
+      for(unsigned int k = 0; k < values.size(); k++){
+
+         std::cout << std::left << std::setw(20) << case_name << std::setw(12);
+         std::cout << values[k].first << std::right << values[k].second << std::endl;
+
+      }
+      return (0);
+
+   }
+
+   return (check_case(case_name, values, G[case_name]) ? 0 : EXIT_FAILURE);
+
+}
@@ -0,0 +1,139 @@
+// -----------------------------------------------------------------------
+//
+//                                    adc_input.cpp V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <new>
+#include <sys/stat.h>
+
+#include "adc_input.h"
+#include "input_stream.h"
+
+/************************************************************************/
+int ReadADCTrace(const char *filename, const int &bytes,
+                 const struct ADCCalibration &cal, struct ADCTrace &T){
+
+   const size_t Nblock = 1 << 18; //Codes appended per read
+
+   struct InputStream S;
+   struct stat st;
+   size_t Ncode = 0,
+          Nread = 0;
+   int res = 0;
+
+   T.bytes    = bytes;
+   T.Nsamples = 0;
+   T.cal      = cal;
+   T.code16.clear();
+   T.code32.clear();
+
+   if((2 != bytes) && (4 != bytes)){
+
+      std::cerr << "ERROR: ADC codes must be 2 (int16) or 4 (int32) bytes";
+      std::cerr << std::endl;
+      return (0);
+
+   }
+
+   //Plain, gzip or zstd, decompressed ahead on the stream's own thread
+   if(!OpenInputStream(filename, S)){ return (0); }
+
+   try{
+
+      //The size of a plain file gives the # codes, so no regrowth
+      if((INPUT_PLAIN == S.format) && (0 == stat(filename, &st))){
+
+         if(2 == bytes){ T.code16.reserve(st.st_size / bytes); }
+         else          { T.code32.reserve(st.st_size / bytes); }
+
+      }
+
+      do{
+
+         if(2 == bytes){ T.code16.resize(Ncode + Nblock); }
+         else          { T.code32.resize(Ncode + Nblock); }
+
+         Nread = InputStreamRead(S, (2 == bytes) ? (void *)&T.code16[Ncode]
+                                                 : (void *)&T.code32[Ncode],
+                                                             Nblock * bytes);
+         if(0 != Nread % bytes){ break; }
+         Ncode += Nread / bytes;
+
+      }while(Nread == Nblock * bytes);
+
+      if(2 == bytes){ T.code16.resize(Ncode); }
+      else          { T.code32.resize(Ncode); }
+
+   }catch(std::bad_alloc& ba){
+
+      std::cerr << "ERROR: ReadADCTrace allocation: " << ba.what();
+      std::cerr << std::endl;
+      goto cleanup;
+
+   }
+
+   if(!CloseInputStream(S)){
+
+      std::cerr << "ERROR: short read of " << filename << std::endl;
+      goto cleanup;
+
+   }
+
+   //A trailing partial sample is an error
+   if((0 != Nread % bytes) || (0 != Ncode % 2)){
+
+      std::cerr << "ERROR: " << filename << " is not a whole number of (x, y)";
+      std::cerr << " samples of " << bytes << " byte codes" << std::endl;
+      goto cleanup;
+
+   }
+
+   T.Nsamples = Ncode / 2;
+   res = 1;
+
+// Cleanup
+cleanup:
+
+   CloseInputStream(S);
+
+   if(!res){
+
+      T.code16.clear();
+      T.code32.clear();
+
+   }
+
+return (res);
+}//End function ReadADCTrace
+
+/************************************************************************/
+int ParseADCCalibration(const char *s, struct ADCCalibration &cal){
+
+   double v[4] = {1.0, 0.0, 1.0, 0.0};
+   char *end = NULL;
+
+   for(int k = 0; k < 4; k++){
+
+      v[k] = strtod(s, &end);
+      if(end == s){ return (0); }
+      s = end;
+      if((k < 3) && (',' != *s)){ return (0); }
+      if(k < 3){ s++; }
+
+   }
+
+   cal.gain[0]   = v[0];
+   cal.offset[0] = v[1];
+   cal.gain[1]   = v[2];
+   cal.offset[1] = v[3];
+
+   return ('\0' == *s);
+
+}//End function ParseADCCalibration
@@ -0,0 +1,155 @@
+// -----------------------------------------------------------------------
+//
+//                                     adc_input.h V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef adc_input_h
+#define adc_input_h
+
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+#include "nlls_solver.h"
+
+/*
+ * Linear calibration of the two channels of a raw ADC trace,
+ *      x = gain[0] * code_x + offset[0],   y = gain[1] * code_y + offset[1]
+ */
+struct ADCCalibration{
+
+   double gain[2];   //Physical units per ADC code of (x, y)
+   double offset[2]; //Physical value of code 0 of (x, y)
+
+};
+
+/*
+ * A raw ADC trace as written by the digitizer: little endian int16 or
+ * int32 codes, the x and y channels interleaved (x0 y0 x1 y1 ...). Only
+ * the array matching bytes is filled.
+ */
+struct ADCTrace{
+
+   int bytes;                   //Bytes per code, 2 (int16) or 4 (int32)
+   unsigned long Nsamples;      //# (x, y) samples
+   std::vector<int16_t> code16; //2 Nsamples codes if bytes = 2
+   std::vector<int32_t> code32; //2 Nsamples codes if bytes = 4
+   struct ADCCalibration cal;   //Calibration of the codes
+
+};
+
+/************************************************************************/
+/*
+ * ReadADCTrace(...) reads a raw ADC trace (see ADCTrace) into memory
+ * as codes, i.e. 2 or 4 bytes per value instead of the 8 of a double
+ * (and the ~12 - 16 of an ASCII column).
+ *
+ *      @param[in] char *filename: input file name
+ *      @param[in] int bytes: bytes per code, 2 (int16) or 4 (int32)
+ *      @param[in] ADCCalibration cal: calibration of the channels
+ *      @param[out] ADCTrace T: the trace
+ *      @return int success/failure
+ *
+ */
+int ReadADCTrace(const char *filename, const int &bytes,
+                 const struct ADCCalibration &cal, struct ADCTrace &T);
+
+/************************************************************************/
+/*
+ * ParseADCCalibration(...) parses "gx,ox,gy,oy" into a calibration
+ *
+ *      @param[in] char *s: the calibration string
+ *      @param[out] ADCCalibration cal: gains and offsets
+ *      @return int success/failure
+ *
+ */
+int ParseADCCalibration(const char *s, struct ADCCalibration &cal);
+
+/************************************************************************/
+/*
+ * ADCX(...) and ADCY(...) return the calibrated sample i of a trace
+ */
+inline double ADCX(const struct ADCTrace &T, const unsigned long &i){
+
+   return (T.cal.gain[0] * ((2 == T.bytes) ? T.code16[2 * i] : T.code32[2 * i])
+                                                        + T.cal.offset[0]);
+
+}
+
+inline double ADCY(const struct ADCTrace &T, const unsigned long &i){
+
+   return (T.cal.gain[1] * ((2 == T.bytes) ? T.code16[2 * i + 1]
+                                           : T.code32[2 * i + 1])
+                                                        + T.cal.offset[1]);
+
+}
+
+/************************************************************************/
+/*
+ * ADCFullScaleY(...) returns the calibrated y of the smallest and the
+ * largest code of a trace, where a clipping digitizer pins the samples
+ */
+inline void ADCFullScaleY(const struct ADCTrace &T, double &lo, double &hi){
+
+   const double cmin = (2 == T.bytes) ? INT16_MIN : INT32_MIN,
+                cmax = (2 == T.bytes) ? INT16_MAX : INT32_MAX;
+
+   lo = std::min(T.cal.gain[1] * cmin, T.cal.gain[1] * cmax) + T.cal.offset[1];
+   hi = std::max(T.cal.gain[1] * cmin, T.cal.gain[1] * cmax) + T.cal.offset[1];
+
+}
+
+/************************************************************************/
+/*
+ * ADCSamples<Code> reads the interleaved codes for NLLSFitSamples(...),
+ * the calibration is applied inside the accumulation loop (all weights
+ * are 1, raw traces carry no uncertainties).
+ */
+template<class Code>
+struct ADCSamples{
+
+   const Code *code;
+   double gx, ox, gy, oy;
+
+   ADCSamples(const Code *c, const struct ADCCalibration &cal) : code(c),
+                     gx(cal.gain[0]), ox(cal.offset[0]),
+                     gy(cal.gain[1]), oy(cal.offset[1]){}
+
+   double X(const unsigned long &i) const { return (gx * code[2 * i] + ox); }
+
+   double Y(const unsigned long &i) const { return (gy * code[2 * i + 1] + oy); }
+
+   double W(const unsigned long &i) const { return (1.0); }
+
+   int Weighted() const { return (0); }
+
+};
+
+/************************************************************************/
+/*
+ * NLLSFitADC<Model>(...) fits Model to a raw ADC trace without
+ * converting it to double arrays, see NLLSFitSamples(...)
+ */
+template<class Model>
+int NLLSFitADC(const struct ADCTrace &T, const unsigned int &Ntries,
+               const double &TOLERANCE, double *param, double *cov,
+               struct NLLSStats &Stats, const struct NLLSLoss *Loss = NULL){
+
+   if(0 == T.Nsamples){ return (0); }
+
+   if(2 == T.bytes){
+
+      return (NLLSFitSamples<Model>(ADCSamples<int16_t>(&T.code16[0], T.cal),
+                            T.Nsamples, Ntries, TOLERANCE, param, cov, Stats, Loss));
+
+   }
+
+   return (NLLSFitSamples<Model>(ADCSamples<int32_t>(&T.code32[0], T.cal),
+                            T.Nsamples, Ntries, TOLERANCE, param, cov, Stats, Loss));
+
+}
+
+#endif
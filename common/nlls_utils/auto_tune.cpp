@@ -0,0 +1,106 @@
+// -----------------------------------------------------------------------
+//
+//                                   auto_tune.cpp V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string.h>
+#include <unistd.h>
+
+#include "auto_tune.h"
+
+/************************************************************************/
+std::string AutoTuneKey(const char *tool, const unsigned long &Npoints){
+
+   char host[256];
+   unsigned long N = 1;
+
+   std::ostringstream key;
+
+   if(0 != gethostname(host, sizeof(host))){ strcpy(host, "localhost"); }
+   host[sizeof(host) - 1] = '\0';
+
+   while(N < Npoints){ N *= 2; }
+
+   key << host << " " << tool << " ";
+   key << DefaultThreads() << " " << N;
+
+   return (key.str());
+
+}//End function AutoTuneKey
+
+/************************************************************************/
+int AutoTuneLoad(const char *filename, const std::string &key,
+                 struct AutoTuneConfig &C){
+
+   std::ifstream in(filename);
+   std::string line;
+
+   int found = 0;
+
+   while(in.is_open() && std::getline(in, line)){
+
+      std::istringstream s(line);
+      std::string host, tool, hw, N;
+      struct AutoTuneConfig T = {0, 0, 0, 0.0};
+
+      if(line.empty() || ('#' == line[0])){ continue; }
+
+      if(!(s >> host >> tool >> hw >> N >> T.mixed >> T.Nworkers >> T.Nqueue >> T.t_trace)){
+
+         std::cerr << "Bad line in tune file " << filename << ": " << line << std::endl;
+         continue;
+
+      }
+
+      if((host + " " + tool + " " + hw + " " + N == key) && (T.Nworkers > 0)){
+
+         C = T;
+         found = 1;
+
+      }
+
+   }
+
+   return (found);
+
+}//End function AutoTuneLoad
+
+/************************************************************************/
+int AutoTuneSave(const char *filename, const std::string &key,
+                 const struct AutoTuneConfig &C){
+
+   const int fresh = !std::ifstream(filename).is_open();
+
+   std::ofstream out(filename, std::ofstream::out | std::ofstream::app);
+
+   if(!out.is_open()){
+
+      std::cerr << "ERROR: cannot append to the tune file " << filename << std::endl;
+      return (0);
+
+   }
+
+   if(fresh){
+
+      out << "# host tool hw_threads Npoints mixed Nworkers Nqueue t_trace[s]\n";
+
+   }
+
+   //One write per line, so runs that append at once do not interleave
+   std::ostringstream line;
+
+   line << key << " " << C.mixed << " " << C.Nworkers << " " << C.Nqueue << " ";
+   line << C.t_trace << "\n";
+   out << line.str() << std::flush;
+   out.close();
+
+   return (!out.fail());
+
+}//End function AutoTuneSave
@@ -0,0 +1,162 @@
+// -----------------------------------------------------------------------
+//
+//                                     auto_tune.h V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef auto_tune_h
+#define auto_tune_h
+
+#include <string>
+#include <algorithm>
+#include <math.h>
+
+#include "parallel_for.h"
+
+/*
+ * The configuration of a batch that AutoTune(...) picks
+ */
+struct AutoTuneConfig{
+
+   int mixed;             //Solver variant: 0 double, 1 mixed precision
+   unsigned int Nworkers; //Fit threads of the pipeline
+   unsigned int Nqueue;   //Capacity of its queues, # traces in flight
+   double t_trace;        //Wall time per trace of the configuration [s]
+
+};
+
+/*
+ * A thread count or queue capacity is only taken over a smaller one if
+ * its trial is this much faster, so the noise of a short trial does not
+ * oversubscribe the cores
+ */
+const double AutoTuneGain = 0.05;
+
+/************************************************************************/
+/*
+ * AutoTuneKey(...) names the configuration of a tool on this host for
+ * traces of about Npoints samples: the host name, the tool, the #
+ * hardware threads and Npoints rounded up to a power of 2
+ *
+ *      @param[in] char *tool: the analysis, e.g. "DoubleProbeAnalysis"
+ *      @param[in] long Npoints: # samples of a trace
+ *      @return std::string the key
+ *
+ */
+std::string AutoTuneKey(const char *tool, const unsigned long &Npoints);
+
+/************************************************************************/
+/*
+ * AutoTuneLoad(...) looks a key up in a tune file, a text file of one
+ * line per configuration
+ *
+ *      <host> <tool> <hw threads> <Npoints> <mixed> <Nworkers> <Nqueue> <t_trace>
+ *
+ * that runs append to. The last line of the key wins, a missing file
+ * holds none.
+ *
+ *      @param[in] char *filename: the tune file
+ *      @param[in] std::string key: the key (AutoTuneKey)
+ *      @param[out] struct AutoTuneConfig C: the configuration
+ *      @return int 1 if the key was found
+ *
+ */
+int AutoTuneLoad(const char *filename, const std::string &key,
+                 struct AutoTuneConfig &C);
+
+/************************************************************************/
+/*
+ * AutoTuneSave(...) appends a configuration to a tune file
+ *
+ *      @param[in] char *filename: the tune file
+ *      @param[in] std::string key: the key (AutoTuneKey)
+ *      @param[in] struct AutoTuneConfig C: the configuration
+ *      @return int success/failure
+ *
+ */
+int AutoTuneSave(const char *filename, const std::string &key,
+                 const struct AutoTuneConfig &C);
+
+/************************************************************************/
+/*
+ * AutoTune<Trial>(...) picks the fastest configuration of a batch from
+ * short trials, each run twice and the faster run kept. One trial is
+ *
+ *      int trial(const struct AutoTuneConfig &C, const unsigned int &Ntraces,
+ *                double &t_wall);
+ *
+ * which fits Ntraces synthetic traces shaped as the input with C and
+ * returns the wall time. The search is greedy, one knob at a time:
+ *        variant : double and mixed precision, on one fit thread
+ *        threads : 1, 2, 4, ... and every hardware thread, queues of 2
+ *                  traces per thread
+ *        queue   : 1, 2 and 4 traces per fit thread
+ * A trial fits 4 traces per fit thread, at least 8, so a thread count
+ * is timed on a full pipeline.
+ *
+ *      @param[in] Trial trial: runs one trial
+ *      @param[out] struct AutoTuneConfig Best: the fastest configuration
+ *      @return int success/failure (a trial failed)
+ *
+ */
+template<class Trial>
+int AutoTune(Trial trial, struct AutoTuneConfig &Best){
+
+   const unsigned int Nhw = DefaultThreads();
+
+   struct AutoTuneConfig C = {0, 1, 2, 0.0};
+
+   //The time per trace of C, the faster of two runs
+   auto timed = [&](struct AutoTuneConfig &T){
+
+      const unsigned int Ntraces = std::max(8u, 4 * T.Nworkers);
+
+      double t = 0.0;
+
+      T.t_trace = HUGE_VAL;
+      for(int r = 0; r < 2; r++){
+
+         if(!trial(T, Ntraces, t)){ return (0); }
+         T.t_trace = std::min(T.t_trace, t / Ntraces);
+
+      }
+
+      return (1);
+
+   };
+
+   if(!timed(C)){ return (0); }
+   Best = C;
+
+   C.mixed = 1;
+   if(!timed(C)){ return (0); }
+   if(C.t_trace < Best.t_trace){ Best = C; }
+
+   for(unsigned int Nw = 2; Nw < 2 * Nhw; Nw *= 2){
+
+      C = Best;
+      C.Nworkers = std::min(Nw, Nhw);
+      C.Nqueue   = 2 * C.Nworkers;
+      if(!timed(C)){ return (0); }
+      if(C.t_trace < (1.0 - AutoTuneGain) * Best.t_trace){ Best = C; }
+
+   }
+
+   for(unsigned int q = 1; q <= 4; q *= 2){
+
+      if(2 == q){ continue; } //The thread search ran it
+
+      C = Best;
+      C.Nqueue = q * C.Nworkers;
+      if(!timed(C)){ return (0); }
+      if(C.t_trace < (1.0 - AutoTuneGain) * Best.t_trace){ Best = C; }
+
+   }
+
+   return (1);
+
+}
+
+#endif
@@ -0,0 +1,276 @@
+// -----------------------------------------------------------------------
+//
+//                                batch_journal.cpp V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#include <iostream>
+#include <string>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "batch_journal.h"
+#include "fit_cache.h"
+
+/*
+ * Record: header, name, result, then the checksum of all three
+ */
+static const uint32_t BatchJournalMagic = 0x4a424550; //"PEBJ"
+
+enum{ JOURNAL_BEGIN = 1,
+      JOURNAL_END   = 2
+};
+
+struct BatchJournalRecord{
+
+   uint32_t magic;
+   uint32_t type;
+   uint64_t key;
+   uint32_t nname;
+   uint32_t nres;
+
+};
+
+/************************************************************************/
+static std::string BatchJournalId(const uint64_t &key, const std::string &name){
+
+   std::string id((const char *)&key, sizeof(key));
+
+   return (id + name);
+
+}
+
+/*
+ * Appends one record with a single write(), so the records of the
+ * threads (and of the processes) sharing the file never interleave
+ */
+static int BatchJournalAppend(struct BatchJournal &J, const uint32_t &type,
+                              const uint64_t &key, const std::string &name,
+                              const void *res, const size_t &nres){
+
+   struct BatchJournalRecord R = {BatchJournalMagic, type, key,
+                                  (uint32_t)name.size(), (uint32_t)nres};
+   std::string buf((const char *)&R, sizeof(R));
+   uint64_t sum = 0;
+   size_t done = 0;
+
+   if(J.failed){ return (0); }
+
+   buf.append(name);
+   if(nres > 0){ buf.append((const char *)res, nres); }
+   sum = FitCacheHash(buf.data(), buf.size(), 0);
+   buf.append((const char *)&sum, sizeof(sum));
+
+   while(done < buf.size()){
+
+      ssize_t r = write(J.fd, buf.data() + done, buf.size() - done);
+
+      if(r < 0){
+
+         if(EINTR == errno){ continue; }
+
+         //A partial record is skipped on reading, but stop appending
+         if(0 == J.failed.exchange(1)){
+
+            std::cerr << "ERROR: cannot append to the journal " << J.filename;
+            std::cerr << ": " << strerror(errno) << std::endl;
+
+         }
+         return (0);
+
+      }
+      done += r;
+
+   }
+
+   return (1);
+
+}
+
+/************************************************************************/
+int OpenBatchJournal(const char *filename, struct BatchJournal &J){
+
+   const size_t Nhead = sizeof(struct BatchJournalRecord);
+
+   std::string buf;
+   struct stat st;
+   size_t p = 0,
+          done = 0;
+
+   J.filename = filename;
+   J.done.clear();
+   J.begun.clear();
+   J.Nrecords = J.Nskipped = 0;
+   J.failed = 0;
+   J.t_sync = std::chrono::steady_clock::now();
+   J.fd = open(filename, O_RDWR | O_CREAT | O_APPEND, 0644);
+
+   if((J.fd < 0) || (0 != fstat(J.fd, &st))){
+
+      std::cerr << "ERROR: cannot open the journal " << filename << ": ";
+      std::cerr << strerror(errno) << std::endl;
+      if(J.fd >= 0){ close(J.fd); J.fd = -1; }
+      return (0);
+
+   }
+
+   buf.resize(st.st_size);
+   while(done < buf.size()){
+
+      ssize_t r = pread(J.fd, &buf[done], buf.size() - done, done);
+
+      if((r < 0) && (EINTR == errno)){ continue; }
+      if(r <= 0){ break; }
+      done += r;
+
+   }
+   buf.resize(done);
+
+   //A record that does not check out is skipped a byte at a time up to
+   //the next one
+   while(p + Nhead + sizeof(uint64_t) <= buf.size()){
+
+      struct BatchJournalRecord R;
+      uint64_t sum = 0;
+      size_t n = 0;
+
+      memcpy(&R, &buf[p], Nhead);
+      n = Nhead + (size_t)R.nname + R.nres;
+
+      if((BatchJournalMagic != R.magic) ||
+         ((JOURNAL_BEGIN != R.type) && (JOURNAL_END != R.type)) ||
+         (p + n + sizeof(sum) > buf.size())){
+
+         p++;
+         J.Nskipped++;
+         continue;
+
+      }
+
+      memcpy(&sum, &buf[p + n], sizeof(sum));
+      if(sum != FitCacheHash(&buf[p], n, 0)){
+
+         p++;
+         J.Nskipped++;
+         continue;
+
+      }
+
+      std::string id = BatchJournalId(R.key, buf.substr(p + Nhead, R.nname));
+
+      if(JOURNAL_BEGIN == R.type){
+
+         J.begun[id]++;
+
+      }else{
+
+         J.done[id] = buf.substr(p + Nhead + R.nname, R.nres);
+         J.begun.erase(id);
+
+      }
+
+      J.Nrecords++;
+      p += n + sizeof(sum);
+
+   }
+
+   J.Nskipped += buf.size() - p;
+
+   return (1);
+
+}//End function OpenBatchJournal
+
+/************************************************************************/
+void CloseBatchJournal(struct BatchJournal &J){
+
+   if(J.fd < 0){ return; }
+
+   fdatasync(J.fd);
+   close(J.fd);
+   J.fd = -1;
+
+}//End function CloseBatchJournal
+
+/************************************************************************/
+int BatchJournalFileKey(const char *filename, const uint64_t &opts, uint64_t &key){
+
+   struct stat st;
+   uint64_t id[3];
+
+   if(0 != stat(filename, &st)){ return (0); }
+
+   id[0] = st.st_size;
+   id[1] = st.st_mtim.tv_sec;
+   id[2] = st.st_mtim.tv_nsec;
+   key   = FitCacheHash(id, sizeof(id), opts);
+
+   return (1);
+
+}//End function BatchJournalFileKey
+
+/************************************************************************/
+int BatchJournalDone(const struct BatchJournal &J, const uint64_t &key,
+                     const std::string &name, void *res, const size_t &nres){
+
+   std::unordered_map<std::string, std::string>::const_iterator it =
+                                         J.done.find(BatchJournalId(key, name));
+
+   //A result of another struct size (another build) is not done
+   if((J.done.end() == it) || (it->second.size() != nres)){ return (0); }
+
+   memcpy(res, it->second.data(), nres);
+
+   return (1);
+
+}//End function BatchJournalDone
+
+/************************************************************************/
+unsigned int BatchJournalBegins(const struct BatchJournal &J, const uint64_t &key,
+                                const std::string &name){
+
+   std::unordered_map<std::string, unsigned int>::const_iterator it =
+                                        J.begun.find(BatchJournalId(key, name));
+
+   return ((J.begun.end() == it) ? 0 : it->second);
+
+}//End function BatchJournalBegins
+
+/************************************************************************/
+int BatchJournalBegin(struct BatchJournal &J, const uint64_t &key,
+                      const std::string &name){
+
+   return (BatchJournalAppend(J, JOURNAL_BEGIN, key, name, NULL, 0));
+
+}//End function BatchJournalBegin
+
+/************************************************************************/
+int BatchJournalEnd(struct BatchJournal &J, const uint64_t &key,
+                    const std::string &name, const void *res, const size_t &nres){
+
+   std::chrono::steady_clock::time_point now;
+
+   if(!BatchJournalAppend(J, JOURNAL_END, key, name, res, nres)){ return (0); }
+
+   //Group commit: one fdatasync covers every record since the last one
+   now = std::chrono::steady_clock::now();
+   if(std::chrono::duration<double>(now - J.t_sync).count() >= BatchJournalSyncInterval){
+
+      if(0 != fdatasync(J.fd)){
+
+         std::cerr << "ERROR: cannot sync the journal " << J.filename << std::endl;
+         return (0);
+
+      }
+      J.t_sync = now;
+
+   }
+
+   return (1);
+
+}//End function BatchJournalEnd
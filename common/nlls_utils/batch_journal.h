@@ -0,0 +1,150 @@
+// -----------------------------------------------------------------------
+//
+//                                 batch_journal.h V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef batch_journal_h
+#define batch_journal_h
+
+#include <string>
+#include <unordered_map>
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+/*
+ * A file begun this many times without an end record crashed every run
+ * that tried it, it is not begun again
+ */
+const unsigned int BatchJournalMaxBegins = 3;
+
+/*
+ * Completed end records are synced to the disk at most this often [s]
+ */
+const double BatchJournalSyncInterval = 0.05;
+
+/*
+ * An append only journal of a batch, see OpenBatchJournal(...)
+ */
+struct BatchJournal{
+
+   int fd;                                            //The journal file
+   std::string filename;
+   std::unordered_map<std::string, std::string> done; //key + name -> result
+   std::unordered_map<std::string, unsigned int> begun;//key + name -> # begins
+   unsigned long Nrecords;                            //# valid records read
+   unsigned long Nskipped;                            //# bytes of torn records
+   std::atomic<int> failed;                           //An append failed
+   std::chrono::steady_clock::time_point t_sync;      //Last fdatasync
+
+};
+
+/************************************************************************/
+/*
+ * OpenBatchJournal(...) opens (or creates) the journal of a batch and
+ * reads what earlier runs recorded. The journal only grows: a run
+ * appends a begin record before it parses a file and an end record,
+ * with the result, once the file is done, each as one write() to the
+ * file opened with O_APPEND. Every record carries a checksum, so the
+ * torn record a killed run leaves at the end (or a partial one between
+ * records of concurrent MPI ranks) is skipped on reading, never taken
+ * for a result. The records are kept in memory, read only during the
+ * batch, so the threads look them up without a lock.
+ *
+ *      @param[in] char *filename: the journal file
+ *      @param[out] struct BatchJournal J: the journal
+ *      @return int success/failure
+ *
+ */
+int OpenBatchJournal(const char *filename, struct BatchJournal &J);
+
+/************************************************************************/
+/*
+ * CloseBatchJournal(...) syncs and closes the journal
+ *
+ *      @param[in/out] struct BatchJournal J: the journal
+ *
+ */
+void CloseBatchJournal(struct BatchJournal &J);
+
+/************************************************************************/
+/*
+ * BatchJournalFileKey(...) is the key a file is journaled under: the
+ * options of its fit (FitCacheKey of the options) with the size and
+ * modification time of the file, so a file changed since it was
+ * journaled, or a batch run with other options, is fitted again
+ *
+ *      @param[in] char *filename: the input file
+ *      @param[in] uint64_t opts: hash of the fit options
+ *      @param[out] uint64_t key: the key
+ *      @return int success/failure (no such file)
+ *
+ */
+int BatchJournalFileKey(const char *filename, const uint64_t &opts, uint64_t &key);
+
+/************************************************************************/
+/*
+ * BatchJournalDone(...) looks up the result an earlier run recorded for
+ * a file
+ *
+ *      @param[in] struct BatchJournal J: the journal
+ *      @param[in] uint64_t key: key of the file (BatchJournalFileKey)
+ *      @param[in] std::string name: the file
+ *      @param[out] void *res: the result, nres bytes
+ *      @param[in] size_t nres: size of the result
+ *      @return int 1 if the file is done
+ *
+ */
+int BatchJournalDone(const struct BatchJournal &J, const uint64_t &key,
+                     const std::string &name, void *res, const size_t &nres);
+
+/************************************************************************/
+/*
+ * BatchJournalBegins(...) is the # times earlier runs began a file they
+ * did not finish
+ *
+ *      @param[in] struct BatchJournal J: the journal
+ *      @param[in] uint64_t key: key of the file (BatchJournalFileKey)
+ *      @param[in] std::string name: the file
+ *      @return unsigned int # begins without an end
+ *
+ */
+unsigned int BatchJournalBegins(const struct BatchJournal &J, const uint64_t &key,
+                                const std::string &name);
+
+/************************************************************************/
+/*
+ * BatchJournalBegin(...) records that a file is begun. It is not synced,
+ * a killed process leaves it in the page cache.
+ *
+ *      @param[in/out] struct BatchJournal J: the journal
+ *      @param[in] uint64_t key: key of the file (BatchJournalFileKey)
+ *      @param[in] std::string name: the file
+ *      @return int success/failure
+ *
+ */
+int BatchJournalBegin(struct BatchJournal &J, const uint64_t &key,
+                      const std::string &name);
+
+/************************************************************************/
+/*
+ * BatchJournalEnd(...) records the result of a file. The journal is
+ * synced when the last sync is older than BatchJournalSyncInterval, so
+ * a crash of the node loses at most the results of that interval (they
+ * are fitted again), a crash of the process none. Called by one thread.
+ *
+ *      @param[in/out] struct BatchJournal J: the journal
+ *      @param[in] uint64_t key: key of the file (BatchJournalFileKey)
+ *      @param[in] std::string name: the file
+ *      @param[in] void *res: the result, nres bytes
+ *      @param[in] size_t nres: size of the result
+ *      @return int success/failure
+ *
+ */
+int BatchJournalEnd(struct BatchJournal &J, const uint64_t &key,
+                    const std::string &name, const void *res, const size_t &nres);
+
+#endif
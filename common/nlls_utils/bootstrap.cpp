@@ -0,0 +1,76 @@
+// -----------------------------------------------------------------------
+//
+//                                    bootstrap.cpp V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+
+#include "bootstrap.h"
+
+/************************************************************************/
+/*
+ * Quantile by linear interpolation between order statistics
+ * (Hyndman & Fan type 7, the R and numpy default).
+ */
+double Percentile(std::vector<double> &v, const double &q){
+
+   if(v.empty()){ return (NAN); }
+
+   std::sort(v.begin(), v.end());
+
+   double h  = q * (v.size() - 1);
+   unsigned int k = (unsigned int)floor(h);
+
+   if(k + 1 >= v.size()){ return (v.back()); }
+
+return (v[k] + (h - k) * (v[k + 1] - v[k]));
+} //End function Percentile
+
+/************************************************************************/
+/*
+ * Percentile intervals and standard deviations of the successful
+ * resampled fits.
+ */
+void BootstrapSummarize(struct BootstrapResult &R, const unsigned int &Npar,
+                                                        const double &CL){
+
+   unsigned int Nboot = R.ok.size();
+   std::vector<double> v;
+
+   R.lo.assign(Npar, NAN);
+   R.hi.assign(Npar, NAN);
+   R.sd.assign(Npar, NAN);
+   R.Nok = 0;
+
+   for(unsigned int b = 0; b < Nboot; b++){ R.Nok += (0 != R.ok[b]); }
+
+   for(unsigned int k = 0; k < Npar; k++){
+
+      double mean = 0.0,
+             var  = 0.0;
+
+      v.clear();
+      for(unsigned int b = 0; b < Nboot; b++){
+
+         if(R.ok[b]){ v.push_back(R.samples[b * Npar + k]); }
+
+      }
+
+      if(v.empty()){ continue; }
+
+      for(unsigned int i = 0; i < v.size(); i++){ mean += v[i]; }
+      mean /= v.size();
+      for(unsigned int i = 0; i < v.size(); i++){ var += (v[i] - mean) * (v[i] - mean); }
+
+      R.sd[k] = (v.size() > 1) ? sqrt(var / (v.size() - 1)) : 0.0;
+      R.lo[k] = Percentile(v, 0.5 * (1.0 - CL));
+      R.hi[k] = Percentile(v, 0.5 * (1.0 + CL));
+
+   }
+
+} //End function BootstrapSummarize
@@ -0,0 +1,182 @@
+// -----------------------------------------------------------------------
+//
+//                                     bootstrap.h V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef bootstrap_h
+#define bootstrap_h
+
+#include <vector>
+#include <math.h>
+#include <stdint.h>
+
+#include "parallel_for.h"
+
+/************************************************************************/
+/*
+ * Resampling schemes:
+ *      BOOT_RESIDUALS: y* = yfit + r_j, the (weight standardized) residual
+ *                      r_j of a random point j is added to the fit
+ *      BOOT_PAIRS    : (x*, y*, w*) = (x_j, y_j, w_j) for a random point j
+ */
+enum BootstrapMode{ BOOT_RESIDUALS = 0, BOOT_PAIRS = 1 };
+
+struct BootstrapOptions{
+
+   unsigned int Nboot;    //Number of resampled fits
+   unsigned int Nthreads; //Number of threads (0 = all hardware threads)
+   uint64_t     seed;     //Random seed
+   int          mode;     //BootstrapMode
+   double       CL;       //Confidence level of the intervals (e.g. 0.95)
+
+};
+
+struct BootstrapResult{
+
+   std::vector<double> samples; //Nboot x Npar fitted parameters, row major
+   std::vector<int>    ok;      //Nboot success flags
+   std::vector<double> lo;      //Npar lower percentile bounds
+   std::vector<double> hi;      //Npar upper percentile bounds
+   std::vector<double> sd;      //Npar bootstrap standard deviations
+   unsigned int        Nok;     //Number of successful resampled fits
+
+};
+
+/************************************************************************/
+/*
+ * SplitMix64(...) advances state and returns the next 64 bit random
+ * number (Steele, Lea & Flood 2014). It is used both as the random
+ * generator and to derive an independent seed for every replicate.
+ *
+ *      @param[in/out] uint64_t state: generator state
+ *      @return uint64_t: random number
+ *
+ */
+inline uint64_t SplitMix64(uint64_t &state){
+
+   uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+
+   z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+   z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+   return (z ^ (z >> 31));
+
+}
+
+/************************************************************************/
+/*
+ * Percentile(...) returns the q-th quantile (0 <= q <= 1) of v using
+ * linear interpolation between order statistics. v is sorted in place.
+ *
+ *      @param[in/out] std::vector v: values
+ *      @param[in] double q: quantile
+ *      @return double: quantile value (NaN if v is empty)
+ *
+ */
+double Percentile(std::vector<double> &v, const double &q);
+
+/************************************************************************/
+/*
+ * BootstrapSummarize(...) fills lo, hi, sd and Nok of a result whose
+ * samples and ok flags are already set.
+ *
+ *      @param[in/out] BootstrapResult R: result
+ *      @param[in] int Npar: number of parameters
+ *      @param[in] double CL: confidence level of the intervals
+ *
+ */
+void BootstrapSummarize(struct BootstrapResult &R, const unsigned int &Npar,
+                                                        const double &CL);
+
+/************************************************************************/
+/*
+ * Bootstrap(...) resamples a fitted data set in memory and refits every
+ * replicate in parallel. Each replicate is warm started from the
+ * nominal fit and draws its random numbers from a generator seeded with
+ * (seed, replicate #) only, so a fixed seed gives the same intervals for
+ * any number of threads.
+ *
+ *      @param[in] std::vector x: independent variable
+ *      @param[in] std::vector y: measurements
+ *      @param[in] std::vector w: weights (empty = 1)
+ *      @param[in] std::vector yfit: nominal fit evaluated at x
+ *      @param[in] std::vector p0: nominal fit parameters
+ *      @param[in] Fit fit: callable as
+ *                 int fit(const std::vector<double> &x,
+ *                         const std::vector<double> &y,
+ *                         const std::vector<double> &w, double *param)
+ *                 which refits in place starting from param
+ *      @param[in] BootstrapOptions opts: options
+ *      @param[out] BootstrapResult R: samples and percentile intervals
+ *      @return int success/failure
+ *
+ */
+template<class Fit>
+int Bootstrap(const std::vector<double> &x, const std::vector<double> &y,
+              const std::vector<double> &w, const std::vector<double> &yfit,
+              const std::vector<double> &p0, Fit fit,
+              const struct BootstrapOptions &opts, struct BootstrapResult &R){
+
+   const unsigned int Npoi = x.size(),
+                      Npar = p0.size();
+
+   if((0 == Npoi) || (y.size() != Npoi) || (yfit.size() != Npoi) ||
+      (!w.empty() && (w.size() != Npoi))){
+
+      return (0);
+
+   }
+
+   //Standardized residuals sqrt(w) * (y - yfit)
+   std::vector<double> r(Npoi);
+   for(unsigned int i = 0; i < Npoi; i++){
+
+      r[i] = (y[i] - yfit[i]) * (w.empty() ? 1.0 : sqrt(w[i]));
+
+   }
+
+   R.samples.assign(opts.Nboot * Npar, 0.0);
+   R.ok.assign(opts.Nboot, 0);
+
+   ParallelFor(opts.Nboot, opts.Nthreads,
+               [&](unsigned int b, unsigned int thread){
+
+      std::vector<double> xb(x), yb(Npoi), wb(w);
+      uint64_t state = opts.seed ^ (0xD1B54A32D192ED03ULL * (b + 1));
+      SplitMix64(state);
+
+      for(unsigned int i = 0; i < Npoi; i++){
+
+         unsigned int j = SplitMix64(state) % Npoi;
+
+         if(BOOT_PAIRS == opts.mode){
+
+            xb[i] = x[j];
+            yb[i] = y[j];
+            if(!w.empty()){ wb[i] = w[j]; }
+
+         }else{
+
+            yb[i] = yfit[i] + r[j] / (w.empty() ? 1.0 : sqrt(w[i]));
+
+         }
+
+      }
+
+      double *param = &R.samples[b * Npar];
+      for(unsigned int k = 0; k < Npar; k++){ param[k] = p0[k]; }
+
+      R.ok[b] = fit(xb, yb, wb, param);
+
+   });
+
+   BootstrapSummarize(R, Npar, opts.CL);
+
+   return (R.Nok > 0);
+
+}
+
+#endif
@@ -0,0 +1,282 @@
+// -----------------------------------------------------------------------
+//
+//                                       dual.h V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef dual_h
+#define dual_h
+
+#include <math.h>
+#include <cmath>
+
+/************************************************************************/
+/*
+ * Dual<T, N> is a forward mode automatic differentiation number: a
+ * value v and its N partial derivatives d[k] = dv/dp[k]. Evaluating a
+ * model expression on Dual parameters seeded with d[k] = 1 for p[k]
+ * gives the exact gradient in the same pass as the value, see ADModel
+ * below. N is a template constant, so every loop over the partials is
+ * unrolled and nothing is allocated.
+ *
+ * The arithmetic operators are friends taking the scalar type T by
+ * value, so mixed expressions such as 0.5 * p[1] work for T = float
+ * without deduction conflicts.
+ *
+ * A parameter is seeded with compile time zeros for every other
+ * partial, but IEEE arithmetic does not let the compiler drop 0 * x or
+ * 0 + x (x may be inf, nan or -0), so plain operators compute all N
+ * partials at every step. The partials therefore combine through Mul,
+ * Add and Sub, which skip a term the compiler knows to be 0
+ * (DUAL_ZERO). With the loops unrolled first (DUAL_UNROLL) the seeds
+ * propagate and only the partials that can be nonzero are computed, as
+ * in a hand-written gradient. Other compilers compute every partial.
+ */
+#if defined(__GNUC__)
+#define DUAL_ZERO(a) (__builtin_constant_p(a) && (T(0) == (a)))
+#define DUAL_UNROLL _Pragma("GCC unroll 64")
+#else
+#define DUAL_ZERO(a) false
+#define DUAL_UNROLL
+#endif
+
+template<class T, int N>
+struct Dual{
+
+   T v;    //Value
+   T d[N]; //Partial derivatives
+
+   Dual(){}
+
+   Dual(const T &c) : v(c){ DUAL_UNROLL for(int k = 0; k < N; k++){ d[k] = T(0); } }
+
+   //A variable: value c, seeded with dv/dp[i] = 1
+   Dual(const T &c, const int &i) : v(c){
+
+      DUAL_UNROLL for(int k = 0; k < N; k++){ d[k] = T(k == i); }
+
+   }
+
+   //Partial a times b, 0 if a is known to be 0
+   static inline T Mul(const T &a, const T &b){
+
+      return (DUAL_ZERO(a) ? T(0) : a * b);
+
+   }
+
+   //Sum and difference of two partials, skipping one known to be 0
+   static inline T Add(const T &a, const T &b){
+
+      return (DUAL_ZERO(a) ? b : (DUAL_ZERO(b) ? a : a + b));
+
+   }
+
+   static inline T Sub(const T &a, const T &b){
+
+      return (DUAL_ZERO(b) ? a : (DUAL_ZERO(a) ? -b : a - b));
+
+   }
+
+   friend Dual operator-(const Dual &a){
+
+      Dual r;
+      r.v = -a.v;
+      DUAL_UNROLL for(int k = 0; k < N; k++){ r.d[k] = -a.d[k]; }
+      return (r);
+
+   }
+
+   friend Dual operator+(const Dual &a, const Dual &b){
+
+      Dual r;
+      r.v = a.v + b.v;
+      DUAL_UNROLL for(int k = 0; k < N; k++){ r.d[k] = Add(a.d[k], b.d[k]); }
+      return (r);
+
+   }
+
+   friend Dual operator-(const Dual &a, const Dual &b){
+
+      Dual r;
+      r.v = a.v - b.v;
+      DUAL_UNROLL for(int k = 0; k < N; k++){ r.d[k] = Sub(a.d[k], b.d[k]); }
+      return (r);
+
+   }
+
+   friend Dual operator*(const Dual &a, const Dual &b){
+
+      Dual r;
+      r.v = a.v * b.v;
+      DUAL_UNROLL for(int k = 0; k < N; k++){
+
+         r.d[k] = Add(Mul(a.d[k], b.v), Mul(b.d[k], a.v));
+
+      }
+      return (r);
+
+   }
+
+   friend Dual operator/(const Dual &a, const Dual &b){
+
+      Dual r;
+      T inv = T(1) / b.v;
+      r.v = a.v * inv;
+      DUAL_UNROLL for(int k = 0; k < N; k++){
+
+         r.d[k] = Mul(Sub(a.d[k], Mul(b.d[k], r.v)), inv);
+
+      }
+      return (r);
+
+   }
+
+   friend Dual operator+(const Dual &a, T c){ Dual r = a; r.v += c; return (r); }
+   friend Dual operator+(T c, const Dual &a){ Dual r = a; r.v += c; return (r); }
+   friend Dual operator-(const Dual &a, T c){ Dual r = a; r.v -= c; return (r); }
+   friend Dual operator-(T c, const Dual &a){ Dual r = -a; r.v += c; return (r); }
+
+   friend Dual operator*(const Dual &a, T c){
+
+      Dual r;
+      r.v = a.v * c;
+      DUAL_UNROLL for(int k = 0; k < N; k++){ r.d[k] = Mul(a.d[k], c); }
+      return (r);
+
+   }
+
+   friend Dual operator*(T c, const Dual &a){ return (a * c); }
+
+   friend Dual operator/(const Dual &a, T c){ return (a * (T(1) / c)); }
+
+   friend Dual operator/(T c, const Dual &a){
+
+      Dual r;
+      T inv = T(1) / a.v;
+      r.v = c * inv;
+      T s = -r.v * inv;
+      DUAL_UNROLL for(int k = 0; k < N; k++){ r.d[k] = Mul(a.d[k], s); }
+      return (r);
+
+   }
+
+};
+
+/************************************************************************/
+/*
+ * Elementary functions, f(a) with derivative f'(a.v) * a.d[k]
+ */
+template<class T, int N>
+inline Dual<T, N> Chain(const Dual<T, N> &a, const T &f, const T &df){
+
+   Dual<T, N> r;
+   r.v = f;
+   DUAL_UNROLL for(int k = 0; k < N; k++){ r.d[k] = Dual<T, N>::Mul(a.d[k], df); }
+   return (r);
+
+}
+
+template<class T, int N>
+inline Dual<T, N> exp(const Dual<T, N> &a){
+
+   T e = exp(a.v);
+   return (Chain(a, e, e));
+
+}
+
+template<class T, int N>
+inline Dual<T, N> log(const Dual<T, N> &a){
+
+   return (Chain(a, T(log(a.v)), T(T(1) / a.v)));
+
+}
+
+template<class T, int N>
+inline Dual<T, N> sqrt(const Dual<T, N> &a){
+
+   T s = sqrt(a.v);
+   return (Chain(a, s, T(T(0.5) / s)));
+
+}
+
+template<class T, int N>
+inline Dual<T, N> tanh(const Dual<T, N> &a){
+
+   T t = tanh(a.v);
+   return (Chain(a, t, T(T(1) - t * t)));
+
+}
+
+template<class T, int N>
+inline Dual<T, N> sin(const Dual<T, N> &a){
+
+   return (Chain(a, T(sin(a.v)), T(cos(a.v))));
+
+}
+
+template<class T, int N>
+inline Dual<T, N> cos(const Dual<T, N> &a){
+
+   return (Chain(a, T(cos(a.v)), T(-sin(a.v))));
+
+}
+
+template<class T, int N>
+inline Dual<T, N> pow(const Dual<T, N> &a, const T &n){
+
+   T pn1 = pow(a.v, n - T(1));
+   return (Chain(a, T(pn1 * a.v), T(n * pn1)));
+
+}
+
+/************************************************************************/
+/*
+ * ADModel<Expr> turns a model written only as an expression into a fit
+ * model for nlls_utils/nlls_solver.h. Expr provides
+ *
+ *      enum{ Npar = ... };
+ *      static const char *Name(const unsigned int &k);
+ *      static const char *Unit(const unsigned int &k);
+ *      template<class X, class P> static P Eval(const X &x, const P *p);
+ *
+ * and EvalGrad(...) evaluates Eval on Dual parameters to get the exact
+ * gradient, no derivative code needed. Eval has to be written with
+ * operations Dual supports (+ - * /, exp, log, sqrt, tanh, sin, cos,
+ * pow with a constant exponent).
+ */
+template<class Expr>
+struct ADModel{
+
+   enum{ Npar = Expr::Npar };
+
+   static const char *Name(const unsigned int &k){ return (Expr::Name(k)); }
+
+   static const char *Unit(const unsigned int &k){ return (Expr::Unit(k)); }
+
+   template<class T>
+   static inline T EvalGrad(const T &x, const T *p, T *grad){
+
+      Dual<T, Npar> pd[Npar];
+
+      //Seeded in place: copies of Dual(p[k], k) hide the zero seeds
+      //from DUAL_ZERO
+      DUAL_UNROLL for(int k = 0; k < Npar; k++){
+
+         pd[k].v = p[k];
+         DUAL_UNROLL for(int j = 0; j < Npar; j++){ pd[k].d[j] = T(j == k); }
+
+      }
+
+      Dual<T, Npar> f = Expr::Eval(x, pd);
+
+      DUAL_UNROLL for(int k = 0; k < Npar; k++){ grad[k] = f.d[k]; }
+
+      return (f.v);
+
+   }
+
+};
+
+#endif
@@ -0,0 +1,416 @@
+// -----------------------------------------------------------------------
+//
+//                                  fit_cache.cpp V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "fit_cache.h"
+
+/*
+ * Entry file: magic, size of the result, size of the output, then both
+ */
+static const char FitCacheMagic[8] = {'P', 'E', 'F', 'C', 'A', 'C', 'H', '1'};
+
+struct FitCacheHeader{
+
+   char magic[8];
+   uint64_t nres;
+   uint64_t nout;
+
+};
+
+/*
+ * Remembered hash of a file, valid while the file is unchanged
+ */
+struct FitCacheStat{
+
+   uint64_t dev, ino, size;
+   uint64_t mtime_s, mtime_ns;
+   uint64_t hash;
+
+};
+
+static const uint64_t P1 = 11400714785074694791ULL,
+                      P2 = 14029467366897019727ULL,
+                      P3 =  1609587929392839161ULL,
+                      P4 =  9650029242287828579ULL,
+                      P5 =  2870177450012600261ULL;
+
+/************************************************************************/
+static inline uint64_t rotl64(const uint64_t &x, const int &r){
+
+   return ((x << r) | (x >> (64 - r)));
+
+}
+
+static inline uint64_t read64(const unsigned char *p){
+
+   uint64_t v;
+
+   memcpy(&v, p, 8);
+   return (v);
+
+}
+
+static inline uint64_t read32(const unsigned char *p){
+
+   uint32_t v;
+
+   memcpy(&v, p, 4);
+   return (v);
+
+}
+
+static inline uint64_t xxround(uint64_t acc, const uint64_t &input){
+
+   acc += input * P2;
+   acc  = rotl64(acc, 31);
+   return (acc * P1);
+
+}
+
+static inline uint64_t xxmerge(uint64_t acc, const uint64_t &val){
+
+   acc ^= xxround(0, val);
+   return (acc * P1 + P4);
+
+}
+
+/************************************************************************/
+uint64_t FitCacheHash(const void *buf, const size_t &n, const uint64_t &seed){
+
+   const unsigned char *p   = (const unsigned char *)buf,
+                       *end = p + n;
+   uint64_t h = 0;
+
+   //Four independent lanes of 8 bytes per 32 byte stripe
+   if(n >= 32){
+
+      uint64_t v1 = seed + P1 + P2,
+               v2 = seed + P2,
+               v3 = seed,
+               v4 = seed - P1;
+
+      for(; p + 32 <= end; p += 32){
+
+         v1 = xxround(v1, read64(p));
+         v2 = xxround(v2, read64(p + 8));
+         v3 = xxround(v3, read64(p + 16));
+         v4 = xxround(v4, read64(p + 24));
+
+      }
+
+      h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+      h = xxmerge(h, v1);
+      h = xxmerge(h, v2);
+      h = xxmerge(h, v3);
+      h = xxmerge(h, v4);
+
+   }else{
+
+      h = seed + P5;
+
+   }
+
+   h += n;
+
+   for(; p + 8 <= end; p += 8){ h ^= xxround(0, read64(p)); h = rotl64(h, 27) * P1 + P4; }
+   if(p + 4 <= end){ h ^= read32(p) * P1; h = rotl64(h, 23) * P2 + P3; p += 4; }
+   for(; p < end; p++){ h ^= (*p) * P5; h = rotl64(h, 11) * P1; }
+
+   h ^= h >> 33;
+   h *= P2;
+   h ^= h >> 29;
+   h *= P3;
+   h ^= h >> 32;
+
+   return (h);
+
+}
+
+/************************************************************************/
+/*
+ * Read / write exactly n bytes
+ */
+static int FitCacheRead(const int &fd, void *buf, const size_t &n){
+
+   size_t done = 0;
+
+   while(done < n){
+
+      ssize_t r = read(fd, (char *)buf + done, n - done);
+
+      if(r < 0){ if(EINTR == errno){ continue; } return (0); }
+      if(0 == r){ return (0); }
+      done += r;
+
+   }
+
+   return (1);
+
+}
+
+static int FitCacheWrite(const int &fd, const void *buf, const size_t &n){
+
+   size_t done = 0;
+
+   while(done < n){
+
+      ssize_t r = write(fd, (const char *)buf + done, n - done);
+
+      if(r < 0){ if(EINTR == errno){ continue; } return (0); }
+      done += r;
+
+   }
+
+   return (1);
+
+}
+
+/************************************************************************/
+static std::string FitCacheHex(const uint64_t &key){
+
+   char hex[17];
+
+   snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)key);
+   return (std::string(hex));
+
+}
+
+static int FitCacheMkdir(const std::string &dir){
+
+   if((0 != mkdir(dir.c_str(), 0755)) && (EEXIST != errno)){
+
+      std::cerr << "ERROR: FitCache cannot create " << dir << ": ";
+      std::cerr << strerror(errno) << std::endl;
+      return (0);
+
+   }
+
+   return (1);
+
+}
+
+/*
+ * Writes a file under a temporary name and renames it into place
+ */
+static int FitCacheReplace(const std::string &path, const void *buf, const size_t &n){
+
+   std::string tmp = path + ".tmp" + std::to_string((long long)getpid()) + "." +
+                     std::to_string((unsigned long long)std::hash<std::thread::id>()(
+                                                      std::this_thread::get_id()));
+   int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644),
+       ok = 0;
+
+   if(fd < 0){ return (0); }
+
+   ok = FitCacheWrite(fd, buf, n);
+   ok = (0 == close(fd)) && ok;
+   ok = ok && (0 == rename(tmp.c_str(), path.c_str()));
+   if(!ok){ unlink(tmp.c_str()); }
+
+   return (ok);
+
+}
+
+/************************************************************************/
+int FitCacheFileHash(const char *dir, const char *filename, uint64_t &hash){
+
+   const size_t Nblock = 1 << 20;
+
+   struct stat st;
+   struct FitCacheStat S, old;
+   std::vector<unsigned char> block;
+   std::string stat_path;
+   char real[PATH_MAX];
+   int fd = open(filename, O_RDONLY),
+       ok = 1;
+
+   if(fd < 0){
+
+      std::cerr << "ERROR: FitCache cannot open " << filename << std::endl;
+      return (0);
+
+   }
+
+   if(0 != fstat(fd, &st)){ close(fd); return (0); }
+
+   S.dev      = st.st_dev;
+   S.ino      = st.st_ino;
+   S.size     = st.st_size;
+   S.mtime_s  = st.st_mtim.tv_sec;
+   S.mtime_ns = st.st_mtim.tv_nsec;
+   S.hash     = 0;
+
+   //The remembered hash, keyed by the absolute path
+   if((NULL != dir) && (NULL != realpath(filename, real))){
+
+      stat_path = std::string(dir) + "/stat/" + FitCacheHex(FitCacheHash(real, strlen(real), 0));
+
+      int sfd = open(stat_path.c_str(), O_RDONLY);
+
+      if(sfd >= 0){
+
+         if(FitCacheRead(sfd, &old, sizeof(old)) && (old.dev == S.dev) &&
+            (old.ino == S.ino) && (old.size == S.size) &&
+            (old.mtime_s == S.mtime_s) && (old.mtime_ns == S.mtime_ns)){
+
+            close(sfd);
+            close(fd);
+            hash = old.hash;
+            return (1);
+
+         }
+         close(sfd);
+
+      }
+
+   }
+
+   block.resize(Nblock);
+   for(;;){
+
+      ssize_t r = read(fd, &block[0], Nblock);
+
+      if(r < 0){ if(EINTR == errno){ continue; } ok = 0; break; }
+      if(0 == r){ break; }
+      S.hash = FitCacheHash(&block[0], r, S.hash);
+
+   }
+   close(fd);
+
+   if(!ok){
+
+      std::cerr << "ERROR: FitCache cannot read " << filename << std::endl;
+      return (0);
+
+   }
+
+   hash = S.hash;
+
+   //A file modified within the last second could change again without
+   //changing its mtime, its hash is not remembered
+   if(!stat_path.empty() && (time(NULL) > (time_t)S.mtime_s + 1) &&
+      FitCacheMkdir(dir) && FitCacheMkdir(std::string(dir) + "/stat")){
+
+      FitCacheReplace(stat_path, &S, sizeof(S));
+
+   }
+
+   return (1);
+
+}
+
+/************************************************************************/
+uint64_t FitCacheKey(const uint64_t &content, const std::vector<double> &opts){
+
+   uint64_t h = FitCacheHash(&FitCacheVersion, sizeof(FitCacheVersion), content);
+
+   if(!opts.empty()){ h = FitCacheHash(&opts[0], opts.size() * sizeof(double), h); }
+
+   return (h);
+
+}
+
+/************************************************************************/
+int FitCacheGet(const char *dir, const uint64_t &key, void *res,
+                const size_t &nres, std::string &output){
+
+   std::string path = std::string(dir) + "/" + FitCacheHex(key) + ".fit";
+   struct FitCacheHeader H;
+   int fd = open(path.c_str(), O_RDONLY),
+       ok = 0;
+
+   if(fd < 0){ return (0); }
+
+   //An entry of another struct size (another build) is a miss
+   if(FitCacheRead(fd, &H, sizeof(H)) && (0 == memcmp(H.magic, FitCacheMagic, 8)) &&
+      (H.nres == nres)){
+
+      output.resize(H.nout);
+      ok = FitCacheRead(fd, res, nres) &&
+           ((0 == H.nout) || FitCacheRead(fd, &output[0], H.nout));
+
+   }
+   close(fd);
+
+   return (ok);
+
+}
+
+/************************************************************************/
+int FitCachePut(const char *dir, const uint64_t &key, const void *res,
+                const size_t &nres, const char *output_filename){
+
+   std::string path = std::string(dir) + "/" + FitCacheHex(key) + ".fit",
+               buf;
+   struct FitCacheHeader H;
+   struct stat st;
+   int fd = open(output_filename, O_RDONLY),
+       ok = 0;
+
+   if(fd < 0){ return (0); }
+
+   if(0 == fstat(fd, &st)){
+
+      buf.resize(sizeof(H) + nres + st.st_size);
+      ok = (0 == st.st_size) || FitCacheRead(fd, &buf[sizeof(H) + nres], st.st_size);
+
+   }
+   close(fd);
+
+   if(!ok || !FitCacheMkdir(dir)){ return (0); }
+
+   memcpy(H.magic, FitCacheMagic, 8);
+   H.nres = nres;
+   H.nout = st.st_size;
+   memcpy(&buf[0], &H, sizeof(H));
+   memcpy(&buf[sizeof(H)], res, nres);
+
+   if(!FitCacheReplace(path, &buf[0], buf.size())){
+
+      std::cerr << "ERROR: FitCache cannot write " << path << std::endl;
+      return (0);
+
+   }
+
+   return (1);
+
+}
+
+/************************************************************************/
+int FitCacheWriteOutput(const char *output_filename, const std::string &output){
+
+   int fd = open(output_filename, O_WRONLY | O_CREAT | O_TRUNC, 0644),
+       ok = 0;
+
+   if(fd < 0){
+
+      std::cerr << "Error opening file:" << output_filename << std::endl;
+      return (0);
+
+   }
+
+   ok = output.empty() || FitCacheWrite(fd, output.data(), output.size());
+   ok = (0 == close(fd)) && ok;
+
+   return (ok);
+
+}
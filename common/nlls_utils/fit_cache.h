@@ -0,0 +1,111 @@
+// -----------------------------------------------------------------------
+//
+//                                   fit_cache.h V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef fit_cache_h
+#define fit_cache_h
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+/*
+ * Bump when a change of the fits or of the _fit.dat format makes the
+ * cached results stale, every key changes with it
+ */
+const uint64_t FitCacheVersion = 1;
+
+/************************************************************************/
+/*
+ * FitCacheHash(...) is a 64 bit hash of a buffer (the xxHash64
+ * algorithm, several GB/s), seed chains the hashes of consecutive
+ * blocks
+ *
+ *      @param[in] void *buf: the data
+ *      @param[in] size_t n: # bytes
+ *      @param[in] uint64_t seed: seed
+ *      @return uint64_t the hash
+ *
+ */
+uint64_t FitCacheHash(const void *buf, const size_t &n, const uint64_t &seed);
+
+/************************************************************************/
+/*
+ * FitCacheFileHash(...) hashes the content of a file, as it is stored
+ * (a .gz file is not inflated). The hash of a file is remembered in the
+ * cache directory with its inode, size and modification time (ns), and
+ * reused without reading the file while these do not change, as git and
+ * make do. With dir NULL the file is always read.
+ *
+ *      @param[in] char *dir: the cache directory (NULL = none)
+ *      @param[in] char *filename: the file
+ *      @param[out] uint64_t hash: the hash of its content
+ *      @return int success/failure (the file could not be read)
+ *
+ */
+int FitCacheFileHash(const char *dir, const char *filename, uint64_t &hash);
+
+/************************************************************************/
+/*
+ * FitCacheKey(...) combines the content hash of an input with every
+ * option that changes its fit: model, initial guess, tolerances, solver
+ * and preprocessing options, given as numbers (not as structs, whose
+ * padding bytes are undefined), and FitCacheVersion
+ *
+ *      @param[in] uint64_t content: hash of the input (FitCacheFileHash)
+ *      @param[in] std::vector opts: the options
+ *      @return uint64_t the key
+ *
+ */
+uint64_t FitCacheKey(const uint64_t &content, const std::vector<double> &opts);
+
+/************************************************************************/
+/*
+ * FitCacheGet(...) looks up a key in the cache directory. An entry holds
+ * the result of the fit (a plain struct of nres bytes) and the content
+ * of the _fit.dat file, so a hit needs neither the input nor the fit.
+ *
+ *      @param[in] char *dir: the cache directory
+ *      @param[in] uint64_t key: the key (FitCacheKey)
+ *      @param[out] void *res: the result, nres bytes
+ *      @param[in] size_t nres: size of the result
+ *      @param[out] std::string output: the content of the _fit.dat file
+ *      @return int 1 on a hit, 0 on a miss
+ *
+ */
+int FitCacheGet(const char *dir, const uint64_t &key, void *res,
+                const size_t &nres, std::string &output);
+
+/************************************************************************/
+/*
+ * FitCachePut(...) stores a result and the _fit.dat file written for it.
+ * The entry is written to a temporary file and renamed, so concurrent
+ * runs sharing the directory never read a partial entry.
+ *
+ *      @param[in] char *dir: the cache directory (created if needed)
+ *      @param[in] uint64_t key: the key (FitCacheKey)
+ *      @param[in] void *res: the result, nres bytes
+ *      @param[in] size_t nres: size of the result
+ *      @param[in] char *output_filename: the _fit.dat file
+ *      @return int success/failure
+ *
+ */
+int FitCachePut(const char *dir, const uint64_t &key, const void *res,
+                const size_t &nres, const char *output_filename);
+
+/************************************************************************/
+/*
+ * FitCacheWriteOutput(...) writes the cached content of a _fit.dat file
+ *
+ *      @param[in] char *output_filename: the _fit.dat file
+ *      @param[in] std::string output: its content
+ *      @return int success/failure
+ *
+ */
+int FitCacheWriteOutput(const char *output_filename, const std::string &output);
+
+#endif
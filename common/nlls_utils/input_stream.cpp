@@ -0,0 +1,455 @@
+// -----------------------------------------------------------------------
+//
+//                                  input_stream.cpp V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <exception>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "input_stream.h"
+
+/************************************************************************/
+/*
+ * Queues a full chunk, waiting while the queue is full. Returns 0 if the
+ * consumer closed the stream.
+ */
+static int InputPush(struct InputStream &S, std::vector<char> &chunk){
+
+   std::unique_lock<std::mutex> guard(S.lock);
+
+   while(!S.stop && (S.queue.size() >= (size_t)InputStream::Nqueue)){ S.room.wait(guard); }
+
+   if(S.stop){ return (0); }
+
+   S.queue.push_back(std::vector<char>());
+   S.queue.back().swap(chunk);
+   S.ready.notify_one();
+
+   return (1);
+
+}
+
+/************************************************************************/
+/*
+ * Reader of plain files
+ */
+static int InputReadPlain(struct InputStream &S){
+
+   std::vector<char> chunk;
+
+   while(1){
+
+      chunk.resize(InputStream::Nchunk);
+      chunk.resize(fread(&chunk[0], 1, InputStream::Nchunk, S.fp));
+
+      if(chunk.empty() && ferror(S.fp)){
+
+         std::cerr << "ERROR: reading " << S.filename << " failed" << std::endl;
+         return (0);
+
+      }
+
+      if(chunk.empty()){ return (1); }
+      if(!InputPush(S, chunk)){ return (1); }
+
+   }
+
+}
+
+#ifdef HAVE_ZLIB
+/************************************************************************/
+/*
+ * Reader of gzip files, concatenated gzip members are read as one
+ */
+static int InputReadGzip(struct InputStream &S){
+
+   std::vector<unsigned char> in(InputStream::Nchunk);
+   std::vector<char> chunk(InputStream::Nchunk);
+   z_stream zs;
+   int ret = Z_OK,
+       res = 0;
+
+   memset(&zs, 0, sizeof(zs));
+
+   //15 + 32: largest window, gzip or zlib header detected automatically
+   if(Z_OK != inflateInit2(&zs, 15 + 32)){
+
+      std::cerr << "ERROR: inflateInit2 failed for " << S.filename << std::endl;
+      return (0);
+
+   }
+
+   zs.next_out  = (Bytef *)&chunk[0];
+   zs.avail_out = InputStream::Nchunk;
+
+   while(1){
+
+      if(0 == zs.avail_in){
+
+         zs.next_in  = &in[0];
+         zs.avail_in = fread(&in[0], 1, InputStream::Nchunk, S.fp);
+
+         if(0 == zs.avail_in){
+
+            //End of the file, complete only right after a member ended
+            res = (Z_STREAM_END == ret) && !ferror(S.fp);
+            if(!res){ std::cerr << "ERROR: truncated gzip file " << S.filename << std::endl; }
+            break;
+
+         }
+
+      }
+
+      //The next member of a concatenated file
+      if(Z_STREAM_END == ret){ inflateReset(&zs); }
+
+      ret = inflate(&zs, Z_NO_FLUSH);
+
+      if((Z_OK != ret) && (Z_STREAM_END != ret) && (Z_BUF_ERROR != ret)){
+
+         std::cerr << "ERROR: corrupt gzip data in " << S.filename;
+         std::cerr << ": " << (zs.msg ? zs.msg : "") << std::endl;
+         break;
+
+      }
+
+      if(0 == zs.avail_out){
+
+         if(!InputPush(S, chunk)){ res = 1; break; }
+         chunk.resize(InputStream::Nchunk);
+         zs.next_out  = (Bytef *)&chunk[0];
+         zs.avail_out = InputStream::Nchunk;
+
+      }
+
+   }
+
+   //The last partial chunk
+   chunk.resize(InputStream::Nchunk - zs.avail_out);
+   if(res && !chunk.empty()){ InputPush(S, chunk); }
+
+   inflateEnd(&zs);
+
+   return (res);
+
+}
+#endif
+
+#ifdef HAVE_ZSTD
+/************************************************************************/
+/*
+ * Reader of zstd files, concatenated frames are read as one
+ */
+static int InputReadZstd(struct InputStream &S){
+
+   std::vector<char> in(InputStream::Nchunk),
+                     chunk(InputStream::Nchunk);
+   ZSTD_DStream *zs = ZSTD_createDStream();
+   ZSTD_inBuffer  zin  = {&in[0], 0, 0};
+   ZSTD_outBuffer zout = {&chunk[0], InputStream::Nchunk, 0};
+   size_t ret = 0;
+   int res = 0;
+
+   if((NULL == zs) || ZSTD_isError(ZSTD_initDStream(zs))){
+
+      std::cerr << "ERROR: ZSTD_initDStream failed for " << S.filename;
+      std::cerr << std::endl;
+      ZSTD_freeDStream(zs);
+      return (0);
+
+   }
+
+   while(1){
+
+      if(zin.pos == zin.size){
+
+         zin.size = fread(&in[0], 1, InputStream::Nchunk, S.fp);
+         zin.pos  = 0;
+
+         if(0 == zin.size){
+
+            //End of the file, complete only right after a frame ended
+            res = (0 == ret) && !ferror(S.fp);
+            if(!res){ std::cerr << "ERROR: truncated zstd file " << S.filename << std::endl; }
+            break;
+
+         }
+
+      }
+
+      ret = ZSTD_decompressStream(zs, &zout, &zin);
+
+      if(ZSTD_isError(ret)){
+
+         std::cerr << "ERROR: corrupt zstd data in " << S.filename;
+         std::cerr << ": " << ZSTD_getErrorName(ret) << std::endl;
+         break;
+
+      }
+
+      if(zout.pos == zout.size){
+
+         if(!InputPush(S, chunk)){ res = 1; break; }
+         chunk.resize(InputStream::Nchunk);
+         zout.dst = &chunk[0];
+         zout.pos = 0;
+
+      }
+
+   }
+
+   //The last partial chunk
+   chunk.resize(zout.pos);
+   if(res && !chunk.empty()){ InputPush(S, chunk); }
+
+   ZSTD_freeDStream(zs);
+
+   return (res);
+
+}
+#endif
+
+/************************************************************************/
+/*
+ * Body of the reader thread
+ */
+static void InputReader(struct InputStream *S){
+
+   int ok = 0;
+
+   switch(S->format){
+
+#ifdef HAVE_ZLIB
+      case INPUT_GZIP : ok = InputReadGzip(*S); break;
+#endif
+#ifdef HAVE_ZSTD
+      case INPUT_ZSTD : ok = InputReadZstd(*S); break;
+#endif
+      default         : ok = InputReadPlain(*S); break;
+
+   }
+
+   std::lock_guard<std::mutex> guard(S->lock);
+   S->done  = 1;
+   S->error = !ok;
+   S->ready.notify_one();
+
+}
+
+/************************************************************************/
+/*
+ * Makes the next queued chunk the current one, waiting for the reader.
+ * Returns 0 at the end of the data.
+ */
+static int InputNext(struct InputStream &S){
+
+   std::unique_lock<std::mutex> guard(S.lock);
+
+   while(S.queue.empty() && !S.done){ S.ready.wait(guard); }
+
+   if(S.queue.empty()){ return (0); }
+
+   S.cur.swap(S.queue.front());
+   S.queue.pop_front();
+   S.pos = 0;
+   S.room.notify_one();
+
+   return (1);
+
+}
+
+/************************************************************************/
+int OpenInputStream(const char *filename, struct InputStream &S){
+
+   unsigned char magic[4] = {0, 0, 0, 0};
+   size_t Nmagic = 0;
+
+   S.format   = INPUT_PLAIN;
+   S.filename = filename;
+   S.done     = 0;
+   S.error    = 0;
+   S.stop     = 0;
+   S.pos      = 0;
+   S.cur.clear();
+   S.queue.clear();
+
+   if(NULL == (S.fp = fopen(filename, "rb"))){
+
+      std::cerr << "Error opening file:" << filename << std::endl;
+      return (0);
+
+   }
+
+   Nmagic = fread(magic, 1, 4, S.fp);
+   rewind(S.fp);
+
+   if((Nmagic >= 2) && (0x1F == magic[0]) && (0x8B == magic[1])){
+
+      S.format = INPUT_GZIP;
+
+   }else if((4 == Nmagic) && (0x28 == magic[0]) && (0xB5 == magic[1]) &&
+                             (0x2F == magic[2]) && (0xFD == magic[3])){
+
+      S.format = INPUT_ZSTD;
+
+   }
+
+#ifndef HAVE_ZLIB
+   if(INPUT_GZIP == S.format){
+
+      std::cerr << "ERROR: " << filename << " is gzip compressed, but this";
+      std::cerr << " build has no zlib" << std::endl;
+      fclose(S.fp);
+      S.fp = NULL;
+      return (0);
+
+   }
+#endif
+
+#ifndef HAVE_ZSTD
+   if(INPUT_ZSTD == S.format){
+
+      std::cerr << "ERROR: " << filename << " is zstd compressed, but this";
+      std::cerr << " build has no libzstd" << std::endl;
+      fclose(S.fp);
+      S.fp = NULL;
+      return (0);
+
+   }
+#endif
+
+   try{
+
+      S.reader = std::thread(InputReader, &S);
+
+   }catch(std::exception& e){
+
+      std::cerr << "ERROR: cannot start the reader of " << filename << ": ";
+      std::cerr << e.what() << std::endl;
+      fclose(S.fp);
+      S.fp = NULL;
+      return (0);
+
+   }
+
+   return (1);
+
+}//End function OpenInputStream
+
+/************************************************************************/
+int InputStreamGetline(struct InputStream &S, std::string &line){
+
+   line.clear();
+
+   while(1){
+
+      if((S.pos == S.cur.size()) && !InputNext(S)){ return (!line.empty()); }
+
+      const char *c  = &S.cur[0] + S.pos,
+                 *nl = (const char *)memchr(c, '\n', S.cur.size() - S.pos);
+
+      if(NULL != nl){
+
+         line.append(c, nl - c);
+         S.pos += nl - c + 1;
+         return (1);
+
+      }
+
+      line.append(c, S.cur.size() - S.pos);
+      S.pos = S.cur.size();
+
+   }
+
+}//End function InputStreamGetline
+
+/************************************************************************/
+size_t InputStreamRead(struct InputStream &S, void *buf, const size_t &n){
+
+   size_t Nread = 0;
+
+   while(Nread < n){
+
+      if((S.pos == S.cur.size()) && !InputNext(S)){ break; }
+
+      size_t Ncopy = std::min(n - Nread, S.cur.size() - S.pos);
+
+      memcpy((char *)buf + Nread, &S.cur[0] + S.pos, Ncopy);
+      S.pos += Ncopy;
+      Nread += Ncopy;
+
+   }
+
+   return (Nread);
+
+}//End function InputStreamRead
+
+/************************************************************************/
+int ReadFileList(const char *filename, std::vector<std::string> &files){
+
+   struct InputStream S;
+   std::string line;
+
+   files.clear();
+
+   if(!OpenInputStream(filename, S)){ return (0); }
+
+   while(InputStreamGetline(S, line)){
+
+      size_t b = line.find_first_not_of(" \t\r"),
+             e = line.find_last_not_of(" \t\r");
+
+      if((std::string::npos == b) || ('#' == line[b])){ continue; }
+
+      files.push_back(line.substr(b, e - b + 1));
+
+   }
+
+   return (CloseInputStream(S));
+
+}//End function ReadFileList
+
+/************************************************************************/
+int CloseInputStream(struct InputStream &S){
+
+   int res = 1;
+
+   if(S.reader.joinable()){
+
+      {
+         std::lock_guard<std::mutex> guard(S.lock);
+         S.stop = 1;
+         S.room.notify_one();
+      }
+
+      S.reader.join();
+
+   }
+
+   res = !S.error;
+
+   if(NULL != S.fp){ fclose(S.fp); }
+   S.fp = NULL;
+   S.queue.clear();
+   S.cur.clear();
+   S.pos = 0;
+
+   return (res);
+
+}//End function CloseInputStream
@@ -0,0 +1,153 @@
+// -----------------------------------------------------------------------
+//
+//                                   input_stream.h V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef input_stream_h
+#define input_stream_h
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/*
+ * Formats recognized from the first bytes of a file (not the extension)
+ */
+enum InputFormat{ INPUT_PLAIN = 0, INPUT_GZIP = 1, INPUT_ZSTD = 2 };
+
+/*
+ * An input file read ahead, and decompressed if needed, by its own
+ * thread. The reader hands fixed size chunks to the consumer through a
+ * queue of at most Nqueue chunks, so memory stays bounded by
+ * (Nqueue + 2) * Nchunk bytes whatever the size of the file, and the
+ * decompression of the next chunks overlaps the parsing of this one.
+ *
+ * gzip needs zlib (HAVE_ZLIB), zstd needs libzstd (HAVE_ZSTD). Both are
+ * detected by cmake, a compressed file whose library is missing is an
+ * error when it is opened.
+ */
+struct InputStream{
+
+   enum{ Nchunk = 1 << 20, //Bytes per chunk
+         Nqueue = 4 };     //Chunks decompressed ahead
+
+   int format;                           //InputFormat of the file
+   FILE *fp;                             //The (compressed) file
+   std::string filename;                 //For the error messages
+
+   std::thread reader;                   //Reads and decompresses
+   std::mutex lock;                      //Guards the fields below
+   std::condition_variable ready,        //A chunk was queued or done set
+                           room;         //A chunk was taken or stop set
+   std::deque<std::vector<char> > queue; //Decompressed chunks in order
+   int done,                             //The reader has finished
+       error,                            //... because of an error
+       stop;                             //The consumer closed the stream
+
+   std::vector<char> cur;                //Chunk being consumed
+   size_t pos;                           //Next byte of cur
+
+};
+
+/************************************************************************/
+/*
+ * OpenInputStream(...) opens a plain, gzip or zstd file and starts its
+ * reader thread. Every opened stream must be closed with
+ * CloseInputStream, also after an error.
+ *
+ *      @param[in] char *filename: input file name
+ *      @param[out] InputStream S: the stream
+ *      @return int success/failure
+ *
+ */
+int OpenInputStream(const char *filename, struct InputStream &S);
+
+/************************************************************************/
+/*
+ * InputStreamGetline(...) reads the next line without its '\n', like
+ * std::getline.
+ *
+ *      @param[in] InputStream S: the stream
+ *      @param[out] std::string line: the line
+ *      @return int 1 if a line was read, 0 at the end of the data
+ *
+ */
+int InputStreamGetline(struct InputStream &S, std::string &line);
+
+/************************************************************************/
+/*
+ * InputStreamRead(...) reads up to n bytes
+ *
+ *      @param[in] InputStream S: the stream
+ *      @param[out] void *buf: at least n bytes
+ *      @param[in] size_t n: bytes wanted
+ *      @return size_t bytes read, less than n only at the end of the data
+ *
+ */
+size_t InputStreamRead(struct InputStream &S, void *buf, const size_t &n);
+
+/************************************************************************/
+/*
+ * ReadFileList(...) reads file names, one per line. Blank lines and
+ * lines starting with '#' are skipped, leading and trailing white space
+ * is removed.
+ *
+ *      @param[in] char *filename: the list (plain or compressed)
+ *      @param[out] std::vector files: the file names
+ *      @return int success/failure
+ *
+ */
+int ReadFileList(const char *filename, std::vector<std::string> &files);
+
+/************************************************************************/
+/*
+ * InputStem(...) returns the file name without a .gz or .zst suffix and
+ * without the 4 character extension after that, the stem of the output
+ * file names (data.dat.gz -> data)
+ *
+ *      @param[in] char *filename: input file name
+ *      @return std::string the stem
+ *
+ */
+inline std::string InputStem(const char *filename){
+
+   std::string stem(filename);
+   const char *suffix[2] = {".gz", ".zst"};
+
+   for(int k = 0; k < 2; k++){
+
+      size_t n = std::string(suffix[k]).length();
+
+      if((stem.length() > n) && (0 == stem.compare(stem.length() - n, n, suffix[k]))){
+
+         stem.resize(stem.length() - n);
+         break;
+
+      }
+
+   }
+
+   stem.resize((stem.length() > 4) ? stem.length() - 4 : 0);
+
+   return (stem);
+
+}
+
+/************************************************************************/
+/*
+ * CloseInputStream(...) stops the reader thread and closes the file
+ *
+ *      @param[in] InputStream S: the stream
+ *      @return int 0 if the data was truncated or corrupt, 1 otherwise
+ *
+ */
+int CloseInputStream(struct InputStream &S);
+
+#endif
@@ -0,0 +1,120 @@
+// -----------------------------------------------------------------------
+//
+//                                   model_bench.h V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef model_bench_h
+#define model_bench_h
+
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <math.h>
+
+#include "nlls_solver.h"
+
+/************************************************************************/
+/*
+ * GradientAgreement<ModelA, ModelB>(...) evaluates two implementations
+ * of the same model at every x and returns the largest relative
+ * difference |fa - fb| / (|fa| + |fb|) of the value (index Npar) and of
+ * every partial derivative (index 0 ... Npar-1).
+ *
+ *      @param[in] std::vector x: evaluation points
+ *      @param[in] double *p: model parameters
+ *      @param[out] std::vector maxrel: Npar + 1 largest relative differences
+ *
+ */
+template<class ModelA, class ModelB>
+void GradientAgreement(const std::vector<double> &x, const double *p,
+                                          std::vector<double> &maxrel){
+
+   const unsigned int Npar = ModelA::Npar;
+
+   double ga[ModelA::Npar + 1],
+          gb[ModelB::Npar + 1];
+
+   maxrel.assign(Npar + 1, 0.0);
+
+   for(unsigned int i = 0; i < x.size(); i++){
+
+      ga[Npar] = ModelA::EvalGrad(x[i], p, ga);
+      gb[Npar] = ModelB::EvalGrad(x[i], p, gb);
+
+      for(unsigned int k = 0; k <= Npar; k++){
+
+         double den = fabs(ga[k]) + fabs(gb[k]);
+
+         if(den > 0.0){ maxrel[k] = std::max(maxrel[k], fabs(ga[k] - gb[k]) / den); }
+
+      }
+
+   }
+
+}
+
+/************************************************************************/
+/*
+ * TimeFitPassSamples<Model>(...) times Npass full Gauss-Newton
+ * iterations of NLLSFitSamples<Model> (the fused residual, gradient and
+ * normal equation pass plus the Npar x Npar solve) on any samples type
+ * started at p, and returns the mean time per data point per pass.
+ *
+ *      @param[in] Samples S: the data
+ *      @param[in] long Npoints: # samples
+ *      @param[in] double *p: starting parameters (not modified)
+ *      @param[in] int Npass: number of passes
+ *      @return double: nanoseconds per point per pass (< 0 on failure)
+ *
+ */
+template<class Model, class Samples>
+double TimeFitPassSamples(const Samples S, const unsigned long &Npoints,
+                          const double *p, const unsigned int &Npass){
+
+   double param[Model::Npar],
+          cov[Model::Npar * Model::Npar];
+
+   struct NLLSStats Stats;
+
+   for(int k = 0; k < Model::Npar; k++){ param[k] = p[k]; }
+
+   if((0 == Npoints) || (0 == Npass)){ return (-1.0); }
+
+   //A negative tolerance never converges, so exactly Npass passes run
+   std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+   int ok = NLLSFitSamples<Model>(S, Npoints, Npass, -1.0, param, cov, Stats);
+   std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+
+   if(!ok){ return (-1.0); }
+
+   return (std::chrono::duration<double, std::nano>(t1 - t0).count() /
+                                          ((double)Npoints * Npass));
+
+}
+
+/************************************************************************/
+/*
+ * TimeFitPass<Model>(...) is TimeFitPassSamples(...) on double arrays
+ *
+ *      @param[in] std::vector x: independent variable
+ *      @param[in] std::vector y: measurements
+ *      @param[in] double *p: starting parameters (not modified)
+ *      @param[in] int Npass: number of passes
+ *      @return double: nanoseconds per point per pass (< 0 on failure)
+ *
+ */
+template<class Model>
+double TimeFitPass(const std::vector<double> &x, const std::vector<double> &y,
+                   const double *p, const unsigned int &Npass){
+
+   if(x.empty()){ return (-1.0); }
+
+   return (TimeFitPassSamples<Model>(ArraySamples(&x[0], &y[0], NULL), x.size(),
+                                     p, Npass));
+
+}
+
+#endif
@@ -0,0 +1,217 @@
+// -----------------------------------------------------------------------
+//
+//                                   mpi_batch.cpp V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <stdlib.h>
+#include <math.h>
+
+#include "mpi_batch.h"
+
+/*
+ * Messages between the ranks and rank 0
+ */
+enum{ MPI_BATCH_REQUEST = 1, // Rank -> 0: give me a chunk
+      MPI_BATCH_CHUNK   = 2  // 0 -> rank: [lo, hi), empty when done
+};
+
+typedef std::chrono::steady_clock MPIClock;
+
+/************************************************************************/
+static double MPISeconds(const MPIClock::time_point &t0){
+
+   return (std::chrono::duration<double>(MPIClock::now() - t0).count());
+
+}
+
+static void MPIBatchFinalize(){
+
+   int finalized = 0;
+
+   MPI_Finalized(&finalized);
+   if(!finalized){ MPI_Finalize(); }
+
+}
+
+/************************************************************************/
+int MPIBatchInit(int *argc, char ***argv){
+
+   int rank = 0;
+
+   MPI_Init(argc, argv);
+   atexit(MPIBatchFinalize);
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+   return (rank);
+
+}
+
+/************************************************************************/
+int MPIBatch(const unsigned int &N, const struct MPIBatchOptions &Opts,
+             const std::function<void(const unsigned int &lo,
+                                      const unsigned int &hi)> &run,
+             std::vector<struct MPIRankStats> &Stats){
+
+   const unsigned int Nmin   = (0 == Opts.Nmin) ? 1 : Opts.Nmin;
+   const double       factor = (Opts.factor > 0.0) ? Opts.factor : 2.0;
+
+   MPIClock::time_point t0 = MPIClock::now();
+   struct MPIRankStats S = {0, 0, 0.0, 0.0, 0.0};
+   int rank = 0,
+       size = 1,
+       dummy = 0;
+
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+   MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+   auto timed_run = [&](const unsigned int &lo, const unsigned int &hi){
+
+      MPIClock::time_point t = MPIClock::now();
+
+      run(lo, hi);
+      S.t_busy += MPISeconds(t);
+      S.Nitems += hi - lo;
+      S.Nchunks++;
+
+   };
+
+   if((0 == rank) && (1 == size)){
+
+      if(N > 0){ timed_run(0, N); }
+
+   }else if(0 == rank){
+
+      unsigned int next = 0;
+      int Nactive = size - 1;
+
+      while((next < N) || (Nactive > 0)){
+
+         MPI_Status st;
+         int flag = 0;
+
+         //Answer the waiting ranks first, block once there is no work
+         //left for this rank
+         if(next < N){
+
+            MPI_Iprobe(MPI_ANY_SOURCE, MPI_BATCH_REQUEST, MPI_COMM_WORLD, &flag, &st);
+
+         }else{
+
+            MPIClock::time_point t = MPIClock::now();
+
+            MPI_Probe(MPI_ANY_SOURCE, MPI_BATCH_REQUEST, MPI_COMM_WORLD, &st);
+            S.t_wait += MPISeconds(t);
+            flag = 1;
+
+         }
+
+         if(flag){
+
+            unsigned int range[2],
+                         c = ceil((N - next) / (factor * size));
+
+            MPI_Recv(&dummy, 1, MPI_INT, st.MPI_SOURCE, MPI_BATCH_REQUEST,
+                     MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+            c = std::min(std::max(c, Nmin), N - next);
+            range[0] = next;
+            range[1] = next + c;
+            next += c;
+            if(0 == c){ Nactive--; }
+
+            MPI_Send(range, 2, MPI_UNSIGNED, st.MPI_SOURCE, MPI_BATCH_CHUNK,
+                     MPI_COMM_WORLD);
+            continue;
+
+         }
+
+         timed_run(next, next + 1);
+         next++;
+
+      }
+
+   }else{
+
+      for(;;){
+
+         MPIClock::time_point t = MPIClock::now();
+         unsigned int range[2];
+
+         MPI_Send(&dummy, 1, MPI_INT, 0, MPI_BATCH_REQUEST, MPI_COMM_WORLD);
+         MPI_Recv(range, 2, MPI_UNSIGNED, 0, MPI_BATCH_CHUNK, MPI_COMM_WORLD,
+                  MPI_STATUS_IGNORE);
+         S.t_wait += MPISeconds(t);
+
+         if(range[0] == range[1]){ break; }
+         timed_run(range[0], range[1]);
+
+      }
+
+   }
+
+   S.t_wall = MPISeconds(t0);
+
+   //Collect the time spent by every rank on rank 0
+   double mine[5] = {(double)S.Nitems, (double)S.Nchunks, S.t_busy, S.t_wait,
+                     S.t_wall};
+   std::vector<double> all(5 * size);
+
+   MPI_Gather(mine, 5, MPI_DOUBLE, all.data(), 5, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+   Stats.clear();
+   if(0 == rank){
+
+      for(int r = 0; r < size; r++){
+
+         struct MPIRankStats R = {(unsigned int)all[5 * r], (unsigned int)all[5 * r + 1],
+                                  all[5 * r + 2], all[5 * r + 3], all[5 * r + 4]};
+         Stats.push_back(R);
+
+      }
+
+   }
+
+   return (1);
+
+}
+
+/************************************************************************/
+void PrintMPIRankStats(const std::vector<struct MPIRankStats> &Stats){
+
+   std::ios::fmtflags flags = std::cout.flags();
+   std::streamsize prec = std::cout.precision();
+   double t_wall = 0.0,
+          t_busy = 0.0;
+
+   std::cout << std::fixed << std::setprecision(3);
+   std::cout << "MPI ranks [s]:" << std::endl;
+   std::cout << " rank  items  chunks     busy     wait     wall" << std::endl;
+
+   for(unsigned int r = 0; r < Stats.size(); r++){
+
+      const struct MPIRankStats &R = Stats[r];
+
+      std::cout << std::setw(5) << r << std::setw(7) << R.Nitems;
+      std::cout << std::setw(8) << R.Nchunks << std::setw(9) << R.t_busy;
+      std::cout << std::setw(9) << R.t_wait << std::setw(9) << R.t_wall;
+      std::cout << std::endl;
+      t_wall = std::max(t_wall, R.t_wall);
+      t_busy += R.t_busy;
+
+   }
+
+   std::cout << " wall time [s]         : " << t_wall << std::endl;
+   std::cout << " sum of busy times [s] : " << t_busy << std::endl;
+
+   std::cout.flags(flags);
+   std::cout.precision(prec);
+
+}//End function PrintMPIRankStats
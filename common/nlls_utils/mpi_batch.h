@@ -0,0 +1,135 @@
+// -----------------------------------------------------------------------
+//
+//                                   mpi_batch.h V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef mpi_batch_h
+#define mpi_batch_h
+
+#include <vector>
+#include <functional>
+#include <mpi.h>
+
+/*
+ * Chunking of a batch over the MPI ranks, see MPIBatch(...)
+ */
+struct MPIBatchOptions{
+
+   unsigned int Nmin; //Smallest chunk handed out (0 = 1)
+   double factor;     //A chunk is remaining / (factor * # ranks) (0 = 2)
+
+};
+
+/*
+ * Time spent by one rank
+ */
+struct MPIRankStats{
+
+   unsigned int Nitems;  //# items run by the rank
+   unsigned int Nchunks; //# chunks run by the rank
+   double t_busy;        //Time spent running chunks [s]
+   double t_wait;        //Time spent waiting for a chunk or a request [s]
+   double t_wall;        //Wall time of MPIBatch [s]
+
+};
+
+/************************************************************************/
+/*
+ * MPIBatchInit(...) initializes MPI, MPI_Finalize is called at exit
+ *
+ *      @param[in] int *argc, char ***argv: the arguments of main
+ *      @return int the rank of this process
+ *
+ */
+int MPIBatchInit(int *argc, char ***argv);
+
+/************************************************************************/
+/*
+ * MPIBatch(...) runs items [0, N) over the ranks of MPI_COMM_WORLD with
+ * guided self-scheduling: a rank that is done asks rank 0 for the next
+ * chunk, of remaining / (factor * # ranks) items but at least Nmin, so
+ * chunks start large (few messages) and shrink towards the end (the
+ * ranks finish together whatever the cost of each item). Rank 0 hands
+ * out the chunks and runs one item at a time in between, so it answers
+ * within the time of one item. Every rank must call it.
+ *
+ *      @param[in] unsigned int N: # items
+ *      @param[in] MPIBatchOptions Opts: chunking
+ *      @param[in] run: runs the items [lo, hi) on this rank
+ *      @param[out] std::vector Stats: on rank 0, the time spent by every
+ *                  rank
+ *      @return int success/failure
+ *
+ */
+int MPIBatch(const unsigned int &N, const struct MPIBatchOptions &Opts,
+             const std::function<void(const unsigned int &lo,
+                                      const unsigned int &hi)> &run,
+             std::vector<struct MPIRankStats> &Stats);
+
+/************************************************************************/
+/*
+ * PrintMPIRankStats(...) prints the time spent by every rank
+ *
+ *      @param[in] std::vector Stats: from MPIBatch
+ *
+ */
+void PrintMPIRankStats(const std::vector<struct MPIRankStats> &Stats);
+
+/************************************************************************/
+/*
+ * MPIGatherResults(...) collects on rank 0 the results computed by
+ * every rank. T must be a plain struct, it is sent as bytes.
+ *
+ *      @param[in/out] std::vector Results: one per item, on rank 0 all
+ *                     of them on return
+ *      @param[in] std::vector mine: the items run by this rank
+ *
+ */
+template <typename T>
+void MPIGatherResults(std::vector<T> &Results, const std::vector<unsigned int> &mine){
+
+   int rank = 0,
+       size = 1,
+       n    = mine.size(),
+       total = 0;
+
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+   MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+   std::vector<int> counts(size), displs(size), bcounts(size), bdispls(size);
+   std::vector<unsigned int> idx;
+   std::vector<T> send(n), recv;
+
+   for(int k = 0; k < n; k++){ send[k] = Results[mine[k]]; }
+
+   MPI_Gather(&n, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+   if(0 == rank){
+
+      for(int r = 0; r < size; r++){
+
+         displs[r]  = total;
+         bcounts[r] = counts[r] * sizeof(T);
+         bdispls[r] = total * sizeof(T);
+         total     += counts[r];
+
+      }
+
+      idx.resize(total);
+      recv.resize(total);
+
+   }
+
+   MPI_Gatherv(mine.data(), n, MPI_UNSIGNED, idx.data(), counts.data(),
+               displs.data(), MPI_UNSIGNED, 0, MPI_COMM_WORLD);
+   MPI_Gatherv(send.data(), n * sizeof(T), MPI_BYTE, recv.data(), bcounts.data(),
+               bdispls.data(), MPI_BYTE, 0, MPI_COMM_WORLD);
+
+   for(int k = 0; k < total; k++){ Results[idx[k]] = recv[k]; }
+
+}
+
+#endif
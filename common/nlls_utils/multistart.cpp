@@ -0,0 +1,91 @@
+// -----------------------------------------------------------------------
+//
+//                                   multistart.cpp V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+
+#include "multistart.h"
+#include "bootstrap.h"
+
+/************************************************************************/
+/*
+ * One random permutation of the strata per axis (Fisher-Yates) and a
+ * uniform offset inside every stratum.
+ */
+void LatinHypercube(const std::vector<double> &lo,
+                    const std::vector<double> &hi,
+                    const std::vector<int> &logscale,
+                    const unsigned int &N, const uint64_t &seed,
+                                            std::vector<double> &p){
+
+   const unsigned int Npar = lo.size();
+
+   uint64_t state = seed;
+   std::vector<unsigned int> perm(N);
+
+   p.assign(N * Npar, 0.0);
+
+   for(unsigned int k = 0; k < Npar; k++){
+
+      double a = logscale[k] ? log(lo[k]) : lo[k],
+             b = logscale[k] ? log(hi[k]) : hi[k];
+
+      for(unsigned int i = 0; i < N; i++){ perm[i] = i; }
+      for(unsigned int i = N; i > 1; i--){
+
+         std::swap(perm[i - 1], perm[SplitMix64(state) % i]);
+
+      }
+
+      for(unsigned int i = 0; i < N; i++){
+
+         //53 random bits -> uniform [0, 1)
+         double u = (perm[i] + ldexp((double)(SplitMix64(state) >> 11), -53)) / N,
+                v = a + u * (b - a);
+
+         p[i * Npar + k] = logscale[k] ? exp(v) : v;
+
+      }
+
+   }
+
+} //End function LatinHypercube
+
+/************************************************************************/
+/*
+ * Noise variance from the first differences of the x sorted data.
+ */
+double NoiseFloorChi2(const std::vector<double> &x,
+                      const std::vector<double> &y,
+                      const std::vector<double> &w,
+                      const unsigned int &Npar){
+
+   const unsigned int Npoi = x.size();
+
+   std::vector<unsigned int> idx(Npoi);
+   double s2 = 0.0;
+
+   if((Npoi <= Npar) || (Npoi < 3) || (y.size() != Npoi)){ return (0.0); }
+
+   for(unsigned int i = 0; i < Npoi; i++){ idx[i] = i; }
+   std::stable_sort(idx.begin(), idx.end(),
+                    [&](unsigned int a, unsigned int b){ return (x[a] < x[b]); });
+
+   for(unsigned int i = 0; i + 1 < Npoi; i++){
+
+      double dy = y[idx[i + 1]] - y[idx[i]],
+             v  = w.empty() ? 2.0 : 1.0 / w[idx[i]] + 1.0 / w[idx[i + 1]];
+
+      s2 += dy * dy / v;
+
+   }
+
+return ((Npoi - Npar) * s2 / (Npoi - 1));
+} //End function NoiseFloorChi2
@@ -0,0 +1,229 @@
+// -----------------------------------------------------------------------
+//
+//                                    multistart.h V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef multistart_h
+#define multistart_h
+
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <stdint.h>
+
+#include "parallel_for.h"
+
+struct MultiStartOptions{
+
+   unsigned int Nstart;   //Number of initial guesses (incl. the user guess)
+   unsigned int Nthreads; //Number of threads (0 = all hardware threads)
+   uint64_t     seed;     //Random seed of the Latin hypercube
+   unsigned int Ntrunc;   //Iterations of the cheap truncated fits
+   unsigned int Npolish;  //Number of best candidates fitted to convergence
+   double       floor_tol;//Stop early once chi^2 <= floor_tol * noise floor
+
+};
+
+struct MultiStartResult{
+
+   std::vector<double> start;  //Nstart x Npar initial guesses, row major
+   std::vector<double> param;  //Nstart x Npar parameters after Ntrunc iterations
+   std::vector<double> score;  //Nstart chi^2 after the truncated fits
+   std::vector<int>    ok;     //Nstart flags: truncated fit ran and succeeded
+   unsigned int        Nrun;   //Number of truncated fits actually run
+   unsigned int        Npol;   //Number of polished candidates
+   int                 best;   //Index of the best candidate (-1 = none)
+   double              chi2;   //chi^2 of the best polished fit
+   double              floor;  //Noise floor estimate of chi^2
+   int                 early;  //1 if a candidate hit the noise floor
+
+};
+
+/************************************************************************/
+/*
+ * LatinHypercube(...) draws N points in the box lo <= p <= hi such that
+ * every parameter axis, cut into N equal strata, has exactly one point
+ * per stratum. Axes with logscale set are stratified in log(p), which
+ * suits positive scale parameters spanning decades.
+ *
+ *      @param[in] std::vector lo: lower bounds (> 0 on log axes)
+ *      @param[in] std::vector hi: upper bounds
+ *      @param[in] std::vector logscale: 1 = stratify in log(p)
+ *      @param[in] int N: number of points
+ *      @param[in] uint64_t seed: random seed
+ *      @param[out] std::vector p: N x Npar points, row major
+ *
+ */
+void LatinHypercube(const std::vector<double> &lo,
+                    const std::vector<double> &hi,
+                    const std::vector<int> &logscale,
+                    const unsigned int &N, const uint64_t &seed,
+                                            std::vector<double> &p);
+
+/************************************************************************/
+/*
+ * NoiseFloorChi2(...) estimates the chi^2 an ideal fit would reach from
+ * first differences of the data sorted by x. For a model that is smooth
+ * on the sample spacing, y[i+1] - y[i] is mostly noise, so
+ *
+ *      s2 = sum (dy^2 / (1/w[i] + 1/w[i+1])) / (N - 1)
+ *
+ * estimates the (weighted) noise variance and the floor is
+ * (N - Npar) * s2. Sharp model features bias s2 high, which only makes
+ * the early stop trigger a little sooner.
+ *
+ *      @param[in] std::vector x: independent variable
+ *      @param[in] std::vector y: measurements
+ *      @param[in] std::vector w: weights (empty = 1)
+ *      @param[in] int Npar: number of fit parameters
+ *      @return double: chi^2 noise floor (0 if it cannot be estimated)
+ *
+ */
+double NoiseFloorChi2(const std::vector<double> &x,
+                      const std::vector<double> &y,
+                      const std::vector<double> &w,
+                      const unsigned int &Npar);
+
+/************************************************************************/
+/*
+ * MultiStart(...) searches for a good initial guess of a nonlinear fit.
+ *
+ *      1) Candidate 0 is the user guess p0, the other Nstart - 1 are a
+ *         Latin hypercube over the box [lo, hi].
+ *      2) Every candidate gets Ntrunc iterations of the fit in parallel
+ *         and is scored by its chi^2. As soon as one candidate reaches
+ *         floor_tol * noise floor the remaining ones are cancelled.
+ *      3) The Npolish best scoring candidates continue to convergence
+ *         in parallel and the lowest chi^2 wins.
+ *
+ * Candidates are claimed in index order, so with one thread the result
+ * is fully reproducible. With several threads the early stop may see a
+ * few more or fewer candidates.
+ *
+ *      @param[in] std::vector p0: user initial guess
+ *      @param[in] std::vector lo: lower bounds of the search box
+ *      @param[in] std::vector hi: upper bounds of the search box
+ *      @param[in] std::vector logscale: 1 = sample axis in log(p)
+ *      @param[in] double floor: chi^2 noise floor (<= 0 disables the
+ *                               early stop)
+ *      @param[in] Fit fit: callable as
+ *                 int fit(double *param, unsigned int Niter, double &chi2)
+ *                 which fits in place starting from param with at most
+ *                 Niter iterations (0 = until converged) and returns chi2
+ *      @param[in] MultiStartOptions opts: options
+ *      @param[out] std::vector p: best fit parameters
+ *      @param[out] MultiStartResult R: details of the search
+ *      @return int success/failure
+ *
+ */
+template<class Fit>
+int MultiStart(const std::vector<double> &p0, const std::vector<double> &lo,
+               const std::vector<double> &hi, const std::vector<int> &logscale,
+               const double &floor, Fit fit,
+               const struct MultiStartOptions &opts, std::vector<double> &p,
+                                                 struct MultiStartResult &R){
+
+   const unsigned int Npar   = p0.size(),
+                      Nstart = std::max(opts.Nstart, 1u);
+
+   std::atomic<int> done(0);        //Set once a candidate hits the floor
+   std::atomic<unsigned int> Nrun(0);
+   std::vector<double> lhs,
+                       polished,    //Npolish x Npar polished parameters
+                       pchi2;       //Npolish chi^2 of the polished fits
+   std::vector<int> order,
+                    pok;
+
+   R.best  = -1;
+   R.chi2  = NAN;
+   R.floor = floor;
+   R.early = 0;
+   R.Npol  = 0;
+
+   if((lo.size() != Npar) || (hi.size() != Npar) ||
+      (logscale.size() != Npar)){
+
+      return (0);
+
+   }
+
+   //Candidate 0 is the user guess
+   LatinHypercube(lo, hi, logscale, Nstart - 1, opts.seed, lhs);
+   R.start.assign(p0.begin(), p0.end());
+   R.start.insert(R.start.end(), lhs.begin(), lhs.end());
+   R.param.assign(R.start.begin(), R.start.end());
+   R.score.assign(Nstart, NAN);
+   R.ok.assign(Nstart, 0);
+
+   //Cheap truncated fits, cancelled once one reaches the noise floor
+   ParallelFor(Nstart, opts.Nthreads, [&](unsigned int c, unsigned int thread){
+
+      if(done.load()){ return; }
+
+      double *param = &R.param[c * Npar],
+             chi2   = NAN;
+
+      ++Nrun;
+      if(!fit(param, std::max(opts.Ntrunc, 1u), chi2) || !std::isfinite(chi2)){
+
+         return;
+
+      }
+
+      R.score[c] = chi2;
+      R.ok[c] = 1;
+
+      if((floor > 0.0) && (chi2 <= opts.floor_tol * floor)){ done = 1; }
+
+   });
+
+   R.Nrun  = Nrun.load();
+   R.early = done.load();
+
+   for(unsigned int c = 0; c < Nstart; c++){ if(R.ok[c]){ order.push_back(c); } }
+   if(order.empty()){ return (0); }
+
+   std::stable_sort(order.begin(), order.end(),
+                    [&](int a, int b){ return (R.score[a] < R.score[b]); });
+   R.Npol = std::min((unsigned int)order.size(), std::max(opts.Npolish, 1u));
+
+   //Polish the best candidates to convergence, from where Ntrunc stopped
+   polished.assign(R.Npol * Npar, 0.0);
+   pchi2.assign(R.Npol, NAN);
+   pok.assign(R.Npol, 0);
+
+   ParallelFor(R.Npol, opts.Nthreads, [&](unsigned int k, unsigned int thread){
+
+      double *param = &polished[k * Npar];
+
+      for(unsigned int j = 0; j < Npar; j++){
+
+         param[j] = R.param[order[k] * Npar + j];
+
+      }
+      pok[k] = fit(param, 0, pchi2[k]) && std::isfinite(pchi2[k]);
+
+   });
+
+   for(unsigned int k = 0; k < R.Npol; k++){
+
+      if(pok[k] && ((R.best < 0) || (pchi2[k] < R.chi2))){
+
+         R.best = order[k];
+         R.chi2 = pchi2[k];
+         p.assign(polished.begin() + k * Npar,
+                  polished.begin() + (k + 1) * Npar);
+
+      }
+
+   }
+
+   return (R.best >= 0);
+
+}
+
+#endif
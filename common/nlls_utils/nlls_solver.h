@@ -0,0 +1,540 @@
+// -----------------------------------------------------------------------
+//
+//                                   nlls_solver.h V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef nlls_solver_h
+#define nlls_solver_h
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <new>
+#include <math.h>
+#include <float.h>
+
+#include "matrix_utils/matrix_ops.h"
+#include "robust_loss.h"
+
+/************************************************************************/
+/*
+ * A fit model is a type with compile time traits and an inlineable
+ * evaluation, e.g.
+ *
+ *      struct MyModel{
+ *
+ *         enum{ Npar = 2 };                          //# fit parameters
+ *
+ *         static const char *Name(const unsigned int &k); //Parameter name
+ *         static const char *Unit(const unsigned int &k); //Parameter unit
+ *
+ *         //f(x; p) and grad[k] = df/dp[k], for T = double and float
+ *         template<class T>
+ *         static inline T EvalGrad(const T &x, const T *p, T *grad);
+ *
+ *      };
+ *
+ * The solvers below are templated on the model, so the gradient is
+ * inlined into the accumulation loop instead of being called through a
+ * table of function pointers. A new diagnostic only needs a model
+ * header.
+ */
+
+/*
+ * Why a fit stopped, see NLLSStopTest(...)
+ */
+enum{ NLLS_STOP_MAXITER  = 0, //Ntries iterations without converging
+      NLLS_STOP_STEP     = 1, //Step within sqrt(TOL) standard errors
+      NLLS_STOP_RESIDUAL = 2, //Relative decrease of chi2 below TOL
+      NLLS_STOP_GRADIENT = 3, //Residuals orthogonal to the Jacobian within TOL
+      NLLS_STOP_EXACT    = 4  //chi2 zero to rounding
+};
+
+/*
+ * Goodness of fit statistics common to all models, see NLLSFit(...)
+ */
+struct NLLSStats{
+
+   double chi2;     //Weighted sum of squared residuals
+   double chi2_red; //Reduced chi^2, chi2 / (# points - Npar)
+   double R2;       //Coefficient of determination
+   double dparam2;  //Squared norm of the last parameter step
+   double step;     //Largest |step| of the last iteration [standard errors]
+   int    stop;     //Why the fit stopped, NLLS_STOP_*
+   int    Niter;    //Number of iterations
+   double scale;    //Robust scale of the residuals (robust loss, else 0)
+   unsigned long Noutliers; //# residuals beyond c * scale (robust loss)
+
+};
+
+/************************************************************************/
+/*
+ * NLLSStopName(...) is the reason a fit stopped, for printing
+ *
+ *      @param[in] int stop: NLLS_STOP_*
+ *      @return char * the reason
+ *
+ */
+inline const char *NLLSStopName(const int &stop){
+
+   switch(stop){
+
+      case NLLS_STOP_STEP     : return ("step");
+      case NLLS_STOP_RESIDUAL : return ("residual change");
+      case NLLS_STOP_GRADIENT : return ("gradient");
+      case NLLS_STOP_EXACT    : return ("exact fit");
+      default                 : return ("maximum # iterations");
+
+   }
+
+}
+
+/************************************************************************/
+/*
+ * NLLSStopTest(...) decides whether a Gauss-Newton iteration converged,
+ * on criteria that depend neither on the units nor on the magnitude of
+ * the parameters (Isat ~ 1e-6 A next to Te ~ 1 eV, x0 ~ 668 nm next to
+ * sigma2 ~ 5e-7 nm^2), in this order:
+ *        exact fit: chi2 <= DBL_EPSILON^2 * sum(w * y^2)
+ *        gradient : max |b[k]| / sqrt(a[k][k] * chi2) <= TOL, the cosine
+ *                   of the residuals and each column of sqrt(W) * A
+ *        step     : max |dparam[k]| / err[k] <= sqrt(TOL), the step of
+ *                   each parameter in its own standard error
+ *                   err[k] = sqrt(ainv[k][k] * s2)
+ *        residual : the predicted (b . dparam) and the actual decrease
+ *                   of chi2 since the last pass are both <= TOL * chi2
+ * The step is applied whatever the result, so the fit ends one step
+ * past the tested point.
+ *
+ *      @param[in] int Npar: # parameters
+ *      @param[in] double *a: AT * W * A (only the diagonal is read)
+ *      @param[in] double *ainv: (AT * W * A)^-1
+ *      @param[in] double *b: AT * W * dy
+ *      @param[in] double *dparam: the step ainv * b
+ *      @param[in] double chi2: chi^2 of this pass
+ *      @param[in] double chi2_prev: chi^2 of the last pass (< 0: none)
+ *      @param[in] double swy2: sum of w * y^2 of this pass
+ *      @param[in] double s2: variance of unit weight, chi2_red for an
+ *                            unweighted fit, else 1 (as for cov)
+ *      @param[in] double TOLERANCE: the tolerance (< 0: never converged)
+ *      @param[out] double step: max |dparam[k]| / err[k]
+ *      @return int NLLS_STOP_*, NLLS_STOP_MAXITER while not converged
+ *
+ */
+inline int NLLSStopTest(const unsigned int &Npar, const double *a, const double *ainv,
+                        const double *b, const double *dparam, const double &chi2,
+                        const double &chi2_prev, const double &swy2, const double &s2,
+                        const double &TOLERANCE, double &step){
+
+   double grad = 0.0, //Largest cosine of the residuals and a column
+          pred = 0.0; //Decrease of chi2 predicted for the step
+
+   step = 0.0;
+   for(unsigned int i = 0; i < Npar; i++){
+
+      const double var = ainv[i * Npar + i] * s2,
+                   aii = a[i * Npar + i];
+
+      step  = std::max(step, (var > 0.0) ? fabs(dparam[i]) / sqrt(var) : HUGE_VAL);
+      grad  = std::max(grad, ((aii > 0.0) && (chi2 > 0.0)) ? fabs(b[i]) / sqrt(aii * chi2)
+                                                           : 0.0);
+      pred += b[i] * dparam[i];
+
+   }
+
+   if(!(TOLERANCE >= 0.0)){ return (NLLS_STOP_MAXITER); }
+
+   if(chi2 <= DBL_EPSILON * DBL_EPSILON * swy2){ return (NLLS_STOP_EXACT); }
+
+   if(grad <= TOLERANCE){ return (NLLS_STOP_GRADIENT); }
+
+   if(step <= sqrt(TOLERANCE)){ return (NLLS_STOP_STEP); }
+
+   if((chi2_prev >= 0.0) && (pred <= TOLERANCE * chi2) &&
+      (fabs(chi2_prev - chi2) <= TOLERANCE * chi2)){ return (NLLS_STOP_RESIDUAL); }
+
+   return (NLLS_STOP_MAXITER);
+
+}
+
+/************************************************************************/
+/*
+ * The fit reads its data through a samples type with inlineable
+ * accessors, so data stored in another form (e.g. raw ADC codes, see
+ * adc_input.h) is converted inside the accumulation loop instead of
+ * being copied to double arrays first:
+ *
+ *      double X(i), Y(i), W(i); //Independent variable, measurement, weight
+ *      int Weighted();          //0 if all W(i) = 1
+ *
+ * ArraySamples reads plain double arrays. A samples type is a few
+ * pointers and constants and is passed by value, so its members stay
+ * in registers instead of being reloaded through a reference on every
+ * row (~20% of the pass).
+ */
+struct ArraySamples{
+
+   const double *x, *y, *w; //w = NULL for an unweighted fit
+
+   ArraySamples(const double *xi, const double *yi, const double *wi) :
+                                                   x(xi), y(yi), w(wi){}
+
+   double X(const unsigned long &i) const { return (x[i]); }
+
+   double Y(const unsigned long &i) const { return (y[i]); }
+
+   double W(const unsigned long &i) const { return ((NULL == w) ? 1.0 : w[i]); }
+
+   int Weighted() const { return (NULL != w); }
+
+};
+
+/************************************************************************/
+/*
+ * GridSamples reads measurements on a uniform grid x = x0 + i * dx, so
+ * the independent variable is two numbers instead of a column, e.g. a
+ * voltage sweep in fixed steps.
+ */
+struct GridSamples{
+
+   double x0, dx;           //First x and step
+   const double *y, *w;     //w = NULL for an unweighted fit
+
+   GridSamples(const double &x0i, const double &dxi, const double *yi,
+               const double *wi) : x0(x0i), dx(dxi), y(yi), w(wi){}
+
+   double X(const unsigned long &i) const { return (x0 + dx * i); }
+
+   double Y(const unsigned long &i) const { return (y[i]); }
+
+   double W(const unsigned long &i) const { return ((NULL == w) ? 1.0 : w[i]); }
+
+   int Weighted() const { return (NULL != w); }
+
+};
+
+/*
+ * A model that is odd in x for every p, f(-x) = -f(x) and so grad(-x) =
+ * -grad(x), specializes NLLSModelOdd with value 1 (see DoubleProbeModel)
+ */
+template<class Model>
+struct NLLSModelOdd{ enum{ value = 0 }; };
+
+/************************************************************************/
+/*
+ * NLLSMirror(...) pairs the samples about x = 0: it returns c2 such that
+ * X(c2 - i) = -X(i) for every row i whose partner c2 - i is a row, or
+ * -1 if the samples have no such pairs. Only a grid through (or half a
+ * step off) x = 0 has them, within 1e-9 steps; the partner then takes
+ * -X(i), off its grid point by that much at most.
+ *
+ *      @param[in] Samples S: the data
+ *      @param[in] long Npoints: # samples
+ *      @return long c2, twice the index of x = 0, or -1
+ *
+ */
+template<class Samples>
+inline long NLLSMirror(const Samples &S, const unsigned long &Npoints){
+
+   return (-1);
+
+}
+
+inline long NLLSMirror(const GridSamples &S, const unsigned long &Npoints){
+
+   const double c2 = -2.0 * S.x0 / S.dx,
+                r  = rint(c2);
+
+   if(!(fabs(c2 - r) <= 1.0E-9) || !(r > 0.0) || !(r < 2.0 * (Npoints - 1.0))){ return (-1); }
+
+   return ((long)r);
+
+}
+
+/************************************************************************/
+/*
+ * NLLSFitSamples<Model>(...) performs a Model::Npar parameter (weighted)
+ * nonlinear least squares curve fit by Gauss-Newton iteration:
+ *      http://mathworld.wolfram.com/NonlinearLeastSquaresFitting.html
+ *
+ * The normal equations AT * W * A and AT * W * dy are accumulated in
+ * the same pass that evaluates the residuals, so A is never stored. The
+ * statistics come from the sums of the last iteration, i.e. they are
+ * evaluated before the final (converged) step is applied:
+ *        chi2_red = chi2 / (Npoints - Npar)
+ *        R^2      = 1 - chi2 / (weighted total sum of squares)
+ *        cov      = (AT * W * A)^-1, scaled by chi2_red if the fit is
+ *                   unweighted (the noise level is then unknown)
+ *
+ * The parameters are normalized internally: AT * W * A is scaled to a
+ * unit diagonal (Jacobi scaling, p[k] * sqrt(a[k][k]) are the solved
+ * for parameters) before it is inverted, so LAPACK does not pivot on a
+ * matrix whose entries span the squared ratio of the parameter units
+ * (~1e12 for Isat and Te). The fit stops on the relative step, the
+ * relative change of chi2 or the gradient, see NLLSStopTest(...), and
+ * Stats.stop tells which.
+ *
+ * With a robust Loss (Huber, Tukey biweight) the fit is iteratively
+ * reweighted least squares, without an outer loop: the same pass
+ * multiplies the weight of each row by psi(u) / u of its residual
+ * u = dy * sqrt(w) / scale, so a spike (an arc, a cosmic) that sits
+ * beyond c * scale pulls on the fit with a bounded (Huber) or no
+ * (Tukey) force. The first pass is plain least squares, each pass keeps
+ * |dy| * sqrt(w) of its rows and sets the scale of the next one to
+ * their median absolute deviation, 1.4826 * median (O(Npoints) with
+ * nth_element), which a spike does not inflate. The fit stops once
+ * it is converged and the relative change of the scale is below 1e-3.
+ * chi2, the statistics and cov then include the robust weights, and
+ * Stats.Noutliers counts the residuals beyond c * scale. A redescending
+ * loss (Tukey) needs an initial guess in the right basin, as any fit
+ * does.
+ *
+ * An odd model (NLLSModelOdd) on samples mirrored about x = 0 (see
+ * NLLSMirror, a GridSamples sweep from -x to x) is evaluated only on
+ * one side: the row at -x takes -f and -grad of its partner, so each
+ * evaluation of the model serves two rows.
+ *
+ *      @param[in] Samples S: the data, see ArraySamples
+ *      @param[in] long Npoints: # samples
+ *      @param[in] int Ntries: maximum # iterations
+ *      @param[in] double TOLERANCE: convergence tolerance, see
+ *                                   NLLSStopTest (< 0: Ntries passes)
+ *      @param[in/out] double *param: Npar initial guess / final fit
+ *      @param[out] double *cov: Npar x Npar covariance matrix, row major
+ *      @param[out] NLLSStats Stats: fit statistics
+ *      @param[in] NLLSLoss Loss: robust loss (NULL = least squares)
+ *      @return int success/failure
+ *
+ */
+template<class Model, class Samples>
+int NLLSFitSamples(const Samples S, const unsigned long &Npoints,
+                   const unsigned int &Ntries, const double &TOLERANCE,
+                   double *param, double *cov, struct NLLSStats &Stats,
+                   const struct NLLSLoss *Loss = NULL){
+
+   const unsigned int Npar = Model::Npar;
+
+   //Relative change of the scale that ends a robust fit
+   const double SCALE_TOL = 1.0E-3;
+
+   const int robust = (NULL != Loss) && (NLLS_LOSS_L2 != Loss->type) &&
+                      (Npoints > Npar);
+
+   unsigned int it = 0;
+
+   int stop = NLLS_STOP_MAXITER; //Why the fit stopped
+
+   unsigned long Nout = 0; //# residuals beyond c * scale
+
+   //Rows i and c2 - i mirror each other about x = 0 (odd models only)
+   const long c2 = NLLSModelOdd<Model>::value ? NLLSMirror(S, Npoints) : -1;
+
+   std::vector<double> absr; //|dy| * sqrt(w) of the last pass (robust loss)
+
+   double At[Model::Npar],             //One row of the A matrix
+          a[Model::Npar * Model::Npar],    //Product of AT * W * A
+          an[Model::Npar * Model::Npar],   //AT * W * A scaled to a unit diagonal
+          ainv[Model::Npar * Model::Npar], //Inverse of AT * W * A
+          b[Model::Npar],              //Product of AT * W * dy
+          d[Model::Npar],              //1 / sqrt(diagonal of AT * W * A)
+          dparam[Model::Npar],         //The step ainv * b
+          *ainvp  = ainv,
+          chi2    = 0.0,  //Sum of w * dy^2
+          sw      = 0.0,  //Sum of w
+          swy     = 0.0,  //Sum of w * y
+          swy2    = 0.0,  //Sum of w * y^2
+          sstot   = 0.0,  //Total weighted sum of squares about the mean
+          chi2p   = -1.0, //chi2 of the last pass, < 0 = none
+          dparam2 = 1.0,  //Squared norm of the last parameter step
+          step    = 0.0,  //Largest |dparam| in standard errors
+          scale   = 0.0,  //Robust scale of the residuals, 0 = not yet known
+          dscale  = 0.0;  //Relative change of the scale
+
+   for(unsigned int i = 0; i < Npar * Npar; i++){ ainv[i] = 0.0; }
+
+   try{
+
+      absr.resize(robust ? Npoints : 0);
+
+   }catch(std::bad_alloc& ba){
+
+      std::cerr << "ERROR: NLLSFit residuals: " << ba.what() << std::endl;
+      return (0);
+
+   }
+
+   while((it < Ntries) && (NLLS_STOP_MAXITER == stop)){
+
+      for(unsigned int i = 0; i < Npar * Npar; i++){ a[i] = 0.0; }
+      for(unsigned int i = 0; i < Npar; i++){ b[i] = 0.0; }
+      chi2 = sw = swy = swy2 = 0.0;
+      Nout = 0;
+
+      //Adds one row of A to AT * W * A and AT * W * dy, given the model
+      //and its gradient At at that row times sgn (-1: at the mirror row)
+      auto add_row = [&](const unsigned long &row, const double &f, const double &sgn){
+
+         const double yt  = S.Y(row),
+                      dyt = yt - sgn * f;
+
+         double wt = S.W(row);
+
+         //IRLS weight of the residual, the scale is that of the last pass
+         if(robust){
+
+            absr[row] = fabs(dyt) * sqrt(wt);
+
+            if(scale > 0.0){
+
+               const double u  = absr[row] / scale,
+                            wu = NLLSLossWeight(*Loss, u);
+
+               Nout += (u > Loss->c);
+               wt   *= wu;
+
+            }
+
+         }
+
+         //Sums for the goodness of fit statistics
+         chi2 += wt * dyt * dyt;
+         sw   += wt;
+         swy  += wt * yt;
+         swy2 += wt * yt * yt;
+
+         for(unsigned int i = 0; i < Npar; i++){
+
+            b[i] += sgn * wt * At[i] * dyt;
+
+            for(unsigned int j = i; j < Npar; j++){
+
+               a[i * Npar + j] += wt * At[i] * At[j];
+
+            }
+
+         }
+
+      };
+
+      //Accumulate AT * W * A and AT * W * dy one row of A at a time. The
+      //mirror row of an odd model reuses the evaluation of its partner,
+      //which halves the transcendental work of a symmetric sweep.
+      for(unsigned long row = 0; row < Npoints; row++){
+
+         const long mirror = (c2 >= 0) ? c2 - (long)row : -1;
+
+         //Done with its partner
+         if((mirror >= 0) && (mirror < (long)row)){ continue; }
+
+         const double f = Model::EvalGrad(S.X(row), param, At);
+
+         add_row(row, f, 1.0);
+         if((mirror > (long)row) && (mirror < (long)Npoints)){ add_row(mirror, f, -1.0); }
+
+      }
+
+      //Only the upper triangle was accumulated
+      for(unsigned int i = 0; i < Npar; i++){
+
+         for(unsigned int j = 0; j < i; j++){ a[i * Npar + j] = a[j * Npar + i]; }
+
+      }
+
+      //Invert the normalized matrix, ainv = D * an^-1 * D
+      for(unsigned int i = 0; i < Npar; i++){
+
+         d[i] = (a[i * Npar + i] > 0.0) ? 1.0 / sqrt(a[i * Npar + i]) : 1.0;
+
+      }
+      for(unsigned int i = 0; i < Npar * Npar; i++){ an[i] = a[i] * d[i / Npar] * d[i % Npar]; }
+
+      if(!InvertMatrix(an, Npar, &ainvp)){
+
+         std::cerr << "ERROR: matrix inversion failed: ainv" << std::endl;
+         return (0);
+
+      }
+      for(unsigned int i = 0; i < Npar * Npar; i++){ ainv[i] *= d[i / Npar] * d[i % Npar]; }
+
+      //The step dparam = ainv * b
+      dparam2 = 0.0;
+      for(unsigned int i = 0; i < Npar; i++){
+
+         dparam[i] = 0.0;
+         for(unsigned int j = 0; j < Npar; j++){ dparam[i] += ainv[i * Npar + j] * b[j]; }
+         dparam2 += dparam[i] * dparam[i];
+
+      }
+
+      stop = NLLSStopTest(Npar, a, ainv, b, dparam, chi2, chi2p, swy2,
+                          (!S.Weighted() && (Npoints > Npar)) ? chi2 / (Npoints - Npar)
+                                                              : 1.0,
+                          TOLERANCE, step);
+      chi2p = chi2;
+
+      //Apply it
+      ++it;
+      for(unsigned int i = 0; i < Npar; i++){ param[i] += dparam[i]; }
+
+      if(robust){
+
+         double s = 0.0;
+
+         std::nth_element(absr.begin(), absr.begin() + Npoints / 2, absr.end());
+         s = 1.4826 * absr[Npoints / 2];
+
+         dscale = (s > 0.0) ? fabs(s - scale) / s : 0.0;
+         scale  = s;
+
+         //The weights of the next pass still move
+         if(dscale > SCALE_TOL){ stop = NLLS_STOP_MAXITER; }
+
+      }
+
+   }//End while loop checking convergence tolerance or max iterations
+
+   sstot = (sw > 0.0) ? swy2 - swy * swy / sw : 0.0;
+   Stats.chi2     = chi2;
+   Stats.chi2_red = (Npoints > Npar) ? chi2 / (Npoints - Npar) : 0.0;
+   Stats.R2       = (sstot > 0.0) ? 1.0 - chi2 / sstot : 0.0;
+   Stats.dparam2  = dparam2;
+   Stats.step     = step;
+   Stats.stop     = stop;
+   Stats.Niter    = it;
+   Stats.scale    = scale;
+   Stats.Noutliers = Nout;
+   for(unsigned int i = 0; i < Npar * Npar; i++){
+
+      cov[i] = ainv[i] * ((!S.Weighted() && (Npoints > Npar)) ? Stats.chi2_red : 1.0);
+
+   }
+
+   return (1);
+
+}
+
+/************************************************************************/
+/*
+ * NLLSFit<Model>(...) on double arrays, see NLLSFitSamples(...)
+ *
+ *      @param[in] double *x: independent variable
+ *      @param[in] double *y: measurements
+ *      @param[in] double *w: weights, normally 1 / sigma^2 (NULL = 1)
+ *      @param[in] int Npoints: length of the arrays
+ *
+ */
+template<class Model>
+int NLLSFit(const double *x, const double *y, const double *w,
+            const unsigned int &Npoints, const unsigned int &Ntries,
+            const double &TOLERANCE, double *param, double *cov,
+            struct NLLSStats &Stats, const struct NLLSLoss *Loss = NULL){
+
+   return (NLLSFitSamples<Model>(ArraySamples(x, y, w), Npoints, Ntries,
+                                 TOLERANCE, param, cov, Stats, Loss));
+
+}
+
+#endif
@@ -0,0 +1,66 @@
+// -----------------------------------------------------------------------
+//
+//                                   parallel_for.h V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef parallel_for_h
+#define parallel_for_h
+
+#include <vector>
+#include <thread>
+#include <atomic>
+
+/************************************************************************/
+/*
+ * DefaultThreads() returns the number of hardware threads (at least 1)
+ *
+ */
+inline unsigned int DefaultThreads(){
+
+   unsigned int Nthreads = std::thread::hardware_concurrency();
+
+   return ((0 == Nthreads) ? 1 : Nthreads);
+
+}
+
+/************************************************************************/
+/*
+ * ParallelFor(...) calls body(i, thread) for i = 0 ... N-1 on Nthreads
+ * threads. Indices are handed out one at a time from a shared counter,
+ * so uneven work (e.g. fits that need more iterations) balances itself.
+ * The order in which indices run is not defined, results that must not
+ * depend on the thread count should be stored by index.
+ *
+ *      @param[in] N: number of work items
+ *      @param[in] Nthreads: number of threads (0 = DefaultThreads())
+ *      @param[in] body: callable as body(unsigned int i, unsigned int thread)
+ *
+ */
+template<class Body>
+void ParallelFor(const unsigned int &N, unsigned int Nthreads, Body body){
+
+   if(0 == Nthreads){ Nthreads = DefaultThreads(); }
+   if(Nthreads > N){ Nthreads = (0 == N) ? 1 : N; }
+
+   std::atomic<unsigned int> next(0);
+
+   //Every thread pulls the next unclaimed index until none are left
+   auto worker = [&](unsigned int thread){
+
+      for(unsigned int i = next++; i < N; i = next++){ body(i, thread); }
+
+   };
+
+   std::vector<std::thread> pool;
+   for(unsigned int t = 1; t < Nthreads; t++){ pool.push_back(std::thread(worker, t)); }
+
+   worker(0);
+
+   for(unsigned int t = 0; t < pool.size(); t++){ pool[t].join(); }
+
+}
+
+#endif
@@ -0,0 +1,58 @@
+// -----------------------------------------------------------------------
+//
+//                                    pipeline.cpp V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#include <iostream>
+#include <iomanip>
+
+#include "pipeline.h"
+
+/************************************************************************/
+void PrintPipelineStats(const struct PipelineStats &Stats){
+
+   const char *stage[3] = {"read ", "fit  ", "write"},
+              *queue[2] = {"read -> fit  ", "fit  -> write"};
+
+   std::ios::fmtflags flags = std::cout.flags();
+   std::streamsize prec = std::cout.precision();
+
+   std::cout << std::fixed << std::setprecision(3);
+   std::cout << "Pipeline stages [s, summed over threads]:" << std::endl;
+   std::cout << " stage  threads  items  failed     busy  starved  blocked";
+   std::cout << std::endl;
+
+   for(int s = 0; s < 3; s++){
+
+      const struct PipelineStageStats &P = Stats.stage[s];
+
+      std::cout << " " << stage[s] << " " << std::setw(8) << P.Nthreads;
+      std::cout << std::setw(7) << P.Nitems << std::setw(8) << P.Nfailed;
+      std::cout << std::setw(9) << P.t_busy << std::setw(9) << P.t_starved;
+      std::cout << std::setw(9) << P.t_blocked << std::endl;
+
+   }
+
+   std::cout << "Pipeline queues [items]:" << std::endl;
+   for(int q = 0; q < 2; q++){
+
+      const struct QueueStats &Q = Stats.queue[q];
+
+      std::cout << " " << queue[q] << " : mean " << Q.mean << " / ";
+      std::cout << Q.capacity << ", max " << Q.max << ", full ";
+      std::cout << Q.t_full << " s, empty " << Q.t_empty << " s" << std::endl;
+
+   }
+
+   std::cout << " wall time [s]         : " << Stats.t_wall << std::endl;
+   std::cout << " sum of busy times [s] : ";
+   std::cout << Stats.stage[0].t_busy + Stats.stage[1].t_busy + Stats.stage[2].t_busy;
+   std::cout << std::endl;
+
+   std::cout.flags(flags);
+   std::cout.precision(prec);
+
+}//End function PrintPipelineStats
@@ -0,0 +1,387 @@
+// -----------------------------------------------------------------------
+//
+//                                     pipeline.h V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef pipeline_h
+#define pipeline_h
+
+#include <iostream>
+#include <exception>
+#include <vector>
+#include <deque>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+
+#include "parallel_for.h"
+
+/*
+ * Occupancy of a BoundedQueue over its lifetime
+ */
+struct QueueStats{
+
+   unsigned int capacity; //Largest # items the queue holds
+   unsigned int max;      //Largest # items it held
+   double mean;           //Time averaged # items
+   double t_full;         //Time producers waited on a full queue [s]
+   double t_empty;        //Time consumers waited on an empty queue [s]
+
+};
+
+/************************************************************************/
+/*
+ * BoundedQueue<T> moves items between threads. Push waits while the
+ * queue is full, which holds back a producer that is ahead of its
+ * consumers (backpressure) and bounds the memory of the items in
+ * flight. Pop waits while the queue is empty. Once Close() is called
+ * Pop drains the items left and then returns 0.
+ */
+template<class T>
+struct BoundedQueue{
+
+   typedef std::chrono::steady_clock Clock;
+
+   std::mutex lock;
+   std::condition_variable not_full,
+                           not_empty;
+   std::deque<T> items;
+   int closed;
+
+   struct QueueStats Stats;
+   Clock::time_point t0,     //Creation
+                     tlast;  //Last change of the occupancy
+   double area;              //Integral of the occupancy over time [s]
+
+   BoundedQueue(const unsigned int &capacity) : closed(0), area(0.0){
+
+      Stats.capacity = (0 == capacity) ? 1 : capacity;
+      Stats.max      = 0;
+      Stats.mean     = 0.0;
+      Stats.t_full   = 0.0;
+      Stats.t_empty  = 0.0;
+      t0 = tlast = Clock::now();
+
+   }
+
+   //Called with the lock held, before the occupancy changes
+   void Account(){
+
+      Clock::time_point t = Clock::now();
+
+      area += items.size() * std::chrono::duration<double>(t - tlast).count();
+      tlast = t;
+
+   }
+
+   int Push(T &item){
+
+      std::unique_lock<std::mutex> guard(lock);
+
+      if(items.size() >= Stats.capacity){
+
+         Clock::time_point t = Clock::now();
+         while(!closed && (items.size() >= Stats.capacity)){ not_full.wait(guard); }
+         Stats.t_full += std::chrono::duration<double>(Clock::now() - t).count();
+
+      }
+
+      if(closed){ return (0); }
+
+      Account();
+      items.push_back(std::move(item));
+      if(items.size() > Stats.max){ Stats.max = items.size(); }
+      not_empty.notify_one();
+
+      return (1);
+
+   }
+
+   int Pop(T &item){
+
+      std::unique_lock<std::mutex> guard(lock);
+
+      if(items.empty()){
+
+         Clock::time_point t = Clock::now();
+         while(!closed && items.empty()){ not_empty.wait(guard); }
+         Stats.t_empty += std::chrono::duration<double>(Clock::now() - t).count();
+
+      }
+
+      if(items.empty()){ return (0); }
+
+      Account();
+      item = std::move(items.front());
+      items.pop_front();
+      not_full.notify_one();
+
+      return (1);
+
+   }
+
+   void Close(){
+
+      std::lock_guard<std::mutex> guard(lock);
+
+      closed = 1;
+      not_full.notify_all();
+      not_empty.notify_all();
+
+   }
+
+   struct QueueStats GetStats(){
+
+      std::lock_guard<std::mutex> guard(lock);
+      double life = 0.0;
+
+      Account();
+      life = std::chrono::duration<double>(tlast - t0).count();
+      Stats.mean = (life > 0.0) ? area / life : 0.0;
+
+      return (Stats);
+
+   }
+
+};
+
+/*
+ * Thread counts and queue sizes of RunPipeline
+ */
+struct PipelineOptions{
+
+   unsigned int Nreaders; //Reader threads (0 = 1)
+   unsigned int Nworkers; //Fit threads (0 = DefaultThreads())
+   unsigned int Nqueue;   //Capacity of each queue (0 = 2 * Nworkers)
+
+};
+
+/*
+ * Time every stage spent working and waiting, summed over its threads.
+ * A stage whose input queue stays full (and whose producers are
+ * blocked) is the bottleneck, the stages around it are starved or
+ * blocked.
+ */
+struct PipelineStageStats{
+
+   unsigned int Nthreads; //# threads of the stage
+   unsigned long Nitems;  //# items processed
+   unsigned long Nfailed; //# items the stage returned 0 for
+   double t_busy;         //Time in the stage function [s]
+   double t_starved;      //Time waiting for input [s]
+   double t_blocked;      //Time waiting for room downstream [s]
+
+};
+
+struct PipelineStats{
+
+   double t_wall;                      //Wall time of the pipeline [s]
+   struct PipelineStageStats stage[3]; //read, fit, write
+   struct QueueStats queue[2];         //read -> fit, fit -> write
+
+};
+
+/************************************************************************/
+/*
+ * PipelineCall(...) runs a stage on one item. A stage that throws (a
+ * bad_alloc on a huge or corrupt file, ...) fails that item only, the
+ * other items of the batch go on.
+ *
+ *      @param[in] stage: callable as int f(unsigned int i, Item &item)
+ *      @param[in] unsigned int i: index of the item
+ *      @param[in/out] Item item: the item
+ *      @return int what the stage returned, 0 if it threw
+ *
+ */
+template<class Stage, class Item>
+int PipelineCall(Stage &stage, const unsigned int &i, Item &item){
+
+   try{
+
+      return (stage(i, item));
+
+   }catch(std::exception& e){
+
+      std::cerr << "ERROR: item " << i << " failed: " << e.what() << std::endl;
+
+   }catch(...){
+
+      std::cerr << "ERROR: item " << i << " failed" << std::endl;
+
+   }
+
+   return (0);
+
+}
+
+/************************************************************************/
+/*
+ * RunPipeline<Item>(...) processes N items in three overlapping stages:
+ *
+ *      read(i, item)   Nreaders threads, each takes the next index i
+ *      fit(i, item)    Nworkers threads
+ *      write(i, item)  the calling thread, one item at a time
+ *
+ * with a BoundedQueue between two stages, so at most
+ * Nreaders + 2 Nqueue + Nworkers + 1 items are in memory. An item is
+ * passed on also when a stage returns 0 (failure) or throws (see
+ * PipelineCall), so that the later stages can report it, write is its
+ * last owner. Items reach write in the order they are fitted, not in
+ * index order.
+ *
+ *      @param[in] N: number of items
+ *      @param[in] PipelineOptions Opts: thread counts and queue sizes
+ *      @param[in] read, fit, write: callable as int f(unsigned int i, Item &item)
+ *      @param[out] PipelineStats Stats: time spent by every stage
+ *
+ */
+template<class Item, class Read, class Fit, class Write>
+void RunPipeline(const unsigned int &N, const struct PipelineOptions &Opts,
+                 Read read, Fit fit, Write write, struct PipelineStats &Stats){
+
+   typedef std::chrono::steady_clock Clock;
+   typedef std::pair<unsigned int, Item> Slot;
+
+   const unsigned int Nreaders = (0 == Opts.Nreaders) ? 1 : Opts.Nreaders,
+                      Nworkers = (0 == Opts.Nworkers) ? DefaultThreads()
+                                                      : Opts.Nworkers,
+                      Nqueue   = (0 == Opts.Nqueue) ? 2 * Nworkers : Opts.Nqueue;
+
+   BoundedQueue<Slot> parsed(Nqueue),
+                      fitted(Nqueue);
+   std::atomic<unsigned int> next(0),
+                             readers_left(Nreaders),
+                             workers_left(Nworkers);
+   std::mutex stats_lock;
+   std::vector<std::thread> pool;
+   Clock::time_point t0 = Clock::now();
+
+   for(int s = 0; s < 3; s++){
+
+      struct PipelineStageStats &P = Stats.stage[s];
+      P.Nthreads = (0 == s) ? Nreaders : (1 == s) ? Nworkers : 1;
+      P.Nitems = P.Nfailed = 0;
+      P.t_busy = P.t_starved = P.t_blocked = 0.0;
+
+   }
+
+   //Adds the times of one thread to its stage
+   auto account = [&](const int &s, const unsigned long &Nitems,
+                      const unsigned long &Nfailed, const double &busy,
+                      const double &starved, const double &blocked){
+
+      std::lock_guard<std::mutex> guard(stats_lock);
+      Stats.stage[s].Nitems    += Nitems;
+      Stats.stage[s].Nfailed   += Nfailed;
+      Stats.stage[s].t_busy    += busy;
+      Stats.stage[s].t_starved += starved;
+      Stats.stage[s].t_blocked += blocked;
+
+   };
+
+   auto seconds = [](const Clock::time_point &a, const Clock::time_point &b){
+
+      return (std::chrono::duration<double>(b - a).count());
+
+   };
+
+   auto reader = [&](){
+
+      unsigned long Nitems = 0, Nfailed = 0;
+      double busy = 0.0, blocked = 0.0;
+
+      for(unsigned int i = next++; i < N; i = next++){
+
+         Slot slot;
+         slot.first = i;
+
+         Clock::time_point t = Clock::now();
+         Nfailed += !PipelineCall(read, i, slot.second);
+         Clock::time_point t1 = Clock::now();
+         parsed.Push(slot);
+         busy += seconds(t, t1);
+         blocked += seconds(t1, Clock::now());
+         ++Nitems;
+
+      }
+
+      account(0, Nitems, Nfailed, busy, 0.0, blocked);
+      if(0 == --readers_left){ parsed.Close(); }
+
+   };
+
+   auto worker = [&](){
+
+      unsigned long Nitems = 0, Nfailed = 0;
+      double busy = 0.0, starved = 0.0, blocked = 0.0;
+      Slot slot;
+
+      while(1){
+
+         Clock::time_point t = Clock::now();
+         if(!parsed.Pop(slot)){ starved += seconds(t, Clock::now()); break; }
+         Clock::time_point t1 = Clock::now();
+         Nfailed += !PipelineCall(fit, slot.first, slot.second);
+         Clock::time_point t2 = Clock::now();
+         fitted.Push(slot);
+         starved += seconds(t, t1);
+         busy += seconds(t1, t2);
+         blocked += seconds(t2, Clock::now());
+         ++Nitems;
+
+      }
+
+      account(1, Nitems, Nfailed, busy, starved, blocked);
+      if(0 == --workers_left){ fitted.Close(); }
+
+   };
+
+   for(unsigned int t = 0; t < Nreaders; t++){ pool.push_back(std::thread(reader)); }
+   for(unsigned int t = 0; t < Nworkers; t++){ pool.push_back(std::thread(worker)); }
+
+   //The writer serializes the output on this thread
+   {
+      unsigned long Nitems = 0, Nfailed = 0;
+      double busy = 0.0, starved = 0.0;
+      Slot slot;
+
+      while(1){
+
+         Clock::time_point t = Clock::now();
+         if(!fitted.Pop(slot)){ starved += seconds(t, Clock::now()); break; }
+         Clock::time_point t1 = Clock::now();
+         Nfailed += !PipelineCall(write, slot.first, slot.second);
+         starved += seconds(t, t1);
+         busy += seconds(t1, Clock::now());
+         ++Nitems;
+
+      }
+
+      account(2, Nitems, Nfailed, busy, starved, 0.0);
+   }
+
+   for(unsigned int t = 0; t < pool.size(); t++){ pool[t].join(); }
+
+   Stats.t_wall   = seconds(t0, Clock::now());
+   Stats.queue[0] = parsed.GetStats();
+   Stats.queue[1] = fitted.GetStats();
+
+}
+
+/************************************************************************/
+/*
+ * PrintPipelineStats(...) prints the time of every stage and the
+ * occupancy of the queues
+ *
+ *      @param[in] PipelineStats Stats: from RunPipeline
+ *
+ */
+void PrintPipelineStats(const struct PipelineStats &Stats);
+
+#endif
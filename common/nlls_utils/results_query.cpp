@@ -0,0 +1,163 @@
+// -----------------------------------------------------------------------
+//
+//                                  results_query.cpp V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+#include <getopt.h>
+
+#include "results_store.h"
+
+/************************************************************************/
+/*
+ * Parses "lo:hi", "lo:" (up from lo), ":hi" or a single value
+ */
+static int ParseRange(const char *s, int64_t &lo, int64_t &hi){
+
+   const char *colon = strchr(s, ':');
+   char *end = NULL;
+
+   if(NULL == colon){
+
+      lo = hi = strtoll(s, &end, 10);
+      return ((end != s) && ('\0' == *end));
+
+   }
+
+   if(colon != s){ lo = strtoll(s, &end, 10); if(end != colon){ return (0); } }
+   if('\0' != colon[1]){ hi = strtoll(colon + 1, &end, 10); if('\0' != *end){ return (0); } }
+
+   return (1);
+
+}
+
+/************************************************************************/
+static void print_usage(){
+
+   std::cout << "Usage:" << std::endl;
+   std::cout << "build/bin/ResultsQuery -D <store> [-s shot[:shot]] [-t ms:ms]";
+   std::cout << " [-c channel] [-k tool] [-n]" << std::endl;
+   std::cout << "   -D <store> : results store directory (see -D of the analyses)";
+   std::cout << std::endl;
+   std::cout << "   -s <range> : shot range lo:hi, lo: or :hi" << std::endl;
+   std::cout << "   -t <range> : shot time range [ms since the epoch]" << std::endl;
+   std::cout << "   -c <ch>    : channel" << std::endl;
+   std::cout << "   -k <tool>  : 1 DoubleProbeAnalysis, 2 LIF Gaussian, 3 LIF Voigt";
+   std::cout << std::endl;
+   std::cout << "   -n         : only count the matching rows" << std::endl;
+
+}
+
+/************************************************************************/
+/*
+ * Prints the rows of a results store (see nlls_utils/results_store.h)
+ * selected by shot, time, channel and tool, one per line
+ */
+int main(int argc, char** argv){
+
+   int opt   = 0,
+       count = 0;
+   char *dir = NULL;
+
+   struct ResultsFilter F = {INT64_MIN, INT64_MAX, INT64_MIN, INT64_MAX, -1, 0};
+   struct ResultsView V;
+   std::vector<uint64_t> rows;
+   unsigned long Nscanned = 0;
+
+   while((opt = getopt(argc, argv, "D:s:t:c:k:n")) != -1){
+
+      switch (opt) {
+
+         case 'D' : //store directory option
+
+            dir = optarg;
+            break;
+
+         case 's' : //shot range option
+
+            if(!ParseRange(optarg, F.shot_lo, F.shot_hi)){ print_usage(); return (-1); }
+            break;
+
+         case 't' : //time range option
+
+            if(!ParseRange(optarg, F.t_lo, F.t_hi)){ print_usage(); return (-1); }
+            break;
+
+         case 'c' : //channel option
+
+            F.channel = atoi(optarg);
+            break;
+
+         case 'k' : //tool option
+
+            F.tool = atoi(optarg);
+            break;
+
+         case 'n' : //count only option
+
+            count = 1;
+            break;
+
+         default :
+
+            print_usage();
+            return (-1);
+
+      }
+
+   }
+
+   if(NULL == dir){ print_usage(); return (-1); }
+
+   std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+   if(!ResultsOpen(dir, V)){ return (-1); }
+   ResultsQuery(V, F, rows, Nscanned);
+
+   std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+
+   if(!count){
+
+      struct ResultsRow R;
+
+      std::cout << "#shot channel tool t_shot[ms] t_run[ms] Npoints status Niter";
+      std::cout << " t_fit[s] chi2 chi2/dof R2";
+      for(int k = 0; k < ResultsRow::MAXPAR; k++){ std::cout << " p" << k << " err" << k; }
+      std::cout << std::endl;
+      std::cout.precision(10);
+
+      for(unsigned long j = 0; j < rows.size(); j++){
+
+         ResultsGet(V, rows[j], R);
+         std::cout << R.shot << " " << R.channel << " " << R.tool << " ";
+         std::cout << R.t_shot << " " << R.t_run << " " << R.Npoints << " ";
+         std::cout << R.status << " " << R.Niter << " " << R.t_fit << " ";
+         std::cout << R.chi2 << " " << R.chi2_red << " " << R.R2;
+         for(int k = 0; k < ResultsRow::MAXPAR; k++){
+
+            std::cout << " " << R.p[k] << " " << R.err[k];
+
+         }
+         std::cout << std::endl;
+
+      }
+
+   }
+
+   std::cout << "# " << rows.size() << " of " << V.Nrows << " rows, ";
+   std::cout << Nscanned << " of " << (V.Nrows + ResultsBlock - 1) / ResultsBlock;
+   std::cout << " blocks read, ";
+   std::cout << std::chrono::duration<double, std::milli>(t1 - t0).count();
+   std::cout << " ms" << std::endl;
+
+   ResultsClose(V);
+
+return (0);
+}
@@ -0,0 +1,513 @@
+// -----------------------------------------------------------------------
+//
+//                                 results_store.cpp V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "results_store.h"
+#include "input_stream.h"
+
+/*
+ * Meta file: magic, # columns, # rows
+ */
+static const char ResultsMagic[8] = {'P', 'E', 'R', 'S', 'T', 'O', 'R', '1'};
+
+struct ResultsMeta{
+
+   char magic[8];
+   uint64_t Ncols;
+   uint64_t Nrows;
+
+};
+
+/*
+ * Zone map entry of a block of rows
+ */
+struct ResultsZone{
+
+   int64_t shot_min, shot_max;
+   int64_t t_min, t_max;
+
+};
+
+/*
+ * A column: file name, bytes per value and offset in ResultsRow
+ */
+struct ResultsColumn{
+
+   std::string name;
+   size_t size;
+   size_t offset;
+
+};
+
+/************************************************************************/
+static std::vector<struct ResultsColumn> ResultsBuildColumns(){
+
+   struct ResultsColumn c[12] = {
+      {"shot",     8, offsetof(ResultsRow, shot)},
+      {"t_shot",   8, offsetof(ResultsRow, t_shot)},
+      {"t_run",    8, offsetof(ResultsRow, t_run)},
+      {"Npoints",  8, offsetof(ResultsRow, Npoints)},
+      {"channel",  4, offsetof(ResultsRow, channel)},
+      {"tool",     4, offsetof(ResultsRow, tool)},
+      {"Niter",    4, offsetof(ResultsRow, Niter)},
+      {"status",   4, offsetof(ResultsRow, status)},
+      {"t_fit",    8, offsetof(ResultsRow, t_fit)},
+      {"chi2",     8, offsetof(ResultsRow, chi2)},
+      {"chi2_red", 8, offsetof(ResultsRow, chi2_red)},
+      {"R2",       8, offsetof(ResultsRow, R2)}};
+
+   std::vector<struct ResultsColumn> cols(c, c + 12);
+
+   for(int k = 0; k < ResultsRow::MAXPAR; k++){
+
+      struct ResultsColumn p = {"p" + std::to_string(k), 8,
+                                offsetof(ResultsRow, p) + k * sizeof(double)},
+                           e = {"err" + std::to_string(k), 8,
+                                offsetof(ResultsRow, err) + k * sizeof(double)};
+      cols.push_back(p);
+      cols.push_back(e);
+
+   }
+
+   return (cols);
+
+}
+
+/*
+ * The columns, built once (a thread safe static since C++11)
+ */
+static const std::vector<struct ResultsColumn> &ResultsColumns(){
+
+   static const std::vector<struct ResultsColumn> cols = ResultsBuildColumns();
+
+   return (cols);
+
+}
+
+/************************************************************************/
+/*
+ * pread / pwrite of exactly n bytes
+ */
+static int ResultsPread(const int &fd, void *buf, const size_t &n, const off_t &off){
+
+   size_t done = 0;
+
+   while(done < n){
+
+      ssize_t r = pread(fd, (char *)buf + done, n - done, off + done);
+
+      if(r < 0){ if(EINTR == errno){ continue; } return (0); }
+      if(0 == r){ return (0); }
+      done += r;
+
+   }
+
+   return (1);
+
+}
+
+static int ResultsPwrite(const int &fd, const void *buf, const size_t &n, const off_t &off){
+
+   size_t done = 0;
+
+   while(done < n){
+
+      ssize_t r = pwrite(fd, (const char *)buf + done, n - done, off + done);
+
+      if(r < 0){ if(EINTR == errno){ continue; } return (0); }
+      done += r;
+
+   }
+
+   return (1);
+
+}
+
+/************************************************************************/
+int ResultsAppend(const char *dir, const std::vector<struct ResultsRow> &rows){
+
+   const std::vector<struct ResultsColumn> &cols = ResultsColumns();
+   const std::string base(dir);
+
+   struct ResultsMeta meta;
+   struct stat st;
+   std::vector<char> buf;
+   int fd  = -1,
+       res = 0;
+
+   if(rows.empty()){ return (1); }
+
+   if((0 != mkdir(dir, 0755)) && (EEXIST != errno)){
+
+      std::cerr << "ERROR: cannot create the results store " << dir << ": ";
+      std::cerr << strerror(errno) << std::endl;
+      return (0);
+
+   }
+
+   if((fd = open((base + "/meta").c_str(), O_RDWR | O_CREAT, 0644)) < 0){
+
+      std::cerr << "ERROR: cannot open " << base << "/meta: " << strerror(errno);
+      std::cerr << std::endl;
+      return (0);
+
+   }
+
+   //Every appender, in any process, waits here for the others
+   if(0 != flock(fd, LOCK_EX)){
+
+      std::cerr << "ERROR: cannot lock " << base << "/meta" << std::endl;
+      close(fd);
+      return (0);
+
+   }
+
+   //A new store gets its header under the lock
+   if((0 == fstat(fd, &st)) && (0 == st.st_size)){
+
+      memcpy(meta.magic, ResultsMagic, 8);
+      meta.Ncols = cols.size();
+      meta.Nrows = 0;
+
+      if(!ResultsPwrite(fd, &meta, sizeof(meta), 0)){
+
+         std::cerr << "ERROR: cannot initialize " << base << "/meta" << std::endl;
+         goto cleanup;
+
+      }
+
+   }
+
+   if(!ResultsPread(fd, &meta, sizeof(meta), 0) ||
+      (0 != memcmp(meta.magic, ResultsMagic, 8)) || (meta.Ncols != cols.size())){
+
+      std::cerr << "ERROR: " << dir << " is not a results store of this version";
+      std::cerr << std::endl;
+      goto cleanup;
+
+   }
+
+   //Columns first, rows past Nrows are not visible until Nrows moves
+   for(unsigned int c = 0; c < cols.size(); c++){
+
+      int cfd = open((base + "/" + cols[c].name + ".col").c_str(),
+                     O_WRONLY | O_CREAT, 0644);
+      int ok  = 0;
+
+      if(cfd < 0){
+
+         std::cerr << "ERROR: cannot open column " << cols[c].name << " of ";
+         std::cerr << dir << ": " << strerror(errno) << std::endl;
+         goto cleanup;
+
+      }
+
+      buf.resize(rows.size() * cols[c].size);
+      for(unsigned int i = 0; i < rows.size(); i++){
+
+         memcpy(&buf[i * cols[c].size], (const char *)&rows[i] + cols[c].offset,
+                                                               cols[c].size);
+
+      }
+
+      ok = ResultsPwrite(cfd, &buf[0], buf.size(), meta.Nrows * cols[c].size);
+      close(cfd);
+
+      if(!ok){
+
+         std::cerr << "ERROR: cannot write column " << cols[c].name << " of ";
+         std::cerr << dir << std::endl;
+         goto cleanup;
+
+      }
+
+   }
+
+   //Zone map of the blocks the new rows fall in
+   {
+      int zfd = open((base + "/zone").c_str(), O_RDWR | O_CREAT, 0644);
+      int ok  = (zfd >= 0);
+
+      for(uint64_t i = 0; ok && (i < rows.size()); ){
+
+         const uint64_t row   = meta.Nrows + i,
+                        block = row / ResultsBlock,
+                        end   = std::min((uint64_t)rows.size(),
+                                         i + ResultsBlock - row % ResultsBlock);
+         struct ResultsZone Z;
+
+         //An unfinished block already has an entry
+         if((row % ResultsBlock) > 0){
+
+            ok = ResultsPread(zfd, &Z, sizeof(Z), block * sizeof(Z));
+
+         }else{
+
+            Z.shot_min = Z.t_min = INT64_MAX;
+            Z.shot_max = Z.t_max = INT64_MIN;
+
+         }
+
+         for(; i < end; i++){
+
+            Z.shot_min = std::min(Z.shot_min, rows[i].shot);
+            Z.shot_max = std::max(Z.shot_max, rows[i].shot);
+            Z.t_min    = std::min(Z.t_min, rows[i].t_shot);
+            Z.t_max    = std::max(Z.t_max, rows[i].t_shot);
+
+         }
+
+         ok = ok && ResultsPwrite(zfd, &Z, sizeof(Z), block * sizeof(Z));
+
+      }
+
+      if(zfd >= 0){ close(zfd); }
+
+      if(!ok){
+
+         std::cerr << "ERROR: cannot update the zone map of " << dir << std::endl;
+         goto cleanup;
+
+      }
+   }
+
+   //Publish the rows
+   meta.Nrows += rows.size();
+   if(!ResultsPwrite(fd, &meta.Nrows, sizeof(meta.Nrows),
+                     offsetof(ResultsMeta, Nrows))){
+
+      std::cerr << "ERROR: cannot update " << base << "/meta" << std::endl;
+      goto cleanup;
+
+   }
+
+   res = 1;
+
+// Cleanup
+cleanup:
+
+   flock(fd, LOCK_UN);
+   close(fd);
+
+return (res);
+}//End function ResultsAppend
+
+/************************************************************************/
+int ResultsOpen(const char *dir, struct ResultsView &V){
+
+   const std::vector<struct ResultsColumn> &cols = ResultsColumns();
+   const std::string base(dir);
+
+   struct ResultsMeta meta;
+   int fd = -1,
+       ok = 0;
+
+   V.Nrows = 0;
+   V.col.assign(cols.size(), (const void *)NULL);
+   V.len.assign(cols.size(), 0);
+   V.zone.clear();
+
+   if((fd = open((base + "/meta").c_str(), O_RDONLY)) < 0){
+
+      std::cerr << "ERROR: no results store in " << dir << std::endl;
+      return (0);
+
+   }
+
+   //The row count under a shared lock, appends publish it last
+   flock(fd, LOCK_SH);
+   ok = ResultsPread(fd, &meta, sizeof(meta), 0);
+   flock(fd, LOCK_UN);
+   close(fd);
+
+   if(!ok || (0 != memcmp(meta.magic, ResultsMagic, 8)) ||
+      (meta.Ncols != cols.size())){
+
+      std::cerr << "ERROR: " << dir << " is not a results store of this version";
+      std::cerr << std::endl;
+      return (0);
+
+   }
+
+   V.Nrows = meta.Nrows;
+   if(0 == V.Nrows){ return (1); }
+
+   for(unsigned int c = 0; c < cols.size(); c++){
+
+      int cfd = open((base + "/" + cols[c].name + ".col").c_str(), O_RDONLY);
+      void *p = MAP_FAILED;
+
+      V.len[c] = V.Nrows * cols[c].size;
+      if(cfd >= 0){
+
+         p = mmap(NULL, V.len[c], PROT_READ, MAP_SHARED, cfd, 0);
+         close(cfd);
+
+      }
+
+      if(MAP_FAILED == p){
+
+         std::cerr << "ERROR: cannot map column " << cols[c].name << " of ";
+         std::cerr << dir << std::endl;
+         V.len[c] = 0;
+         ResultsClose(V);
+         return (0);
+
+      }
+
+      V.col[c] = p;
+
+   }
+
+   //The zone map is small (32 bytes per block), read it whole
+   {
+      const uint64_t Nblocks = (V.Nrows + ResultsBlock - 1) / ResultsBlock;
+      int zfd = open((base + "/zone").c_str(), O_RDONLY);
+
+      V.zone.resize(4 * Nblocks);
+      ok = (zfd >= 0) && ResultsPread(zfd, &V.zone[0], V.zone.size() * 8, 0);
+      if(zfd >= 0){ close(zfd); }
+
+      if(!ok){
+
+         std::cerr << "ERROR: cannot read the zone map of " << dir << std::endl;
+         ResultsClose(V);
+         return (0);
+
+      }
+   }
+
+   return (1);
+
+}//End function ResultsOpen
+
+/************************************************************************/
+void ResultsClose(struct ResultsView &V){
+
+   for(unsigned int c = 0; c < V.col.size(); c++){
+
+      if((NULL != V.col[c]) && (V.len[c] > 0)){ munmap((void *)V.col[c], V.len[c]); }
+
+   }
+
+   V.Nrows = 0;
+   V.col.clear();
+   V.len.clear();
+   V.zone.clear();
+
+}//End function ResultsClose
+
+/************************************************************************/
+int ResultsQuery(const struct ResultsView &V, const struct ResultsFilter &F,
+                 std::vector<uint64_t> &rows, unsigned long &Nscanned){
+
+   //Columns in the order of ResultsColumns()
+   const int64_t *shot    = (const int64_t *)V.col[0],
+                 *t_shot  = (const int64_t *)V.col[1];
+   const int32_t *channel = (const int32_t *)V.col[4],
+                 *tool    = (const int32_t *)V.col[5];
+
+   rows.clear();
+   Nscanned = 0;
+
+   for(uint64_t b = 0; b * ResultsBlock < V.Nrows; b++){
+
+      const int64_t *Z = &V.zone[4 * b];
+      const uint64_t end = std::min(V.Nrows, (b + 1) * ResultsBlock);
+
+      if((Z[1] < F.shot_lo) || (Z[0] > F.shot_hi) ||
+         (Z[3] < F.t_lo)    || (Z[2] > F.t_hi)){ continue; }
+
+      ++Nscanned;
+
+      for(uint64_t i = b * ResultsBlock; i < end; i++){
+
+         if((shot[i] >= F.shot_lo) && (shot[i] <= F.shot_hi) &&
+            (t_shot[i] >= F.t_lo) && (t_shot[i] <= F.t_hi) &&
+            ((F.channel < 0) || (channel[i] == F.channel)) &&
+            ((0 == F.tool) || (tool[i] == F.tool))){
+
+            rows.push_back(i);
+
+         }
+
+      }
+
+   }
+
+   return (1);
+
+}//End function ResultsQuery
+
+/************************************************************************/
+void ResultsGet(const struct ResultsView &V, const uint64_t &i,
+                struct ResultsRow &R){
+
+   const std::vector<struct ResultsColumn> &cols = ResultsColumns();
+
+   for(unsigned int c = 0; c < cols.size(); c++){
+
+      memcpy((char *)&R + cols[c].offset,
+             (const char *)V.col[c] + i * cols[c].size, cols[c].size);
+
+   }
+
+}//End function ResultsGet
+
+/************************************************************************/
+int64_t ResultsShotFromName(const char *filename){
+
+   std::string stem = InputStem(filename);
+   size_t slash = stem.find_last_of('/'),
+          last  = std::string::npos,
+          first = 0;
+
+   if(std::string::npos != slash){ stem = stem.substr(slash + 1); }
+
+   last = stem.find_last_of("0123456789");
+   if(std::string::npos == last){ return (-1); }
+
+   first = stem.find_last_not_of("0123456789", last);
+   first = (std::string::npos == first) ? 0 : first + 1;
+
+   return (strtoll(stem.substr(first, last - first + 1).c_str(), NULL, 10));
+
+}//End function ResultsShotFromName
+
+/************************************************************************/
+int64_t ResultsFileTime(const char *filename){
+
+   struct stat st;
+
+   if(0 != stat(filename, &st)){ return (0); }
+
+   return ((int64_t)st.st_mtim.tv_sec * 1000 + st.st_mtim.tv_nsec / 1000000);
+
+}//End function ResultsFileTime
+
+/************************************************************************/
+int64_t ResultsNow(){
+
+   return (std::chrono::duration_cast<std::chrono::milliseconds>(
+              std::chrono::system_clock::now().time_since_epoch()).count());
+
+}//End function ResultsNow
@@ -0,0 +1,165 @@
+// -----------------------------------------------------------------------
+//
+//                                  results_store.h V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef results_store_h
+#define results_store_h
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+/*
+ * Analyses that write to a store, the meaning of the parameter columns
+ */
+enum ResultsTool{ TOOL_DOUBLEPROBE = 1, //(Isat [A], Te [eV])
+                  TOOL_LIF_GAUSS   = 2, //(x0 [nm], sigma2 [nm^2], Ao, Bo)
+                  TOOL_LIF_VOIGT   = 3  //(x0, sigma2, gamma [nm], Ao, Bo)
+};
+
+/*
+ * One fit as a row of the store. Unused parameter slots are NaN.
+ */
+struct ResultsRow{
+
+   enum{ MAXPAR = 6 };
+
+   int64_t shot;         //Shot number (-1 = unknown)
+   int64_t t_shot;       //Time of the shot, ms since the epoch
+   int64_t t_run;        //Time of the analysis, ms since the epoch
+   int64_t Npoints;      //# samples fitted
+   int32_t channel;      //Digitizer / probe channel
+   int32_t tool;         //ResultsTool
+   int32_t Niter;        //# iterations
+   int32_t status;       //1 = converged fit, 0 = failed, -k = rejected by
+                         //triage for reason k (see triage.h)
+   double  t_fit;        //Wall time of the fit [s]
+   double  chi2;         //Weighted sum of squared residuals
+   double  chi2_red;     //Reduced chi^2
+   double  R2;           //Coefficient of determination
+   double  p[MAXPAR];    //Parameters
+   double  err[MAXPAR];  //Standard errors of the parameters
+
+};
+
+/*
+ * Read only view of a store. Every column is an array of Nrows values
+ * mapped from its file, rows appended after ResultsOpen are not seen.
+ */
+struct ResultsView{
+
+   uint64_t Nrows;                //# rows visible
+   std::vector<const void *> col; //One mapped array per column
+   std::vector<size_t> len;       //Mapped length of every column [bytes]
+   std::vector<int64_t> zone;     //Zone map, see ResultsQuery
+
+};
+
+/*
+ * Selection of rows, every condition is inclusive
+ */
+struct ResultsFilter{
+
+   int64_t shot_lo, shot_hi; //Shot range
+   int64_t t_lo, t_hi;       //Range of t_shot [ms]
+   int32_t channel;          //Channel (-1 = any)
+   int32_t tool;             //ResultsTool (0 = any)
+
+};
+
+/************************************************************************/
+/*
+ * ResultsAppend(...) appends rows to the store in directory dir and
+ * creates the store if needed. The store is a directory of column files
+ * (one little endian array per field of ResultsRow), a zone map and a
+ * meta file with the row count. Appends from any number of processes
+ * are serialized by an exclusive flock on the meta file. The columns
+ * and the zone map are written first and the new row count last, so a
+ * reader never sees a partial row.
+ *
+ * Rows are never rewritten, the store only grows. Only one thread per
+ * process may append at a time (flock does not exclude the threads of
+ * a process), in a batch that is the pipeline's writer.
+ *
+ *      @param[in] char *dir: the store directory
+ *      @param[in] std::vector rows: the rows to append
+ *      @return int success/failure
+ *
+ */
+int ResultsAppend(const char *dir, const std::vector<struct ResultsRow> &rows);
+
+/************************************************************************/
+/*
+ * ResultsOpen(...) maps the columns of a store for reading
+ *
+ *      @param[in] char *dir: the store directory
+ *      @param[out] ResultsView V: the view
+ *      @return int success/failure
+ *
+ */
+int ResultsOpen(const char *dir, struct ResultsView &V);
+
+/************************************************************************/
+/*
+ * ResultsClose(...) unmaps the columns
+ *
+ *      @param[in] ResultsView V: the view
+ *
+ */
+void ResultsClose(struct ResultsView &V);
+
+/************************************************************************/
+/*
+ * ResultsQuery(...) returns the rows matching a filter in row (append)
+ * order. The zone map holds the shot and t_shot range of every block of
+ * ResultsBlock rows, so blocks outside the filter are skipped without
+ * reading their rows. Shots are analyzed roughly in order, so a time or
+ * shot range touches only a few blocks.
+ *
+ *      @param[in] ResultsView V: the view
+ *      @param[in] ResultsFilter F: the selection
+ *      @param[out] std::vector rows: the matching row indices
+ *      @param[out] unsigned long Nscanned: # blocks read
+ *      @return int success/failure
+ *
+ */
+int ResultsQuery(const struct ResultsView &V, const struct ResultsFilter &F,
+                 std::vector<uint64_t> &rows, unsigned long &Nscanned);
+
+/************************************************************************/
+/*
+ * ResultsGet(...) gathers row i of a view into a ResultsRow
+ *
+ *      @param[in] ResultsView V: the view
+ *      @param[in] uint64_t i: the row
+ *      @param[out] ResultsRow R: its fields
+ *
+ */
+void ResultsGet(const struct ResultsView &V, const uint64_t &i,
+                struct ResultsRow &R);
+
+/************************************************************************/
+/*
+ * ResultsShotFromName(...) takes the shot number from the last run of
+ * digits in the stem of a file name (shot_012345.dat.gz -> 12345), -1
+ * if there is none. ResultsFileTime(...) returns the modification time
+ * of a file in ms since the epoch (0 if it does not exist), used as
+ * the time of the shot when none is given. ResultsNow() returns the
+ * current time in ms since the epoch.
+ */
+int64_t ResultsShotFromName(const char *filename);
+
+int64_t ResultsFileTime(const char *filename);
+
+int64_t ResultsNow();
+
+/*
+ * # rows summarized by one zone map entry
+ */
+const uint64_t ResultsBlock = 1024;
+
+#endif
@@ -0,0 +1,59 @@
+// -----------------------------------------------------------------------
+//
+//                                  robust_loss.cpp V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#include <string>
+#include <stdlib.h>
+
+#include "robust_loss.h"
+
+/************************************************************************/
+int NLLSLossParse(const char *spec, struct NLLSLoss &L){
+
+   const std::string s(spec);
+   const size_t comma = s.find(',');
+   const std::string name = s.substr(0, comma);
+
+   L.type = NLLS_LOSS_L2;
+   L.c    = 0.0;
+
+   if("huber" == name){
+
+      L.type = NLLS_LOSS_HUBER;
+      L.c    = NLLSHuberC;
+
+   }else if("tukey" == name){
+
+      L.type = NLLS_LOSS_TUKEY;
+      L.c    = NLLSTukeyC;
+
+   }else if("l2" != name){
+
+      return (0);
+
+   }
+
+   if(std::string::npos != comma){
+
+      char *end = NULL;
+
+      L.c = strtod(spec + comma + 1, &end);
+      if((end == spec + comma + 1) || ('\0' != *end) || !(L.c > 0.0)){ return (0); }
+
+   }
+
+   return (1);
+
+}//End function NLLSLossParse
+
+/************************************************************************/
+const char *NLLSLossName(const struct NLLSLoss &L){
+
+   return ((NLLS_LOSS_HUBER == L.type) ? "huber" :
+           (NLLS_LOSS_TUKEY == L.type) ? "tukey" : "l2");
+
+}//End function NLLSLossName
@@ -0,0 +1,86 @@
+// -----------------------------------------------------------------------
+//
+//                                   robust_loss.h V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef robust_loss_h
+#define robust_loss_h
+
+#include <math.h>
+
+/*
+ * Loss functions of the fit, see NLLSFitSamples(...). A zero struct
+ * NLLSLoss is the plain least squares fit.
+ */
+enum{ NLLS_LOSS_L2    = 0, //Least squares
+      NLLS_LOSS_HUBER = 1, //Quadratic within c sigma, linear beyond
+      NLLS_LOSS_TUKEY = 2  //Tukey biweight, 0 weight beyond c sigma
+};
+
+/*
+ * Tuning constants of 95% efficiency for Gaussian noise
+ */
+const double NLLSHuberC = 1.345;
+const double NLLSTukeyC = 4.685;
+
+struct NLLSLoss{
+
+   int    type; //NLLS_LOSS_L2, _HUBER or _TUKEY
+   double c;    //Tuning constant [units of the residual scale]
+
+};
+
+/************************************************************************/
+/*
+ * NLLSLossParse(...) reads a loss given as "huber", "tukey" or "l2",
+ * optionally followed by the tuning constant, e.g. "tukey,3.5"
+ *
+ *      @param[in] char *spec: the loss
+ *      @param[out] struct NLLSLoss L: the loss
+ *      @return int success/failure
+ *
+ */
+int NLLSLossParse(const char *spec, struct NLLSLoss &L);
+
+/************************************************************************/
+/*
+ * NLLSLossName(...) is the name of a loss, as NLLSLossParse reads it
+ *
+ *      @param[in] struct NLLSLoss L: the loss
+ *      @return char * the name
+ *
+ */
+const char *NLLSLossName(const struct NLLSLoss &L);
+
+/************************************************************************/
+/*
+ * NLLSLossWeight(...) is the IRLS weight psi(u) / u of a residual u in
+ * units of the residual scale
+ *
+ *      @param[in] struct NLLSLoss L: the loss
+ *      @param[in] double u: the scaled residual
+ *      @return double the weight, 0 to 1
+ *
+ */
+inline double NLLSLossWeight(const struct NLLSLoss &L, const double &u){
+
+   const double au = fabs(u);
+
+   if(NLLS_LOSS_HUBER == L.type){ return ((au <= L.c) ? 1.0 : L.c / au); }
+
+   if(NLLS_LOSS_TUKEY == L.type){
+
+      const double t = 1.0 - (u / L.c) * (u / L.c);
+
+      return ((au < L.c) ? t * t : 0.0);
+
+   }
+
+   return (1.0);
+
+}
+
+#endif
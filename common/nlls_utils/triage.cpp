@@ -0,0 +1,28 @@
+// -----------------------------------------------------------------------
+//
+//                                     triage.cpp V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#include "triage.h"
+
+/************************************************************************/
+const char *TriageName(const int &reason){
+
+   switch(reason){
+
+      case TRIAGE_OK          : return ("ok");
+      case TRIAGE_TOO_FEW     : return ("too_few");
+      case TRIAGE_NONFINITE   : return ("nonfinite");
+      case TRIAGE_FLAT        : return ("flat");
+      case TRIAGE_SATURATED   : return ("saturated");
+      case TRIAGE_NO_COVERAGE : return ("no_coverage");
+      case TRIAGE_LOW_SNR     : return ("low_snr");
+
+   }
+
+   return ("unknown");
+
+}//End function TriageName
@@ -0,0 +1,253 @@
+// -----------------------------------------------------------------------
+//
+//                                      triage.h V 0.01
+//
+//                                (c) Brian Lynch February, 2015
+//
+// -----------------------------------------------------------------------
+
+#ifndef triage_h
+#define triage_h
+
+#include <math.h>
+#include <algorithm>
+
+/*
+ * Why a trace was rejected before its fit, see Triage(...). The order
+ * is that of the tests, a trace gets the first reason that applies.
+ */
+enum{ TRIAGE_OK          = 0, //Fit it
+      TRIAGE_TOO_FEW     = 1, //Fewer samples than the fit needs
+      TRIAGE_NONFINITE   = 2, //A nan or inf sample
+      TRIAGE_FLAT        = 3, //Every measurement the same
+      TRIAGE_SATURATED   = 4, //Too many samples on the rails of the digitizer
+      TRIAGE_NO_COVERAGE = 5, //The independent variable misses the feature
+      TRIAGE_LOW_SNR     = 6  //The signal is lost in the noise
+};
+
+/*
+ * What the independent variable must cover
+ */
+enum{ TRIAGE_COVER_NONE = 0, //Anything
+      TRIAGE_COVER_ZERO = 1, //Both signs, e.g. the sweep of an odd I-V trace
+      TRIAGE_COVER_PEAK = 2  //The maximum of y, falling to half on both sides
+};
+
+/*
+ * Default thresholds: 5% of the samples pinned on one rail and a signal
+ * rms of one noise rms. Pure noise has a signal rms of ~N^-1/4 noise
+ * rms, a usable trace several, a narrow peak of a few samples ~5 (its
+ * steps count as noise).
+ */
+const double TriageSatFrac = 0.05;
+const double TriageSNRMin  = 1.0;
+
+struct TriageOptions{
+
+   unsigned long Nmin; //Fewest samples, e.g. 2 Npar
+   double sat_frac;    //Largest fraction of the samples pinned on a rail
+   double snr_min;     //Smallest signal rms / noise rms
+   int cover;          //TRIAGE_COVER_NONE, _ZERO or _PEAK
+   double full_lo,     //Full scale of the digitizer in units of y, e.g. the
+          full_hi;     //calibrated extreme codes (-HUGE_VAL, HUGE_VAL: none)
+
+};
+
+/*
+ * What Triage(...) found
+ */
+struct TriageStats{
+
+   unsigned long N;          //# samples
+   unsigned long Nnonfinite; //# samples with a nan or inf
+   unsigned long Nlo, Nhi;   //# samples on the min and on the max of y
+   unsigned long Nrun;       //Longest run of successive samples on an extreme
+   unsigned long Nrepeat;    //# successive equal samples off the min and max
+   unsigned long Nfull;      //# samples on or beyond the declared full scale
+   double xmin, xmax;        //Range of x
+   double ymin, ymax;        //Range of y
+   double xpeak;             //x of the max of y
+   double noise;             //Noise rms, from the differences of successive y
+   double snr;               //Signal rms / noise rms (inf without noise)
+   int reason;               //TRIAGE_OK or why the trace was rejected
+
+};
+
+/************************************************************************/
+/*
+ * TriageName(...) is the printable name of a TRIAGE_ reason
+ *
+ *      @param[in] int reason: the reason
+ *      @return char * the name
+ *
+ */
+const char *TriageName(const int &reason);
+
+/************************************************************************/
+/*
+ * Triage<Samples>(...) classifies a trace before its fit, from one pass
+ * over the samples (any samples type of NLLSFitSamples, see
+ * nlls_solver.h, so raw ADC codes are not converted first) without
+ * allocating, and a second for TRIAGE_COVER_PEAK. A trace that cannot
+ * fit would take every iteration of the solver; it is rejected with the
+ * first reason of
+ *
+ *      TOO_FEW     N < Opts.Nmin
+ *      NONFINITE   a nan or inf x or y
+ *      FLAT        ymin = ymax
+ *      SATURATED   more than Opts.sat_frac of the samples, and more than
+ *                  3, on or beyond the declared full scale, or in one
+ *                  run of successive samples on ymin or on ymax while
+ *                  the trace repeats no value anywhere else
+ *      NO_COVERAGE x misses what Opts.cover asks for: both signs of x,
+ *                  or samples below half the peak (above ymin) on both
+ *                  sides of it, else the scan stops on the line
+ *      LOW_SNR     signal rms / noise rms < Opts.snr_min
+ *
+ * A clipping digitizer holds its rail while the signal is beyond it.
+ * Values on ymin or ymax alone are no evidence: a physical plateau
+ * written with a few digits, or integer counts on a zero background,
+ * repeat their extremes too, but then also repeat values off them. So
+ * without a declared full scale only a run in a trace whose noise never
+ * repeats a value is clipping.
+ *
+ * The noise variance is half the mean square difference of successive
+ * y, which the smooth signal of a sampled sweep hardly adds to, and the
+ * signal variance that of y less the noise. The sums are taken about
+ * the first sample, so an offset does not cancel them.
+ *
+ *      @param[in] Samples S: the trace
+ *      @param[in] unsigned long Npoints: # samples
+ *      @param[in] struct TriageOptions Opts: thresholds
+ *      @param[out] struct TriageStats T: what was found, T.reason
+ *      @return int 1 if the trace is to be fitted (TRIAGE_OK)
+ *
+ */
+template<class Samples>
+int Triage(const Samples S, const unsigned long &Npoints,
+           const struct TriageOptions &Opts, struct TriageStats &T){
+
+   const double Nrail = fmax(Opts.sat_frac * Npoints, 3.0);
+
+   unsigned long run_lo = 0, //Runs on ymin and ymax: the current one, the
+                 run_hi = 0, //longest and the # runs
+                 Lrun_lo = 0,
+                 Lrun_hi = 0,
+                 Nrun_lo = 0,
+                 Nrun_hi = 0,
+                 Nsame = 0;  //# successive equal samples
+
+   double y0 = 0.0,  //The first finite y
+          yp = 0.0,  //The previous finite y
+          sy = 0.0,  //Sums of y - y0, (y - y0)^2 and of the squared differences
+          syy = 0.0,
+          sdd = 0.0,
+          var = 0.0;
+   unsigned long Nd = 0;
+
+   T.N = Npoints;
+   T.Nnonfinite = T.Nlo = T.Nhi = T.Nrun = T.Nrepeat = T.Nfull = 0;
+   T.xmin = T.xmax = T.ymin = T.ymax = T.xpeak = 0.0;
+   T.noise = T.snr = 0.0;
+   T.reason = TRIAGE_OK;
+
+   for(unsigned long i = 0; i < Npoints; i++){
+
+      const double x = S.X(i),
+                   y = S.Y(i);
+
+      if(!isfinite(x) || !isfinite(y)){ T.Nnonfinite++; continue; }
+
+      if(0 == Nd){
+
+         T.xmin = T.xmax = T.xpeak = x;
+         y0 = yp = T.ymin = T.ymax = y;
+
+      }
+
+      const int same = (Nd > 0) && (y == yp);
+
+      //A new extreme restarts the count and the runs of samples on it
+      if(y < T.ymin){ T.ymin = y; T.Nlo = Lrun_lo = Nrun_lo = 0; }
+      if(y > T.ymax){ T.ymax = y; T.xpeak = x; T.Nhi = Lrun_hi = Nrun_hi = 0; }
+      if(y == T.ymin){
+
+         T.Nlo++;
+         run_lo = same ? run_lo + 1 : 1;
+         Nrun_lo += !same;
+         Lrun_lo = std::max(Lrun_lo, run_lo);
+
+      }
+      if(y == T.ymax){
+
+         T.Nhi++;
+         run_hi = same ? run_hi + 1 : 1;
+         Nrun_hi += !same;
+         Lrun_hi = std::max(Lrun_hi, run_hi);
+
+      }
+      Nsame   += same;
+      T.Nfull += (y <= Opts.full_lo) || (y >= Opts.full_hi);
+      T.xmin = (x < T.xmin) ? x : T.xmin;
+      T.xmax = (x > T.xmax) ? x : T.xmax;
+
+      sy  += y - y0;
+      syy += (y - y0) * (y - y0);
+      sdd += (y - yp) * (y - yp);
+      yp = y;
+      Nd++;
+
+   }
+
+   if((Npoints < 2) || (Npoints < Opts.Nmin)){ T.reason = TRIAGE_TOO_FEW; return (0); }
+   if(T.Nnonfinite > 0){ T.reason = TRIAGE_NONFINITE; return (0); }
+   if(!(T.ymax > T.ymin)){ T.reason = TRIAGE_FLAT; return (0); }
+
+   //The successive equal samples inside the runs on the extremes are
+   //not repeats of the noise
+   T.Nrun    = std::max(Lrun_lo, Lrun_hi);
+   T.Nrepeat = Nsame - (T.Nlo - Nrun_lo) - (T.Nhi - Nrun_hi);
+
+   if((T.Nfull > Nrail) || ((T.Nrun > Nrail) && (0 == T.Nrepeat))){
+
+      T.reason = TRIAGE_SATURATED;
+      return (0);
+
+   }
+
+   if((TRIAGE_COVER_ZERO == Opts.cover) && !((T.xmin < 0.0) && (T.xmax > 0.0))){
+
+      T.reason = TRIAGE_NO_COVERAGE;
+      return (0);
+
+   }
+
+   if(TRIAGE_COVER_PEAK == Opts.cover){
+
+      const double half = 0.5 * (T.ymin + T.ymax);
+      int left  = 0,
+          right = 0;
+
+      for(unsigned long i = 0; i < Npoints; i++){
+
+         const double x = S.X(i);
+
+         if(S.Y(i) < half){ left |= (x < T.xpeak); right |= (x > T.xpeak); }
+
+      }
+
+      if(!(left && right)){ T.reason = TRIAGE_NO_COVERAGE; return (0); }
+
+   }
+
+   T.noise = sqrt(0.5 * sdd / (Npoints - 1));
+   var = syy / Npoints - (sy / Npoints) * (sy / Npoints) - T.noise * T.noise;
+   T.snr = (T.noise > 0.0) ? sqrt(fmax(var, 0.0)) / T.noise : INFINITY;
+
+   if(T.snr < Opts.snr_min){ T.reason = TRIAGE_LOW_SNR; return (0); }
+
+   return (1);
+
+}
+
+#endif